@@ -0,0 +1,215 @@
+/**
+ * This application measures how the cost of one sample_distributor
+ * general_work() call changes with the numbers of inputs and outputs.
+ *
+ * It connects a sample_distributor to buffers directly, without a
+ * flowgraph or scheduler. Before each call it writes a burst of items,
+ * ending with a "burst_end" tag, to every input that has space and
+ * discards everything on the outputs, so every call has the same amount of
+ * work available. Only the general_work() calls are timed.
+ *
+ * For each combination of inputs and outputs, it prints the time per call
+ * and the time per item delivered to an output. When there are more inputs
+ * than outputs, the time per call shows how the cost of finding waiting
+ * inputs grows with the number of inputs.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <gnuradio/block_detail.h>
+#include <gnuradio/buffer.h>
+#include <gnuradio/gr_complex.h>
+#include <sparsdr/sample_distributor.h>
+
+namespace {
+
+/*!
+ * A sample_distributor with buffers on its inputs and outputs, so that
+ * general_work() can be called directly
+ *
+ * Every input is connected, but only a few of them get a burst before each
+ * call. This measures the cost of assigning decoders to those bursts as the
+ * number of connected inputs grows.
+ */
+class distributor_harness {
+public:
+    distributor_harness(std::size_t inputs,
+            std::size_t outputs,
+            std::size_t active_inputs,
+            int burst_items)
+        : d_distributor(gr::sparsdr::sample_distributor::make(sizeof(gr_complex))),
+          d_burst_items(burst_items),
+          d_active_inputs(std::min(active_inputs, inputs)),
+          d_next_input(0),
+          d_input_buffers(),
+          d_output_buffers(),
+          d_output_readers(),
+          d_ninput_items(inputs),
+          d_input_items(inputs),
+          d_output_items(outputs),
+          d_release_tag()
+    {
+        d_release_tag.key = pmt::intern("burst_end");
+        d_release_tag.value = pmt::PMT_T;
+        // Room for a few bursts, so inputs without decoders can keep
+        // some items while others are written
+        const int buffer_items = std::max(8192, 4 * burst_items);
+
+        gr::block_detail_sptr detail = gr::make_block_detail(inputs, outputs);
+        for (std::size_t i = 0; i < inputs; i++) {
+            gr::buffer_sptr buffer = gr::make_buffer(buffer_items, sizeof(gr_complex));
+            std::memset(buffer->write_pointer(), 0,
+                buffer->space_available() * sizeof(gr_complex));
+            detail->set_input(i, gr::buffer_add_reader(buffer, 0, d_distributor));
+            d_input_buffers.push_back(buffer);
+        }
+        for (std::size_t i = 0; i < outputs; i++) {
+            gr::buffer_sptr buffer = gr::make_buffer(buffer_items,
+                sizeof(gr_complex), d_distributor);
+            detail->set_output(i, buffer);
+            d_output_buffers.push_back(buffer);
+            d_output_readers.push_back(gr::buffer_add_reader(buffer, 0));
+        }
+        d_distributor->set_detail(detail);
+    }
+
+    /*!
+     * Writes a burst to each of the next few inputs that has space, calls
+     * general_work() once, and discards the output items
+     *
+     * \param elapsed the time of the general_work() call is added to this
+     */
+    void call(std::chrono::nanoseconds& elapsed)
+    {
+        const gr::block_detail_sptr detail = d_distributor->detail();
+        const std::size_t input_count = d_input_buffers.size();
+        for (std::size_t i = 0; i < d_active_inputs; i++) {
+            // Move through the inputs so that each burst needs a decoder
+            const gr::buffer_sptr& buffer =
+                d_input_buffers[(d_next_input + i) % input_count];
+            if (buffer->space_available() >= d_burst_items) {
+                d_release_tag.offset = buffer->nitems_written() + d_burst_items - 1;
+                buffer->add_item_tag(d_release_tag);
+                buffer->update_write_pointer(d_burst_items);
+            }
+        }
+        d_next_input = (d_next_input + d_active_inputs) % input_count;
+        for (std::size_t i = 0; i < input_count; i++) {
+            const gr::buffer_reader_sptr& reader = detail->input(i);
+            d_ninput_items[i] = reader->items_available();
+            d_input_items[i] = reader->read_pointer();
+        }
+        int noutput_items = d_burst_items;
+        for (std::size_t i = 0; i < d_output_buffers.size(); i++) {
+            noutput_items = std::min(noutput_items,
+                d_output_buffers[i]->space_available());
+            d_output_items[i] = d_output_buffers[i]->write_pointer();
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        d_distributor->general_work(noutput_items, d_ninput_items,
+            d_input_items, d_output_items);
+        const auto end = std::chrono::steady_clock::now();
+        elapsed += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+
+        // Without a scheduler, nothing else removes old tags
+        for (std::size_t i = 0; i < d_input_buffers.size(); i++) {
+            d_input_buffers[i]->prune_tags(detail->input(i)->nitems_read());
+        }
+        for (std::size_t i = 0; i < d_output_buffers.size(); i++) {
+            const gr::buffer_reader_sptr& reader = d_output_readers[i];
+            reader->update_read_pointer(reader->items_available());
+            d_output_buffers[i]->prune_tags(reader->nitems_read());
+        }
+    }
+
+    /*! Returns the number of decoder assignments so far */
+    std::uint64_t assignments() const
+    {
+        return d_distributor->stats().assignments;
+    }
+
+private:
+    gr::sparsdr::sample_distributor::sptr d_distributor;
+    int d_burst_items;
+    /*! The number of inputs that get a burst before each call */
+    std::size_t d_active_inputs;
+    /*! The first input to get a burst before the next call */
+    std::size_t d_next_input;
+    /*! Buffers that this harness writes and the distributor reads */
+    std::vector<gr::buffer_sptr> d_input_buffers;
+    /*! Buffers that the distributor writes */
+    std::vector<gr::buffer_sptr> d_output_buffers;
+    /*! Readers that discard items from d_output_buffers */
+    std::vector<gr::buffer_reader_sptr> d_output_readers;
+    gr_vector_int d_ninput_items;
+    gr_vector_const_void_star d_input_items;
+    gr_vector_void_star d_output_items;
+    /*! Tag added to the last item of each burst */
+    gr::tag_t d_release_tag;
+};
+
+}
+
+int main(int argc, char** argv) {
+    namespace po = boost::program_options;
+    std::size_t max_outputs;
+    std::size_t max_inputs;
+    std::size_t active_inputs;
+    int burst_items;
+    std::uint64_t calls;
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "Print help message")
+        ("max-outputs", po::value(&max_outputs)->default_value(64), "Largest number of outputs (decoders) to test")
+        ("max-inputs", po::value(&max_inputs)->default_value(1024), "Largest number of inputs to test")
+        ("active-inputs", po::value(&active_inputs)->default_value(4), "Number of inputs that get a burst before each general_work call")
+        ("burst-items", po::value(&burst_items)->default_value(256), "Number of items in each burst written to an input")
+        ("calls", po::value(&calls)->default_value(10000), "Number of general_work calls to time for each configuration")
+        ;
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << "\n";
+        return 1;
+    }
+
+    std::cout << "inputs\toutputs\tcalls\tassignments\tns/call\tns/assignment\n";
+    for (std::size_t outputs = 1; outputs <= max_outputs; outputs *= 4) {
+        for (std::size_t inputs = 4; inputs <= max_inputs; inputs *= 4) {
+            distributor_harness harness(inputs, outputs, active_inputs,
+                burst_items);
+            // Warm up: the first calls set up decoders and give every input
+            // a burst
+            std::chrono::nanoseconds warmup(0);
+            for (std::size_t i = 0; i < inputs; i++) {
+                harness.call(warmup);
+            }
+
+            const std::uint64_t assignments_before = harness.assignments();
+            std::chrono::nanoseconds elapsed(0);
+            for (std::uint64_t i = 0; i < calls; i++) {
+                harness.call(elapsed);
+            }
+            const std::uint64_t assignments = harness.assignments()
+                - assignments_before;
+            std::cout << inputs << '\t' << outputs << '\t' << calls << '\t'
+                << assignments << '\t'
+                << static_cast<double>(elapsed.count()) / calls << '\t'
+                << static_cast<double>(elapsed.count())
+                    / std::max<std::uint64_t>(assignments, 1)
+                << '\n';
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+/**
+ * This application converts a raw capture (back-to-back 8-byte compressed
+ * samples, as written by sparsdr_receive) into an indexed .iqz file.
+ *
+ * Reconstruction can then use iqz_file_source to read only the chunks in
+ * a range of time or bins.
+ */
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <sparsdr/iqz_file.h>
+
+int main(int argc, char** argv) {
+    namespace po = boost::program_options;
+    std::string input_path;
+    std::string output_path;
+    std::uint32_t chunk_samples;
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "Print help message")
+        ("input", po::value(&input_path)->required(), "Raw compressed sample file to read")
+        ("output", po::value(&output_path)->required(), ".iqz file to write")
+        ("chunk-samples", po::value(&chunk_samples)->default_value(65536), "Maximum number of samples in each chunk")
+        ;
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << "\n";
+        return 1;
+    }
+    po::notify(vm);
+
+    std::ifstream input(input_path, std::ios::binary);
+    if (!input) {
+        std::cerr << "Can't open " << input_path << '\n';
+        return -1;
+    }
+
+    try {
+        gr::sparsdr::iqz_writer writer(output_path, chunk_samples);
+        std::vector<std::uint32_t> words(2 * static_cast<std::size_t>(chunk_samples));
+        while (input) {
+            input.read(reinterpret_cast<char*>(words.data()),
+                words.size() * sizeof(std::uint32_t));
+            // A partial sample at the end of the file is ignored
+            const std::size_t samples = input.gcount() / (2 * sizeof(std::uint32_t));
+            writer.write(words.data(), samples);
+        }
+        writer.close();
+
+        const gr::sparsdr::iqz_reader reader(output_path);
+        std::cout << "Wrote " << reader.chunks().size() << " chunks\n";
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return -1;
+    }
+    return 0;
+}
@@ -27,28 +27,25 @@ void run_receive(const std::string& usrp_address,
         const std::string& antenna,
         const std::string& output_path,
         uint32_t threshold,
+        double target_rate,
         double gain,
         double frequency,
-        bool mask_enable,
-        uint16_t mask_low,
-        uint16_t mask_high);
+        const std::vector<gr::sparsdr::mask_range>& masks,
+        double auto_mask_level,
+        double rate_ceiling,
+        const std::vector<gr::sparsdr::mask_range>& low_priority);
 
 /*!
- * Parses a bin mask range
+ * Parses a list of bin mask ranges
  *
- * \param range a string containing the bin range
- * \param enable_mask this will be set to true if the bin range was parsed
- * successfully and is non-empty, or set to false if the bin range is an
- * empty string
- * \param low If the bin range was parsed successfully and is non-empty,
- * this value will be set to the lower bound of the range.
- * \param high If the bin range was parsed successfully and is non-empty,
- * this value will be set to the upper bound of the range.
+ * \param ranges a string containing bin ranges separated by commas
+ * \param masks the parsed ranges will be appended to this vector
  *
- * \return true if the bin range is an empty string or was parsed successfully,
- * or false if the bin range could not be parsed
+ * \return true if the ranges are an empty string or were parsed successfully,
+ * or false if any range could not be parsed
  */
-bool parse_mask_bins(const std::string& range, bool* enable_mask, uint16_t* low, uint16_t* high);
+bool parse_mask_bins(const std::string& ranges,
+    std::vector<gr::sparsdr::mask_range>* masks);
 
 }
 
@@ -59,9 +56,13 @@ int main(int argc, char** argv) {
     std::string antenna;
     std::string output_path;
     uint32_t threshold;
+    double target_rate;
     double gain;
     double frequency;
     std::string mask_bins;
+    double auto_mask_level;
+    double rate_ceiling;
+    std::string low_priority_bins;
 
     po::options_description desc("Allowed options");
     desc.add_options()
@@ -75,14 +76,30 @@ constructor, for example \"addr=192.168.10.2\"")
             "path to the output file to write")
         ("threshold", po::value(&threshold)->default_value(25000),
             "The signal level threshold that determines if samples are sent")
+        ("target-rate", po::value(&target_rate)->default_value(0.0),
+            "If not zero, adjust the threshold of each bin automatically \
+(starting from --threshold) so that the USRP sends about this many samples \
+per second")
         ("gain", po::value(&gain)->default_value(0.0),
             "The receive gain in decibels")
         ("frequency", po::value(&frequency)->default_value(2.45e9),
             "The center frequency")
         ("mask-bins", po::value(&mask_bins),
-            "A range of bins to mask out (disable), formatted as two numbers \
-separated by two . characters. The start bin is inclusive, and the \
-end bin is exclusive.\nExample: 10..20 masks bins 10 through 19.");
+            "Bins to mask out (disable), separated by commas. Each entry is \
+a single bin or a range formatted as two numbers separated by two . \
+characters. The start bin is inclusive, and the end bin is exclusive. \
+Bins must be less than 2048.\n\
+Example: 10..20,35 masks bins 10 through 19 and bin 35.")
+        ("auto-mask-level", po::value(&auto_mask_level)->default_value(0.0),
+            "If not zero, automatically mask bins that send samples in more \
+than this fraction (0 to 1) of FFT windows, and unmask them later")
+        ("rate-ceiling", po::value(&rate_ceiling)->default_value(0.0),
+            "If not zero, the compressed data rate in bytes per second that \
+the link from the USRP can carry. When the rate nears this value, the \
+receiver masks low-priority bins and raises thresholds until it falls again.")
+        ("low-priority-bins", po::value(&low_priority_bins),
+            "Bins to mask first when the rate nears --rate-ceiling, in the \
+same format as --mask-bins");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -94,24 +111,33 @@ end bin is exclusive.\nExample: 10..20 masks bins 10 through 19.");
     }
 
     // Parse mask_bins
-    bool mask_enable = false;
-    uint16_t mask_low = 0;
-    uint16_t mask_high = 0;
-    if (!parse_mask_bins(mask_bins, &mask_enable, &mask_low, &mask_high)) {
+    std::vector<gr::sparsdr::mask_range> masks;
+    if (!parse_mask_bins(mask_bins, &masks)) {
         std::cerr << "Invalid mask-bins syntax\n";
         return 1;
     }
+    if (auto_mask_level < 0.0 || auto_mask_level > 1.0) {
+        std::cerr << "auto-mask-level must be between 0 and 1\n";
+        return 1;
+    }
+    std::vector<gr::sparsdr::mask_range> low_priority;
+    if (!parse_mask_bins(low_priority_bins, &low_priority)) {
+        std::cerr << "Invalid low-priority-bins syntax\n";
+        return 1;
+    }
 
     run_receive(
         usrp_address,
         antenna,
         output_path,
         threshold,
+        target_rate,
         gain,
         frequency,
-        mask_enable,
-        mask_low,
-        mask_high);
+        masks,
+        auto_mask_level,
+        rate_ceiling,
+        low_priority);
 
     return 0;
 }
@@ -122,12 +148,13 @@ void run_receive(const std::string& usrp_address,
         const std::string& antenna,
         const std::string& output_path,
         uint32_t threshold,
+        double target_rate,
         double gain,
         double frequency,
-        bool mask_enable,
-        uint16_t mask_low,
-        uint16_t mask_high) {
-    using std::chrono::high_resolution_clock;
+        const std::vector<gr::sparsdr::mask_range>& masks,
+        double auto_mask_level,
+        double rate_ceiling,
+        const std::vector<gr::sparsdr::mask_range>& low_priority) {
 
     // Clean shutdown in response to SIGINT or SIGHUP
     struct sigaction shutdown_action;
@@ -143,14 +170,20 @@ void run_receive(const std::string& usrp_address,
     usrp->set_center_freq(frequency);
     usrp->set_antenna("RX2");
 
-    // Set up mask
-    gr::sparsdr::mask_range mask;
-    if (mask_enable) {
-        mask.start = mask_low;
-        mask.end = mask_high;
+    auto receiver = gr::sparsdr::real_time_receiver::make(usrp, output_path,
+        threshold, masks, gr::sparsdr::real_time_receiver::RESTART_ON_OVERFLOW,
+        target_rate, auto_mask_level, rate_ceiling);
+    if (receiver->governor()) {
+        std::vector<bool> low_priority_bins(
+            gr::sparsdr::compressing_usrp_source::BIN_COUNT, false);
+        for (const auto& range : low_priority) {
+            for (std::size_t i = range.start;
+                    i < range.end && i < low_priority_bins.size(); i++) {
+                low_priority_bins[i] = true;
+            }
+        }
+        receiver->governor()->set_low_priority(low_priority_bins);
     }
-
-    auto receiver = gr::sparsdr::real_time_receiver::make(usrp, output_path, threshold, mask);
     const auto expected_average_interval = receiver->expected_average_interval();
 
     auto top_block = gr::make_top_block("real_time_receive");
@@ -158,58 +191,124 @@ void run_receive(const std::string& usrp_address,
 
     top_block->start();
 
-    // Check for recent average packets, and restart compression if one has
-    // not been seen recently enough.
-    // This type of overflow indicates that whatever is handling the compressed
-    // samples could not process them quickly enough.
+    // The receiver detects overflows using the hardware time in the samples
+    // and restarts compression itself. That can only work while samples are
+    // arriving, so this loop restarts compression if the sample stream
+    // stops completely.
     uint32_t restart_count = 0;
+    std::uint64_t previous_samples = 0;
+    std::uint64_t previous_mask_decisions = 0;
+    std::uint32_t previous_throttle_level = 0;
     while (running) {
         std::this_thread::sleep_for(expected_average_interval * 2);
-        const auto last_average = receiver->last_average();
-        const auto since_last_average = high_resolution_clock::now() - last_average;
-        if (since_last_average > expected_average_interval * 2) {
+        const auto stats = receiver->average_stats();
+        const std::uint64_t samples = stats.averages + stats.data_samples;
+        if (samples == previous_samples) {
             restart_count += 1;
-            std::cerr << "Compression internal overflow, restarting\n";
+            std::cerr << "No samples received after "
+                << stats.averages << " averages and "
+                << stats.data_samples << " data samples (last hardware time "
+                << stats.last_hardware_time << "), restarting\n";
             receiver->restart_compression();
         }
+        previous_samples = samples;
+
+        if (receiver->masker()) {
+            // Log the automatically masked bins whenever they change
+            const auto masker_stats = receiver->masker()->stats();
+            const std::uint64_t decisions = masker_stats.masks + masker_stats.unmasks;
+            if (decisions != previous_mask_decisions) {
+                std::cerr << "Automatically masked bins:";
+                for (const std::uint16_t bin : receiver->masker()->masked_bins()) {
+                    std::cerr << ' ' << bin;
+                }
+                std::cerr << '\n';
+            }
+            previous_mask_decisions = decisions;
+        }
+        if (receiver->governor()) {
+            const auto level = receiver->governor()->stats().level;
+            if (level != previous_throttle_level) {
+                std::cerr << "Compressed data rate "
+                    << (level > previous_throttle_level ? "high" : "lower")
+                    << ", throttle level " << level << '\n';
+            }
+            previous_throttle_level = level;
+        }
     }
 
     top_block->stop();
     top_block->wait();
 
-    std::cerr << "Restarted compression " << restart_count << " times\n";
+    std::cerr << "Detected " << receiver->average_stats().overflows
+        << " overflows\n";
+    const auto capture_stats = receiver->capture_stats();
+    std::cerr << "Wrote " << capture_stats.bytes_written << " bytes, dropped "
+        << capture_stats.items_dropped << " items while the file was behind"
+        << " (at most " << capture_stats.max_queued_buffers
+        << " buffers waiting)\n";
+    std::cerr << "Restarted compression " << restart_count
+        << " times after the sample stream stopped\n";
+    if (receiver->controller()) {
+        const auto controller_stats = receiver->controller()->stats();
+        std::cerr << "Threshold controller made " << controller_stats.updates
+            << " updates with " << controller_stats.threshold_writes
+            << " threshold writes, final margin " << controller_stats.margin
+            << "\n";
+    }
+    if (receiver->masker()) {
+        const auto masker_stats = receiver->masker()->stats();
+        std::cerr << "Automatically masked bins " << masker_stats.masks
+            << " times and unmasked them " << masker_stats.unmasks
+            << " times\n";
+    }
+    if (receiver->governor()) {
+        const auto governor_stats = receiver->governor()->stats();
+        std::cerr << "Throttled " << governor_stats.raises
+            << " times, relaxed " << governor_stats.relaxes << " times\n";
+    }
 }
 
-bool parse_mask_bins(const std::string& range, bool* enable_mask, uint16_t* low, uint16_t* high) {
-    if (range.empty()) {
-        *enable_mask = false;
-        return true;
-    } else {
-        // Find the ..
-        const auto separator_pos = range.find("..");
-        if (separator_pos != std::string::npos) {
-            // Found, parse low and high values
-            const auto low_str = range.substr(0, separator_pos);
-            const auto high_str = range.substr(separator_pos + 2);
-            try {
-                *low = boost::lexical_cast<uint16_t>(low_str);
-                *high = boost::lexical_cast<uint16_t>(high_str);
-                *enable_mask = true;
-
-                // Sanity check
-                if (high < low) {
+bool parse_mask_bins(const std::string& ranges,
+    std::vector<gr::sparsdr::mask_range>* masks) {
+    // Parse into a wider type so that large values are rejected instead
+    // of wrapping around
+    const uint32_t bin_count = gr::sparsdr::compressing_usrp_source::BIN_COUNT;
+    std::size_t start = 0;
+    while (start < ranges.size()) {
+        std::size_t end = ranges.find(',', start);
+        if (end == std::string::npos) {
+            end = ranges.size();
+        }
+        const auto range = ranges.substr(start, end - start);
+        start = end + 1;
+        try {
+            // Find the ..
+            const auto separator_pos = range.find("..");
+            if (separator_pos != std::string::npos) {
+                // Found, parse low and high values
+                const auto low = boost::lexical_cast<uint32_t>(
+                    range.substr(0, separator_pos));
+                const auto high = boost::lexical_cast<uint32_t>(
+                    range.substr(separator_pos + 2));
+                // Sanity check (the end bin is exclusive)
+                if (high < low || low >= bin_count || high > bin_count) {
                     return false;
                 }
-
-                return true;
-            } catch (boost::bad_lexical_cast&) {
-                return false;
+                masks->push_back(gr::sparsdr::mask_range(low, high));
+            } else {
+                // One bin
+                const auto bin = boost::lexical_cast<uint32_t>(range);
+                if (bin >= bin_count) {
+                    return false;
+                }
+                masks->push_back(gr::sparsdr::mask_range(bin, bin + 1));
             }
-        } else {
-            // Not found
+        } catch (boost::bad_lexical_cast&) {
             return false;
         }
     }
+    return true;
 }
 
 }
@@ -0,0 +1,195 @@
+/**
+ * This application receives compressed samples from several USRPs at the
+ * same time and writes them to captures that share one timeline, with an
+ * index that lists the captures.
+ */
+
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <signal.h>
+
+#include <boost/program_options.hpp>
+
+#include <gnuradio/top_block.h>
+#include <sparsdr/compressing_usrp_source.h>
+#include <sparsdr/multi_device_receiver.h>
+
+namespace {
+
+volatile sig_atomic_t running = 1;
+
+void shutdown_handler(int) {
+    running = 0;
+}
+
+void run_receive(const std::vector<std::string>& usrp_addresses,
+        const std::vector<double>& frequencies,
+        const std::string& antenna,
+        const std::string& output_prefix,
+        const std::string& index_path,
+        uint32_t threshold,
+        double gain,
+        const std::string& time_source,
+        const std::vector<int>& cores);
+
+}
+
+int main(int argc, char** argv) {
+    namespace po = boost::program_options;
+
+    std::vector<std::string> usrp_addresses;
+    std::vector<double> frequencies;
+    std::string antenna;
+    std::string output_prefix;
+    std::string index_path;
+    uint32_t threshold;
+    double gain;
+    std::string time_source;
+    std::vector<int> cores;
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "display help information")
+        ("usrp-address", po::value(&usrp_addresses)->composing(),
+            "USRP address in the format accepted by the uhd::device_addr_t \
+constructor, for example \"addr=192.168.10.2\". Give this once for each USRP.")
+        ("frequency", po::value(&frequencies)->composing(),
+            "The center frequency of a USRP. Give this once for each USRP, \
+in the same order as --usrp-address.")
+        ("antenna", po::value(&antenna)->default_value("RX2"),
+            "The antenna to receive signals from")
+        ("output-prefix", po::value(&output_prefix)->default_value("compressed"),
+            "The captures are written to files named with this prefix, an \
+underscore, the USRP number, and .iqz")
+        ("index-path", po::value(&index_path)->default_value("compressed.index"),
+            "path to the capture index file to write")
+        ("threshold", po::value(&threshold)->default_value(25000),
+            "The signal level threshold that determines if samples are sent")
+        ("gain", po::value(&gain)->default_value(0.0),
+            "The receive gain in decibels")
+        ("time-source", po::value(&time_source)->default_value("external"),
+            "The source of the reference clock and PPS signal for all USRPs \
+(external, gpsdo, or internal)")
+        ("core", po::value(&cores)->composing(),
+            "A CPU core to run a USRP's receive path on. Give this once for \
+each core. USRPs are assigned to cores in order, wrapping around if there \
+are fewer cores than USRPs.");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << "\n";
+        return 1;
+    }
+    if (usrp_addresses.empty()) {
+        std::cerr << "At least one usrp-address is required\n";
+        return 1;
+    }
+    if (frequencies.size() != usrp_addresses.size()) {
+        std::cerr << "Each USRP needs a frequency\n";
+        return 1;
+    }
+
+    run_receive(
+        usrp_addresses,
+        frequencies,
+        antenna,
+        output_prefix,
+        index_path,
+        threshold,
+        gain,
+        time_source,
+        cores);
+
+    return 0;
+}
+
+namespace {
+
+void run_receive(const std::vector<std::string>& usrp_addresses,
+        const std::vector<double>& frequencies,
+        const std::string& antenna,
+        const std::string& output_prefix,
+        const std::string& index_path,
+        uint32_t threshold,
+        double gain,
+        const std::string& time_source,
+        const std::vector<int>& cores) {
+
+    // Clean shutdown in response to SIGINT or SIGHUP
+    struct sigaction shutdown_action;
+    shutdown_action.sa_handler = shutdown_handler;
+    sigaction(SIGINT, &shutdown_action, nullptr);
+    sigaction(SIGHUP, &shutdown_action, nullptr);
+
+    std::vector<gr::sparsdr::compressing_usrp_source::sptr> usrps;
+    std::vector<std::string> output_paths;
+    for (std::size_t i = 0; i < usrp_addresses.size(); i++) {
+        const auto address = uhd::device_addr_t(usrp_addresses[i]);
+        const auto usrp = gr::sparsdr::compressing_usrp_source::make(address);
+
+        // Basic USRP configuration
+        usrp->set_gain(gain);
+        usrp->set_center_freq(frequencies[i]);
+        usrp->set_antenna(antenna);
+
+        usrps.push_back(usrp);
+        output_paths.push_back(output_prefix + "_" + std::to_string(i) + ".iqz");
+    }
+
+    auto receiver = gr::sparsdr::multi_device_receiver::make(usrps,
+        output_paths, index_path, threshold,
+        std::vector<gr::sparsdr::mask_range>(), time_source, cores);
+    const auto expected_average_interval = receiver->expected_average_interval();
+    std::cerr << "Compression starts at window " << receiver->start_time()
+        << " on all devices\n";
+
+    auto top_block = gr::make_top_block("multi_device_receive");
+    top_block->connect(receiver);
+
+    top_block->start();
+    // Compression starts up to one second (the default start delay) after
+    // the receiver was created
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    // As in sparsdr_receive, restart compression on any device whose sample
+    // stream stops completely
+    std::vector<uint32_t> restart_counts(usrps.size(), 0);
+    std::vector<std::uint64_t> previous_samples(usrps.size(), 0);
+    while (running) {
+        std::this_thread::sleep_for(expected_average_interval * 2);
+        for (std::size_t i = 0; i < usrps.size(); i++) {
+            const auto stats = receiver->average_stats(i);
+            const std::uint64_t samples = stats.averages + stats.data_samples;
+            if (samples == previous_samples[i]) {
+                restart_counts[i] += 1;
+                std::cerr << "No samples received from device " << i
+                    << " after " << stats.averages << " averages and "
+                    << stats.data_samples << " data samples (last hardware time "
+                    << stats.last_hardware_time << "), restarting\n";
+                receiver->restart_compression(i);
+            }
+            previous_samples[i] = samples;
+        }
+    }
+
+    top_block->stop();
+    top_block->wait();
+
+    for (std::size_t i = 0; i < usrps.size(); i++) {
+        const auto stats = receiver->average_stats(i);
+        std::cerr << "Device " << i << ": received " << stats.data_samples
+            << " data samples, detected " << stats.overflows
+            << " overflows, restarted compression " << restart_counts[i]
+            << " times after the sample stream stopped\n";
+    }
+    std::cerr << "Wrote index of " << output_paths.size() << " captures to "
+        << index_path << '\n';
+}
+
+}
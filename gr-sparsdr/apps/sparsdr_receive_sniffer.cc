@@ -37,7 +37,6 @@ void shutdown_handler(int) {
 }
 
 int main(int argc, char** argv) {
-    using std::chrono::high_resolution_clock;
     if (argc < 2) {
         std::cerr << "Usage: sparsdr_receive_sniffer compressed-output-path [path frequency sample_rate]...\n";
         return -1;
@@ -96,24 +95,37 @@ int main(int argc, char** argv) {
     // Run
     top_block->start();
 
-    // Check for recent average packets, and restart compression if one has
-    // not been seen recently enough.
-    // This type of overflow indicates that whatever is handling the compressed
-    // samples could not process them quickly enough.
+    // The receiver detects overflows using the hardware time in the samples
+    // and restarts compression itself. That can only work while samples are
+    // arriving, so this loop restarts compression if the sample stream
+    // stops completely.
     uint32_t restart_count = 0;
+    std::uint64_t previous_samples = 0;
     while (running) {
         std::this_thread::sleep_for(expected_average_interval * 2);
-        const auto last_average = receiver->last_average();
-        const auto since_last_average = high_resolution_clock::now() - last_average;
-        if (since_last_average > expected_average_interval * 2) {
+        const auto stats = receiver->average_stats();
+        const std::uint64_t samples = stats.averages + stats.data_samples;
+        if (samples == previous_samples) {
             restart_count += 1;
-            std::cerr << "Compression internal overflow, restarting\n";
+            std::cerr << "No samples received after "
+                << stats.averages << " averages and "
+                << stats.data_samples << " data samples (last hardware time "
+                << stats.last_hardware_time << "), restarting\n";
             receiver->restart_compression();
         }
+        previous_samples = samples;
     }
 
     top_block->stop();
     top_block->wait();
 
-    std::cerr << "Restarted compression " << restart_count << " times\n";
+    std::cerr << "Detected " << receiver->average_stats().overflows
+        << " overflows\n";
+    const auto capture_stats = receiver->capture_stats();
+    std::cerr << "Wrote " << capture_stats.bytes_written << " bytes, dropped "
+        << capture_stats.items_dropped << " items while the file was behind"
+        << " (at most " << capture_stats.max_queued_buffers
+        << " buffers waiting)\n";
+    std::cerr << "Restarted compression " << restart_count
+        << " times after the sample stream stopped\n";
 }
@@ -0,0 +1,156 @@
+/**
+ * This application measures the steady-state cost of native reconstruction
+ * and checks that it does not allocate memory.
+ *
+ * It generates compressed samples for a number of windows, with a few
+ * active bins in each window, and reconstructs them into several bands.
+ * The first pass warms up the reconstructor. During the second pass, every
+ * call to operator new is counted. The application prints the time per
+ * window and the number of allocations, and exits with status 1 if any
+ * allocations happened in the second pass.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <sparsdr/band_spec.h>
+#include <sparsdr/sample_decoder.h>
+#include "fft_plan_cache.h"
+#include "window_reconstructor.h"
+
+namespace {
+
+std::atomic<std::uint64_t> allocation_count(0);
+
+/*!
+ * Generates compressed samples: active_bins random bins near each band
+ * center in each window, with a gap in time every few windows
+ */
+std::vector<std::uint32_t> generate_samples(const std::vector<gr::sparsdr::band_spec>& bands,
+        std::size_t windows,
+        std::size_t active_bins) {
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> value(-10000, 10000);
+    std::uniform_int_distribution<int> offset(-8, 8);
+    std::vector<std::uint32_t> words;
+    std::uint32_t time = 0;
+    for (std::size_t window = 0; window < windows; window++) {
+        time += (window % 16 == 15) ? 3 : 1;
+        const std::uint32_t wrapped_time = time & 0xfffff;
+        for (std::size_t i = 0; i < active_bins; i++) {
+            const gr::sparsdr::band_spec& band = bands[i % bands.size()];
+            const int center = 1024 + static_cast<int>(2048 * band.frequency() / 100e6);
+            const int logical = (center + offset(random)) & 2047;
+            const std::uint32_t index = (logical + 1024) % 2048;
+            words.push_back(((wrapped_time & 0xffff) << 16) | (index << 4)
+                | ((wrapped_time >> 16) & 0xf));
+            words.push_back((static_cast<std::uint32_t>(static_cast<std::uint16_t>(value(random))) << 16)
+                | static_cast<std::uint16_t>(value(random)));
+        }
+    }
+    return words;
+}
+
+/*!
+ * Reconstructs all samples, reading the output of each band after every
+ * completed window
+ */
+void reconstruct(gr::sparsdr::window_reconstructor& reconstructor,
+        const gr::sparsdr::decoded_samples& samples,
+        std::vector<gr_complex>& output) {
+    for (std::size_t i = 0; i < samples.size(); i++) {
+        if (reconstructor.add_sample(samples, i)) {
+            for (std::size_t band = 0; band < reconstructor.band_count(); band++) {
+                reconstructor.band(band).begin_output(output.data(), output.size());
+                reconstructor.band(band).end_output();
+            }
+        }
+    }
+}
+
+}
+
+void* operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+int main(int argc, char** argv) {
+    namespace po = boost::program_options;
+    std::size_t band_count;
+    std::size_t windows;
+    std::size_t active_bins;
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "Print help message")
+        ("bands", po::value(&band_count)->default_value(8), "Number of bands")
+        ("windows", po::value(&windows)->default_value(100000), "Number of windows in each pass")
+        ("active-bins", po::value(&active_bins)->default_value(16), "Number of active bins in each window")
+        ;
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << "\n";
+        return 1;
+    }
+    if (band_count == 0) {
+        std::cerr << "At least one band is required\n";
+        return 1;
+    }
+
+    // Bands of two sizes spread across the spectrum, so that plans are
+    // shared between bands of the same size
+    std::vector<gr::sparsdr::band_spec> bands;
+    for (std::size_t i = 0; i < band_count; i++) {
+        const float frequency = -40e6 + 80e6 * (i + 0.5) / band_count;
+        bands.push_back(gr::sparsdr::band_spec(frequency, i % 2 == 0 ? 64 : 256));
+    }
+
+    const std::vector<std::uint32_t> words = generate_samples(bands, windows, active_bins);
+    gr::sparsdr::decoded_samples samples;
+    gr::sparsdr::decode_samples(words.data(), words.size() / 2, samples);
+    // Large enough for every band's output from one window
+    std::vector<gr_complex> output(4096);
+
+    gr::sparsdr::window_reconstructor reconstructor(bands);
+    // Warm up
+    reconstruct(reconstructor, samples, output);
+    reconstructor.reset();
+
+    const std::uint64_t allocations_before = allocation_count.load();
+    const auto start = std::chrono::steady_clock::now();
+    reconstruct(reconstructor, samples, output);
+    const auto end = std::chrono::steady_clock::now();
+    const std::uint64_t allocations = allocation_count.load() - allocations_before;
+
+    const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::cout << "bands\twindows\tactive bins\tns/window\tFFT plans\tallocations\n";
+    std::cout << band_count << '\t' << windows << '\t' << active_bins << '\t'
+        << ns / windows << '\t'
+        << gr::sparsdr::fft_plan_cache::plans_created() << '\t'
+        << allocations << '\n';
+    return allocations == 0 ? 0 : 1;
+}
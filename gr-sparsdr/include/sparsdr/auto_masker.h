@@ -0,0 +1,140 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_AUTO_MASKER_H
+#define INCLUDED_SPARSDR_AUTO_MASKER_H
+
+#include <cstdint>
+#include <vector>
+#include <sparsdr/api.h>
+#include <sparsdr/compressing_usrp_source.h>
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief A consistent snapshot of the state of an auto_masker
+     */
+    struct SPARSDR_API auto_masker_stats
+    {
+      /*! \brief The number of times a bin was masked */
+      std::uint64_t masks;
+      /*! \brief The number of times a bin was unmasked after its cooldown */
+      std::uint64_t unmasks;
+      /*! \brief The number of bins that are currently masked by the block */
+      std::uint64_t masked_bins;
+    };
+
+    /*!
+     * \brief Masks bins on a compressing USRP that send data samples
+     * almost all the time
+     * \ingroup sparsdr
+     *
+     * A constant carrier keeps its bins above the threshold, so the USRP
+     * sends a data sample for those bins in every FFT window. That can use
+     * most of the bandwidth and cause overflows.
+     *
+     * This block reads the same compressed samples as an average_detector.
+     * For each bin, it measures the duty cycle (the fraction of FFT windows
+     * that have a data sample for the bin) over a sliding window of rows of
+     * averages. When the duty cycle is above the mask level for a whole
+     * window, the block masks the bin. After a cooldown, it unmasks the bin
+     * and measures it again for a whole window before it can be masked
+     * again.
+     *
+     * Bins that something else has masked on the USRP (for example, a
+     * command-line option or a rate_governor) are never changed. This block
+     * only masks bins that are unmasked, and only unmasks bins that it
+     * masked.
+     *
+     * Each decision is published on the "mask" message port as a
+     * dictionary with these entries:
+     * * bin: the FFT bin index
+     * * masked: true if the bin was masked, false if it was unmasked
+     * * duty_cycle: the measured duty cycle that caused the bin to be
+     *   masked (0 when unmasking)
+     * * time: the expanded hardware time of the row of averages when the
+     *   decision was made
+     */
+    class SPARSDR_API auto_masker : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<auto_masker> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of sparsdr::auto_masker.
+       *
+       * To avoid accidental use of raw pointers, sparsdr::auto_masker's
+       * constructor is in a private implementation
+       * class. sparsdr::auto_masker::make is the public interface for
+       * creating new instances.
+       *
+       * \param usrp the USRP to change masks on. If this is null, the block
+       * only reports its decisions.
+       * \param average_interval the interval between rows of averages, in
+       * hardware time steps (the value passed to
+       * compressing_usrp_source::set_average_packet_interval())
+       * \param mask_level the duty cycle (0 to 1) above which a bin is masked
+       * \param window_rows the number of rows of averages in the sliding
+       * window
+       * \param cooldown_rows the number of rows of averages that a bin stays
+       * masked
+       *
+       * \throws std::invalid_argument if average_interval, window_rows, or
+       * cooldown_rows is 0, or mask_level is not in (0, 1]
+       */
+      static sptr make(compressing_usrp_source::sptr usrp,
+          std::uint32_t average_interval,
+          double mask_level = 0.9,
+          std::uint32_t window_rows = 8,
+          std::uint32_t cooldown_rows = 64);
+
+      /*! \brief Returns counts of the decisions made so far */
+      virtual auto_masker_stats stats() const = 0;
+
+      /*!
+       * \brief Returns the bins that this block has masked, in increasing
+       * order
+       */
+      virtual std::vector<std::uint16_t> masked_bins() const = 0;
+
+      /*!
+       * \brief Changes the duty cycle above which bins are masked
+       *
+       * \throws std::invalid_argument if level is not in (0, 1]
+       */
+      virtual void set_mask_level(double level) = 0;
+
+      /*!
+       * \brief Changes the number of rows of averages that a bin stays
+       * masked
+       *
+       * This applies to bins that are masked later.
+       *
+       * \throws std::invalid_argument if rows is 0
+       */
+      virtual void set_cooldown_rows(std::uint32_t rows) = 0;
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_AUTO_MASKER_H */
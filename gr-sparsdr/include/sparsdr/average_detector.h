@@ -2,17 +2,60 @@
 #define INCLUDED_SPARSDR_AVERAGE_DETECTOR_H
 
 #include <chrono>
+#include <cstdint>
+#include <functional>
 #include <sparsdr/api.h>
 #include <gnuradio/sync_block.h>
 
 namespace gr {
   namespace sparsdr {
 
+    /*!
+     * \brief A consistent snapshot of the samples that an average_detector
+     * has seen
+     */
+    struct SPARSDR_API average_detector_stats
+    {
+      /*! \brief The number of average samples seen */
+      std::uint64_t averages;
+      /*! \brief The number of data samples seen */
+      std::uint64_t data_samples;
+      /*!
+       * \brief The 20-bit hardware time of the most recent sample
+       *
+       * This is only meaningful if averages or data_samples is not zero.
+       */
+      std::uint32_t last_hardware_time;
+      /*! \brief The time when the last average sample was observed */
+      std::chrono::high_resolution_clock::time_point last_average;
+      /*! \brief The number of overflows detected */
+      std::uint64_t overflows;
+    };
+
     /*!
      * \brief Detects average samples in a compressed stream and records
      * the time of the last sample
      * \ingroup sparsdr
      *
+     * If an average interval is provided, this block also uses the
+     * hardware time in each sample to detect overflows. The compressing
+     * USRP sends a row of averages once per average interval, so an overflow
+     * is either a row of averages that did not arrive or a row whose time
+     * does not follow from the previous row.
+     *
+     * When this block detects an overflow, it publishes a dictionary on
+     * the "overflow" message port with these entries:
+     * * expected_time: the expanded hardware time when the next row of
+     *   averages was expected
+     * * time: the expanded hardware time of the sample that revealed the
+     *   overflow
+     * * missing_rows: the number of rows of averages that did not arrive
+     *   (0 if the time jumped by something other than a whole number of
+     *   average intervals)
+     *
+     * This block has an optional output that copies its input. If the
+     * output is connected, the sample that revealed each overflow gets
+     * an "overflow" tag with the same dictionary as its value.
      */
     class SPARSDR_API average_detector : virtual public gr::sync_block
     {
@@ -26,8 +69,31 @@ namespace gr {
        * constructor is in a private implementation
        * class. sparsdr::average_detector::make is the public interface for
        * creating new instances.
+       *
+       * \param average_interval the interval between rows of averages,
+       * in hardware time steps (see TIME_STEP in sample_decoder.h; this is
+       * the value passed to
+       * compressing_usrp_source::set_average_packet_interval()). If this
+       * is 0, overflow detection is disabled.
        */
-      static sptr make();
+      static sptr make(std::uint32_t average_interval = 0);
+
+#ifndef SWIG
+      /*!
+       * \brief Return a shared_ptr to a new instance of
+       * sparsdr::average_detector that calls a function after each overflow
+       *
+       * \param average_interval the interval between rows of averages, as
+       * in the other make function
+       *
+       * \param overflow_callback a function that the block calls from its
+       * work thread after detecting each overflow. The block can't detect
+       * more overflows until the function returns, so it should hand any
+       * slow work (such as writing USRP registers) to another thread.
+       */
+      static sptr make(std::uint32_t average_interval,
+          const std::function<void()>& overflow_callback);
+#endif
 
       /*!
        * \brief Returns the time when the last average sample was observed
@@ -35,6 +101,26 @@ namespace gr {
        * This function is safe to call from any thread.
        */
       virtual std::chrono::high_resolution_clock::time_point last_average() = 0;
+
+      /*!
+       * \brief Returns counts of the samples observed so far, the hardware
+       * time of the last sample, and the time of the last average sample
+       *
+       * The returned values are all from the same call to work().
+       *
+       * This function is safe to call from any thread. It never blocks the
+       * thread that runs this block.
+       */
+      virtual average_detector_stats stats() = 0;
+
+      /*!
+       * \brief Makes this block forget the time of the last row of averages,
+       * so that the next row will not be reported as an overflow
+       *
+       * This should be called after compression is restarted.
+       * It is safe to call from any thread.
+       */
+      virtual void resync() = 0;
     };
 
   } // namespace sparsdr
@@ -0,0 +1,138 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_BAND_BUFFERING_H
+#define INCLUDED_SPARSDR_BAND_BUFFERING_H
+#include <cstddef>
+
+namespace gr {
+namespace sparsdr {
+
+/*!
+ * \brief Buffering settings for one band of a reconstruct block
+ *
+ * These trade latency against throughput. A band that feeds a live decoder
+ * should use small buffers and frequent flushes. A band that is only
+ * recorded can use large buffers.
+ *
+ * The output buffer hints apply to the block that produces the band's
+ * samples in both engines. The other settings apply only when
+ * reconstructing in a separate sparsdr_reconstruct process.
+ */
+class band_buffering {
+private:
+    /*! \brief The capacity of the shared-memory ring for this band, in bytes */
+    std::size_t d_ring_size;
+    /*!
+     * \brief The number of bytes that sparsdr_reconstruct buffers before
+     * writing to the ring, or 0 to write each sample immediately
+     */
+    std::size_t d_buffer_size;
+    /*!
+     * \brief The longest time, in milliseconds, that sparsdr_reconstruct
+     * keeps samples in its buffer, or 0 to keep them until the buffer is
+     * full
+     */
+    unsigned int d_flush_interval_ms;
+    /*!
+     * \brief The minimum size of the output buffer in items, or 0 to use
+     * the flowgraph default
+     */
+    long d_min_output_buffer;
+    /*!
+     * \brief The maximum size of the output buffer in items, or 0 to use
+     * the flowgraph default
+     */
+    long d_max_output_buffer;
+public:
+    /*!
+     * \brief Creates buffering settings
+     *
+     * The default settings match the behavior of earlier versions.
+     *
+     * \param ring_size the capacity of the shared-memory ring, in bytes
+     * \param buffer_size the number of bytes that sparsdr_reconstruct
+     * buffers before writing to the ring, or 0 for no buffering
+     * \param flush_interval_ms the longest time, in milliseconds, that
+     * buffered samples wait, or 0 to wait until the buffer is full
+     * \param min_output_buffer the minimum output buffer size in items,
+     * or 0 for the default
+     * \param max_output_buffer the maximum output buffer size in items,
+     * or 0 for the default
+     */
+    inline explicit band_buffering(std::size_t ring_size = 1024 * 1024,
+        std::size_t buffer_size = 8192,
+        unsigned int flush_interval_ms = 0,
+        long min_output_buffer = 0,
+        long max_output_buffer = 0) :
+        d_ring_size(ring_size),
+        d_buffer_size(buffer_size),
+        d_flush_interval_ms(flush_interval_ms),
+        d_min_output_buffer(min_output_buffer),
+        d_max_output_buffer(max_output_buffer)
+    {
+    }
+
+    /*!
+     * \brief Returns settings for a band that feeds a live decoder:
+     * a small ring, no buffering in sparsdr_reconstruct, and small output
+     * buffers
+     */
+    static inline band_buffering low_latency()
+    {
+        return band_buffering(256 * 1024, 0, 0, 0, 4096);
+    }
+
+    /*!
+     * \brief Returns settings for a band that is recorded: a large ring,
+     * a large buffer whose samples wait at most one second, and large
+     * output buffers
+     */
+    static inline band_buffering recording()
+    {
+        return band_buffering(16 * 1024 * 1024, 1024 * 1024, 1000, 1024 * 1024, 0);
+    }
+
+    inline std::size_t ring_size() const
+    {
+        return d_ring_size;
+    }
+    inline std::size_t buffer_size() const
+    {
+        return d_buffer_size;
+    }
+    inline unsigned int flush_interval_ms() const
+    {
+        return d_flush_interval_ms;
+    }
+    inline long min_output_buffer() const
+    {
+        return d_min_output_buffer;
+    }
+    inline long max_output_buffer() const
+    {
+        return d_max_output_buffer;
+    }
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,144 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_CAPTURE_INDEX_H
+#define INCLUDED_SPARSDR_CAPTURE_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sparsdr/api.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Information about one capture in a capture_index
+     */
+    struct SPARSDR_API capture_index_entry
+    {
+      /*! \brief The path to the .iqz file */
+      std::string path;
+      /*! \brief The center frequency of the device, in hertz */
+      double center_frequency;
+      /*! \brief The bandwidth that the device captured, in hertz */
+      double bandwidth;
+      /*!
+       * \brief The expanded time (in hardware time steps) on the shared
+       * timeline when the capture started
+       */
+      std::uint64_t start_time;
+
+      inline capture_index_entry()
+        : path(), center_frequency(0.0), bandwidth(0.0), start_time(0)
+      {}
+      inline capture_index_entry(const std::string& path,
+          double center_frequency,
+          double bandwidth,
+          std::uint64_t start_time)
+        : path(path),
+          center_frequency(center_frequency),
+          bandwidth(bandwidth),
+          start_time(start_time)
+      {}
+    };
+
+    /*!
+     * \brief A list of captures from several devices that share one
+     * timeline
+     *
+     * Each capture is an .iqz file from one device. The expanded times in
+     * all the files count hardware time steps (see TIME_STEP in
+     * sample_decoder.h) from the same instant,
+     * so samples from different files with the same expanded time were
+     * received at the same time. Together the captures cover a band wider
+     * than one device can receive.
+     *
+     * An index can be converted to and from text with one line for each
+     * capture:
+     *
+     *     capture <center frequency> <bandwidth> <start time> <path>
+     *
+     * The path is the rest of the line, so it may contain spaces. Empty
+     * lines and lines that start with # are ignored.
+     */
+    class SPARSDR_API capture_index
+    {
+    public:
+      /*! \brief Creates an empty index */
+      capture_index();
+
+      /*! \brief Adds a capture to the end of the index */
+      void add(const capture_index_entry& entry);
+
+      /*! \brief Returns the number of captures */
+      std::size_t size() const;
+
+      /*!
+       * \brief Returns a capture
+       *
+       * \throws std::out_of_range if index is not less than size()
+       */
+      const capture_index_entry& entry(std::size_t index) const;
+
+      /*!
+       * \brief Returns the index of the capture that can best reconstruct
+       * a signal at a frequency, or -1 if no capture includes it
+       *
+       * If more than one capture includes the frequency, this returns the
+       * one whose center frequency is closest.
+       *
+       * \param frequency the frequency in hertz
+       */
+      int find(double frequency) const;
+
+      /*! \brief Converts this index into text */
+      std::string to_string() const;
+      /*!
+       * \brief Reads an index from text produced by to_string()
+       *
+       * \throws std::invalid_argument if the text is not valid
+       */
+      static capture_index from_string(const std::string& text);
+
+      /*!
+       * \brief Writes this index to a file
+       *
+       * \throws std::runtime_error if the file can't be written
+       */
+      void write(const std::string& path) const;
+      /*!
+       * \brief Reads an index from a file
+       *
+       * \throws std::runtime_error if the file can't be read
+       * \throws std::invalid_argument if the file is not valid
+       */
+      static capture_index read(const std::string& path);
+
+    private:
+      /*! \brief The captures, in the order they were added */
+      std::vector<capture_index_entry> d_entries;
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_CAPTURE_INDEX_H */
@@ -0,0 +1,128 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_CAPTURE_SINK_H
+#define INCLUDED_SPARSDR_CAPTURE_SINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sparsdr/api.h>
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Counts of the data handled by a capture_sink
+     */
+    struct SPARSDR_API capture_sink_stats
+    {
+      /*! \brief The number of bytes written to the file */
+      std::uint64_t bytes_written;
+      /*!
+       * \brief The number of bytes written during the last complete second
+       */
+      std::uint64_t bytes_per_second;
+      /*!
+       * \brief The number of input items discarded because all buffers
+       * were waiting to be written (only for regular files)
+       */
+      std::uint64_t items_dropped;
+      /*! \brief The number of buffers currently waiting to be written */
+      std::uint32_t queued_buffers;
+      /*! \brief The largest value of queued_buffers seen so far */
+      std::uint32_t max_queued_buffers;
+      /*! \brief The number of writes that failed */
+      std::uint64_t write_errors;
+    };
+
+    /*!
+     * \brief Writes compressed samples to a file without blocking the
+     * stream on the disk
+     * \ingroup sparsdr
+     *
+     * Items are copied into one of a set of large buffers. When a buffer is
+     * full, a separate thread writes it to the file while the block fills
+     * the next one. A buffer that has held items for longer than the flush
+     * interval is written even if it is not full, so that a program
+     * reading the file does not wait for a quiet stream to fill a buffer.
+     *
+     * If the file is a regular file and it cannot keep up, so that all
+     * buffers are waiting to be written, the block discards incoming samples
+     * (and counts them) instead of waiting. The block can also reserve
+     * space for a regular file ahead of the writes, and can write it with
+     * O_DIRECT to bypass the page cache. Buffers written with O_DIRECT are
+     * only written when they are full.
+     *
+     * If the file is a named pipe or another kind of file, its reader
+     * needs samples with little delay and should not miss any. The block
+     * uses buffers of at most 64 KiB and waits for the reader when all
+     * buffers are waiting to be written, like a file sink.
+     */
+    class SPARSDR_API capture_sink : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<capture_sink> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of sparsdr::capture_sink.
+       *
+       * To avoid accidental use of raw pointers, sparsdr::capture_sink's
+       * constructor is in a private implementation
+       * class. sparsdr::capture_sink::make is the public interface for
+       * creating new instances.
+       *
+       * \param path the path to the file to write. An existing file is
+       * truncated.
+       *
+       * \param buffer_size the size of each buffer in bytes. This is rounded
+       * up to a multiple of 4096 bytes.
+       *
+       * \param buffer_count the number of buffers (at least 2)
+       *
+       * \param direct_io true to write to a regular file with O_DIRECT
+       *
+       * \param preallocate_size the number of bytes to reserve for the file
+       * each time the writes reach the end of the reserved space, or 0 to
+       * disable preallocation
+       *
+       * \param flush_interval the time in seconds after which a partly
+       * filled buffer is written, or 0 to write only full buffers
+       */
+      static sptr make(const std::string& path,
+          std::size_t buffer_size = 4 * 1024 * 1024,
+          int buffer_count = 2,
+          bool direct_io = false,
+          std::size_t preallocate_size = 256 * 1024 * 1024,
+          double flush_interval = 0.1);
+
+      /*!
+       * \brief Returns counts of the data written and discarded
+       *
+       * This function is safe to call from any thread.
+       */
+      virtual capture_sink_stats stats() const = 0;
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_CAPTURE_SINK_H */
@@ -22,7 +22,10 @@
 #ifndef INCLUDED_SPARSDR_COMPRESSING_USRP_SOURCE_H
 #define INCLUDED_SPARSDR_COMPRESSING_USRP_SOURCE_H
 
+#include <cstddef>
+#include <vector>
 #include <sparsdr/api.h>
+#include <sparsdr/compression_config.h>
 #include <gnuradio/hier_block2.h>
 #include <gnuradio/uhd/usrp_source.h>
 
@@ -34,12 +37,18 @@ namespace gr {
      * compression settings to be changed
      * \ingroup sparsdr
      *
+     * The block keeps a copy of every compression register that it has
+     * written (see config()). set_thresholds(), set_mask(), and restore()
+     * use it to write only the registers that change.
      */
     class SPARSDR_API compressing_usrp_source : virtual public gr::hier_block2
     {
      public:
       typedef boost::shared_ptr<compressing_usrp_source> sptr;
 
+      /*! \brief The number of FFT bins that have a threshold and a mask */
+      static const std::size_t BIN_COUNT = compression_config::BIN_COUNT;
+
       /*!
        * \brief Return a shared_ptr to a new instance of sparsdr::compressing_usrp_source.
        *
@@ -76,6 +85,49 @@ namespace gr {
        */
       virtual void set_antenna(const std::string& ant) = 0;
 
+      /*!
+       * Returns the actual center frequency.
+       */
+      virtual double get_center_freq() = 0;
+
+      // Begin clock and time settings
+
+      /*!
+       * Sets the source of the reference clock, for example "internal",
+       * "external", or "gpsdo".
+       */
+      virtual void set_clock_source(const std::string& source) = 0;
+
+      /*!
+       * Sets the source of the PPS signal, for example "internal",
+       * "external", or "gpsdo".
+       */
+      virtual void set_time_source(const std::string& source) = 0;
+
+      /*!
+       * Returns the current device time.
+       */
+      virtual ::uhd::time_spec_t get_time_now() = 0;
+
+      /*!
+       * Returns the device time at the last PPS edge.
+       */
+      virtual ::uhd::time_spec_t get_time_last_pps() = 0;
+
+      /*!
+       * Sets the device time at the next PPS edge.
+       *
+       * \param time the device time to set at the next PPS edge
+       */
+      virtual void set_time_next_pps(const ::uhd::time_spec_t& time) = 0;
+
+      /*!
+       * Sets the device time immediately.
+       *
+       * \param time the device time to set
+       */
+      virtual void set_time_now(const ::uhd::time_spec_t& time) = 0;
+
       // Begin SparSDR-specific settings
 
       /*!
@@ -110,6 +162,18 @@ namespace gr {
        */
       virtual void stop_all() = 0;
 
+      /*!
+       * \brief Stops compression and starts it again
+       *
+       * This disables the FFT and sending of FFT and average samples in the
+       * same order as stop_all(), then enables again only the ones that
+       * were enabled, in the same order as start_all(). No other setting
+       * can change in between, so changes made by other threads (for
+       * example, a threshold_controller) are neither lost nor undone. This
+       * function is safe to call from any thread.
+       */
+      virtual void restart() = 0;
+
       /*!
        * \brief Sets the size of the FFT to use when compressing
        *
@@ -154,6 +218,52 @@ namespace gr {
        */
       virtual void set_mask_enabled(uint16_t index, bool enabled) = 0;
 
+      /*!
+       * \brief Sets the thresholds for many FFT bins together
+       *
+       * Only bins whose threshold register would change are written. The
+       * register does not store the lowest 11 bits of the threshold, so
+       * thresholds that differ only in those bits are equal. Bins that this
+       * block has never written are always written.
+       *
+       * If time is not zero, every write is a timed command with that
+       * device time. The update is only atomic if all of its writes fit in
+       * the USRP's command queue, which holds a limited number of timed
+       * commands. When the queue is full, UHD blocks until the queued
+       * commands run at the command time, and the writes that did not fit
+       * take effect late, as soon as they are written. Updates that may
+       * change many bins should use a time far enough in the future and
+       * expect to block until it.
+       *
+       * @param thresholds the thresholds for bins 0 through
+       * thresholds.size() - 1. Other bins do not change.
+       * @param time the device time when the thresholds take effect, or
+       * zero to write them immediately
+       * @return the number of registers written
+       * @throws std::invalid_argument if thresholds has more than BIN_COUNT
+       * elements
+       */
+      virtual std::size_t set_thresholds(const std::vector<uint32_t>& thresholds,
+          const ::uhd::time_spec_t& time = ::uhd::time_spec_t(0.0)) = 0;
+
+      /*!
+       * \brief Enables or disables the masks for many FFT bins together
+       *
+       * Only bins whose mask changes (or that this block has never written)
+       * are written. If time is not zero, the writes are timed commands as
+       * in set_thresholds().
+       *
+       * @param mask true for each bin to mask, for bins 0 through
+       * mask.size() - 1. Other bins do not change.
+       * @param time the device time when the masks take effect, or zero to
+       * write them immediately
+       * @return the number of registers written
+       * @throws std::invalid_argument if mask has more than BIN_COUNT
+       * elements
+       */
+      virtual std::size_t set_mask(const std::vector<bool>& mask,
+          const ::uhd::time_spec_t& time = ::uhd::time_spec_t(0.0)) = 0;
+
       /*!
        * \brief Sets the weight used to calculate average signal magnitudes
        *
@@ -178,6 +288,42 @@ namespace gr {
        * The interval must not be zero.
        */
       virtual void set_average_packet_interval(uint32_t interval) = 0;
+
+      /*!
+       * \brief Returns the compression settings that this block has
+       * written to the USRP
+       *
+       * Settings that this block has not written since it was created (or
+       * since invalidate_config()) are unknown. This function is safe to
+       * call from any thread.
+       */
+      virtual compression_config config() const = 0;
+
+      /*!
+       * \brief Writes the known settings in a configuration that are
+       * unknown or different in config()
+       *
+       * General settings are written first, then thresholds and masks, then
+       * the sending and FFT enables in the same order as start_all(). To
+       * change the FFT size, stop the FFT first. If time is not zero, the
+       * writes are timed commands as in set_thresholds().
+       *
+       * @param config the configuration to restore
+       * @param time the device time when the configuration takes effect, or
+       * zero to write it immediately
+       * @return the number of registers written
+       */
+      virtual std::size_t restore(const compression_config& config,
+          const ::uhd::time_spec_t& time = ::uhd::time_spec_t(0.0)) = 0;
+
+      /*!
+       * \brief Makes every setting in config() unknown
+       *
+       * Call this when the USRP may have lost its settings (for example,
+       * after its FPGA was reloaded), so that the next restore() writes
+       * everything.
+       */
+      virtual void invalidate_config() = 0;
     };
 
   } // namespace sparsdr
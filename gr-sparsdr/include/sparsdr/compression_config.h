@@ -0,0 +1,168 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_COMPRESSION_CONFIG_H
+#define INCLUDED_SPARSDR_COMPRESSION_CONFIG_H
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sparsdr/api.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief The compression settings programmed into a USRP, as known
+     * from the register writes that produced them
+     *
+     * Each setting and each bin's threshold and mask is either known or
+     * unknown. Settings are stored as the values of their registers, so
+     * two configurations are equal exactly when the USRP would behave the
+     * same. In particular, the threshold register does not store the
+     * lowest 11 bits of a threshold.
+     *
+     * A configuration can be converted to and from text, one setting per
+     * line, so that it can be saved and compared between runs.
+     */
+    class SPARSDR_API compression_config
+    {
+    public:
+      /*! \brief The number of FFT bins that have a threshold and a mask */
+      static const std::size_t BIN_COUNT = 2048;
+
+      /*! \brief The settings that apply to all bins */
+      enum setting
+      {
+        /*! \brief 1 if compression is enabled */
+        COMPRESSION_ENABLED = 0,
+        /*! \brief 1 if the FFT is running */
+        FFT_ENABLED,
+        /*! \brief 1 if FFT samples are sent */
+        FFT_SEND_ENABLED,
+        /*! \brief 1 if average samples are sent */
+        AVERAGE_SEND_ENABLED,
+        /*! \brief The FFT size */
+        FFT_SIZE,
+        /*! \brief The FFT scaling */
+        FFT_SCALING,
+        /*! \brief The average weight, mapped to 0...255 */
+        AVERAGE_WEIGHT,
+        /*! \brief The base-2 logarithm of the average packet interval */
+        AVERAGE_INTERVAL,
+        SETTING_COUNT
+      };
+
+      /*! \brief Creates a configuration where nothing is known */
+      compression_config();
+
+      /*! \brief Returns the name of a setting, as used in to_string() */
+      static std::string setting_name(setting s);
+
+      /*! \brief Returns true if a setting is known */
+      bool has(setting s) const;
+      /*!
+       * \brief Returns the register value of a setting
+       *
+       * \throws std::out_of_range if the setting is not known
+       */
+      std::uint32_t get(setting s) const;
+      /*! \brief Records the register value of a setting */
+      void set(setting s, std::uint32_t value);
+
+      /*! \brief Returns true if the threshold of a bin is known */
+      bool has_threshold(std::uint16_t bin) const;
+      /*!
+       * \brief Returns the threshold of a bin, with the bits that the
+       * register does not store set to zero
+       *
+       * \throws std::out_of_range if the threshold is not known
+       */
+      std::uint32_t threshold(std::uint16_t bin) const;
+      /*! \brief Records the threshold of a bin */
+      void set_threshold(std::uint16_t bin, std::uint32_t threshold);
+
+      /*! \brief Returns true if the mask of a bin is known */
+      bool has_mask(std::uint16_t bin) const;
+      /*!
+       * \brief Returns true if a bin is masked
+       *
+       * \throws std::out_of_range if the mask is not known
+       */
+      bool mask(std::uint16_t bin) const;
+      /*! \brief Records the mask of a bin */
+      void set_mask(std::uint16_t bin, bool masked);
+
+      /*! \brief Makes everything unknown */
+      void clear();
+
+      /*!
+       * \brief Returns a description of each known setting, threshold, and
+       * mask in other that is unknown or different in this configuration
+       *
+       * Runs of adjacent bins that change in the same way are described
+       * together.
+       */
+      std::vector<std::string> differences(const compression_config& other) const;
+
+      /*!
+       * \brief Converts this configuration into text
+       *
+       * Each line is a setting name and a register value, "threshold"
+       * followed by a range of bins and a threshold, or "mask" followed by
+       * a range of bins and 0 or 1. A range is one bin number or two
+       * numbers separated by a hyphen (inclusive). Unknown values are left
+       * out.
+       */
+      std::string to_string() const;
+      /*!
+       * \brief Reads a configuration from text produced by to_string()
+       *
+       * \throws std::invalid_argument if the text is not valid
+       */
+      static compression_config from_string(const std::string& text);
+
+      bool operator==(const compression_config& other) const;
+      inline bool operator!=(const compression_config& other) const
+      {
+          return !(*this == other);
+      }
+
+    private:
+      /*! \brief The register value of each setting */
+      std::uint32_t d_settings[SETTING_COUNT];
+      /*! \brief The settings that are known */
+      std::bitset<SETTING_COUNT> d_settings_known;
+      /*! \brief The threshold register value (threshold >> 11) of each bin */
+      std::vector<std::uint32_t> d_thresholds;
+      /*! \brief The bins that have a known threshold */
+      std::bitset<BIN_COUNT> d_thresholds_known;
+      /*! \brief The mask of each bin */
+      std::bitset<BIN_COUNT> d_masks;
+      /*! \brief The bins that have a known mask */
+      std::bitset<BIN_COUNT> d_masks_known;
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_COMPRESSION_CONFIG_H */
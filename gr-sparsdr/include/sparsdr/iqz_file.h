@@ -0,0 +1,246 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_IQZ_FILE_H
+#define INCLUDED_SPARSDR_IQZ_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sparsdr/api.h>
+#include <sparsdr/sample_decoder.h>
+
+/*
+ * Indexed compressed sample file format (.iqz), version 1
+ *
+ * All integers are little-endian.
+ *
+ * File header (16 bytes):
+ *   8 bytes : "SPARSDRZ"
+ *   u32 : version (1)
+ *   u32 : maximum number of samples in each chunk
+ *
+ * Then any number of chunks. Each chunk has a 288-byte header:
+ *   u32 : "IQZC"
+ *   u32 : number of samples in the chunk
+ *   u32 : number of data (not average) samples in the chunk
+ *   u32 : reserved (0)
+ *   u64 : expanded time of the first data sample in the chunk
+ *   u64 : expanded time of the last data sample in the chunk
+ *   u64[32] : bitmap of the FFT bins that have data samples in the chunk
+ *     (bin i is bit i % 64 of element i / 64)
+ * followed by the samples, 8 bytes each, in the same format that the USRP
+ * sends (see sample_decoder.h).
+ *
+ * Expanded times count hardware time steps (see TIME_STEP in
+ * sample_decoder.h) from the start of the capture, or from an earlier time chosen by the writer (for
+ * example, so that captures from several devices share one timeline).
+ * The writer expands the times of average samples as well as data
+ * samples, so a quiet period longer than one rollover of the 20-bit
+ * hardware time does not shift later times. Expanded times do not
+ * overflow, so a reader can start decoding at any chunk. If a chunk has no
+ * data samples, both times are the time of the last sample (data or
+ * average) before it.
+ *
+ * Every chunk except the last has the maximum number of samples.
+ *
+ * After the last chunk is the index, which has one 296-byte entry for
+ * each chunk:
+ *   u64 : offset of the chunk header from the start of the file
+ *   288 bytes : a copy of the chunk header
+ *
+ * The file ends with a 24-byte trailer:
+ *   u64 : offset of the index from the start of the file
+ *   u64 : number of chunks
+ *   8 bytes : "IQZINDEX"
+ *
+ * If a capture was interrupted before the index was written, a reader can
+ * rebuild the index from the chunk headers.
+ */
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Information about a chunk of samples in an .iqz file
+     */
+    struct SPARSDR_API iqz_chunk_info
+    {
+      /*! \brief The number of FFT bins */
+      static const std::size_t BINS = 2048;
+
+      /*! \brief Offset of the chunk header from the start of the file */
+      std::uint64_t offset;
+      /*! \brief The number of samples in the chunk */
+      std::uint32_t sample_count;
+      /*! \brief The number of data (not average) samples in the chunk */
+      std::uint32_t data_sample_count;
+      /*! \brief The expanded time of the first data sample */
+      std::uint64_t start_time;
+      /*! \brief The expanded time of the last data sample */
+      std::uint64_t end_time;
+      /*! \brief The FFT bins that have data samples in this chunk */
+      std::uint64_t active_bins[BINS / 64];
+
+      /*!
+       * \brief Returns true if this chunk has data samples for any bin
+       * in [first_bin, end_bin)
+       */
+      bool has_bins(std::uint16_t first_bin, std::uint16_t end_bin) const;
+
+      /*!
+       * \brief Returns the expanded time of the first sample (data or
+       * average) in this chunk
+       *
+       * \param words the samples in this chunk, from
+       * iqz_reader::read_chunk()
+       */
+      std::uint64_t first_sample_time(const std::vector<std::uint32_t>& words) const;
+    };
+
+    /*!
+     * \brief Writes compressed samples to an .iqz file
+     */
+    class SPARSDR_API iqz_writer
+    {
+    private:
+      /*! \brief The file descriptor of the open file, or -1 after close() */
+      int d_fd;
+      /*! \brief The maximum number of samples in a chunk */
+      std::uint32_t d_chunk_samples;
+      /*! \brief The samples in the current chunk, two words each */
+      std::vector<std::uint32_t> d_chunk;
+      /*! \brief Information about the current chunk */
+      iqz_chunk_info d_chunk_info;
+      /*! \brief The expanded time of the last sample written */
+      std::uint64_t d_last_time;
+      /*! \brief Offset in the file where the next chunk will be written */
+      std::uint64_t d_offset;
+      /*! \brief Information about all chunks written */
+      std::vector<iqz_chunk_info> d_index;
+      /*! \brief Decoded samples from the current call to write() */
+      decoded_samples d_decoded;
+
+      void start_chunk();
+      void write_chunk();
+
+    public:
+      /*!
+       * \brief Creates or truncates a file and writes the file header
+       *
+       * \param path the path to the file
+       * \param chunk_samples the maximum number of samples in each chunk
+       * \param start_time the expanded time that the capture starts at.
+       * The time in the first sample is expanded to the first time at or
+       * after this with the same lowest 20 bits.
+       *
+       * \throws std::runtime_error if the file can't be opened or written
+       */
+      iqz_writer(const std::string& path, std::uint32_t chunk_samples = 65536,
+          std::uint64_t start_time = 0);
+      /*! \brief Calls close() */
+      ~iqz_writer();
+
+      iqz_writer(const iqz_writer&) = delete;
+      iqz_writer& operator=(const iqz_writer&) = delete;
+
+      /*!
+       * \brief Adds samples to the file
+       *
+       * \param words the samples, two 32-bit words each
+       * \param sample_count the number of samples (half the number of words)
+       *
+       * \throws std::runtime_error if the file can't be written
+       */
+      void write(const std::uint32_t* words, std::size_t sample_count);
+
+      /*!
+       * \brief Writes any remaining samples, the index, and the trailer,
+       * then closes the file
+       *
+       * Calling this more than once has no effect.
+       */
+      void close();
+    };
+
+    /*!
+     * \brief Reads chunks of compressed samples from an .iqz file
+     */
+    class SPARSDR_API iqz_reader
+    {
+    private:
+      /*! \brief The file descriptor of the open file */
+      int d_fd;
+      /*! \brief The maximum number of samples in a chunk */
+      std::uint32_t d_chunk_samples;
+      /*! \brief Information about all complete chunks in the file */
+      std::vector<iqz_chunk_info> d_index;
+
+      bool read_index(std::uint64_t file_size);
+      void rebuild_index(std::uint64_t file_size);
+
+    public:
+      /*!
+       * \brief Opens a file and reads its index
+       *
+       * \throws std::runtime_error if the file can't be read or is not
+       * an .iqz file
+       */
+      explicit iqz_reader(const std::string& path);
+      ~iqz_reader();
+
+      iqz_reader(const iqz_reader&) = delete;
+      iqz_reader& operator=(const iqz_reader&) = delete;
+
+      /*! \brief Returns information about all chunks, in time order */
+      inline const std::vector<iqz_chunk_info>& chunks() const
+      {
+          return d_index;
+      }
+
+      /*!
+       * \brief Returns the indexes of the chunks that may have data
+       * samples with expanded times in [start_time, end_time) and bins in
+       * [first_bin, end_bin)
+       *
+       * This only uses the index, so it does not read any samples.
+       */
+      std::vector<std::size_t> find_chunks(std::uint64_t start_time,
+          std::uint64_t end_time,
+          std::uint16_t first_bin = 0,
+          std::uint16_t end_bin = iqz_chunk_info::BINS) const;
+
+      /*!
+       * \brief Reads the samples in a chunk
+       *
+       * \param chunk the index of the chunk in chunks()
+       * \param words this is resized to two words per sample and filled
+       * with the samples
+       *
+       * \throws std::runtime_error if the chunk can't be read
+       */
+      void read_chunk(std::size_t chunk, std::vector<std::uint32_t>& words) const;
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_IQZ_FILE_H */
@@ -0,0 +1,69 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_IQZ_FILE_SINK_H
+#define INCLUDED_SPARSDR_IQZ_FILE_SINK_H
+
+#include <cstdint>
+#include <string>
+#include <sparsdr/api.h>
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Writes compressed samples to an indexed .iqz file
+     * \ingroup sparsdr
+     *
+     * The file is divided into chunks with a header that records the time
+     * range and the bins with data in that chunk. An index of the chunks at
+     * the end of the file allows iqz_file_source to read a range of time or
+     * bins without reading the rest of the file (see iqz_file.h).
+     *
+     * The index is written when the flowgraph stops.
+     */
+    class SPARSDR_API iqz_file_sink : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<iqz_file_sink> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of sparsdr::iqz_file_sink.
+       *
+       * To avoid accidental use of raw pointers, sparsdr::iqz_file_sink's
+       * constructor is in a private implementation
+       * class. sparsdr::iqz_file_sink::make is the public interface for
+       * creating new instances.
+       *
+       * \param path the path to the file to write
+       * \param chunk_samples the maximum number of samples in each chunk
+       * \param start_time the expanded time that the capture starts at
+       * (see iqz_writer)
+       */
+      static sptr make(const std::string& path,
+          std::uint32_t chunk_samples = 65536,
+          std::uint64_t start_time = 0);
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_IQZ_FILE_SINK_H */
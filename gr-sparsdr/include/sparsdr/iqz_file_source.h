@@ -0,0 +1,93 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_IQZ_FILE_SOURCE_H
+#define INCLUDED_SPARSDR_IQZ_FILE_SOURCE_H
+
+#include <cstdint>
+#include <string>
+#include <sparsdr/api.h>
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Reads compressed samples from an indexed .iqz file
+     * \ingroup sparsdr
+     *
+     * The block uses the index in the file to find the chunks that have
+     * data samples in a range of time and bins, and reads only those
+     * chunks. The chunks are sent out whole, so the output may also include
+     * some samples from just outside the range.
+     *
+     * Times are expanded hardware times, in hardware time steps (see
+     * TIME_STEP in sample_decoder.h) from the start of the capture. Bins
+     * are hardware FFT bin indexes, as used by mask_range.
+     *
+     * Chunks are sent one after another even if other chunks were between
+     * them in the file, so the hardware time in the output can jump
+     * forward at the start of a chunk. The first item of each chunk has a
+     * "chunk_start" tag whose value is the expanded time of the first
+     * sample in the chunk (as a uint64).
+     *
+     * The output can be connected to native_reconstruct.
+     */
+    class SPARSDR_API iqz_file_source : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<iqz_file_source> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of sparsdr::iqz_file_source.
+       *
+       * To avoid accidental use of raw pointers, sparsdr::iqz_file_source's
+       * constructor is in a private implementation
+       * class. sparsdr::iqz_file_source::make is the public interface for
+       * creating new instances.
+       *
+       * \param path the path to the file to read
+       * \param start_time the beginning of the time range to read
+       * \param end_time the end of the time range to read (exclusive)
+       * \param first_bin the first bin to read
+       * \param end_bin the bin after the last bin to read
+       */
+      static sptr make(const std::string& path,
+          std::uint64_t start_time = 0,
+          std::uint64_t end_time = UINT64_MAX,
+          std::uint16_t first_bin = 0,
+          std::uint16_t end_bin = 2048);
+
+      /*!
+       * \brief Returns the number of chunks in the file
+       */
+      virtual std::size_t total_chunks() const = 0;
+
+      /*!
+       * \brief Returns the number of chunks in the file that are in the
+       * time and bin range, which is the number of chunks this block reads
+       */
+      virtual std::size_t selected_chunks() const = 0;
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_IQZ_FILE_SOURCE_H */
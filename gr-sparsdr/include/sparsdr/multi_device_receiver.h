@@ -0,0 +1,177 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_MULTI_DEVICE_RECEIVER_H
+#define INCLUDED_SPARSDR_MULTI_DEVICE_RECEIVER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sparsdr/api.h>
+#include <sparsdr/average_detector.h>
+#include <sparsdr/capture_index.h>
+#include <sparsdr/compressing_usrp_source.h>
+#include <sparsdr/mask_range.h>
+#include <gnuradio/hier_block2.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief A hierarchical block that receives compressed samples from
+     * several USRPs at the same time and writes them to captures that share
+     * one timeline
+     * \ingroup sparsdr
+     *
+     * The devices should share a reference clock and a PPS signal. The
+     * receiver sets the same device time on all of them at a PPS edge, then
+     * uses timed commands to start compression on all of them at the same
+     * device time.
+     *
+     * Each device's samples are written to an .iqz file (see iqz_file.h).
+     * The writer expands the 20-bit time in each sample into a 64-bit time
+     * that counts hardware time steps (see TIME_STEP in sample_decoder.h)
+     * from device time zero, so the expanded times
+     * in all the files are on the same timeline. This requires the time
+     * stamps in the compressed samples to follow the device time. An index
+     * file (see capture_index) lists the files with the center frequency
+     * of each device, so reconstruction can treat the captures as one
+     * wide band.
+     *
+     * Each device has its own source, overflow detector, and file sink.
+     * If cores are given, the blocks for each device all run on one core,
+     * and different devices use different cores where possible.
+     *
+     * The receiver detects overflows on each device separately, publishes
+     * a message on its "overflow" message port for each one, and restarts
+     * compression on that device. Because the time stamps follow the
+     * device time, a restarted device stays on the shared timeline.
+     *
+     * This block does not have any inputs or outputs.
+     *
+     * When a multi_device_receiver is destructed it disables compression on
+     * all of its USRPs, returning them to normal mode.
+     */
+    class SPARSDR_API multi_device_receiver : virtual public gr::hier_block2
+    {
+     public:
+      typedef boost::shared_ptr<multi_device_receiver> sptr;
+
+      /*! \brief The duration type returned by expected_average_interval() */
+      typedef std::chrono::nanoseconds duration;
+
+      /*! \brief The bandwidth that each device captures, in hertz */
+      static const double DEVICE_BANDWIDTH;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of sparsdr::multi_device_receiver.
+       *
+       * To avoid accidental use of raw pointers, sparsdr::multi_device_receiver's
+       * constructor is in a private implementation
+       * class. sparsdr::multi_device_receiver::make is the public interface for
+       * creating new instances.
+       *
+       * This function waits for the device times to be set and for all
+       * timed commands to be queued, which takes one to two seconds.
+       *
+       * \param usrps existing USRP sources, configured as for
+       * real_time_receiver. Each one should be tuned to a different center
+       * frequency.
+       *
+       * \param output_paths the path to the .iqz file to write for each
+       * USRP
+       *
+       * \param index_path the path to the capture index file to write
+       *
+       * \param threshold the initial threshold for all bins
+       *
+       * \param masks ranges of bins to mask out on all devices
+       *
+       * \param time_source the source of the reference clock and PPS signal
+       * for all devices, for example "external" or "gpsdo". If this is
+       * "internal", the device times are set one after another without a
+       * PPS edge, so they are only as close as the host can make them.
+       *
+       * \param cores the CPU cores to run each device's blocks on. Device i
+       * uses core cores[i % cores.size()]. If this is empty, the blocks are
+       * not pinned to any core.
+       *
+       * \param start_delay the time in seconds from when the device times
+       * are set until compression starts. This must be long enough to queue
+       * the timed commands for all devices.
+       *
+       * \throws std::invalid_argument if there are no USRPs, or the number
+       * of output paths is different from the number of USRPs
+       *
+       * \throws std::runtime_error if the devices do not see a PPS edge, or
+       * a file can't be written
+       */
+      static sptr make(const std::vector<compressing_usrp_source::sptr>& usrps,
+          const std::vector<std::string>& output_paths,
+          const std::string& index_path,
+          uint32_t threshold = 25000,
+          const std::vector< ::gr::sparsdr::mask_range>& masks
+              = std::vector< ::gr::sparsdr::mask_range>(),
+          const std::string& time_source = "external",
+          const std::vector<int>& cores = std::vector<int>(),
+          double start_delay = 1.0);
+
+      /*! \brief Returns the number of devices */
+      virtual std::size_t device_count() const = 0;
+
+      /*!
+       * \brief Returns the expected time interval between average samples
+       * from each USRP
+       */
+      virtual duration expected_average_interval() const = 0;
+
+      /*!
+       * \brief Returns the expanded time (in hardware time steps from
+       * device time zero) when compression started
+       */
+      virtual std::uint64_t start_time() const = 0;
+
+      /*! \brief Returns the index of the captures that this block writes */
+      virtual capture_index index() const = 0;
+
+      /*!
+       * \brief Returns counts of the samples seen from one USRP, the
+       * hardware time of the last sample, and the number of overflows
+       *
+       * This function is safe to call from any thread.
+       *
+       * \throws std::out_of_range if device is not less than device_count()
+       */
+      virtual average_detector_stats average_stats(std::size_t device) = 0;
+
+      /*!
+       * \brief Disables and re-enables the FFT on one USRP
+       *
+       * \throws std::out_of_range if device is not less than device_count()
+       */
+      virtual void restart_compression(std::size_t device) = 0;
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_MULTI_DEVICE_RECEIVER_H */
@@ -0,0 +1,158 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_SPARSDR_NATIVE_RECONSTRUCT_H
+#define INCLUDED_SPARSDR_NATIVE_RECONSTRUCT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <sparsdr/api.h>
+#include <sparsdr/band_spec.h>
+#include <gnuradio/block.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Reconstructs signals from one or more bands of compressed
+     * samples, without starting a sparsdr_reconstruct process
+     * \ingroup sparsdr
+     *
+     * The input is a stream of compressed samples, as produced by a
+     * compressing_usrp_source. There is one output of reconstructed
+     * samples for each band.
+     *
+     * The reconstruct block uses this block unless it is configured to use
+     * the sparsdr_reconstruct executable.
+     *
+     * A window is complete when a sample from a later window arrives. When
+     * the input ends, the block completes the last window and writes the
+     * second half of the last window in each band.
+     *
+     * By default, the output of each band contains only the reconstructed
+     * windows, and time with no signals in the band is skipped. If gaps are
+     * filled, each gap becomes a run of zeros of the correct length, so
+     * the output follows the capture time. The zeros are written without
+     * running any FFTs. Optionally, the first zero of each run has a
+     * "silence" tag whose value (a uint64) is the length of the run.
+     * Because a gap ends only when the next window in the band arrives,
+     * its zeros are written at that time.
+     *
+     * The block can also tag each burst (a series of adjacent windows) in
+     * each band, so that decoders can handle bursts separately. The first
+     * sample of a burst has a "burst_start" tag and the last sample has a
+     * "burst_end" tag. The value of each tag is a dictionary with "time",
+     * the expanded time of the first or last window (a uint64), and "band",
+     * the index of the band (a uint64). A sample_distributor releases a
+     * decoder at each burst_end tag.
+     *
+     * Bands can be opened and closed while the flowgraph runs. The block
+     * has one output for each band slot. If max_bands is larger than the
+     * number of bands, the extra slots start empty, and an empty slot
+     * produces no samples. open_band() and close_band() (or messages on
+     * the "command" port) schedule a change to a slot at an expanded time
+     * (the time of a compressed sample, which counts half-windows since
+     * the start of the capture; average samples are counted too, so the
+     * time stays correct across silences longer than one rollover of the
+     * 20-bit counter). The change takes effect at the first
+     * window boundary where the next window has a time at or after the
+     * requested time, so an opened band reconstructs exactly the windows
+     * at or after that time, and a closed band reconstructs exactly the
+     * windows before it. Other bands are not interrupted.
+     *
+     * When a band is closed, the rest of its output is written before the
+     * output of any band that is later opened in the same slot. Opening a
+     * band in a slot that already has one closes the old band first. The
+     * first sample of each band opened at run time has a "band_open" tag
+     * whose value is a dictionary with "band" (the slot, a uint64),
+     * "time" (the time when the band was opened, a uint64), "frequency"
+     * (a double), and "bins" (a uint64).
+     *
+     * A message on the "command" port is a dictionary with "cmd" ("open"
+     * or "close"), "band" (the slot), and optionally "time" (an expanded
+     * time, default 0, which means at the next window boundary). Open
+     * commands also have "frequency" and "bins". Invalid commands are
+     * logged and ignored.
+     */
+    class SPARSDR_API native_reconstruct : virtual public gr::block
+    {
+     public:
+      typedef boost::shared_ptr<native_reconstruct> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of sparsdr::native_reconstruct.
+       *
+       * To avoid accidental use of raw pointers, sparsdr::native_reconstruct's
+       * constructor is in a private implementation
+       * class. sparsdr::native_reconstruct::make is the public interface for
+       * creating new instances.
+       *
+       * \param bands the bands to decompress
+       * \param fill_gaps true to write zeros for the time between
+       * windows
+       * \param tag_silence true to tag the start of each run of zeros
+       * (only used if fill_gaps is true)
+       * \param tag_bursts true to tag the start and end of each burst
+       * \param max_bands the number of band slots (and outputs). If this is
+       * less than the number of bands, there is one slot for each band.
+       */
+      static sptr make(std::vector<::gr::sparsdr::band_spec> bands,
+          bool fill_gaps = false,
+          bool tag_silence = false,
+          bool tag_bursts = false,
+          unsigned int max_bands = 0);
+
+      /*!
+       * \brief Schedules a band to open in a slot
+       *
+       * This function is safe to call from any thread.
+       *
+       * \param slot the index of the slot (and output)
+       * \param band the band to reconstruct
+       * \param time the expanded time of the first window to reconstruct,
+       * or 0 to open the band at the next window boundary
+       *
+       * \throws std::out_of_range if the slot or the number of bins is not
+       * valid
+       */
+      virtual void open_band(std::size_t slot, const band_spec& band,
+          std::uint64_t time = 0) = 0;
+
+      /*!
+       * \brief Schedules the band in a slot to close
+       *
+       * Closing an empty slot has no effect. This function is safe to call
+       * from any thread.
+       *
+       * \param slot the index of the slot (and output)
+       * \param time the expanded time of the first window not to
+       * reconstruct, or 0 to close the band at the next window boundary
+       *
+       * \throws std::out_of_range if the slot is not valid
+       */
+      virtual void close_band(std::size_t slot, std::uint64_t time = 0) = 0;
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_NATIVE_RECONSTRUCT_H */
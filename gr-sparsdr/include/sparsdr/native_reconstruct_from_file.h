@@ -0,0 +1,74 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_SPARSDR_NATIVE_RECONSTRUCT_FROM_FILE_H
+#define INCLUDED_SPARSDR_NATIVE_RECONSTRUCT_FROM_FILE_H
+
+#include <string>
+#include <vector>
+#include <sparsdr/api.h>
+#include <sparsdr/band_spec.h>
+#include <gnuradio/block.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Reconstructs signals from one or more bands of a file of
+     * compressed samples, using several threads
+     * \ingroup sparsdr
+     *
+     * The file is memory-mapped and split into chunks at window boundaries.
+     * Worker threads reconstruct the chunks independently, and this block
+     * joins the results in order with the correct overlap at each seam, so
+     * the output is the same as reconstructing the whole file in sequence.
+     * There is one output of reconstructed samples for each band.
+     *
+     * The reconstruct_from_file block uses this block unless it is
+     * configured to use the sparsdr_reconstruct executable.
+     */
+    class SPARSDR_API native_reconstruct_from_file : virtual public gr::block
+    {
+     public:
+      typedef boost::shared_ptr<native_reconstruct_from_file> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of sparsdr::native_reconstruct_from_file.
+       *
+       * To avoid accidental use of raw pointers, sparsdr::native_reconstruct_from_file's
+       * constructor is in a private implementation
+       * class. sparsdr::native_reconstruct_from_file::make is the public interface for
+       * creating new instances.
+       *
+       * \param bands the bands to decompress
+       * \param input_path the file of compressed samples to read
+       * \param threads the number of threads to use, or 0 to use one
+       * thread for each processor
+       */
+      static sptr make(std::vector<::gr::sparsdr::band_spec> bands,
+          const std::string& input_path,
+          unsigned int threads = 0);
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_NATIVE_RECONSTRUCT_FROM_FILE_H */
@@ -0,0 +1,160 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_RATE_GOVERNOR_H
+#define INCLUDED_SPARSDR_RATE_GOVERNOR_H
+
+#include <cstdint>
+#include <vector>
+#include <sparsdr/api.h>
+#include <sparsdr/compressing_usrp_source.h>
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief A consistent snapshot of the state of a rate_governor
+     */
+    struct SPARSDR_API rate_governor_stats
+    {
+      /*! \brief The current throttle level (0 when not throttling) */
+      std::uint32_t level;
+      /*! \brief The number of times the level was raised */
+      std::uint64_t raises;
+      /*! \brief The number of times the level was lowered */
+      std::uint64_t relaxes;
+      /*! \brief The compressed data rate measured in the last period (bytes/s) */
+      double measured_rate;
+    };
+
+    /*!
+     * \brief Throttles a compressing USRP when its compressed data rate
+     * nears the capacity of the link to the host
+     * \ingroup sparsdr
+     *
+     * This block reads the compressed samples from the USRP and measures
+     * their rate in bytes per second of hardware time, over periods of a
+     * fixed number of hardware time steps (see TIME_STEP in
+     * sample_decoder.h).
+     *
+     * When the rate in a period is above the engage fraction of the
+     * ceiling, the block raises its throttle level by one. Level 1 masks the
+     * low-priority bins. Low-priority bins that are already masked when
+     * throttling starts (for example, by an auto_masker) are left alone,
+     * and if all of them are, there is no masking level. Each further level doubles every
+     * threshold, relative to the thresholds that were on the USRP before
+     * throttling started. When the rate stays below the relax fraction of
+     * the ceiling for the relax period count, the block lowers the level by
+     * one. At level 0, the thresholds and masks that the block changed are
+     * restored.
+     *
+     * An overflow message on the "overflow" input port also raises the
+     * level, at most once per period.
+     *
+     * Each level change is published on the "throttle" message port as a
+     * dictionary with the entries level and rate. Changes that raise the
+     * level are also published on the "raise" port. If threshold scaling is
+     * disabled (for example, because a threshold_controller is managing the
+     * thresholds), the block changes only masks, and the "raise" messages
+     * can be sent to the threshold_controller's overflow port instead.
+     */
+    class SPARSDR_API rate_governor : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<rate_governor> sptr;
+
+      /*! \brief The number of threshold doublings available */
+      static const std::uint32_t MAX_THRESHOLD_SHIFT = 8;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of sparsdr::rate_governor.
+       *
+       * To avoid accidental use of raw pointers, sparsdr::rate_governor's
+       * constructor is in a private implementation
+       * class. sparsdr::rate_governor::make is the public interface for
+       * creating new instances.
+       *
+       * \param usrp the USRP to throttle. If this is null, the block only
+       * publishes level changes.
+       * \param ceiling the highest compressed data rate that the link can
+       * carry, in bytes per second
+       * \param period the measurement period, in hardware time steps
+       * \param window_duration the duration of one hardware time step, in
+       * seconds. The default (TIME_STEP) is correct for a USRP N210 with
+       * 2048 bins.
+       *
+       * \throws std::invalid_argument if ceiling, period, or window_duration
+       * is not positive
+       */
+      static sptr make(compressing_usrp_source::sptr usrp,
+          double ceiling,
+          std::uint32_t period = 1024,
+          double window_duration = 10.24e-6);
+
+      /*! \brief Returns the current level and counts of level changes */
+      virtual rate_governor_stats stats() const = 0;
+
+      /*!
+       * \brief Sets the bins that are masked first when throttling
+       *
+       * This takes effect the next time throttling starts.
+       *
+       * \param low_priority one entry per bin, true for low-priority bins
+       * \throws std::invalid_argument if low_priority has more entries than
+       * there are bins
+       */
+      virtual void set_low_priority(const std::vector<bool>& low_priority) = 0;
+
+      /*!
+       * \brief Sets the highest compressed data rate, in bytes per second
+       *
+       * \throws std::invalid_argument if ceiling is not positive
+       */
+      virtual void set_ceiling(double ceiling) = 0;
+
+      /*!
+       * \brief Sets the fractions of the ceiling above which the level is
+       * raised (default 0.9) and below which it is lowered (default 0.5)
+       *
+       * \throws std::invalid_argument unless 0 < relax < engage <= 1
+       */
+      virtual void set_fractions(double engage, double relax) = 0;
+
+      /*!
+       * \brief Sets the number of consecutive periods below the relax
+       * fraction needed to lower the level (default 10)
+       *
+       * \throws std::invalid_argument if periods is 0
+       */
+      virtual void set_relax_periods(std::uint32_t periods) = 0;
+
+      /*!
+       * \brief Enables or disables changing thresholds (enabled by default)
+       *
+       * This takes effect the next time throttling starts at level 0.
+       */
+      virtual void set_threshold_scaling(bool enabled) = 0;
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_RATE_GOVERNOR_H */
@@ -3,8 +3,14 @@
 
 #include <chrono>
 #include <string>
+#include <vector>
 #include <sparsdr/api.h>
+#include <sparsdr/auto_masker.h>
+#include <sparsdr/average_detector.h>
+#include <sparsdr/capture_sink.h>
+#include <sparsdr/threshold_controller.h>
 #include <sparsdr/mask_range.h>
+#include <sparsdr/rate_governor.h>
 #include <sparsdr/compressing_usrp_source.h>
 #include <gnuradio/hier_block2.h>
 
@@ -17,10 +23,22 @@ namespace gr {
      * \ingroup sparsdr
      *
      * The file may be a named pipe that can send data to a decompression
-     * process for real-time use.
+     * process for real-time use. The file is written by a capture_sink,
+     * which discards samples instead of blocking if a regular file is too
+     * slow, and waits for the reader of a named pipe.
      *
      * This block does not have any inputs or outputs.
      *
+     * The receiver uses the hardware time in the compressed samples to
+     * detect overflows (see average_detector), and publishes a message on
+     * its "overflow" message port for each one. Depending on the restart
+     * policy, it also restarts compression immediately.
+     *
+     * If automatic masking is enabled, the receiver also has a "mask"
+     * message port that publishes each decision of its auto_masker.
+     * Similarly, if a rate ceiling is set, the "throttle" message port
+     * publishes each level change of its rate_governor.
+     *
      * When a real_time_receiver is destructed it disables compression on
      * its USRP, returning it to normal mode.
      */
@@ -34,6 +52,16 @@ namespace gr {
       /*! \brief The time point type returned by last_average() */
       typedef std::chrono::high_resolution_clock::time_point time_point;
 
+      /*! \brief What the receiver does when it detects an overflow */
+      enum restart_policy {
+        /*! \brief Only report the overflow */
+        RESTART_NEVER,
+        /*!
+         * \brief Restart compression, at most once per average interval
+         */
+        RESTART_ON_OVERFLOW,
+      };
+
       /*!
        * \brief Return a shared_ptr to a new instance of sparsdr::real_time_receiver.
        *
@@ -54,11 +82,46 @@ namespace gr {
        *
        * \param mask an optional range of bins to mask out. The default
        * value does not mask any bins.
+       *
+       * \param policy what to do when an overflow is detected
+       *
+       * \param target_rate if this is not zero, a threshold_controller
+       * adjusts the per-bin thresholds, starting from threshold, so that
+       * the USRP sends about this many data samples per second
        */
       static sptr make(compressing_usrp_source::sptr usrp,
           const std::string& output_path,
           uint32_t threshold = 25000,
-          ::gr::sparsdr::mask_range mask = ::gr::sparsdr::mask_range());
+          ::gr::sparsdr::mask_range mask = ::gr::sparsdr::mask_range(),
+          restart_policy policy = RESTART_ON_OVERFLOW,
+          double target_rate = 0.0);
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of
+       * sparsdr::real_time_receiver that masks any set of bins
+       *
+       * \param masks ranges of bins to mask out. The ranges may overlap.
+       *
+       * \param auto_mask_level if this is not zero, an auto_masker masks
+       * bins whose data sample duty cycle stays above this level (0 to 1)
+       * and unmasks them after a cooldown. Bins in masks are never
+       * unmasked.
+       *
+       * \param rate_ceiling if this is not zero, a rate_governor throttles
+       * the USRP when its compressed data rate (in bytes per second) nears
+       * this value. If there is also a threshold controller, the governor
+       * only masks low-priority bins and raises the controller's margin.
+       *
+       * The other parameters are the same as in the other make function.
+       */
+      static sptr make(compressing_usrp_source::sptr usrp,
+          const std::string& output_path,
+          uint32_t threshold,
+          const std::vector< ::gr::sparsdr::mask_range>& masks,
+          restart_policy policy = RESTART_ON_OVERFLOW,
+          double target_rate = 0.0,
+          double auto_mask_level = 0.0,
+          double rate_ceiling = 0.0);
 
       /*!
        * \brief Returns the expected time interval between average samples
@@ -71,6 +134,23 @@ namespace gr {
        */
       virtual time_point last_average() = 0;
 
+      /*!
+       * \brief Returns counts of the samples seen from the USRP, the
+       * hardware time of the last sample, and the time of the last average
+       * sample
+       *
+       * This function is safe to call from any thread.
+       */
+      virtual average_detector_stats average_stats() = 0;
+
+      /*!
+       * \brief Returns the amount of data written to the output file, the
+       * write throughput, and the number of buffers waiting to be written
+       *
+       * This function is safe to call from any thread.
+       */
+      virtual capture_sink_stats capture_stats() = 0;
+
       /*!
        * \brief Disables and re-enables the FFT on the USRP
        *
@@ -78,6 +158,31 @@ namespace gr {
        * internal overflow.
        */
       virtual void restart_compression() = 0;
+
+      /*!
+       * \brief Changes what the receiver does when it detects an overflow
+       *
+       * This function is safe to call from any thread.
+       */
+      virtual void set_restart_policy(restart_policy policy) = 0;
+
+      /*!
+       * \brief Returns the threshold controller, or null if the receiver
+       * was created without a target rate
+       */
+      virtual threshold_controller::sptr controller() const = 0;
+
+      /*!
+       * \brief Returns the automatic masker, or null if the receiver
+       * was created without an automatic mask level
+       */
+      virtual auto_masker::sptr masker() const = 0;
+
+      /*!
+       * \brief Returns the rate governor, or null if the receiver was
+       * created without a rate ceiling
+       */
+      virtual rate_governor::sptr governor() const = 0;
     };
 
   } // namespace sparsdr
@@ -22,18 +22,70 @@
 #ifndef INCLUDED_SPARSDR_RECONSTRUCT_H
 #define INCLUDED_SPARSDR_RECONSTRUCT_H
 
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 #include <sparsdr/api.h>
 #include <sparsdr/band_spec.h>
+#include <sparsdr/band_buffering.h>
 #include <gnuradio/hier_block2.h>
 
 namespace gr {
   namespace sparsdr {
 
+    /*!
+     * \brief Counts for one shared-memory ring to or from
+     * sparsdr_reconstruct
+     */
+    struct SPARSDR_API reconstruct_pipe_stats
+    {
+      /*!
+       * \brief The number of bytes in the ring waiting to be read
+       *
+       * A large value means that the reader of the ring is slow.
+       */
+      std::uint64_t bytes_buffered;
+      /*! \brief The number of bytes that passed through the ring during
+       * the last complete second */
+      std::uint64_t bytes_per_second;
+    };
+
+    /*!
+     * \brief The state of the sparsdr_reconstruct process
+     */
+    struct SPARSDR_API reconstruct_stats
+    {
+      /*! \brief True if a sparsdr_reconstruct process is running */
+      bool running;
+      /*! \brief The number of times the process has been restarted */
+      std::uint32_t restarts;
+      /*! \brief The ring that carries compressed samples to the process */
+      reconstruct_pipe_stats compressed;
+    };
+
     /*!
      * \brief The SparSDR reconstruct block receives compressed samples
      * and reconstructs signals from one or more bands
      * \ingroup sparsdr
      *
+     * By default, reconstruction runs in this process using a
+     * native_reconstruct block. It can also run in a separate
+     * sparsdr_reconstruct process. This block exchanges samples with it
+     * through single-producer single-consumer rings in shared memory, one
+     * for the compressed samples and one for each band.
+     *
+     * When a sparsdr_reconstruct process is used, a supervisor thread checks
+     * it several times each second. If it stops unexpectedly, the
+     * supervisor starts a new process with new rings and switches this
+     * block to them. Samples that were in the old rings are lost. After
+     * max_restarts restarts, the outputs end instead. If the process finishes normally (at the end of
+     * its input), the outputs end when it has written all its samples.
+     *
+     * When reconstructing in process, bands can be opened and closed while
+     * the flowgraph runs, using open_band() and close_band() or messages on
+     * the "command" port (see native_reconstruct). max_bands sets the number
+     * of band slots and outputs. The sparsdr_reconstruct process always
+     * reconstructs the bands it was started with.
      */
     class SPARSDR_API reconstruct : virtual public gr::hier_block2
     {
@@ -51,8 +103,68 @@ namespace gr {
        * \param bands the bands to decompress
        * \param reconstruct_path the path to the sparsdr_reconstruct executable
        * \param unbuffered true to disable buffering on the input and output files
+       * \param in_process true to reconstruct in this process, false to
+       * start sparsdr_reconstruct. reconstruct_path and unbuffered are only
+       * used if this is false.
+       * \param fill_gaps true to write zeros for the time between windows
+       * (only used in process, see native_reconstruct)
+       * \param tag_silence true to tag the start of each run of zeros
+       * (only used in process with fill_gaps)
+       * \param tag_bursts true to tag the start and end of each burst
+       * (only used in process)
+       * \param max_restarts the maximum number of times to restart the
+       * sparsdr_reconstruct process if it stops unexpectedly
+       * \param buffering buffering settings for each band, in the same order
+       * as bands, or an empty vector to use the default settings for all
+       * bands. If unbuffered is true, sparsdr_reconstruct does not buffer
+       * any band.
+       *
+       * Empty band slots use the default settings.
+       * \param max_bands the number of band slots and outputs (only used in
+       * process). If this is less than the number of bands, there is one
+       * slot for each band.
+       *
+       * \throws std::invalid_argument if buffering is not empty and does not
+       * have one element for each band, or if max_bands is larger than the
+       * number of bands and in_process is false
+       */
+      static sptr make(std::vector<::gr::sparsdr::band_spec> bands, const std::string& reconstruct_path = "sparsdr_reconstruct", bool unbuffered = false, bool in_process = true, bool fill_gaps = false, bool tag_silence = false, bool tag_bursts = false, unsigned int max_restarts = 5, std::vector<::gr::sparsdr::band_buffering> buffering = std::vector<::gr::sparsdr::band_buffering>(), unsigned int max_bands = 0);
+
+      /*!
+       * \brief Returns the state of the sparsdr_reconstruct process and
+       * counts for the compressed sample ring
+       *
+       * When reconstructing in process, this returns all zeros.
+       * Values are updated by the supervisor thread about once per second.
+       * This function is safe to call from any thread.
+       */
+      virtual reconstruct_stats stats() const = 0;
+
+      /*!
+       * \brief Returns counts for the output ring of each band, in the same
+       * order as the bands
+       *
+       * When reconstructing in process, this returns an empty vector.
+       * This function is safe to call from any thread.
+       */
+      virtual std::vector<reconstruct_pipe_stats> band_stats() const = 0;
+
+      /*!
+       * \brief Schedules a band to open in a slot (see
+       * native_reconstruct::open_band())
+       *
+       * \throws std::logic_error if reconstructing with sparsdr_reconstruct
+       */
+      virtual void open_band(std::size_t slot, const band_spec& band,
+          std::uint64_t time = 0) = 0;
+
+      /*!
+       * \brief Schedules the band in a slot to close (see
+       * native_reconstruct::close_band())
+       *
+       * \throws std::logic_error if reconstructing with sparsdr_reconstruct
        */
-      static sptr make(std::vector<::gr::sparsdr::band_spec> bands, const std::string& reconstruct_path = "sparsdr_reconstruct", bool unbuffered = false);
+      virtual void close_band(std::size_t slot, std::uint64_t time = 0) = 0;
     };
 
   } // namespace sparsdr
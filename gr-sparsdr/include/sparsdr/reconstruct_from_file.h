@@ -49,10 +49,15 @@ namespace gr {
        * creating new instances.
        *
        * \param bands the bands to decompress
+       * \param input_path the file of compressed samples to read
        * \param reconstruct_path the path to the sparsdr_reconstruct executable
-       * \param unbuffered true to disable buffering on the input and output files
+       * \param in_process true to reconstruct in this process with
+       * native_reconstruct_from_file, false to start sparsdr_reconstruct.
+       * reconstruct_path is only used if this is false.
+       * \param threads the number of threads to use in process, or 0 to use
+       * one thread for each processor
        */
-      static sptr make(std::vector<::gr::sparsdr::band_spec> bands, const std::string& input_path, const std::string& reconstruct_path = "sparsdr_reconstruct");
+      static sptr make(std::vector<::gr::sparsdr::band_spec> bands, const std::string& input_path, const std::string& reconstruct_path = "sparsdr_reconstruct", bool in_process = true, unsigned int threads = 0);
     };
 
   } // namespace sparsdr
@@ -0,0 +1,377 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_SAMPLE_DECODER_H
+#define INCLUDED_SPARSDR_SAMPLE_DECODER_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPARSDR_DECODER_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SPARSDR_DECODER_NEON 1
+#include <arm_neon.h>
+#endif
+
+/*
+ * Compressed sample format
+ *
+ * Each sample is 8 bytes, which the USRP source delivers as two 32-bit
+ * little-endian items.
+ *
+ * First item:
+ * Bits 31:16 : 16 least significant bits of the time
+ * Bit 15 : 1 for an average sample, 0 for a data sample
+ * Bits 14:4 : FFT bin index
+ * Bits 3:0 : 4 most significant bits of the time
+ *
+ * Second item, data sample:
+ * Bits 31:16 : imaginary part (signed)
+ * Bits 15:0 : real part (signed)
+ *
+ * Second item, average sample: the magnitude, with its two 16-bit halves
+ * swapped (the more significant half comes first in the byte stream)
+ */
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief The duration of one step of the hardware time, in seconds
+     *
+     * The time in each compressed sample counts half-windows of the FFT
+     * (1024 samples at 100 Msps with 2048 bins, because windows overlap by
+     * half). The FPGA takes it from its own time counter, which keeps
+     * running while compression is stopped, so restarting compression does
+     * not restart the times. Only the 20 least significant bits are sent.
+     * Expanded times add back the rollovers of those bits, so they count
+     * steps from an earlier instant such as the start of a capture.
+     *
+     * Times described as hardware time steps elsewhere use this unit.
+     */
+    const double TIME_STEP = 10.24e-6;
+    /*! \brief The duration of one step of the hardware time, in nanoseconds */
+    const std::uint64_t TIME_STEP_NS = 10240;
+
+    /*!
+     * \brief A batch of decoded compressed samples, in structure-of-arrays
+     * form
+     *
+     * All arrays have the same length. For each sample, real and imag are
+     * only meaningful for data samples and magnitude is only meaningful for
+     * average samples.
+     */
+    struct decoded_samples
+    {
+      /*! \brief Value in flags for an average sample */
+      static const std::uint8_t AVERAGE = 1;
+
+      /*! \brief FFT bin index of each sample (0-2047) */
+      std::vector<std::uint16_t> index;
+      /*! \brief 20-bit time of each sample */
+      std::vector<std::uint32_t> time;
+      /*! \brief Flags for each sample (AVERAGE or 0) */
+      std::vector<std::uint8_t> flags;
+      /*! \brief Real part of each data sample */
+      std::vector<std::int16_t> real;
+      /*! \brief Imaginary part of each data sample */
+      std::vector<std::int16_t> imag;
+      /*! \brief Magnitude of each average sample */
+      std::vector<std::uint32_t> magnitude;
+
+      /*! \brief Changes the number of samples in this batch */
+      inline void resize(std::size_t count)
+      {
+          index.resize(count);
+          time.resize(count);
+          flags.resize(count);
+          real.resize(count);
+          imag.resize(count);
+          magnitude.resize(count);
+      }
+
+      /*! \brief Returns the number of samples in this batch */
+      inline std::size_t size() const
+      {
+          return index.size();
+      }
+
+      /*! \brief Returns true if the sample at position i is an average */
+      inline bool is_average(std::size_t i) const
+      {
+          return (flags[i] & AVERAGE) != 0;
+      }
+    };
+
+    namespace detail {
+
+      /*!
+       * \brief A function that decodes samples [begin, end) from words into
+       * the same positions in out
+       */
+      typedef void (*decode_function)(const std::uint32_t* words,
+          std::size_t begin, std::size_t end, decoded_samples& out);
+
+      inline void
+      decode_scalar(const std::uint32_t* words, std::size_t begin,
+          std::size_t end, decoded_samples& out)
+      {
+          for (std::size_t i = begin; i < end; i++) {
+              const std::uint32_t header = words[2 * i];
+              const std::uint32_t payload = words[2 * i + 1];
+              out.index[i] = (header >> 4) & 0x7ff;
+              out.time[i] = (header >> 16) | ((header & 0xf) << 16);
+              out.flags[i] = (header >> 15) & 1;
+              out.real[i] = static_cast<std::int16_t>(payload & 0xffff);
+              out.imag[i] = static_cast<std::int16_t>(payload >> 16);
+              out.magnitude[i] = (payload << 16) | (payload >> 16);
+          }
+      }
+
+#if defined(SPARSDR_DECODER_X86)
+      __attribute__((target("sse4.1")))
+      inline void
+      decode_sse41(const std::uint32_t* words, std::size_t begin,
+          std::size_t end, decoded_samples& out)
+      {
+          const __m128i index_mask = _mm_set1_epi32(0x7ff);
+          const __m128i time_high_mask = _mm_set1_epi32(0xf);
+          const __m128i one = _mm_set1_epi32(1);
+          // Moves the low halves of the payloads into the low 8 bytes and
+          // the high halves into the high 8 bytes
+          const __m128i split_halves = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13,
+              2, 3, 6, 7, 10, 11, 14, 15);
+
+          std::size_t i = begin;
+          for (; i + 4 <= end; i += 4) {
+              const __m128i a = _mm_loadu_si128(
+                  reinterpret_cast<const __m128i*>(words + 2 * i));
+              const __m128i b = _mm_loadu_si128(
+                  reinterpret_cast<const __m128i*>(words + 2 * i + 4));
+              // [h0 h1 p0 p1] and [h2 h3 p2 p3]
+              const __m128i a_sorted = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+              const __m128i b_sorted = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+              const __m128i header = _mm_unpacklo_epi64(a_sorted, b_sorted);
+              const __m128i payload = _mm_unpackhi_epi64(a_sorted, b_sorted);
+
+              const __m128i time = _mm_or_si128(_mm_srli_epi32(header, 16),
+                  _mm_slli_epi32(_mm_and_si128(header, time_high_mask), 16));
+              _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.time[i]), time);
+
+              const __m128i magnitude = _mm_or_si128(_mm_slli_epi32(payload, 16),
+                  _mm_srli_epi32(payload, 16));
+              _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.magnitude[i]), magnitude);
+
+              const __m128i index = _mm_and_si128(_mm_srli_epi32(header, 4), index_mask);
+              _mm_storel_epi64(reinterpret_cast<__m128i*>(&out.index[i]),
+                  _mm_packus_epi32(index, index));
+
+              const __m128i flags = _mm_and_si128(_mm_srli_epi32(header, 15), one);
+              const __m128i flags16 = _mm_packus_epi32(flags, flags);
+              const std::int32_t flags8 = _mm_cvtsi128_si32(
+                  _mm_packus_epi16(flags16, flags16));
+              std::memcpy(&out.flags[i], &flags8, sizeof flags8);
+
+              const __m128i halves = _mm_shuffle_epi8(payload, split_halves);
+              _mm_storel_epi64(reinterpret_cast<__m128i*>(&out.real[i]), halves);
+              _mm_storel_epi64(reinterpret_cast<__m128i*>(&out.imag[i]),
+                  _mm_srli_si128(halves, 8));
+          }
+          decode_scalar(words, i, end, out);
+      }
+
+      __attribute__((target("avx2")))
+      inline void
+      decode_avx2(const std::uint32_t* words, std::size_t begin,
+          std::size_t end, decoded_samples& out)
+      {
+          const __m256i index_mask = _mm256_set1_epi32(0x7ff);
+          const __m256i time_high_mask = _mm256_set1_epi32(0xf);
+          const __m256i one = _mm256_set1_epi32(1);
+          // Moves headers into the low lane and payloads into the high lane
+          const __m256i deinterleave = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+          // Within each lane, moves the low halves of the payloads into the
+          // low 8 bytes and the high halves into the high 8 bytes
+          const __m256i split_halves = _mm256_setr_epi8(
+              0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15,
+              0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+
+          std::size_t i = begin;
+          for (; i + 8 <= end; i += 8) {
+              const __m256i a = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(
+                  reinterpret_cast<const __m256i*>(words + 2 * i)), deinterleave);
+              const __m256i b = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(
+                  reinterpret_cast<const __m256i*>(words + 2 * i + 8)), deinterleave);
+              const __m256i header = _mm256_permute2x128_si256(a, b, 0x20);
+              const __m256i payload = _mm256_permute2x128_si256(a, b, 0x31);
+
+              const __m256i time = _mm256_or_si256(_mm256_srli_epi32(header, 16),
+                  _mm256_slli_epi32(_mm256_and_si256(header, time_high_mask), 16));
+              _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.time[i]), time);
+
+              const __m256i magnitude = _mm256_or_si256(
+                  _mm256_slli_epi32(payload, 16), _mm256_srli_epi32(payload, 16));
+              _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.magnitude[i]),
+                  magnitude);
+
+              // Packing works within each 128-bit lane, so the results need to
+              // be moved together afterwards
+              const __m256i index = _mm256_and_si256(_mm256_srli_epi32(header, 4),
+                  index_mask);
+              const __m256i index16 = _mm256_permute4x64_epi64(
+                  _mm256_packus_epi32(index, index), _MM_SHUFFLE(3, 1, 2, 0));
+              _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.index[i]),
+                  _mm256_castsi256_si128(index16));
+
+              const __m256i flags = _mm256_and_si256(_mm256_srli_epi32(header, 15), one);
+              const __m256i flags16 = _mm256_packus_epi32(flags, flags);
+              const __m256i flags8 = _mm256_packus_epi16(flags16, flags16);
+              const std::int32_t flags_low = _mm256_extract_epi32(flags8, 0);
+              const std::int32_t flags_high = _mm256_extract_epi32(flags8, 4);
+              std::memcpy(&out.flags[i], &flags_low, sizeof flags_low);
+              std::memcpy(&out.flags[i + 4], &flags_high, sizeof flags_high);
+
+              const __m256i halves = _mm256_permute4x64_epi64(
+                  _mm256_shuffle_epi8(payload, split_halves), _MM_SHUFFLE(3, 1, 2, 0));
+              _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.real[i]),
+                  _mm256_castsi256_si128(halves));
+              _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.imag[i]),
+                  _mm256_extracti128_si256(halves, 1));
+          }
+          decode_sse41(words, i, end, out);
+      }
+#endif
+
+#if defined(SPARSDR_DECODER_NEON)
+      inline void
+      decode_neon(const std::uint32_t* words, std::size_t begin,
+          std::size_t end, decoded_samples& out)
+      {
+          const uint32x4_t index_mask = vdupq_n_u32(0x7ff);
+          const uint32x4_t time_high_mask = vdupq_n_u32(0xf);
+          const uint32x4_t one = vdupq_n_u32(1);
+
+          std::size_t i = begin;
+          for (; i + 4 <= end; i += 4) {
+              // Deinterleaves headers into val[0] and payloads into val[1]
+              const uint32x4x2_t items = vld2q_u32(words + 2 * i);
+              const uint32x4_t header = items.val[0];
+              const uint32x4_t payload = items.val[1];
+
+              vst1q_u32(&out.time[i], vorrq_u32(vshrq_n_u32(header, 16),
+                  vshlq_n_u32(vandq_u32(header, time_high_mask), 16)));
+              vst1q_u32(&out.magnitude[i], vorrq_u32(vshlq_n_u32(payload, 16),
+                  vshrq_n_u32(payload, 16)));
+              vst1_u16(&out.index[i], vmovn_u32(vandq_u32(
+                  vshrq_n_u32(header, 4), index_mask)));
+
+              const uint16x4_t flags16 = vmovn_u32(vandq_u32(
+                  vshrq_n_u32(header, 15), one));
+              const uint8x8_t flags8 = vmovn_u16(vcombine_u16(flags16, flags16));
+              vst1_lane_u32(reinterpret_cast<std::uint32_t*>(&out.flags[i]),
+                  vreinterpret_u32_u8(flags8), 0);
+
+              vst1_s16(&out.real[i], vreinterpret_s16_u16(vmovn_u32(payload)));
+              vst1_s16(&out.imag[i], vreinterpret_s16_u16(vshrn_n_u32(payload, 16)));
+          }
+          decode_scalar(words, i, end, out);
+      }
+#endif
+
+      /*!
+       * \brief Returns the fastest decode function that this processor
+       * supports
+       */
+      inline decode_function
+      select_decoder()
+      {
+#if defined(SPARSDR_DECODER_X86)
+          __builtin_cpu_init();
+          if (__builtin_cpu_supports("avx2")) {
+              return &decode_avx2;
+          }
+          if (__builtin_cpu_supports("sse4.1")) {
+              return &decode_sse41;
+          }
+#elif defined(SPARSDR_DECODER_NEON)
+          return &decode_neon;
+#endif
+          return &decode_scalar;
+      }
+
+      /*! \brief Returns the decode function, selecting it on first use */
+      inline decode_function
+      decoder()
+      {
+          // Initialization of a function-local static is thread-safe
+          static const decode_function selected = select_decoder();
+          return selected;
+      }
+
+    } // namespace detail
+
+    /*!
+     * \brief Decodes compressed samples
+     *
+     * \param words the compressed samples, two 32-bit items per sample
+     * \param count the number of samples (not items) to decode
+     * \param out the decoded samples. This is resized to count.
+     *
+     * This function is safe to call from any thread.
+     */
+    inline void
+    decode_samples(const std::uint32_t* words, std::size_t count,
+        decoded_samples& out)
+    {
+        out.resize(count);
+        detail::decoder()(words, 0, count, out);
+    }
+
+    /*!
+     * \brief Returns the name of the decoder implementation that
+     * decode_samples() uses on this processor ("avx2", "sse4.1", "neon",
+     * or "scalar")
+     */
+    inline const char*
+    sample_decoder_name()
+    {
+        const detail::decode_function selected = detail::decoder();
+#if defined(SPARSDR_DECODER_X86)
+        if (selected == &detail::decode_avx2) {
+            return "avx2";
+        }
+        if (selected == &detail::decode_sse41) {
+            return "sse4.1";
+        }
+#elif defined(SPARSDR_DECODER_NEON)
+        if (selected == &detail::decode_neon) {
+            return "neon";
+        }
+#endif
+        return "scalar";
+    }
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_SAMPLE_DECODER_H */
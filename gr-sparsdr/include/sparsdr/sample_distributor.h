@@ -22,22 +22,128 @@
 #ifndef INCLUDED_SPARSDR_SAMPLE_DISTRIBUTOR_H
 #define INCLUDED_SPARSDR_SAMPLE_DISTRIBUTOR_H
 
+#include <cstdint>
 #include <sparsdr/api.h>
 #include <gnuradio/block.h>
 
 namespace gr {
   namespace sparsdr {
 
+    /*!
+     * \brief A decoder that reads items directly from the input buffers of a
+     * sample_distributor, without copying them
+     */
+    class SPARSDR_API zero_copy_decoder
+    {
+     public:
+      typedef boost::shared_ptr<zero_copy_decoder> sptr;
+
+      virtual ~zero_copy_decoder() {}
+
+      /*!
+       * \brief Processes items from an input of the sample distributor
+       *
+       * This is called from a thread that the sample distributor starts for
+       * this decoder, so other decoders can process items at the same time.
+       * The sample distributor waits for all its decoders to return before
+       * it removes the items from its input buffers.
+       *
+       * \param input the index of the input that the items came from
+       * \param items the items, in the input buffer. This pointer is only
+       * valid during this call.
+       * \param item_count the number of items available
+       *
+       * \return the number of items processed, from 0 to item_count.
+       * Items that were not processed will be provided again in the next
+       * call.
+       */
+      virtual int decode(int input, const void* items, int item_count) = 0;
+
+      /*!
+       * \brief Called when the input that this decoder was processing has
+       * run out of items and the decoder has become available for other
+       * inputs
+       *
+       * This is called from the sample distributor's thread, never while
+       * decode() is running.
+       */
+      virtual void release(int input) {}
+    };
+
+    /*!
+     * \brief Counts of events in a sample_distributor
+     */
+    struct SPARSDR_API sample_distributor_stats
+    {
+      /*! \brief The number of times a decoder was assigned to an input */
+      std::uint64_t assignments;
+      /*! \brief The number of times a decoder was released by an input */
+      std::uint64_t releases;
+      /*!
+       * \brief The number of times a decoder was taken from an idle input
+       * (included in releases)
+       */
+      std::uint64_t preemptions;
+      /*!
+       * \brief The number of calls to general_work() where at least one input
+       * could not get a decoder
+       */
+      std::uint64_t deficits;
+      /*! \brief The total number of items queued for inputs without decoders */
+      std::uint64_t queued_items;
+    };
+
     /*!
      * \brief Handles samples from many inputs and distributes them to decoders
      * \ingroup sparsdr
      *
+     * There are two kinds of decoders. Each output of this block can lead to
+     * a decoder, and samples sent to an output are copied into its buffer.
+     * A zero_copy_decoder added with add_zero_copy_decoder() instead reads
+     * samples directly from this block's input buffer, on a thread of its
+     * own. In each call to general_work(), this block starts all busy
+     * zero-copy decoders and copies items to outputs while they run.
+     *
+     * When an input has samples and no decoder, this block assigns it an
+     * available zero-copy decoder if there is one, or an available output
+     * otherwise. An input keeps its decoder until it has no samples, or
+     * until the decoder has received an item with a "burst_end" tag.
+     * Assigning and releasing a decoder take constant time, regardless of
+     * the numbers of inputs and decoders.
+     *
+     * When more inputs need decoders than are available, the allocation
+     * policy decides which inputs get decoders first. Each input that does
+     * not get a decoder can queue up to a configurable number of items in
+     * this block, so that its upstream buffer does not fill up. Queued items
+     * are sent to the decoder before new items when the input gets one.
+     *
+     * Items copied to an output get a "source" tag with the index of their
+     * input as its value whenever the input that uses the output changes.
      */
     class SPARSDR_API sample_distributor : virtual public gr::block
     {
      public:
       typedef boost::shared_ptr<sample_distributor> sptr;
 
+      /*! \brief How decoders are allocated to inputs that are waiting */
+      enum allocation_policy {
+        /*! \brief Inputs that have been waiting longest go first */
+        FIRST_COME,
+        /*! \brief Inputs go in order of index, starting after the last
+         * input that got a decoder */
+        ROUND_ROBIN,
+        /*! \brief Inputs with higher priorities (see set_priority()) go
+         * first, and inputs with equal priorities go in first-come order */
+        WEIGHTED_PRIORITY,
+        /*!
+         * \brief Like FIRST_COME, but an input keeps its decoder when it
+         * runs out of samples. If no decoder is free, the decoder of the
+         * input that has been idle for the longest time is given to the
+         * waiting input.
+         */
+        PREEMPT_OLDEST_IDLE,
+      };
+
       /*!
        * \brief Return a shared_ptr to a new instance of sparsdr::sample_distributor.
        *
@@ -47,8 +153,15 @@ namespace gr {
        * creating new instances.
        *
        * \param item_size The size of stream items to process
+       * \param policy How decoders are allocated when there are not enough
+       * for all inputs
+       * \param max_queue_items The maximum number of items to queue for
+       * each input that is waiting for a decoder. If this is 0, no items are
+       * queued and waiting inputs hold their items in upstream buffers.
        */
-      static sptr make(int item_size);
+      static sptr make(int item_size,
+          allocation_policy policy = FIRST_COME,
+          int max_queue_items = 0);
 
       /**
        * \return the number of decoders this block has available but did not use
@@ -61,6 +174,38 @@ namespace gr {
        */
       virtual int decoder_surplus() const = 0;
 
+      /*!
+       * \brief Adds a decoder that will read samples directly from this
+       * block's input buffers
+       *
+       * This must be called before the flowgraph starts.
+       */
+      virtual void add_zero_copy_decoder(zero_copy_decoder::sptr decoder) = 0;
+
+      /*!
+       * \brief Changes the allocation policy
+       *
+       * This function is safe to call from any thread.
+       */
+      virtual void set_allocation_policy(allocation_policy policy) = 0;
+
+      /*!
+       * \brief Sets the priority of an input for the WEIGHTED_PRIORITY
+       * allocation policy
+       *
+       * Inputs have priority 0 by default. Higher values go first.
+       *
+       * This function is safe to call from any thread.
+       */
+      virtual void set_priority(int input, float priority) = 0;
+
+      /*!
+       * \brief Returns counts of decoder assignments and other events
+       *
+       * This function is safe to call from any thread.
+       */
+      virtual sample_distributor_stats stats() const = 0;
+
     };
 
   } // namespace sparsdr
@@ -0,0 +1,177 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_THRESHOLD_CONTROLLER_H
+#define INCLUDED_SPARSDR_THRESHOLD_CONTROLLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <sparsdr/api.h>
+#include <sparsdr/compressing_usrp_source.h>
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief A consistent snapshot of the state of a threshold_controller
+     */
+    struct SPARSDR_API threshold_controller_stats
+    {
+      /*! \brief The number of times the thresholds were recalculated */
+      std::uint64_t updates;
+      /*! \brief The number of threshold registers written */
+      std::uint64_t threshold_writes;
+      /*! \brief The current ratio of thresholds to noise floors */
+      double margin;
+      /*!
+       * \brief The data sample rate (samples per second) measured before
+       * the last update
+       */
+      double measured_rate;
+    };
+
+    /*!
+     * \brief Adjusts per-bin thresholds on a compressing USRP so that it
+     * sends data samples at about a target rate
+     * \ingroup sparsdr
+     *
+     * This block reads the same compressed samples as an average_detector.
+     * It estimates the noise floor of each bin from the average samples,
+     * and counts data samples to measure the rate that the USRP is sending.
+     * The threshold for each bin is the noise floor multiplied by a margin,
+     * which is shared by all bins.
+     *
+     * Every few rows of averages, the block compares the measured rate
+     * with the target rate and scales the margin towards the target. Three
+     * things keep it from changing the registers too often:
+     * * The margin does not change while the measured rate is within the
+     *   hysteresis fraction of the target
+     * * The margin changes by at most a factor of max_step in one update
+     * * A bin's threshold is written only when it would change by more than
+     *   the hysteresis fraction, and at most max_writes bins are written in
+     *   one update (the largest changes first)
+     *
+     * Each overflow message received on the "overflow" input port (for
+     * example, from an average_detector) makes the next update increase the
+     * margin by max_step, because the measured rate is too low when samples
+     * are lost.
+     *
+     * After each update, this block publishes a dictionary on the "update"
+     * message port with the entries margin, rate, and writes.
+     */
+    class SPARSDR_API threshold_controller : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<threshold_controller> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of sparsdr::threshold_controller.
+       *
+       * To avoid accidental use of raw pointers, sparsdr::threshold_controller's
+       * constructor is in a private implementation
+       * class. sparsdr::threshold_controller::make is the public interface for
+       * creating new instances.
+       *
+       * \param usrp the USRP to write thresholds to. If this is null,
+       * the block only calculates thresholds (see thresholds()).
+       * \param target_rate the target rate of data samples, in samples per
+       * second
+       * \param average_interval the interval between rows of averages, in
+       * hardware time steps (the value passed to
+       * compressing_usrp_source::set_average_packet_interval())
+       * \param initial_margin the margin to use until the first update
+       * \param window_duration the duration of one hardware time step, in
+       * seconds. The default (TIME_STEP) is correct for a USRP N210 with
+       * 2048 bins.
+       */
+      static sptr make(compressing_usrp_source::sptr usrp,
+          double target_rate,
+          std::uint32_t average_interval,
+          double initial_margin = 8.0,
+          double window_duration = 10.24e-6);
+
+      /*! \brief Returns the current state of the controller */
+      virtual threshold_controller_stats stats() const = 0;
+
+      /*!
+       * \brief Returns the threshold of each bin that this block has most
+       * recently written, or 0 for unknown thresholds
+       *
+       * Thresholds that were already written to the USRP when this block
+       * was created are also known.
+       */
+      virtual std::vector<std::uint32_t> thresholds() const = 0;
+
+      /*!
+       * \brief Sets the target rate of data samples, in samples per second
+       *
+       * \throws std::invalid_argument if rate is not positive
+       */
+      virtual void set_target_rate(double rate) = 0;
+
+      /*!
+       * \brief Sets the lowest and highest thresholds that the controller
+       * will write
+       *
+       * \throws std::invalid_argument if min is greater than max
+       */
+      virtual void set_threshold_range(std::uint32_t min, std::uint32_t max) = 0;
+
+      /*!
+       * \brief Sets the fraction of the target rate and of each threshold
+       * that changes must exceed (default 0.2)
+       *
+       * \throws std::invalid_argument if hysteresis is not in [0, 1)
+       */
+      virtual void set_hysteresis(double hysteresis) = 0;
+
+      /*!
+       * \brief Sets the largest factor that the margin can change by in
+       * one update (default 2)
+       *
+       * \throws std::invalid_argument if max_step is not greater than 1
+       */
+      virtual void set_max_step(double max_step) = 0;
+
+      /*!
+       * \brief Sets the maximum number of thresholds written in one update
+       * (default 256)
+       *
+       * Bins that the block has never written are not limited.
+       *
+       * \throws std::invalid_argument if max_writes is 0
+       */
+      virtual void set_max_writes(std::size_t max_writes) = 0;
+
+      /*!
+       * \brief Sets the number of rows of averages between updates
+       * (default 4)
+       *
+       * \throws std::invalid_argument if rows is 0
+       */
+      virtual void set_update_rows(std::uint32_t rows) = 0;
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_THRESHOLD_CONTROLLER_H */
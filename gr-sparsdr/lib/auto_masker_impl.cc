@@ -0,0 +1,250 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdexcept>
+#include <gnuradio/io_signature.h>
+#include "auto_masker_impl.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    auto_masker::sptr
+    auto_masker::make(compressing_usrp_source::sptr usrp,
+        std::uint32_t average_interval,
+        double mask_level,
+        std::uint32_t window_rows,
+        std::uint32_t cooldown_rows)
+    {
+      return gnuradio::get_initial_sptr
+        (new auto_masker_impl(usrp, average_interval, mask_level, window_rows,
+            cooldown_rows));
+    }
+
+    /*
+     * The private constructor
+     */
+    auto_masker_impl::auto_masker_impl(compressing_usrp_source::sptr usrp,
+        std::uint32_t average_interval,
+        double mask_level,
+        std::uint32_t window_rows,
+        std::uint32_t cooldown_rows)
+      : gr::sync_block("auto_masker",
+              gr::io_signature::make(1, 1, sizeof(uint32_t)),
+              gr::io_signature::make(0, 0, 0)),
+        d_usrp(usrp),
+        d_tolerance(average_interval / 8),
+        d_window_rows(window_rows),
+        d_mutex(),
+        d_mask_level(mask_level),
+        d_cooldown_rows(cooldown_rows),
+        d_masked(),
+        d_masks(0),
+        d_unmasks(0),
+        d_samples(),
+        d_time_expander(),
+        d_have_row(false),
+        d_row_time(0),
+        d_rows(0),
+        d_counts(static_cast<std::size_t>(window_rows) * BIN_COUNT, 0),
+        d_segment_start(window_rows, 0),
+        d_segment(0),
+        d_sums(BIN_COUNT, 0),
+        d_measure_from(BIN_COUNT, 0),
+        d_unmask_row(BIN_COUNT, 0),
+        d_mask_port(pmt::intern("mask")),
+        d_bin_key(pmt::intern("bin")),
+        d_masked_key(pmt::intern("masked")),
+        d_duty_cycle_key(pmt::intern("duty_cycle")),
+        d_time_key(pmt::intern("time"))
+    {
+        if (average_interval == 0 || window_rows == 0 || cooldown_rows == 0) {
+            throw std::invalid_argument(
+                "Average interval, window rows, and cooldown rows must not be 0");
+        }
+        if (!(mask_level > 0.0 && mask_level <= 1.0)) {
+            throw std::invalid_argument("Mask level must be in (0, 1]");
+        }
+        // Never split a sample across calls to work()
+        set_output_multiple(2);
+        message_port_register_out(d_mask_port);
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    auto_masker_impl::~auto_masker_impl()
+    {
+    }
+
+    int
+    auto_masker_impl::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      const uint32_t* in = reinterpret_cast<const uint32_t*>(input_items[0]);
+      const int sample_count = noutput_items / 2;
+      decode_samples(in, sample_count, d_samples);
+
+      for (int i = 0; i < sample_count; i++) {
+          const std::uint64_t time = d_time_expander.expand(d_samples.time[i]);
+          if (d_samples.is_average(i)) {
+              if (!d_have_row || time - d_row_time > d_tolerance) {
+                  start_row(time);
+              }
+          } else if (d_have_row) {
+              const std::uint16_t bin = d_samples.index[i];
+              d_counts[d_segment * BIN_COUNT + bin]++;
+              d_sums[bin]++;
+          }
+      }
+
+      // Tell runtime system how many output items we produced.
+      return noutput_items;
+    }
+
+    void
+    auto_masker_impl::start_row(std::uint64_t time)
+    {
+        if (!d_have_row) {
+            d_have_row = true;
+            d_row_time = time;
+            d_segment_start[d_segment] = time;
+            return;
+        }
+        d_row_time = time;
+        d_rows++;
+
+        // Bins masked by something else (a command-line option or a
+        // rate_governor) belong to it, so they are not measured or changed
+        std::bitset<BIN_COUNT> usrp_masks;
+        if (d_usrp) {
+            const compression_config config = d_usrp->config();
+            for (std::uint16_t i = 0; i < BIN_COUNT; i++) {
+                if (config.has_mask(i) && config.mask(i)) {
+                    usrp_masks.set(i);
+                }
+            }
+        }
+
+        std::vector<decision> decisions;
+        {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            // When the window is full, the segment after the current one is
+            // the oldest
+            const std::uint32_t oldest = (d_segment + 1) % d_window_rows;
+            const double window_length = static_cast<double>(
+                time - d_segment_start[oldest]);
+            for (std::uint16_t i = 0; i < BIN_COUNT; i++) {
+                if (usrp_masks.test(i) && !d_masked.test(i)) {
+                    continue;
+                }
+                if (d_masked.test(i)) {
+                    if (d_rows >= d_unmask_row[i]) {
+                        d_masked.reset(i);
+                        d_measure_from[i] = d_rows;
+                        d_unmasks++;
+                        decisions.push_back(decision { i, false, 0.0 });
+                    }
+                } else if (d_rows - d_measure_from[i] >= d_window_rows
+                        && window_length > 0.0) {
+                    const double duty_cycle = d_sums[i] / window_length;
+                    if (duty_cycle > d_mask_level) {
+                        d_masked.set(i);
+                        d_unmask_row[i] = d_rows + d_cooldown_rows;
+                        d_masks++;
+                        decisions.push_back(decision { i, true, duty_cycle });
+                    }
+                }
+            }
+        }
+
+        // Start the next segment, replacing the oldest
+        d_segment = (d_segment + 1) % d_window_rows;
+        std::uint32_t* counts = &d_counts[d_segment * BIN_COUNT];
+        for (std::size_t i = 0; i < BIN_COUNT; i++) {
+            d_sums[i] -= counts[i];
+            counts[i] = 0;
+        }
+        d_segment_start[d_segment] = time;
+
+        for (const decision& d : decisions) {
+            if (d_usrp) {
+                d_usrp->set_mask_enabled(d.bin, d.masked);
+            }
+            pmt::pmt_t info = pmt::make_dict();
+            info = pmt::dict_add(info, d_bin_key, pmt::from_uint64(d.bin));
+            info = pmt::dict_add(info, d_masked_key, pmt::from_bool(d.masked));
+            info = pmt::dict_add(info, d_duty_cycle_key,
+                pmt::from_double(d.duty_cycle));
+            info = pmt::dict_add(info, d_time_key, pmt::from_uint64(time));
+            message_port_pub(d_mask_port, info);
+        }
+    }
+
+    auto_masker_stats
+    auto_masker_impl::stats() const
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        auto_masker_stats stats;
+        stats.masks = d_masks;
+        stats.unmasks = d_unmasks;
+        stats.masked_bins = d_masked.count();
+        return stats;
+    }
+
+    std::vector<std::uint16_t>
+    auto_masker_impl::masked_bins() const
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        std::vector<std::uint16_t> bins;
+        for (std::uint16_t i = 0; i < BIN_COUNT; i++) {
+            if (d_masked.test(i)) {
+                bins.push_back(i);
+            }
+        }
+        return bins;
+    }
+
+    void
+    auto_masker_impl::set_mask_level(double level)
+    {
+        if (!(level > 0.0 && level <= 1.0)) {
+            throw std::invalid_argument("Mask level must be in (0, 1]");
+        }
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_mask_level = level;
+    }
+
+    void
+    auto_masker_impl::set_cooldown_rows(std::uint32_t rows)
+    {
+        if (rows == 0) {
+            throw std::invalid_argument("Cooldown rows must not be 0");
+        }
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_cooldown_rows = rows;
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
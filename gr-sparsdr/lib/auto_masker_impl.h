@@ -0,0 +1,128 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_AUTO_MASKER_IMPL_H
+#define INCLUDED_SPARSDR_AUTO_MASKER_IMPL_H
+
+#include <bitset>
+#include <mutex>
+#include <sparsdr/auto_masker.h>
+#include <sparsdr/sample_decoder.h>
+#include "time_expander.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    class auto_masker_impl : public auto_masker
+    {
+     private:
+      static const std::size_t BIN_COUNT = compressing_usrp_source::BIN_COUNT;
+
+      /*! \brief A decision to mask or unmask a bin */
+      struct decision
+      {
+        std::uint16_t bin;
+        bool masked;
+        double duty_cycle;
+      };
+
+      /*! \brief The USRP to change masks on, or null */
+      compressing_usrp_source::sptr d_usrp;
+      /*! \brief Maximum spread of times within one row of averages */
+      std::uint32_t d_tolerance;
+      /*! \brief The number of segments (rows) in the sliding window */
+      std::uint32_t d_window_rows;
+
+      /*! \brief Protects the settings and state below */
+      mutable std::mutex d_mutex;
+      double d_mask_level;
+      std::uint32_t d_cooldown_rows;
+      /*! \brief The bins that this block has masked */
+      std::bitset<BIN_COUNT> d_masked;
+      std::uint64_t d_masks;
+      std::uint64_t d_unmasks;
+
+      /*! \brief Samples decoded from the input */
+      decoded_samples d_samples;
+      /*! \brief Expands the hardware time of each sample */
+      time_expander d_time_expander;
+      /*! \brief True if a row of averages has been seen */
+      bool d_have_row;
+      /*! \brief The expanded time of the first sample in the last row */
+      std::uint64_t d_row_time;
+      /*! \brief The number of rows that have ended */
+      std::uint64_t d_rows;
+      /*!
+       * \brief Data samples in each bin for each segment
+       *
+       * Segment s, bin b is at s * BIN_COUNT + b.
+       */
+      std::vector<std::uint32_t> d_counts;
+      /*! \brief The expanded time when each segment started */
+      std::vector<std::uint64_t> d_segment_start;
+      /*! \brief The segment that is receiving samples */
+      std::uint32_t d_segment;
+      /*! \brief Data samples in each bin over the whole window */
+      std::vector<std::uint32_t> d_sums;
+      /*!
+       * \brief For each bin, the row when it started being measured (at
+       * the start or when it was unmasked)
+       */
+      std::vector<std::uint64_t> d_measure_from;
+      /*! \brief For each masked bin, the row when it will be unmasked */
+      std::vector<std::uint64_t> d_unmask_row;
+
+      const pmt::pmt_t d_mask_port;
+      const pmt::pmt_t d_bin_key;
+      const pmt::pmt_t d_masked_key;
+      const pmt::pmt_t d_duty_cycle_key;
+      const pmt::pmt_t d_time_key;
+
+      /*!
+       * \brief Called at the start of each row of averages to evaluate the
+       * segment that ended
+       *
+       * \param time the expanded time of the first sample in the row
+       */
+      void start_row(std::uint64_t time);
+
+     public:
+      auto_masker_impl(compressing_usrp_source::sptr usrp,
+          std::uint32_t average_interval,
+          double mask_level,
+          std::uint32_t window_rows,
+          std::uint32_t cooldown_rows);
+      ~auto_masker_impl();
+
+      // Where all the action really happens
+      int work(int noutput_items,
+         gr_vector_const_void_star &input_items,
+         gr_vector_void_star &output_items);
+
+      virtual auto_masker_stats stats() const;
+      virtual std::vector<std::uint16_t> masked_bins() const;
+      virtual void set_mask_level(double level);
+      virtual void set_cooldown_rows(std::uint32_t rows);
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_AUTO_MASKER_IMPL_H */
@@ -2,6 +2,8 @@
 #include "config.h"
 #endif
 
+#include <algorithm>
+#include <cstring>
 #include <gnuradio/io_signature.h>
 #include "average_detector_impl.h"
 
@@ -9,25 +11,56 @@ namespace gr {
   namespace sparsdr {
 
     average_detector::sptr
-    average_detector::make()
+    average_detector::make(std::uint32_t average_interval)
     {
       return gnuradio::get_initial_sptr
-        (new average_detector_impl());
+        (new average_detector_impl(average_interval, std::function<void()>()));
+    }
+
+    average_detector::sptr
+    average_detector::make(std::uint32_t average_interval,
+        const std::function<void()>& overflow_callback)
+    {
+      return gnuradio::get_initial_sptr
+        (new average_detector_impl(average_interval, overflow_callback));
     }
 
     /*
      * The private constructor
      */
-    average_detector_impl::average_detector_impl()
+    average_detector_impl::average_detector_impl(std::uint32_t average_interval,
+        const std::function<void()>& overflow_callback)
       : gr::sync_block("average_detector",
               // Each compressed sample is really 8 bytes, but this also works.
               // The work function can reassemble each sample from two 4-byte
               // integers.
               gr::io_signature::make(1, 1, sizeof(uint32_t)),
-              gr::io_signature::make(0, 0, 0)),
-        d_last_average(),
-        d_last_average_mutex()
-    {}
+              // Optional copy of the input, with overflow tags
+              gr::io_signature::make(0, 1, sizeof(uint32_t))),
+        d_sequence(0),
+        d_last_average(time_point().time_since_epoch().count()),
+        d_averages(0),
+        d_data_samples(0),
+        d_last_hardware_time(0),
+        d_overflows(0),
+        d_samples(),
+        d_average_interval(average_interval),
+        d_tolerance(average_interval / 8),
+        d_time_expander(),
+        d_have_row(false),
+        d_row_time(0),
+        d_row_overdue(false),
+        d_resync_requested(false),
+        d_overflow_callback(overflow_callback),
+        d_overflow_key(pmt::intern("overflow")),
+        d_expected_time_key(pmt::intern("expected_time")),
+        d_time_key(pmt::intern("time")),
+        d_missing_rows_key(pmt::intern("missing_rows"))
+    {
+        // Never split a sample across calls to work()
+        set_output_multiple(2);
+        message_port_register_out(d_overflow_key);
+    }
 
     /*
      * Our virtual destructor.
@@ -43,17 +76,41 @@ namespace gr {
     {
       const uint32_t* in = reinterpret_cast<const uint32_t*>(input_items[0]);
       const int sample_count = noutput_items / 2;
-      for (int i = 0; i < sample_count; i++) {
-          // Get the first half of the sample and check bit 15, which
-          // indicates an average
-          const uint32_t sample0 = in[i * 2];
-          const bool is_average = (sample0 >> 15) & 1 == 1;
-          if (is_average) {
-              const time_point now = std::chrono::high_resolution_clock::now();
-              std::lock_guard<std::mutex> guard(d_last_average_mutex);
-              d_last_average = now;
-          }
+      decode_samples(in, sample_count, d_samples);
+      if (sample_count == 0) {
+          return noutput_items;
       }
+      const bool tag_output = !output_items.empty();
+      if (tag_output) {
+          std::memcpy(output_items[0], in, noutput_items * sizeof(uint32_t));
+      }
+      const std::uint64_t overflows = d_average_interval != 0
+          ? check_timing(tag_output) : 0;
+      const std::uint64_t averages = std::count(d_samples.flags.begin(),
+          d_samples.flags.end(), decoded_samples::AVERAGE);
+
+      // This is the only thread that writes, so the sequence number can be
+      // updated without a read-modify-write operation
+      const std::uint32_t sequence = d_sequence.load(std::memory_order_relaxed);
+      d_sequence.store(sequence + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      if (averages != 0) {
+          // All samples in this call arrived at about the same time
+          const time_point now = std::chrono::high_resolution_clock::now();
+          d_last_average.store(now.time_since_epoch().count(),
+              std::memory_order_relaxed);
+      }
+      d_averages.store(d_averages.load(std::memory_order_relaxed) + averages,
+          std::memory_order_relaxed);
+      d_data_samples.store(d_data_samples.load(std::memory_order_relaxed)
+          + (sample_count - averages), std::memory_order_relaxed);
+      d_last_hardware_time.store(d_samples.time[sample_count - 1],
+          std::memory_order_relaxed);
+      d_overflows.store(d_overflows.load(std::memory_order_relaxed) + overflows,
+          std::memory_order_relaxed);
+
+      d_sequence.store(sequence + 2, std::memory_order_release);
 
       // Tell runtime system how many output items we produced.
       return noutput_items;
@@ -62,8 +119,106 @@ namespace gr {
     std::chrono::high_resolution_clock::time_point
     average_detector_impl::last_average()
     {
-        std::lock_guard<std::mutex> guard(d_last_average_mutex);
-        return d_last_average;
+        return time_point(time_point::duration(
+            d_last_average.load(std::memory_order_acquire)));
+    }
+
+    average_detector_stats
+    average_detector_impl::stats()
+    {
+        average_detector_stats stats;
+        std::uint32_t sequence;
+        do {
+            sequence = d_sequence.load(std::memory_order_acquire);
+            stats.averages = d_averages.load(std::memory_order_relaxed);
+            stats.data_samples = d_data_samples.load(std::memory_order_relaxed);
+            stats.last_hardware_time = d_last_hardware_time.load(
+                std::memory_order_relaxed);
+            stats.last_average = time_point(time_point::duration(
+                d_last_average.load(std::memory_order_relaxed)));
+            stats.overflows = d_overflows.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((sequence & 1) != 0
+            || sequence != d_sequence.load(std::memory_order_relaxed));
+        return stats;
+    }
+
+    std::uint64_t
+    average_detector_impl::check_timing(bool tag_output)
+    {
+        if (d_resync_requested.exchange(false)) {
+            d_have_row = false;
+            d_row_overdue = false;
+        }
+
+        std::uint64_t overflows = 0;
+        for (std::size_t i = 0; i < d_samples.size(); i++) {
+            const std::uint64_t time = d_time_expander.expand(d_samples.time[i]);
+            const std::uint64_t expected_time = d_row_time + d_average_interval;
+            if (d_samples.is_average(i)) {
+                if (!d_have_row) {
+                    d_row_time = time;
+                    d_have_row = true;
+                    continue;
+                }
+                // Averages in one row may have slightly different times
+                const std::uint64_t since_row = time - d_row_time;
+                if (since_row <= d_tolerance) {
+                    continue;
+                }
+                // Round to the nearest number of intervals
+                const std::uint64_t intervals = (since_row + d_average_interval / 2)
+                    / d_average_interval;
+                const std::uint64_t rounded = intervals * d_average_interval;
+                const std::uint64_t error = since_row > rounded
+                    ? since_row - rounded : rounded - since_row;
+                if (!d_row_overdue && (intervals != 1 || error > d_tolerance)) {
+                    const std::uint64_t missing_rows = error > d_tolerance
+                        ? 0 : intervals - 1;
+                    report_overflow(i, tag_output, expected_time, time, missing_rows);
+                    overflows++;
+                }
+                // Start again from this row
+                d_row_time = time;
+                d_row_overdue = false;
+            } else if (d_have_row && !d_row_overdue
+                    && time > expected_time + d_tolerance) {
+                // The next row of averages should have arrived before this
+                // data sample. Report now instead of waiting for the next
+                // row.
+                d_row_overdue = true;
+                report_overflow(i, tag_output, expected_time, time,
+                    (time - d_row_time) / d_average_interval);
+                overflows++;
+            }
+        }
+        return overflows;
+    }
+
+    void
+    average_detector_impl::report_overflow(std::size_t sample, bool tag_output,
+        std::uint64_t expected_time, std::uint64_t time,
+        std::uint64_t missing_rows)
+    {
+        pmt::pmt_t info = pmt::make_dict();
+        info = pmt::dict_add(info, d_expected_time_key, pmt::from_uint64(expected_time));
+        info = pmt::dict_add(info, d_time_key, pmt::from_uint64(time));
+        info = pmt::dict_add(info, d_missing_rows_key, pmt::from_uint64(missing_rows));
+
+        if (tag_output) {
+            add_item_tag(0, nitems_written(0) + sample * 2, d_overflow_key, info,
+                alias_pmt());
+        }
+        message_port_pub(d_overflow_key, info);
+        if (d_overflow_callback) {
+            d_overflow_callback();
+        }
+    }
+
+    void
+    average_detector_impl::resync()
+    {
+        d_resync_requested.store(true);
     }
 
   } /* namespace sparsdr */
@@ -21,9 +21,12 @@
 #ifndef INCLUDED_SPARSDR_AVERAGE_DETECTOR_IMPL_H
 #define INCLUDED_SPARSDR_AVERAGE_DETECTOR_IMPL_H
 
+#include <atomic>
 #include <chrono>
-#include <mutex>
+#include <functional>
 #include <sparsdr/average_detector.h>
+#include <sparsdr/sample_decoder.h>
+#include "time_expander.h"
 
 namespace gr {
   namespace sparsdr {
@@ -33,13 +36,76 @@ namespace gr {
      private:
       typedef std::chrono::high_resolution_clock::time_point time_point;
 
+      /*!
+       * \brief Sequence number used to read a consistent set of the values
+       * below
+       *
+       * work() makes this odd before changing the values and even after
+       * changing them. Readers retry if it is odd or has changed.
+       */
+      std::atomic<std::uint32_t> d_sequence;
       /*! \brief The time of the last observed average sample */
-      time_point d_last_average;
-      /*! \brief Mutex that controls access to d_last_average */
-      std::mutex d_last_average_mutex;
+      std::atomic<time_point::rep> d_last_average;
+      /*! \brief The number of average samples observed */
+      std::atomic<std::uint64_t> d_averages;
+      /*! \brief The number of data samples observed */
+      std::atomic<std::uint64_t> d_data_samples;
+      /*! \brief The 20-bit hardware time of the last observed sample */
+      std::atomic<std::uint32_t> d_last_hardware_time;
+      /*! \brief The number of overflows detected */
+      std::atomic<std::uint64_t> d_overflows;
+      /*! \brief Samples decoded from the input */
+      decoded_samples d_samples;
+
+      /*! \brief Interval between rows of averages, or 0 to disable checks */
+      std::uint32_t d_average_interval;
+      /*!
+       * \brief Maximum difference between the actual and expected times of
+       * a row of averages, and the maximum spread of times within one row
+       */
+      std::uint32_t d_tolerance;
+      /*! \brief Expands the hardware time of each sample */
+      time_expander d_time_expander;
+      /*! \brief True if a row of averages has been seen since the last resync */
+      bool d_have_row;
+      /*! \brief The expanded time of the first sample in the last row */
+      std::uint64_t d_row_time;
+      /*!
+       * \brief True if an overflow has already been reported because the
+       * row after d_row_time is late
+       */
+      bool d_row_overdue;
+      /*! \brief Set by resync() to discard d_row_time in the next work() */
+      std::atomic<bool> d_resync_requested;
+      /*! \brief Called after each overflow */
+      std::function<void()> d_overflow_callback;
+
+      const pmt::pmt_t d_overflow_key;
+      const pmt::pmt_t d_expected_time_key;
+      const pmt::pmt_t d_time_key;
+      const pmt::pmt_t d_missing_rows_key;
+
+      /*!
+       * \brief Checks the hardware times of the samples in d_samples
+       *
+       * \return the number of overflows found
+       */
+      std::uint64_t check_timing(bool tag_output);
+
+      /*!
+       * \brief Publishes an overflow message, tags the output if
+       * tag_output is true, and calls the overflow callback
+       *
+       * \param sample the position of the sample in d_samples that
+       * revealed the overflow
+       */
+      void report_overflow(std::size_t sample, bool tag_output,
+          std::uint64_t expected_time, std::uint64_t time,
+          std::uint64_t missing_rows);
 
      public:
-      average_detector_impl();
+      average_detector_impl(std::uint32_t average_interval,
+          const std::function<void()>& overflow_callback);
       ~average_detector_impl();
 
       // Where all the action really happens
@@ -48,6 +114,8 @@ namespace gr {
          gr_vector_void_star &output_items);
 
       virtual std::chrono::high_resolution_clock::time_point last_average();
+      virtual average_detector_stats stats();
+      virtual void resync();
     };
 
   } // namespace sparsdr
@@ -0,0 +1,415 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include "band_reconstructor.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    namespace {
+    /*!
+     * \brief Returns the smallest power of two that is greater than or
+     * equal to value
+     */
+    std::uint16_t next_power_of_two(std::uint16_t value)
+    {
+        std::uint16_t power = 1;
+        while (power < value) {
+            power <<= 1;
+        }
+        return power;
+    }
+
+    /*!
+     * \brief Returns the value of the 2048-point Hann window used by the
+     * compression FFT at the provided index
+     */
+    double hann_2048(std::size_t index)
+    {
+        return 0.5 * (1.0 - std::cos(2.0 * M_PI * index
+            / band_reconstructor::NATIVE_FFT_SIZE));
+    }
+    }
+
+    band_reconstructor::band_reconstructor(const band_spec& band,
+        reconstruct_workspace& workspace,
+        bool fill_gaps,
+        bool track_bursts,
+        float compressed_bandwidth)
+      : d_bin_start(0),
+        d_bin_end(0),
+        d_fft_size(0),
+        d_rotation(0),
+        d_scale(1.0),
+        d_fc_bins(0),
+        d_bin_offset(0.0),
+        d_phase_base(1.0, 0.0),
+        d_phase_correction(1.0, 0.0),
+        d_frequency_base(1.0, 0.0),
+        d_frequency_correction(1.0, 0.0),
+        d_fft(),
+        d_workspace(workspace),
+        d_previous(nullptr),
+        d_previous_time(0),
+        d_have_previous(false),
+        d_windows(0),
+        d_first_time(0),
+        d_output(nullptr),
+        d_output_capacity(0),
+        d_output_count(0),
+        d_pending(),
+        d_pending_start(0),
+        d_fill_gaps(fill_gaps),
+        d_zero_runs(),
+        d_zero_run_start(0),
+        d_pending_zeros(0),
+        d_silences(),
+        d_track_bursts(track_bursts),
+        d_samples_produced(0),
+        d_burst_events(),
+        d_burst_event_start(0)
+    {
+        const std::uint16_t bins = band.bins();
+        if (bins == 0 || bins > NATIVE_FFT_SIZE) {
+            throw std::out_of_range("bins must be in the range [1, 2048]");
+        }
+        d_fft_size = next_power_of_two(bins);
+
+        // Offset from the center of the capture, in bins. The whole-number
+        // part selects the bins and the fractional part is corrected
+        // after the inverse FFT.
+        const float exact_bin_offset = static_cast<float>(NATIVE_FFT_SIZE)
+            * band.frequency() / compressed_bandwidth;
+        const float fc_bins = std::floor(exact_bin_offset);
+        const float bin_offset = exact_bin_offset - fc_bins;
+
+        // Choose the bins centered on fc_bins (same as choose_bins in
+        // sparsdr_reconstruct)
+        const int center = NATIVE_FFT_SIZE / 2 + static_cast<int>(fc_bins);
+        const int low_bin = center - bins / 2;
+        const int high_bin = center + bins / 2 + (bins % 2);
+        d_bin_start = static_cast<std::uint16_t>(
+            std::min(std::max(low_bin, 0), static_cast<int>(NATIVE_FFT_SIZE)));
+        d_bin_end = static_cast<std::uint16_t>(
+            std::min(std::max(high_bin, 0), static_cast<int>(NATIVE_FFT_SIZE)));
+        // Bins in the band get moved to the center of the smaller window
+        const int middle = (d_bin_start + d_bin_end) / 2;
+        d_rotation = middle - d_fft_size / 2;
+
+        // Scale to undo the window and FFT gain
+        const std::size_t decimation = NATIVE_FFT_SIZE / d_fft_size;
+        double window_sum = 0.0;
+        for (std::size_t i = 0; i < NATIVE_FFT_SIZE; i += decimation) {
+            window_sum += hann_2048(i);
+        }
+        if (window_sum == 0.0) {
+            // Only possible with a one-bin FFT
+            window_sum = 1.0;
+        }
+        const double hop = static_cast<double>(d_fft_size) / 2.0;
+        d_scale = static_cast<float>(hop / window_sum
+            / (static_cast<double>(decimation) * d_fft_size));
+
+        d_fc_bins = static_cast<std::int64_t>(fc_bins);
+        d_bin_offset = bin_offset;
+        d_phase_base = std::polar(1.0f, static_cast<float>(M_PI) * fc_bins);
+        d_frequency_base = std::polar(1.0f,
+            static_cast<float>(2.0 * M_PI) * -bin_offset / d_fft_size);
+
+        d_silences.reserve(16);
+        d_burst_events.reserve(16);
+        d_fft = workspace.inverse_fft(d_fft_size);
+        d_previous = workspace.allocate(d_fft_size);
+    }
+
+    band_reconstructor::~band_reconstructor()
+    {
+        d_workspace.release(d_previous, d_fft_size);
+    }
+
+    void
+    band_reconstructor::process_window(std::uint64_t time, const gr_complex* logical_bins)
+    {
+        const bool gap = d_windows != 0 && time > d_previous_time + 1;
+        if (d_fill_gaps && gap) {
+            // Continue the phase correction over the windows that were
+            // skipped
+            d_phase_correction *= correction(time - d_previous_time - 1, 0);
+        }
+
+        // Select bins, move them to the center of a d_fft_size window,
+        // shift to FFT order and apply the phase correction
+        gr_complex* const fft_in = d_fft->get_inbuf();
+        std::fill(fft_in, fft_in + d_fft_size, gr_complex(0.0, 0.0));
+        const std::uint16_t half_size = d_fft_size / 2;
+        for (int bin = d_bin_start; bin < d_bin_end; bin++) {
+            const int logical_index = bin - d_rotation;
+            const int fft_index = (logical_index + half_size) & (d_fft_size - 1);
+            fft_in[fft_index] = logical_bins[bin] * d_phase_correction;
+        }
+        d_phase_correction *= d_phase_base;
+        // Keep rounding errors from accumulating over a long capture
+        d_phase_correction /= std::abs(d_phase_correction);
+
+        d_fft->execute();
+        gr_complex* const samples = d_fft->get_outbuf();
+        for (std::uint16_t i = 0; i < d_fft_size; i++) {
+            samples[i] *= d_scale;
+        }
+
+        // Overlap and write
+        const std::size_t second_half_size = d_fft_size - half_size;
+        if (d_have_previous && time == d_previous_time + 1) {
+            // Add the first half of this window to the second half of the
+            // previous window
+            const std::size_t overlap_size = std::min<std::size_t>(
+                half_size, second_half_size);
+            gr_complex* const previous_end = d_previous + d_fft_size;
+            for (std::size_t i = 0; i < overlap_size; i++) {
+                previous_end[i - overlap_size] += samples[i];
+            }
+            emit(d_previous + half_size, second_half_size);
+        } else {
+            // Not contiguous, finish the previous window (if any) and
+            // start again with the first half of this window
+            flush();
+            if (d_fill_gaps && gap && time > d_previous_time + 2) {
+                // The previous window ended at half-window
+                // d_previous_time + 2, and this window starts at
+                // half-window time
+                emit_zeros((time - d_previous_time - 2) * half_size);
+            }
+            if (d_track_bursts) {
+                d_burst_events.push_back(burst_event { d_samples_produced,
+                    true, time });
+            }
+            emit(samples, half_size);
+        }
+        std::copy(samples, samples + d_fft_size, d_previous);
+        if (d_windows == 0) {
+            d_first_time = time;
+        }
+        d_windows++;
+        d_previous_time = time;
+        d_have_previous = true;
+    }
+
+    void
+    band_reconstructor::advance(std::uint64_t time)
+    {
+        if (d_have_previous && time > d_previous_time) {
+            flush();
+        }
+    }
+
+    void
+    band_reconstructor::flush()
+    {
+        if (d_have_previous) {
+            const std::uint16_t half_size = d_fft_size / 2;
+            emit(d_previous + half_size, d_fft_size - half_size);
+            d_have_previous = false;
+            if (d_track_bursts) {
+                d_burst_events.push_back(burst_event { d_samples_produced - 1,
+                    false, d_previous_time });
+            }
+        }
+    }
+
+    void
+    band_reconstructor::reset()
+    {
+        d_phase_correction = gr_complex(1.0, 0.0);
+        d_frequency_correction = gr_complex(1.0, 0.0);
+        d_previous_time = 0;
+        d_have_previous = false;
+        d_windows = 0;
+        d_first_time = 0;
+        d_pending.clear();
+        d_pending_start = 0;
+        d_zero_runs.clear();
+        d_zero_run_start = 0;
+        d_pending_zeros = 0;
+        d_silences.clear();
+        d_samples_produced = 0;
+        d_burst_events.clear();
+        d_burst_event_start = 0;
+    }
+
+    void
+    band_reconstructor::take_burst_events(std::uint64_t end,
+        std::vector<burst_event>& events)
+    {
+        while (d_burst_event_start < d_burst_events.size()
+                && d_burst_events[d_burst_event_start].sample < end) {
+            events.push_back(d_burst_events[d_burst_event_start]);
+            d_burst_event_start++;
+        }
+        if (d_burst_event_start == d_burst_events.size()) {
+            d_burst_events.clear();
+            d_burst_event_start = 0;
+        }
+    }
+
+    gr_complex
+    band_reconstructor::correction(std::uint64_t windows, std::uint64_t samples) const
+    {
+        // The phase correction is e^(i * pi * fc_bins) per window, which is
+        // always 1 or -1
+        const bool negate = (d_fc_bins % 2 != 0) && (windows % 2 != 0);
+        // The frequency correction turns by -bin_offset / fft_size cycles
+        // per sample. Only the fractional part of the total matters.
+        const long double cycles = std::fmod(
+            static_cast<long double>(d_bin_offset) * samples / d_fft_size, 1.0L);
+        const gr_complex frequency = std::polar(1.0f,
+            static_cast<float>(-2.0L * M_PI * cycles));
+        return negate ? -frequency : frequency;
+    }
+
+    void
+    band_reconstructor::begin_output(gr_complex* output, int capacity)
+    {
+        d_output = output;
+        d_output_capacity = capacity;
+        d_output_count = 0;
+        d_silences.clear();
+
+        // Write samples left over from last time
+        write_pending();
+    }
+
+    void
+    band_reconstructor::write_pending()
+    {
+        while (d_output_count < d_output_capacity) {
+            const std::size_t space = d_output_capacity - d_output_count;
+            const bool have_run = d_zero_run_start < d_zero_runs.size();
+            const std::size_t run_position = have_run
+                ? d_zero_runs[d_zero_run_start].position : d_pending.size();
+            if (d_pending_start < run_position) {
+                // Samples before the next run of zeros
+                const std::size_t count = std::min(run_position - d_pending_start,
+                    space);
+                std::memcpy(d_output + d_output_count,
+                    d_pending.data() + d_pending_start,
+                    count * sizeof(gr_complex));
+                d_output_count += count;
+                d_pending_start += count;
+            } else if (have_run) {
+                zero_run& run = d_zero_runs[d_zero_run_start];
+                const std::size_t count = std::min<std::uint64_t>(run.length,
+                    space);
+                write_zeros(count);
+                run.length -= count;
+                d_pending_zeros -= count;
+                if (run.length == 0) {
+                    d_zero_run_start++;
+                }
+            } else {
+                break;
+            }
+        }
+        if (pending() == 0) {
+            d_pending.clear();
+            d_pending_start = 0;
+            d_zero_runs.clear();
+            d_zero_run_start = 0;
+        }
+    }
+
+    int
+    band_reconstructor::end_output()
+    {
+        d_output = nullptr;
+        d_output_capacity = 0;
+        return d_output_count;
+    }
+
+    void
+    band_reconstructor::emit(const gr_complex* samples, std::size_t count)
+    {
+        d_samples_produced += count;
+        for (std::size_t i = 0; i < count; i++) {
+            const gr_complex corrected = samples[i] * d_frequency_correction;
+            d_frequency_correction *= d_frequency_base;
+
+            if (d_output != nullptr && pending() == 0
+                    && d_output_count < d_output_capacity) {
+                d_output[d_output_count] = corrected;
+                d_output_count += 1;
+            } else {
+                d_pending.push_back(corrected);
+            }
+        }
+        // Keep rounding errors from changing the magnitude of the correction
+        d_frequency_correction /= std::abs(d_frequency_correction);
+    }
+
+    void
+    band_reconstructor::emit_zeros(std::uint64_t count)
+    {
+        d_samples_produced += count;
+        d_frequency_correction *= correction(0, count);
+        d_frequency_correction /= std::abs(d_frequency_correction);
+
+        if (d_output != nullptr && pending() == 0) {
+            const std::uint64_t written = std::min<std::uint64_t>(count,
+                d_output_capacity - d_output_count);
+            write_zeros(written);
+            count -= written;
+        }
+        if (count != 0) {
+            if (d_zero_run_start < d_zero_runs.size()
+                    && d_zero_runs.back().position == d_pending.size()) {
+                d_zero_runs.back().length += count;
+            } else {
+                d_zero_runs.push_back(zero_run { d_pending.size(), count });
+            }
+            d_pending_zeros += count;
+        }
+    }
+
+    void
+    band_reconstructor::write_zeros(int count)
+    {
+        if (count == 0) {
+            return;
+        }
+        std::memset(static_cast<void*>(d_output + d_output_count), 0,
+            count * sizeof(gr_complex));
+        if (!d_silences.empty()
+                && d_silences.back().offset + d_silences.back().length == d_output_count) {
+            d_silences.back().length += count;
+        } else {
+            d_silences.push_back(output_run { d_output_count, count });
+        }
+        d_output_count += count;
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
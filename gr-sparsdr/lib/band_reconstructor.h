@@ -0,0 +1,342 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_BAND_RECONSTRUCTOR_H
+#define INCLUDED_SPARSDR_BAND_RECONSTRUCTOR_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/fft/fft.h>
+#include <sparsdr/band_spec.h>
+#include <boost/noncopyable.hpp>
+#include "reconstruct_workspace.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Reconstructs the signals in one band from windows of
+     * compressed samples
+     *
+     * This is a C++ version of the FFT and output stages of
+     * sparsdr_reconstruct. For each window, it selects the bins in the band,
+     * shifts them into FFT order, applies a phase correction, runs an
+     * inverse FFT, overlaps the result with the previous window, and applies
+     * a frequency correction.
+     *
+     * Reconstructed samples are written directly into the output buffer
+     * set with begin_output(). Samples that do not fit are kept and written
+     * at the beginning of the next output buffer.
+     *
+     * By default, time with no windows for this band is skipped, so the
+     * output only contains reconstructed windows (like sparsdr_reconstruct).
+     * If gaps are filled, each gap becomes a run of zeros of the correct
+     * length, and the corrections continue across it, so the output follows
+     * the capture time. Zeros are written with memset and do not need an
+     * FFT, so a band costs little while it is silent.
+     *
+     * A burst is a series of adjacent windows. If bursts are tracked, the
+     * reconstructor records the position of the first and last sample of
+     * each burst in its output.
+     *
+     * The FFT plan and window buffer come from a reconstruct_workspace.
+     * After the first few windows, processing windows does not allocate
+     * memory unless the output buffers fill up.
+     */
+    class band_reconstructor : public boost::noncopyable
+    {
+    public:
+      /*! \brief The size of the FFT used for compression */
+      static const std::uint16_t NATIVE_FFT_SIZE = 2048;
+
+      /*!
+       * \brief Creates a reconstructor for a band
+       *
+       * \param band the frequency and number of bins to reconstruct
+       * \param workspace the workspace that provides the FFT plan and
+       * buffers. This must outlive the reconstructor, and all reconstructors
+       * that use it must run on the same thread.
+       * \param fill_gaps true to write zeros for the time between
+       * non-adjacent windows
+       * \param track_bursts true to record the start and end of each burst
+       * (see take_burst_events())
+       * \param compressed_bandwidth the bandwidth of the compressed
+       * samples, in hertz
+       */
+      band_reconstructor(const band_spec& band,
+          reconstruct_workspace& workspace,
+          bool fill_gaps = false,
+          bool track_bursts = false,
+          float compressed_bandwidth = 100e6);
+      /*! \brief Returns the window buffer to the workspace */
+      ~band_reconstructor();
+
+      /*! \brief The start or end of a burst */
+      struct burst_event
+      {
+        /*!
+         * \brief The index of the first (for a start) or last (for an end)
+         * sample of the burst, counting all samples this reconstructor has
+         * produced since it was created or reset
+         */
+        std::uint64_t sample;
+        /*! \brief True for the start of a burst, false for the end */
+        bool start;
+        /*!
+         * \brief The expanded time of the first (for a start) or last
+         * (for an end) window of the burst
+         */
+        std::uint64_t time;
+      };
+
+      /*! \brief A range of samples in an output buffer */
+      struct output_run
+      {
+        /*! \brief The index of the first sample in the output buffer */
+        int offset;
+        /*! \brief The number of samples */
+        int length;
+      };
+
+      /*!
+       * \brief Reconstructs one window
+       *
+       * \param time the expanded time of the window, in half-windows
+       * \param logical_bins NATIVE_FFT_SIZE bin values in logical order
+       * (lowest frequency first)
+       */
+      void process_window(std::uint64_t time, const gr_complex* logical_bins);
+
+      /*!
+       * \brief Notifies this reconstructor that a window with the provided
+       * time has been completed, but it did not contain any bins in
+       * this band
+       *
+       * Because no later window can overlap with the last window that this
+       * reconstructor processed, this writes the rest of that window.
+       */
+      void advance(std::uint64_t time);
+
+      /*! \brief Writes the rest of the last window processed, if any */
+      void flush();
+
+      /*!
+       * \brief Returns this reconstructor to its initial state, discarding
+       * any windows and pending samples
+       */
+      void reset();
+
+      /*!
+       * \brief Returns the combined phase and frequency correction that
+       * a reconstructor would apply after processing a number of windows
+       * and writing a number of samples
+       *
+       * Reconstructors that process consecutive parts of a stream
+       * separately can multiply their output by this to match the output
+       * of one reconstructor that processed the whole stream.
+       */
+      gr_complex correction(std::uint64_t windows, std::uint64_t samples) const;
+
+      /*! \brief Returns the number of windows processed since the last reset */
+      inline std::uint64_t windows_processed() const { return d_windows; }
+      /*!
+       * \brief Returns the time of the first window processed since the last
+       * reset (only valid if windows_processed() is not zero)
+       */
+      inline std::uint64_t first_window_time() const { return d_first_time; }
+      /*!
+       * \brief Returns the time of the last window processed (only valid if
+       * windows_processed() is not zero)
+       */
+      inline std::uint64_t last_window_time() const { return d_previous_time; }
+
+      /*!
+       * \brief Sets the buffer where reconstructed samples will be written
+       *
+       * This first writes any samples that did not fit in the previous
+       * output buffer.
+       */
+      void begin_output(gr_complex* output, int capacity);
+
+      /*!
+       * \brief Stops writing to the output buffer set with begin_output()
+       * and returns the number of samples written to it
+       */
+      int end_output();
+
+      /*!
+       * \brief Returns the number of reconstructed samples (including
+       * gap zeros) waiting for space in an output buffer
+       */
+      inline std::size_t pending() const
+      {
+          return d_pending.size() - d_pending_start + d_pending_zeros;
+      }
+
+      /*!
+       * \brief Returns the runs of gap zeros written to the current output
+       * buffer, in order
+       *
+       * This is only valid until the next call to begin_output().
+       */
+      inline const std::vector<output_run>& silences() const
+      {
+          return d_silences;
+      }
+
+      /*!
+       * \brief Removes the recorded burst events for samples before end
+       * and appends them to events, in order
+       *
+       * Events are only recorded if bursts are tracked.
+       */
+      void take_burst_events(std::uint64_t end, std::vector<burst_event>& events);
+
+      /*! \brief Returns the size of the inverse FFT for this band */
+      inline std::uint16_t fft_size() const { return d_fft_size; }
+      /*! \brief Returns the first logical bin in this band */
+      inline std::uint16_t bin_start() const { return d_bin_start; }
+      /*! \brief Returns the logical bin after the last bin in this band */
+      inline std::uint16_t bin_end() const { return d_bin_end; }
+
+    private:
+      /*! \brief First logical bin to reconstruct (inclusive) */
+      std::uint16_t d_bin_start;
+      /*! \brief Last logical bin to reconstruct (exclusive) */
+      std::uint16_t d_bin_end;
+      /*! \brief Size of the inverse FFT, a power of two */
+      std::uint16_t d_fft_size;
+      /*!
+       * \brief Rotation applied when moving bins from the 2048-bin window
+       * into the smaller window for this band
+       */
+      int d_rotation;
+      /*! \brief Scale factor applied to time-domain samples */
+      float d_scale;
+      /*! \brief The whole-number part of the band offset, in bins */
+      std::int64_t d_fc_bins;
+      /*! \brief The fractional part of the band offset, in bins */
+      double d_bin_offset;
+
+      /*! \brief e^(i * pi * fc_bins), applied once per window */
+      gr_complex d_phase_base;
+      /*! \brief The phase correction to apply to the next window */
+      gr_complex d_phase_correction;
+      /*! \brief e^(i * 2 * pi * -bin_offset / fft_size), applied per sample */
+      gr_complex d_frequency_base;
+      /*! \brief The frequency correction to apply to the next sample */
+      gr_complex d_frequency_correction;
+
+      /*! \brief Inverse FFT, shared with other bands of the same size */
+      std::shared_ptr<gr::fft::fft_complex> d_fft;
+      /*! \brief The workspace that d_previous came from */
+      reconstruct_workspace& d_workspace;
+
+      /*!
+       * \brief Time-domain samples of the previous window, which have been
+       * half written (d_fft_size samples, allocated from the workspace)
+       */
+      gr_complex* d_previous;
+      /*! \brief Time of the previous window */
+      std::uint64_t d_previous_time;
+      /*! \brief True if d_previous contains a window */
+      bool d_have_previous;
+      /*! \brief The number of windows processed */
+      std::uint64_t d_windows;
+      /*! \brief The time of the first window processed */
+      std::uint64_t d_first_time;
+
+      /*! \brief The current output buffer, or null if none is set */
+      gr_complex* d_output;
+      /*! \brief The capacity of d_output, in samples */
+      int d_output_capacity;
+      /*! \brief The number of samples written to d_output */
+      int d_output_count;
+
+      /*! \brief Samples that did not fit in the output buffer */
+      std::vector<gr_complex> d_pending;
+      /*! \brief Index of the first sample in d_pending not yet written */
+      std::size_t d_pending_start;
+
+      /*! \brief True to write zeros for gaps between windows */
+      bool d_fill_gaps;
+      /*! \brief A run of gap zeros that did not fit in the output buffer */
+      struct zero_run
+      {
+        /*! \brief The index in d_pending that the zeros come before */
+        std::size_t position;
+        /*! \brief The number of zeros not yet written */
+        std::uint64_t length;
+      };
+      /*!
+       * \brief Runs of zeros that did not fit in the output buffer, in order
+       *
+       * Gaps can be very long, so the zeros are counted instead of being
+       * stored in d_pending.
+       */
+      std::vector<zero_run> d_zero_runs;
+      /*! \brief Index of the first run in d_zero_runs not yet written */
+      std::size_t d_zero_run_start;
+      /*! \brief The total number of zeros in d_zero_runs */
+      std::uint64_t d_pending_zeros;
+      /*! \brief Runs of zeros written to d_output */
+      std::vector<output_run> d_silences;
+
+      /*! \brief True to record burst events */
+      bool d_track_bursts;
+      /*! \brief The number of samples produced, including pending samples */
+      std::uint64_t d_samples_produced;
+      /*! \brief Burst events that have not been taken */
+      std::vector<burst_event> d_burst_events;
+      /*! \brief Index of the first event in d_burst_events not yet taken */
+      std::size_t d_burst_event_start;
+
+      /*!
+       * \brief Applies the frequency correction to samples and writes them
+       * to the output buffer, or to d_pending if the output buffer is full
+       */
+      void emit(const gr_complex* samples, std::size_t count);
+
+      /*!
+       * \brief Advances the frequency correction over a gap and writes
+       * zeros for it to the output buffer, or records them as pending if
+       * the output buffer is full
+       */
+      void emit_zeros(std::uint64_t count);
+
+      /*!
+       * \brief Writes zeros to the output buffer, which must have space
+       * for them
+       */
+      void write_zeros(int count);
+
+      /*!
+       * \brief Writes pending samples and zeros to the output buffer until
+       * it is full or nothing is pending
+       */
+      void write_pending();
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_BAND_RECONSTRUCTOR_H */
@@ -0,0 +1,144 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sparsdr/capture_index.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    capture_index::capture_index() : d_entries()
+    {
+    }
+
+    void
+    capture_index::add(const capture_index_entry& entry)
+    {
+        d_entries.push_back(entry);
+    }
+
+    std::size_t
+    capture_index::size() const
+    {
+        return d_entries.size();
+    }
+
+    const capture_index_entry&
+    capture_index::entry(std::size_t index) const
+    {
+        return d_entries.at(index);
+    }
+
+    int
+    capture_index::find(double frequency) const
+    {
+        int best = -1;
+        double best_distance = 0.0;
+        for (std::size_t i = 0; i < d_entries.size(); i++) {
+            const capture_index_entry& entry = d_entries[i];
+            const double distance = std::abs(frequency - entry.center_frequency);
+            if (distance > entry.bandwidth / 2.0) {
+                continue;
+            }
+            if (best == -1 || distance < best_distance) {
+                best = static_cast<int>(i);
+                best_distance = distance;
+            }
+        }
+        return best;
+    }
+
+    std::string
+    capture_index::to_string() const
+    {
+        std::ostringstream stream;
+        // Enough digits to read the same frequencies back
+        stream.precision(17);
+        for (const capture_index_entry& entry : d_entries) {
+            stream << "capture " << entry.center_frequency << ' '
+                << entry.bandwidth << ' ' << entry.start_time << ' '
+                << entry.path << '\n';
+        }
+        return stream.str();
+    }
+
+    capture_index
+    capture_index::from_string(const std::string& text)
+    {
+        capture_index index;
+        std::istringstream lines(text);
+        std::string line;
+        while (std::getline(lines, line)) {
+            std::istringstream fields(line);
+            std::string name;
+            if (!(fields >> name) || name[0] == '#') {
+                // Empty line or comment
+                continue;
+            }
+            capture_index_entry entry;
+            if (name != "capture"
+                || !(fields >> entry.center_frequency >> entry.bandwidth
+                    >> entry.start_time)
+                || entry.bandwidth <= 0.0) {
+                throw std::invalid_argument("Invalid line: " + line);
+            }
+            // The path is the rest of the line after one space
+            fields.get();
+            std::getline(fields, entry.path);
+            if (entry.path.empty()) {
+                throw std::invalid_argument("Invalid line: " + line);
+            }
+            index.add(entry);
+        }
+        return index;
+    }
+
+    void
+    capture_index::write(const std::string& path) const
+    {
+        std::ofstream file(path);
+        file << to_string();
+        file.close();
+        if (!file) {
+            throw std::runtime_error("Can't write " + path);
+        }
+    }
+
+    capture_index
+    capture_index::read(const std::string& path)
+    {
+        std::ifstream file(path);
+        std::ostringstream text;
+        text << file.rdbuf();
+        if (!file) {
+            throw std::runtime_error("Can't read " + path);
+        }
+        return from_string(text.str());
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
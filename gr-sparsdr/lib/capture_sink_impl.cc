@@ -0,0 +1,407 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/thread/thread.hpp>
+
+#include <gnuradio/io_signature.h>
+#include <gnuradio/logger.h>
+#include "capture_sink_impl.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    const std::size_t capture_sink_impl::ALIGNMENT;
+    const std::size_t capture_sink_impl::STREAM_BUFFER_SIZE;
+
+    capture_sink::sptr
+    capture_sink::make(const std::string& path,
+        std::size_t buffer_size,
+        int buffer_count,
+        bool direct_io,
+        std::size_t preallocate_size,
+        double flush_interval)
+    {
+      return gnuradio::get_initial_sptr
+        (new capture_sink_impl(path, buffer_size, buffer_count, direct_io,
+            preallocate_size, flush_interval));
+    }
+
+    /*
+     * The private constructor
+     */
+    capture_sink_impl::capture_sink_impl(const std::string& path,
+        std::size_t buffer_size,
+        int buffer_count,
+        bool direct_io,
+        std::size_t preallocate_size,
+        double flush_interval)
+      : gr::sync_block("capture_sink",
+              // Each compressed sample is two 4-byte items
+              gr::io_signature::make(1, 1, sizeof(uint32_t)),
+              gr::io_signature::make(0, 0, 0)),
+        d_fd(-1),
+        d_direct_io(direct_io),
+        // Round up to a multiple of the alignment
+        d_buffer_size((std::max(buffer_size, ALIGNMENT) + ALIGNMENT - 1)
+            / ALIGNMENT * ALIGNMENT),
+        d_preallocate_size(preallocate_size),
+        d_allocated(0),
+        d_file_offset(0),
+        d_blocking(false),
+        d_flush_interval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(std::max(0.0, flush_interval)))),
+        d_buffers(),
+        d_fill_index(0),
+        d_filling(true),
+        d_fill_start(),
+        d_write_index(0),
+        d_queued(0),
+        d_mutex(),
+        d_wake(),
+        d_written(),
+        d_stopping(false),
+        d_writer(),
+        d_rate_start(),
+        d_rate_start_bytes(0),
+        d_error_log_limiter(std::chrono::seconds(1)),
+        d_bytes_written(0),
+        d_bytes_per_second(0),
+        d_items_dropped(0),
+        d_max_queued(0),
+        d_write_errors(0)
+    {
+        if (buffer_count < 2) {
+            throw std::invalid_argument("capture_sink needs at least 2 buffers");
+        }
+        d_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (d_fd == -1) {
+            throw std::runtime_error("Can't open " + path + ": "
+                + std::strerror(errno));
+        }
+        // Named pipes and devices can't be preallocated or use O_DIRECT.
+        // Their readers usually process samples as they arrive, so use
+        // small buffers and wait for the reader instead of dropping samples.
+        struct stat file_status;
+        if (::fstat(d_fd, &file_status) != 0 || !S_ISREG(file_status.st_mode)) {
+            d_direct_io = false;
+            d_preallocate_size = 0;
+            d_blocking = true;
+            d_buffer_size = std::min(d_buffer_size, STREAM_BUFFER_SIZE);
+        }
+
+        for (int i = 0; i < buffer_count; i++) {
+            void* data = nullptr;
+            if (::posix_memalign(&data, ALIGNMENT, d_buffer_size) != 0) {
+                for (aligned_buffer& buffer : d_buffers) {
+                    std::free(buffer.data);
+                }
+                ::close(d_fd);
+                throw std::bad_alloc();
+            }
+            d_buffers.push_back(aligned_buffer { static_cast<char*>(data), 0 });
+        }
+
+        // Keep whole samples together so that dropped data does not
+        // split one
+        set_output_multiple(2);
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    capture_sink_impl::~capture_sink_impl()
+    {
+        if (d_writer.joinable()) {
+            finish();
+        }
+        for (aligned_buffer& buffer : d_buffers) {
+            std::free(buffer.data);
+        }
+        ::close(d_fd);
+    }
+
+    bool
+    capture_sink_impl::start()
+    {
+        if (d_direct_io) {
+            // O_DIRECT needs aligned file offsets, which a previous stop()
+            // may have left unaligned
+            const int flags = ::fcntl(d_fd, F_GETFL);
+            if (d_file_offset % ALIGNMENT != 0
+                || flags == -1
+                || ::fcntl(d_fd, F_SETFL, flags | O_DIRECT) != 0) {
+                GR_LOG_WARN(d_logger, "Can't use O_DIRECT, using normal writes");
+                d_direct_io = false;
+            }
+        }
+        d_stopping = false;
+        d_rate_start = std::chrono::steady_clock::now();
+        d_rate_start_bytes = d_bytes_written.load(std::memory_order_relaxed);
+        d_writer = std::thread(&capture_sink_impl::run_writer, this);
+        return true;
+    }
+
+    bool
+    capture_sink_impl::stop()
+    {
+        finish();
+        return true;
+    }
+
+    int
+    capture_sink_impl::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      const char* in = static_cast<const char*>(input_items[0]);
+      std::size_t remaining = noutput_items * sizeof(uint32_t);
+
+      std::unique_lock<std::mutex> lock(d_mutex);
+      while (remaining != 0) {
+          if (!d_filling) {
+              if (d_queued.load(std::memory_order_acquire) == d_buffers.size()) {
+                  if (d_blocking) {
+                      wait_for_buffer(lock);
+                  } else {
+                      // All buffers are waiting for the disk. Drop the rest
+                      // of the items instead of waiting.
+                      d_items_dropped.store(
+                          d_items_dropped.load(std::memory_order_relaxed)
+                              + remaining / sizeof(uint32_t),
+                          std::memory_order_relaxed);
+                      break;
+                  }
+              }
+              // The writer thread is finished with the next buffer
+              d_buffers[d_fill_index].used = 0;
+              d_filling = true;
+          }
+          aligned_buffer& buffer = d_buffers[d_fill_index];
+          if (buffer.used == 0) {
+              d_fill_start = std::chrono::steady_clock::now();
+          }
+          const std::size_t copy_size = std::min(remaining,
+              d_buffer_size - buffer.used);
+          std::memcpy(buffer.data + buffer.used, in, copy_size);
+          buffer.used += copy_size;
+          in += copy_size;
+          remaining -= copy_size;
+          if (buffer.used == d_buffer_size) {
+              queue_fill_buffer();
+          }
+      }
+
+      return noutput_items;
+    }
+
+    void
+    capture_sink_impl::wait_for_buffer(std::unique_lock<std::mutex>& lock)
+    {
+        while (d_queued.load(std::memory_order_acquire) == d_buffers.size()) {
+            d_written.wait_for(lock, std::chrono::milliseconds(100));
+            // A reader that never reads would otherwise keep the flowgraph
+            // from stopping
+            boost::this_thread::interruption_point();
+        }
+    }
+
+    bool
+    capture_sink_impl::flush_due(std::chrono::steady_clock::time_point now) const
+    {
+        return d_flush_interval != std::chrono::steady_clock::duration::zero()
+            && !d_direct_io
+            && d_filling
+            && d_buffers[d_fill_index].used != 0
+            && now - d_fill_start >= d_flush_interval;
+    }
+
+    void
+    capture_sink_impl::queue_fill_buffer()
+    {
+        const std::uint32_t queued = d_queued.fetch_add(1, std::memory_order_release) + 1;
+        d_wake.notify_one();
+        if (queued > d_max_queued.load(std::memory_order_relaxed)) {
+            d_max_queued.store(queued, std::memory_order_relaxed);
+        }
+        d_fill_index = (d_fill_index + 1) % d_buffers.size();
+        d_filling = false;
+    }
+
+    void
+    capture_sink_impl::run_writer()
+    {
+        // Wake up periodically to keep the throughput current and to
+        // flush partly filled buffers
+        std::chrono::steady_clock::duration wake_interval = std::chrono::seconds(1);
+        if (d_flush_interval != std::chrono::steady_clock::duration::zero()) {
+            wake_interval = std::min(wake_interval, d_flush_interval);
+        }
+        std::unique_lock<std::mutex> lock(d_mutex);
+        while (true) {
+            if (d_queued.load(std::memory_order_acquire) == 0) {
+                if (d_stopping) {
+                    break;
+                }
+                if (flush_due(std::chrono::steady_clock::now())) {
+                    queue_fill_buffer();
+                    continue;
+                }
+                d_wake.wait_for(lock, wake_interval);
+                update_rate();
+                continue;
+            }
+            lock.unlock();
+            write_buffer(d_buffers[d_write_index]);
+            d_write_index = (d_write_index + 1) % d_buffers.size();
+            update_rate();
+            lock.lock();
+            d_queued.fetch_sub(1, std::memory_order_release);
+            d_written.notify_one();
+        }
+    }
+
+    void
+    capture_sink_impl::write_buffer(const aligned_buffer& buffer)
+    {
+        if (d_preallocate_size != 0
+            && d_file_offset + buffer.used > d_allocated) {
+            // Reserve space in large extents so that the file system does
+            // not need to allocate blocks during each write. Space after
+            // the end of the data is freed by finish().
+            const std::uint64_t start = std::max(d_allocated, d_file_offset);
+            const std::uint64_t length = std::max<std::uint64_t>(
+                d_preallocate_size, buffer.used);
+            if (::fallocate(d_fd, FALLOC_FL_KEEP_SIZE, start, length) == 0) {
+                d_allocated = start + length;
+            } else {
+                GR_LOG_WARN(d_logger, "Can't preallocate file space: "
+                    << std::strerror(errno));
+                d_preallocate_size = 0;
+            }
+        }
+
+        std::size_t written = 0;
+        while (written < buffer.used) {
+            const ssize_t result = ::write(d_fd, buffer.data + written,
+                buffer.used - written);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                d_write_errors.store(
+                    d_write_errors.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+                if (d_error_log_limiter.allow()) {
+                    GR_LOG_ERROR(d_logger, "Write failed: "
+                        << std::strerror(errno) << " ("
+                        << d_error_log_limiter.suppressed()
+                        << " similar messages suppressed)");
+                }
+                break;
+            }
+            written += result;
+        }
+        d_file_offset += written;
+        d_bytes_written.store(
+            d_bytes_written.load(std::memory_order_relaxed) + written,
+            std::memory_order_relaxed);
+    }
+
+    void
+    capture_sink_impl::update_rate()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const auto elapsed = now - d_rate_start;
+        if (elapsed < std::chrono::seconds(1)) {
+            return;
+        }
+        const std::uint64_t bytes = d_bytes_written.load(std::memory_order_relaxed);
+        const double seconds = std::chrono::duration<double>(elapsed).count();
+        d_bytes_per_second.store(
+            static_cast<std::uint64_t>((bytes - d_rate_start_bytes) / seconds),
+            std::memory_order_relaxed);
+        d_rate_start = now;
+        d_rate_start_bytes = bytes;
+    }
+
+    void
+    capture_sink_impl::finish()
+    {
+        if (!d_writer.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            d_stopping = true;
+        }
+        d_wake.notify_one();
+        // The writer thread writes all queued buffers before it exits
+        d_writer.join();
+
+        if (d_filling && d_buffers[d_fill_index].used != 0) {
+            // The last buffer is partly full, so its length is probably
+            // not aligned
+            if (d_direct_io) {
+                const int flags = ::fcntl(d_fd, F_GETFL);
+                if (flags != -1) {
+                    ::fcntl(d_fd, F_SETFL, flags & ~O_DIRECT);
+                }
+            }
+            write_buffer(d_buffers[d_fill_index]);
+            d_buffers[d_fill_index].used = 0;
+        }
+        if (d_allocated > d_file_offset) {
+            // Free the reserved space after the end of the data
+            if (::ftruncate(d_fd, d_file_offset) == 0) {
+                d_allocated = d_file_offset;
+            }
+        }
+    }
+
+    capture_sink_stats
+    capture_sink_impl::stats() const
+    {
+        capture_sink_stats stats;
+        stats.bytes_written = d_bytes_written.load(std::memory_order_relaxed);
+        stats.bytes_per_second = d_bytes_per_second.load(std::memory_order_relaxed);
+        stats.items_dropped = d_items_dropped.load(std::memory_order_relaxed);
+        stats.queued_buffers = d_queued.load(std::memory_order_relaxed);
+        stats.max_queued_buffers = d_max_queued.load(std::memory_order_relaxed);
+        stats.write_errors = d_write_errors.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
@@ -0,0 +1,203 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_CAPTURE_SINK_IMPL_H
+#define INCLUDED_SPARSDR_CAPTURE_SINK_IMPL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sparsdr/capture_sink.h>
+#include "log_rate_limiter.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    class capture_sink_impl : public capture_sink
+    {
+     private:
+      /*! \brief Alignment of buffers, buffer sizes, and file offsets */
+      static const std::size_t ALIGNMENT = 4096;
+      /*!
+       * \brief Largest buffer size for files that are not regular files
+       *
+       * This is the default capacity of a pipe on Linux.
+       */
+      static const std::size_t STREAM_BUFFER_SIZE = 64 * 1024;
+
+      /*! \brief A buffer allocated with ALIGNMENT */
+      struct aligned_buffer
+      {
+        char* data;
+        /*! \brief The number of bytes of data filled */
+        std::size_t used;
+      };
+
+      /*! \brief The file descriptor of the open file */
+      int d_fd;
+      /*! \brief True if d_fd has O_DIRECT set */
+      bool d_direct_io;
+      /*! \brief Size of each buffer in bytes */
+      std::size_t d_buffer_size;
+      /*! \brief Bytes to reserve at a time, or 0 to not preallocate */
+      std::size_t d_preallocate_size;
+      /*! \brief End of the space reserved with fallocate() */
+      std::uint64_t d_allocated;
+      /*! \brief Offset in the file where the next buffer will be written */
+      std::uint64_t d_file_offset;
+      /*!
+       * \brief True to wait for the writer thread when all buffers are
+       * queued instead of discarding items
+       */
+      bool d_blocking;
+      /*!
+       * \brief The time after which a partly filled buffer is written,
+       * or zero to write only full buffers
+       */
+      std::chrono::steady_clock::duration d_flush_interval;
+
+      /*!
+       * \brief The buffers
+       *
+       * The block fills them and the writer thread writes them in the same
+       * circular order.
+       */
+      std::vector<aligned_buffer> d_buffers;
+      /*!
+       * \brief The index of the buffer that the block is filling
+       *
+       * This and the other fill state are protected by d_mutex while the
+       * writer thread is running, because the writer thread queues a
+       * partly filled buffer when it is time to flush it.
+       */
+      std::size_t d_fill_index;
+      /*!
+       * \brief True if the block owns d_buffers[d_fill_index]
+       *
+       * This is false when all buffers were given to the writer thread.
+       */
+      bool d_filling;
+      /*! \brief The time when the first item went into the buffer being filled */
+      std::chrono::steady_clock::time_point d_fill_start;
+      /*! \brief The index of the next buffer that the writer thread will write */
+      std::size_t d_write_index;
+      /*!
+       * \brief The number of buffers given to the writer thread that have
+       * not been written yet
+       */
+      std::atomic<std::uint32_t> d_queued;
+      /*! \brief Protects d_stopping and the fill state */
+      std::mutex d_mutex;
+      /*! \brief Notified when a buffer is queued or the writer should stop */
+      std::condition_variable d_wake;
+      /*! \brief Notified when the writer thread has written a buffer */
+      std::condition_variable d_written;
+      /*! \brief True when the writer thread should exit */
+      bool d_stopping;
+      /*! \brief Writes queued buffers to the file */
+      std::thread d_writer;
+
+      /*! \brief The start of the current throughput measurement interval */
+      std::chrono::steady_clock::time_point d_rate_start;
+      /*! \brief The value of d_bytes_written at d_rate_start */
+      std::uint64_t d_rate_start_bytes;
+      /*! \brief Limits the rate of messages about write errors */
+      log_rate_limiter d_error_log_limiter;
+
+      /*! \brief Statistics */
+      std::atomic<std::uint64_t> d_bytes_written;
+      std::atomic<std::uint64_t> d_bytes_per_second;
+      std::atomic<std::uint64_t> d_items_dropped;
+      std::atomic<std::uint32_t> d_max_queued;
+      std::atomic<std::uint64_t> d_write_errors;
+
+      /*!
+       * \brief Gives the buffer being filled to the writer thread, and
+       * tries to start filling the next one
+       *
+       * d_mutex must be locked.
+       */
+      void queue_fill_buffer();
+
+      /*!
+       * \brief Waits until the writer thread has written at least one
+       * queued buffer
+       *
+       * The scheduler can interrupt the wait to stop the flowgraph.
+       */
+      void wait_for_buffer(std::unique_lock<std::mutex>& lock);
+
+      /*!
+       * \brief Returns true if the buffer being filled has items that
+       * have waited for the flush interval
+       *
+       * d_mutex must be locked.
+       */
+      bool flush_due(std::chrono::steady_clock::time_point now) const;
+
+      /*!
+       * \brief Runs the writer thread
+       */
+      void run_writer();
+
+      /*!
+       * \brief Reserves file space, then writes a buffer to the file
+       * at d_file_offset
+       */
+      void write_buffer(const aligned_buffer& buffer);
+
+      /*!
+       * \brief Updates d_bytes_per_second if one second has passed since
+       * the last update
+       */
+      void update_rate();
+
+      /*!
+       * \brief Stops the writer thread and writes the buffer that was
+       * being filled
+       */
+      void finish();
+
+     public:
+      capture_sink_impl(const std::string& path,
+          std::size_t buffer_size,
+          int buffer_count,
+          bool direct_io,
+          std::size_t preallocate_size,
+          double flush_interval);
+      ~capture_sink_impl();
+
+      virtual bool start() override;
+      virtual bool stop() override;
+
+      virtual capture_sink_stats stats() const override;
+
+      int work(int noutput_items,
+         gr_vector_const_void_star &input_items,
+         gr_vector_void_star &output_items);
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_CAPTURE_SINK_IMPL_H */
@@ -50,6 +50,28 @@ namespace gr {
 
     namespace registers = gr::sparsdr::detail::registers;
 
+    const std::size_t compressing_usrp_source::BIN_COUNT;
+
+    namespace {
+    /**
+     * Returns the threshold register value that sets the threshold for
+     * one bin
+     */
+    uint32_t
+    threshold_command(uint16_t index, uint32_t threshold)
+    {
+        // Register format:
+        // Bits 31:21 : index (11 bits)
+        // Bits 20:0 : threshold shifted right by 11 bits (21 bits)
+
+        // Check that index fits within 11 bits
+        if (index > 0x7ffu) {
+            throw std::out_of_range("index must fit within 11 bits");
+        }
+        return (index << 21) | (threshold >> 11);
+    }
+    }
+
     compressing_usrp_source::sptr
     compressing_usrp_source::make(const ::uhd::device_addr_t& device_addr)
     {
@@ -68,7 +90,9 @@ namespace gr {
           device_addr,
           // Always use sc16 to prevent interpreting the samples as numbers
           ::uhd::stream_args_t("sc16", "sc16")
-      ))
+      )),
+      d_register_mutex(),
+      d_config()
     {
         // Connect the all-important output
         //d_usrp->set_auto_dc_offset    (true, 0);
@@ -100,6 +124,44 @@ namespace gr {
     compressing_usrp_source_impl::set_antenna(const std::string& ant) {
         d_usrp->set_antenna(ant);
     }
+    double
+    compressing_usrp_source_impl::get_center_freq() {
+        return d_usrp->get_center_freq();
+    }
+
+
+    // Clock and time settings
+
+    void
+    compressing_usrp_source_impl::set_clock_source(const std::string& source)
+    {
+        d_usrp->set_clock_source(source);
+    }
+    void
+    compressing_usrp_source_impl::set_time_source(const std::string& source)
+    {
+        d_usrp->set_time_source(source);
+    }
+    ::uhd::time_spec_t
+    compressing_usrp_source_impl::get_time_now()
+    {
+        return d_usrp->get_time_now();
+    }
+    ::uhd::time_spec_t
+    compressing_usrp_source_impl::get_time_last_pps()
+    {
+        return d_usrp->get_time_last_pps();
+    }
+    void
+    compressing_usrp_source_impl::set_time_next_pps(const ::uhd::time_spec_t& time)
+    {
+        d_usrp->set_time_next_pps(time);
+    }
+    void
+    compressing_usrp_source_impl::set_time_now(const ::uhd::time_spec_t& time)
+    {
+        d_usrp->set_time_now(time);
+    }
 
 
     // SparSDR-specific settings
@@ -107,25 +169,29 @@ namespace gr {
     void
     compressing_usrp_source_impl::set_compression_enabled(bool enabled)
     {
-        d_usrp->set_user_register(registers::ENABLE_COMPRESSION, enabled);
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        write_setting(compression_config::COMPRESSION_ENABLED, registers::ENABLE_COMPRESSION, enabled);
     }
 
     void
     compressing_usrp_source_impl::set_fft_enabled(bool enabled)
     {
-        d_usrp->set_user_register(registers::RUN_FFT, enabled);
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        write_setting(compression_config::FFT_ENABLED, registers::RUN_FFT, enabled);
     }
 
     void
     compressing_usrp_source_impl::set_fft_send_enabled(bool enabled)
     {
-        d_usrp->set_user_register(registers::FFT_SEND, enabled);
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        write_setting(compression_config::FFT_SEND_ENABLED, registers::FFT_SEND, enabled);
     }
 
     void
     compressing_usrp_source_impl::set_average_send_enabled(bool enabled)
     {
-        d_usrp->set_user_register(registers::AVG_SEND, enabled);
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        write_setting(compression_config::AVERAGE_SEND_ENABLED, registers::AVG_SEND, enabled);
     }
 
     void
@@ -144,36 +210,111 @@ namespace gr {
         set_fft_send_enabled(false);
     }
 
+    void
+    compressing_usrp_source_impl::restart()
+    {
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        const auto enabled = [this](compression_config::setting setting) {
+            return d_config.has(setting) && d_config.get(setting) != 0;
+        };
+        const bool fft = enabled(compression_config::FFT_ENABLED);
+        const bool average_send = enabled(compression_config::AVERAGE_SEND_ENABLED);
+        const bool fft_send = enabled(compression_config::FFT_SEND_ENABLED);
+
+        write_setting(compression_config::FFT_ENABLED, registers::RUN_FFT, false);
+        write_setting(compression_config::AVERAGE_SEND_ENABLED, registers::AVG_SEND, false);
+        write_setting(compression_config::FFT_SEND_ENABLED, registers::FFT_SEND, false);
+
+        if (fft_send) {
+            write_setting(compression_config::FFT_SEND_ENABLED, registers::FFT_SEND, true);
+        }
+        if (average_send) {
+            write_setting(compression_config::AVERAGE_SEND_ENABLED, registers::AVG_SEND, true);
+        }
+        if (fft) {
+            write_setting(compression_config::FFT_ENABLED, registers::RUN_FFT, true);
+        }
+    }
+
     void
     compressing_usrp_source_impl::set_fft_size(uint32_t size)
     {
-        d_usrp->set_user_register(registers::FFT_SIZE, size);
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        write_setting(compression_config::FFT_SIZE, registers::FFT_SIZE, size);
     }
 
     void
     compressing_usrp_source_impl::set_fft_scaling(uint32_t scaling)
     {
-        d_usrp->set_user_register(registers::SCALING, scaling);
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        write_setting(compression_config::FFT_SCALING, registers::SCALING, scaling);
     }
 
     void
     compressing_usrp_source_impl::set_threshold(uint16_t index, uint32_t threshold)
     {
-        // Register format:
-        // Bits 31:21 : index (11 bits)
-        // Bits 20:0 : threshold shifted right by 11 bits (21 bits)
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        write_threshold(index, threshold);
+    }
 
-        // Check that index fits within 11 bits
-        if (index > 0x7ffu) {
-            throw std::out_of_range("index must fit within 11 bits");
+    void
+    compressing_usrp_source_impl::set_mask_enabled(uint16_t index, bool enabled)
+    {
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        write_mask(index, enabled);
+    }
+
+    std::size_t
+    compressing_usrp_source_impl::set_thresholds(const std::vector<uint32_t>& thresholds,
+        const ::uhd::time_spec_t& time)
+    {
+        if (thresholds.size() > BIN_COUNT) {
+            throw std::invalid_argument("Too many thresholds");
         }
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        std::size_t written = 0;
+        write_timed(time, [&]() {
+            for (uint16_t i = 0; i < thresholds.size(); i++) {
+                if (!d_config.has_threshold(i)
+                    || d_config.threshold(i) != (thresholds[i] & ~0x7ffu)) {
+                    write_threshold(i, thresholds[i]);
+                    written++;
+                }
+            }
+        });
+        return written;
+    }
 
-        const uint32_t command = (index << 21) | (threshold >> 11);
+    std::size_t
+    compressing_usrp_source_impl::set_mask(const std::vector<bool>& mask,
+        const ::uhd::time_spec_t& time)
+    {
+        if (mask.size() > BIN_COUNT) {
+            throw std::invalid_argument("Too many mask values");
+        }
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        std::size_t written = 0;
+        write_timed(time, [&]() {
+            for (uint16_t i = 0; i < mask.size(); i++) {
+                if (!d_config.has_mask(i) || d_config.mask(i) != mask[i]) {
+                    write_mask(i, mask[i]);
+                    written++;
+                }
+            }
+        });
+        return written;
+    }
+
+    void
+    compressing_usrp_source_impl::write_threshold(uint16_t index, uint32_t threshold)
+    {
+        const uint32_t command = threshold_command(index, threshold);
         d_usrp->set_user_register(registers::THRESHOLD, command);
+        d_config.set_threshold(index, threshold);
     }
 
     void
-    compressing_usrp_source_impl::set_mask_enabled(uint16_t index, bool enabled)
+    compressing_usrp_source_impl::write_mask(uint16_t index, bool enabled)
     {
         // Register format:
         // Bits 31:1 : index (31 bits)
@@ -185,6 +326,99 @@ namespace gr {
         }
         const uint32_t command = (index << 1) | enabled;
         d_usrp->set_user_register(registers::MASK, command);
+        if (index < BIN_COUNT) {
+            d_config.set_mask(index, enabled);
+        }
+    }
+
+    compression_config
+    compressing_usrp_source_impl::config() const
+    {
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        return d_config;
+    }
+
+    std::size_t
+    compressing_usrp_source_impl::restore(const compression_config& config,
+        const ::uhd::time_spec_t& time)
+    {
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        std::size_t written = 0;
+        const auto restore_setting = [&](compression_config::setting setting,
+            uint8_t address) {
+            if (config.has(setting) && (!d_config.has(setting)
+                    || d_config.get(setting) != config.get(setting))) {
+                write_setting(setting, address, config.get(setting));
+                written++;
+            }
+        };
+        write_timed(time, [&]() {
+            // Settings first, then the tables, then the enables in the same
+            // order as start_all()
+            restore_setting(compression_config::COMPRESSION_ENABLED,
+                registers::ENABLE_COMPRESSION);
+            restore_setting(compression_config::FFT_SIZE, registers::FFT_SIZE);
+            restore_setting(compression_config::FFT_SCALING, registers::SCALING);
+            restore_setting(compression_config::AVERAGE_WEIGHT,
+                registers::AVG_WEIGHT);
+            restore_setting(compression_config::AVERAGE_INTERVAL,
+                registers::AVG_INTERVAL);
+            for (uint16_t i = 0; i < BIN_COUNT; i++) {
+                if (config.has_threshold(i) && (!d_config.has_threshold(i)
+                        || d_config.threshold(i) != config.threshold(i))) {
+                    write_threshold(i, config.threshold(i));
+                    written++;
+                }
+                if (config.has_mask(i) && (!d_config.has_mask(i)
+                        || d_config.mask(i) != config.mask(i))) {
+                    write_mask(i, config.mask(i));
+                    written++;
+                }
+            }
+            restore_setting(compression_config::FFT_SEND_ENABLED,
+                registers::FFT_SEND);
+            restore_setting(compression_config::AVERAGE_SEND_ENABLED,
+                registers::AVG_SEND);
+            restore_setting(compression_config::FFT_ENABLED, registers::RUN_FFT);
+        });
+        return written;
+    }
+
+    void
+    compressing_usrp_source_impl::invalidate_config()
+    {
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        d_config.clear();
+    }
+
+    void
+    compressing_usrp_source_impl::write_setting(compression_config::setting setting,
+        uint8_t address,
+        uint32_t value)
+    {
+        d_usrp->set_user_register(address, value);
+        d_config.set(setting, value);
+    }
+
+    template <typename F>
+    void
+    compressing_usrp_source_impl::write_timed(const ::uhd::time_spec_t& time, F write)
+    {
+        const bool timed = time.get_real_secs() != 0.0;
+        if (timed) {
+            d_usrp->set_command_time(time);
+        }
+        try {
+            write();
+        } catch (...) {
+            if (timed) {
+                d_usrp->clear_command_time();
+            }
+            throw;
+        }
+        if (timed) {
+            d_usrp->clear_command_time();
+        }
     }
 
     void
@@ -195,7 +429,9 @@ namespace gr {
         }
         // Map to 0...255
         const uint8_t mapped = static_cast<uint8_t>(weight * 255.0);
-        d_usrp->set_user_register(registers::AVG_WEIGHT, mapped);
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        write_setting(compression_config::AVERAGE_WEIGHT, registers::AVG_WEIGHT,
+            mapped);
     }
 
     void
@@ -206,7 +442,9 @@ namespace gr {
         }
         // Register format: ceiling of the base-2 logarithm of the interval
         const uint32_t ceiling_log_interval = 31 - leading_zeros(interval);
-        d_usrp->set_user_register(registers::AVG_INTERVAL, ceiling_log_interval);
+        std::lock_guard<std::mutex> lock(d_register_mutex);
+        write_setting(compression_config::AVERAGE_INTERVAL,
+            registers::AVG_INTERVAL, ceiling_log_interval);
     }
 
   } /* namespace sparsdr */
@@ -21,6 +21,7 @@
 #ifndef INCLUDED_SPARSDR_COMPRESSING_USRP_SOURCE_IMPL_H
 #define INCLUDED_SPARSDR_COMPRESSING_USRP_SOURCE_IMPL_H
 
+#include <mutex>
 #include <sparsdr/compressing_usrp_source.h>
 
 namespace gr {
@@ -32,6 +33,38 @@ namespace gr {
       // The inner USRP source
       gr::uhd::usrp_source::sptr d_usrp;
 
+      /*! \brief Protects d_config and groups of writes */
+      mutable std::mutex d_register_mutex;
+      /*! \brief The values of all registers written */
+      compression_config d_config;
+
+      /*!
+       * \brief Writes the register for a setting and records its value
+       *
+       * d_register_mutex must be locked.
+       */
+      void write_setting(compression_config::setting setting,
+          uint8_t address,
+          uint32_t value);
+      /*!
+       * \brief Writes a threshold register and records its value
+       *
+       * d_register_mutex must be locked.
+       */
+      void write_threshold(uint16_t index, uint32_t threshold);
+      /*!
+       * \brief Writes a mask register and records its value
+       *
+       * d_register_mutex must be locked.
+       */
+      void write_mask(uint16_t index, bool enabled);
+      /*!
+       * \brief Sets the command time if time is not zero, calls write,
+       * then clears the command time
+       */
+      template <typename F>
+      void write_timed(const ::uhd::time_spec_t& time, F write);
+
      public:
       compressing_usrp_source_impl(const ::uhd::device_addr_t& device_addr);
       ~compressing_usrp_source_impl();
@@ -41,6 +74,14 @@ namespace gr {
          const ::uhd::tune_request_t tune_request
       );
       virtual void set_antenna(const std::string& ant);
+      virtual double get_center_freq();
+
+      virtual void set_clock_source(const std::string& source);
+      virtual void set_time_source(const std::string& source);
+      virtual ::uhd::time_spec_t get_time_now();
+      virtual ::uhd::time_spec_t get_time_last_pps();
+      virtual void set_time_next_pps(const ::uhd::time_spec_t& time);
+      virtual void set_time_now(const ::uhd::time_spec_t& time);
 
       virtual void set_compression_enabled(bool enabled);
       virtual void set_fft_enabled(bool enabled);
@@ -48,10 +89,19 @@ namespace gr {
       virtual void set_average_send_enabled(bool enabled);
       virtual void start_all();
       virtual void stop_all();
+      virtual void restart();
       virtual void set_fft_size(uint32_t size);
       virtual void set_fft_scaling(uint32_t scaling);
       virtual void set_threshold(uint16_t index, uint32_t threshold);
       virtual void set_mask_enabled(uint16_t index, bool enabled);
+      virtual std::size_t set_thresholds(const std::vector<uint32_t>& thresholds,
+          const ::uhd::time_spec_t& time);
+      virtual std::size_t set_mask(const std::vector<bool>& mask,
+          const ::uhd::time_spec_t& time);
+      virtual compression_config config() const;
+      virtual std::size_t restore(const compression_config& config,
+          const ::uhd::time_spec_t& time);
+      virtual void invalidate_config();
       virtual void set_average_weight(float weight);
       virtual void set_average_packet_interval(uint32_t interval);
     };
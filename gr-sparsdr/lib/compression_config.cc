@@ -0,0 +1,365 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sstream>
+#include <stdexcept>
+#include <sparsdr/compression_config.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    const std::size_t compression_config::BIN_COUNT;
+
+    namespace {
+
+    const char* const SETTING_NAMES[compression_config::SETTING_COUNT] = {
+        "compression_enabled",
+        "fft_enabled",
+        "fft_send_enabled",
+        "average_send_enabled",
+        "fft_size",
+        "fft_scaling",
+        "average_weight",
+        "average_interval",
+    };
+
+    /*! \brief The number of threshold bits that the register does not store */
+    const unsigned int THRESHOLD_SHIFT = 11;
+
+    /*! \brief Formats a bin range as "start" or "start-last" */
+    std::string
+    bin_range(std::size_t start, std::size_t end)
+    {
+        std::ostringstream stream;
+        stream << start;
+        if (end - start > 1) {
+            stream << '-' << (end - 1);
+        }
+        return stream.str();
+    }
+
+    /*!
+     * \brief Calls emit(start, end) for each run of adjacent bins
+     * [start, end) where included(bin) is true and key(bin) is the same
+     */
+    template <typename Included, typename Key, typename Emit>
+    void
+    for_each_run(Included included, Key key, Emit emit)
+    {
+        std::size_t bin = 0;
+        while (bin < compression_config::BIN_COUNT) {
+            if (!included(bin)) {
+                bin++;
+                continue;
+            }
+            const std::size_t start = bin;
+            bin++;
+            while (bin < compression_config::BIN_COUNT && included(bin)
+                && key(bin) == key(start)) {
+                bin++;
+            }
+            emit(start, bin);
+        }
+    }
+
+    /*!
+     * \brief Parses a bin range, returning the first bin and one past the
+     * last bin
+     */
+    std::pair<std::size_t, std::size_t>
+    parse_bin_range(const std::string& text)
+    {
+        std::size_t start;
+        std::size_t last;
+        char separator;
+        std::istringstream stream(text);
+        if (!(stream >> start)) {
+            throw std::invalid_argument("Invalid bin range " + text);
+        }
+        if (stream >> separator) {
+            if (separator != '-' || !(stream >> last)) {
+                throw std::invalid_argument("Invalid bin range " + text);
+            }
+        } else {
+            last = start;
+        }
+        if (last < start || last >= compression_config::BIN_COUNT) {
+            throw std::invalid_argument("Invalid bin range " + text);
+        }
+        return std::make_pair(start, last + 1);
+    }
+
+    }
+
+    compression_config::compression_config()
+      : d_settings(),
+        d_settings_known(),
+        d_thresholds(BIN_COUNT, 0),
+        d_thresholds_known(),
+        d_masks(),
+        d_masks_known()
+    {
+    }
+
+    std::string
+    compression_config::setting_name(setting s)
+    {
+        return SETTING_NAMES[s];
+    }
+
+    bool
+    compression_config::has(setting s) const
+    {
+        return d_settings_known.test(s);
+    }
+
+    std::uint32_t
+    compression_config::get(setting s) const
+    {
+        if (!has(s)) {
+            throw std::out_of_range(setting_name(s) + " is not known");
+        }
+        return d_settings[s];
+    }
+
+    void
+    compression_config::set(setting s, std::uint32_t value)
+    {
+        d_settings[s] = value;
+        d_settings_known.set(s);
+    }
+
+    bool
+    compression_config::has_threshold(std::uint16_t bin) const
+    {
+        return bin < BIN_COUNT && d_thresholds_known.test(bin);
+    }
+
+    std::uint32_t
+    compression_config::threshold(std::uint16_t bin) const
+    {
+        if (!has_threshold(bin)) {
+            throw std::out_of_range("Threshold is not known");
+        }
+        return d_thresholds[bin] << THRESHOLD_SHIFT;
+    }
+
+    void
+    compression_config::set_threshold(std::uint16_t bin, std::uint32_t threshold)
+    {
+        d_thresholds.at(bin) = threshold >> THRESHOLD_SHIFT;
+        d_thresholds_known.set(bin);
+    }
+
+    bool
+    compression_config::has_mask(std::uint16_t bin) const
+    {
+        return bin < BIN_COUNT && d_masks_known.test(bin);
+    }
+
+    bool
+    compression_config::mask(std::uint16_t bin) const
+    {
+        if (!has_mask(bin)) {
+            throw std::out_of_range("Mask is not known");
+        }
+        return d_masks.test(bin);
+    }
+
+    void
+    compression_config::set_mask(std::uint16_t bin, bool masked)
+    {
+        d_masks.set(bin, masked);
+        d_masks_known.set(bin);
+    }
+
+    void
+    compression_config::clear()
+    {
+        d_settings_known.reset();
+        d_thresholds_known.reset();
+        d_masks_known.reset();
+    }
+
+    std::vector<std::string>
+    compression_config::differences(const compression_config& other) const
+    {
+        std::vector<std::string> result;
+        for (int i = 0; i < SETTING_COUNT; i++) {
+            const setting s = static_cast<setting>(i);
+            if (other.has(s) && (!has(s) || get(s) != other.get(s))) {
+                std::ostringstream stream;
+                stream << setting_name(s) << ": ";
+                if (has(s)) {
+                    stream << get(s);
+                } else {
+                    stream << "unknown";
+                }
+                stream << " -> " << other.get(s);
+                result.push_back(stream.str());
+            }
+        }
+
+        // A bin changes if other knows it and this does not, or both know it
+        // with different values. Runs of bins group by old and new values.
+        const auto threshold_changed = [&](std::size_t bin) {
+            return other.d_thresholds_known.test(bin)
+                && (!d_thresholds_known.test(bin)
+                    || d_thresholds[bin] != other.d_thresholds[bin]);
+        };
+        const auto threshold_key = [&](std::size_t bin) {
+            return std::make_pair(d_thresholds_known.test(bin)
+                    ? static_cast<std::int64_t>(d_thresholds[bin]) : -1,
+                other.d_thresholds[bin]);
+        };
+        for_each_run(threshold_changed, threshold_key,
+            [&](std::size_t start, std::size_t end) {
+                std::ostringstream stream;
+                stream << "threshold " << bin_range(start, end) << ": ";
+                if (d_thresholds_known.test(start)) {
+                    stream << (d_thresholds[start] << THRESHOLD_SHIFT);
+                } else {
+                    stream << "unknown";
+                }
+                stream << " -> " << (other.d_thresholds[start] << THRESHOLD_SHIFT);
+                result.push_back(stream.str());
+            });
+
+        const auto mask_changed = [&](std::size_t bin) {
+            return other.d_masks_known.test(bin)
+                && (!d_masks_known.test(bin) || d_masks[bin] != other.d_masks[bin]);
+        };
+        const auto mask_key = [&](std::size_t bin) {
+            return std::make_pair(d_masks_known.test(bin) ? int(d_masks[bin]) : -1,
+                int(other.d_masks[bin]));
+        };
+        for_each_run(mask_changed, mask_key,
+            [&](std::size_t start, std::size_t end) {
+                std::ostringstream stream;
+                stream << "mask " << bin_range(start, end) << ": ";
+                if (d_masks_known.test(start)) {
+                    stream << d_masks[start];
+                } else {
+                    stream << "unknown";
+                }
+                stream << " -> " << other.d_masks[start];
+                result.push_back(stream.str());
+            });
+        return result;
+    }
+
+    std::string
+    compression_config::to_string() const
+    {
+        std::ostringstream stream;
+        for (int i = 0; i < SETTING_COUNT; i++) {
+            if (d_settings_known.test(i)) {
+                stream << SETTING_NAMES[i] << ' ' << d_settings[i] << '\n';
+            }
+        }
+        for_each_run([&](std::size_t bin) { return d_thresholds_known.test(bin); },
+            [&](std::size_t bin) { return d_thresholds[bin]; },
+            [&](std::size_t start, std::size_t end) {
+                stream << "threshold " << bin_range(start, end) << ' '
+                    << (d_thresholds[start] << THRESHOLD_SHIFT) << '\n';
+            });
+        for_each_run([&](std::size_t bin) { return d_masks_known.test(bin); },
+            [&](std::size_t bin) { return d_masks[bin]; },
+            [&](std::size_t start, std::size_t end) {
+                stream << "mask " << bin_range(start, end) << ' '
+                    << d_masks[start] << '\n';
+            });
+        return stream.str();
+    }
+
+    compression_config
+    compression_config::from_string(const std::string& text)
+    {
+        compression_config config;
+        std::istringstream lines(text);
+        std::string line;
+        while (std::getline(lines, line)) {
+            std::istringstream fields(line);
+            std::string name;
+            if (!(fields >> name)) {
+                // Empty line
+                continue;
+            }
+            if (name == "threshold" || name == "mask") {
+                std::string range_text;
+                std::uint32_t value;
+                if (!(fields >> range_text >> value)
+                    || (name == "mask" && value > 1)) {
+                    throw std::invalid_argument("Invalid line: " + line);
+                }
+                const auto range = parse_bin_range(range_text);
+                for (std::size_t bin = range.first; bin < range.second; bin++) {
+                    if (name == "threshold") {
+                        config.set_threshold(bin, value);
+                    } else {
+                        config.set_mask(bin, value != 0);
+                    }
+                }
+                continue;
+            }
+            int s = 0;
+            while (s < SETTING_COUNT && name != SETTING_NAMES[s]) {
+                s++;
+            }
+            std::uint32_t value;
+            if (s == SETTING_COUNT || !(fields >> value)) {
+                throw std::invalid_argument("Invalid line: " + line);
+            }
+            config.set(static_cast<setting>(s), value);
+        }
+        return config;
+    }
+
+    bool
+    compression_config::operator==(const compression_config& other) const
+    {
+        if (d_settings_known != other.d_settings_known
+            || d_thresholds_known != other.d_thresholds_known
+            || d_masks_known != other.d_masks_known) {
+            return false;
+        }
+        for (int i = 0; i < SETTING_COUNT; i++) {
+            if (d_settings_known.test(i) && d_settings[i] != other.d_settings[i]) {
+                return false;
+            }
+        }
+        for (std::size_t bin = 0; bin < BIN_COUNT; bin++) {
+            if (d_thresholds_known.test(bin)
+                && d_thresholds[bin] != other.d_thresholds[bin]) {
+                return false;
+            }
+            if (d_masks_known.test(bin) && d_masks[bin] != other.d_masks[bin]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
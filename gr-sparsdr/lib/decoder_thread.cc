@@ -0,0 +1,95 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "decoder_thread.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    decoder_thread::decoder_thread(zero_copy_decoder::sptr decoder)
+      : d_decoder(decoder),
+        d_mutex(),
+        d_wake(),
+        d_finished(),
+        d_transfer(),
+        d_running(false),
+        d_stopping(false),
+        d_thread()
+    {
+        d_thread = std::thread(&decoder_thread::run, this);
+    }
+
+    decoder_thread::~decoder_thread()
+    {
+        {
+            std::unique_lock<std::mutex> lock(d_mutex);
+            d_finished.wait(lock, [this] { return !d_running; });
+            d_stopping = true;
+        }
+        d_wake.notify_one();
+        d_thread.join();
+    }
+
+    void
+    decoder_thread::start(const item_transfer& transfer)
+    {
+        {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            d_transfer = transfer;
+            d_running = true;
+        }
+        d_wake.notify_one();
+    }
+
+    item_transfer
+    decoder_thread::wait()
+    {
+        std::unique_lock<std::mutex> lock(d_mutex);
+        d_finished.wait(lock, [this] { return !d_running; });
+        return d_transfer;
+    }
+
+    void
+    decoder_thread::run()
+    {
+        std::unique_lock<std::mutex> lock(d_mutex);
+        while (true) {
+            d_wake.wait(lock, [this] { return d_stopping || d_running; });
+            if (d_stopping) {
+                return;
+            }
+            // The distributor does not touch the transfer until it finishes
+            lock.unlock();
+            item_transfer& transfer = d_transfer;
+            transfer.run([&](const char* items, int item_count) {
+                return d_decoder->decode(transfer.input, items, item_count);
+            });
+            lock.lock();
+            d_running = false;
+            d_finished.notify_one();
+        }
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
@@ -0,0 +1,142 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_DECODER_THREAD_H
+#define INCLUDED_SPARSDR_DECODER_THREAD_H
+
+#include <sparsdr/sample_distributor.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Items that one input of a sample_distributor sends to its
+     * decoder in one step: first some queued items, then some items from the
+     * input buffer
+     */
+    struct item_transfer
+    {
+      /*! \brief The input that the items came from */
+      int input;
+      /*! \brief The index of the decoder in the sample distributor */
+      int decoder;
+      /*! \brief Queued items to send first */
+      const char* queue_items;
+      /*! \brief The number of queued items to send */
+      int queue_count;
+      /*! \brief True if the last queued item has a release tag */
+      bool queue_release;
+      /*! \brief Items in the input buffer to send after the queued items */
+      const char* items;
+      /*! \brief The number of items in the input buffer to send */
+      int item_count;
+      /*! \brief True if the last item in the input buffer has a release tag */
+      bool release;
+      /*! \brief The number of queued items that the decoder accepted */
+      int queue_sent;
+      /*! \brief The number of items in the input buffer that the decoder accepted */
+      int sent;
+
+      /*!
+       * \brief Sends the queued items, and then the other items if all
+       * queued items were accepted
+       *
+       * \param send a function that takes a pointer to items and a number
+       * of items, and returns the number of items accepted
+       */
+      template <typename Send>
+      void run(Send send)
+      {
+          queue_sent = queue_count == 0 ? 0
+              : std::max(0, std::min(queue_count, send(queue_items, queue_count)));
+          sent = queue_sent != queue_count || item_count == 0 ? 0
+              : std::max(0, std::min(item_count, send(items, item_count)));
+      }
+    };
+
+    /*!
+     * \brief Runs a zero_copy_decoder on its own thread
+     *
+     * A sample_distributor starts transfers to all its busy zero-copy
+     * decoders and then waits for all of them, so that the decoders run at
+     * the same time. The items stay in the distributor's buffers until the
+     * transfer finishes.
+     */
+    class decoder_thread
+    {
+    private:
+      /*! \brief The decoder that this thread runs */
+      zero_copy_decoder::sptr d_decoder;
+      /*! \brief Protects d_transfer, d_running, and d_stopping */
+      std::mutex d_mutex;
+      /*! \brief Notified when a transfer starts or the thread stops */
+      std::condition_variable d_wake;
+      /*! \brief Notified when a transfer finishes */
+      std::condition_variable d_finished;
+      /*! \brief The current or last transfer */
+      item_transfer d_transfer;
+      /*! \brief True while d_transfer has not finished */
+      bool d_running;
+      /*! \brief Set to make the thread exit */
+      bool d_stopping;
+      /*! \brief The thread that calls decode() */
+      std::thread d_thread;
+
+      void run();
+
+    public:
+      /*! \brief Starts a thread that waits for transfers */
+      explicit decoder_thread(zero_copy_decoder::sptr decoder);
+      /*! \brief Waits for any transfer in progress and stops the thread */
+      ~decoder_thread();
+
+      decoder_thread(const decoder_thread&) = delete;
+      decoder_thread& operator=(const decoder_thread&) = delete;
+
+      /*! \brief Returns the decoder that this thread runs */
+      inline const zero_copy_decoder::sptr& decoder() const
+      {
+          return d_decoder;
+      }
+
+      /*!
+       * \brief Starts sending items to the decoder and returns without
+       * waiting
+       *
+       * The previous transfer must have finished.
+       */
+      void start(const item_transfer& transfer);
+
+      /*!
+       * \brief Waits for the transfer that start() began to finish
+       *
+       * \return the transfer, with queue_sent and sent set
+       */
+      item_transfer wait();
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_DECODER_THREAD_H */
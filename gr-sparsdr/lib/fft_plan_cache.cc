@@ -0,0 +1,93 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include "fft_plan_cache.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    namespace {
+    /*! \brief Unused plans and counts, shared by the whole process */
+    struct plan_pool
+    {
+      std::mutex mutex;
+      /*! \brief Unused plans for each FFT size */
+      std::map<std::uint16_t, std::vector<gr::fft::fft_complex*>> idle;
+      std::size_t created = 0;
+    };
+
+    plan_pool& pool()
+    {
+        // Never destroyed, so that plans can be returned during static
+        // destruction
+        static plan_pool* const instance = new plan_pool();
+        return *instance;
+    }
+
+    void release(std::uint16_t size, gr::fft::fft_complex* plan)
+    {
+        plan_pool& plans = pool();
+        std::lock_guard<std::mutex> lock(plans.mutex);
+        plans.idle[size].push_back(plan);
+    }
+    }
+
+    std::shared_ptr<gr::fft::fft_complex>
+    fft_plan_cache::acquire(std::uint16_t size)
+    {
+        plan_pool& plans = pool();
+        gr::fft::fft_complex* plan = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(plans.mutex);
+            std::vector<gr::fft::fft_complex*>& idle = plans.idle[size];
+            if (!idle.empty()) {
+                plan = idle.back();
+                idle.pop_back();
+            } else {
+                plans.created++;
+            }
+        }
+        if (plan == nullptr) {
+            // Planning is slow, so do it without holding the lock
+            plan = new gr::fft::fft_complex(size, false, 1);
+        }
+        return std::shared_ptr<gr::fft::fft_complex>(plan,
+            [size](gr::fft::fft_complex* unused) {
+                release(size, unused);
+            });
+    }
+
+    std::size_t
+    fft_plan_cache::plans_created()
+    {
+        plan_pool& plans = pool();
+        std::lock_guard<std::mutex> lock(plans.mutex);
+        return plans.created;
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
@@ -0,0 +1,67 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_FFT_PLAN_CACHE_H
+#define INCLUDED_SPARSDR_FFT_PLAN_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <gnuradio/fft/fft.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief A process-wide cache of inverse FFT plans
+     *
+     * Creating a gr::fft::fft_complex plans the FFT (and reads and writes
+     * the FFTW wisdom file), which is much slower than running it. This
+     * cache keeps plans that are no longer used, keyed by FFT size, and
+     * gives them to the next user that needs the same size.
+     *
+     * A plan has its own input and output buffers, so only one thread may
+     * use a plan at a time. Each plan from acquire() is given to only one
+     * user until all copies of the returned pointer are destroyed.
+     * All plans use the aligned buffers that gr::fft allocates, so the
+     * buffer alignment does not need to be part of the key.
+     *
+     * All functions are safe to call from any thread.
+     */
+    class fft_plan_cache
+    {
+    public:
+      /*!
+       * \brief Returns an inverse FFT plan of the provided size, creating
+       * one if no unused plan of that size is available
+       *
+       * When the last copy of the returned pointer is destroyed, the plan
+       * returns to the cache.
+       */
+      static std::shared_ptr<gr::fft::fft_complex> acquire(std::uint16_t size);
+
+      /*! \brief Returns the number of plans that the cache has created */
+      static std::size_t plans_created();
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_FFT_PLAN_CACHE_H */
@@ -46,6 +46,7 @@ namespace gr {
               gr::io_signature::make(1, 1, sizeof(std::uint32_t)),
               gr::io_signature::make(0, 0, 0)),
         d_average_model(max_history),
+        d_samples(),
         d_parent(parent),
         d_main_gui(nullptr)
     {
@@ -102,29 +103,13 @@ namespace gr {
     {
         // One sample is really 8 bytes
         const auto nsamples = noutput_items / 2;
-        const std::uint8_t* in = static_cast<const std::uint8_t*>(input_items[0]);
+        const std::uint32_t* in = static_cast<const std::uint32_t*>(input_items[0]);
+        decode_samples(in, nsamples, d_samples);
 
-        // Do <+signal processing+>
         for (int i = 0; i < nsamples; i++) {
-            const std::uint8_t* sample_bytes = in + 8 * i;
-            // Parse sample
-            const auto fft_index = static_cast<std::uint16_t>(sample_bytes[0])
-                | static_cast<std::uint16_t>(sample_bytes[1]) << 8;
-            const auto is_average = ((fft_index >> 15) & 1) == 1;
-            if (is_average) {
-                const auto index = (fft_index >> 4) & 0x7ff;
-
-                // Magnitude is in two 2-byte chunks. Bytes within each chunk are little endian,
-                // but the more significant chunk is first.
-                const auto mag_more_significant = static_cast<std::uint16_t>(sample_bytes[4])
-                    | static_cast<std::uint16_t>(sample_bytes[5]) << 8;
-                const auto mag_less_significant = static_cast<std::uint16_t>(sample_bytes[6])
-                    | static_cast<std::uint16_t>(sample_bytes[7]) << 8;
-                const auto magnitude = static_cast<std::uint32_t>(mag_more_significant)
-                    << 16 | static_cast<std::uint32_t>(mag_less_significant);
-
+            if (d_samples.is_average(i)) {
                 // Add this average to the model
-                d_average_model.store_sample(index, magnitude);
+                d_average_model.store_sample(d_samples.index[i], d_samples.magnitude[i]);
             }
         }
 
@@ -22,6 +22,7 @@
 #define INCLUDED_SPARSDR_AVERAGE_WATERFALL_IMPL_H
 
 #include <sparsdr/average_waterfall.h>
+#include <sparsdr/sample_decoder.h>
 #include "stream_average_model.h"
 #include "average_waterfall_view.h"
 
@@ -33,6 +34,8 @@ namespace gr {
      private:
       /** Stores averages for the GUI */
       stream_average_model d_average_model;
+      /** Samples decoded from the input */
+      decoded_samples d_samples;
 
       int d_argc;
       char* d_argv;
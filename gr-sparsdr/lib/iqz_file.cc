@@ -0,0 +1,483 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <sparsdr/iqz_file.h>
+#include "time_expander.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The .iqz reader and writer only support little-endian processors"
+#endif
+
+namespace gr {
+  namespace sparsdr {
+
+    namespace {
+
+    const char FILE_MAGIC[8] = { 'S', 'P', 'A', 'R', 'S', 'D', 'R', 'Z' };
+    const char INDEX_MAGIC[8] = { 'I', 'Q', 'Z', 'I', 'N', 'D', 'E', 'X' };
+    /*! \brief "IQZC" as a little-endian integer */
+    const std::uint32_t CHUNK_MAGIC = 0x435a5149;
+    const std::uint32_t VERSION = 1;
+
+    struct file_header
+    {
+      char magic[8];
+      std::uint32_t version;
+      std::uint32_t chunk_samples;
+    };
+
+    struct chunk_header
+    {
+      std::uint32_t magic;
+      std::uint32_t sample_count;
+      std::uint32_t data_sample_count;
+      std::uint32_t reserved;
+      std::uint64_t start_time;
+      std::uint64_t end_time;
+      std::uint64_t active_bins[iqz_chunk_info::BINS / 64];
+    };
+
+    struct index_entry
+    {
+      std::uint64_t offset;
+      chunk_header header;
+    };
+
+    struct trailer
+    {
+      std::uint64_t index_offset;
+      std::uint64_t chunk_count;
+      char magic[8];
+    };
+
+    static_assert(sizeof(file_header) == 16, "Unexpected file header size");
+    static_assert(sizeof(chunk_header) == 288, "Unexpected chunk header size");
+    static_assert(sizeof(index_entry) == 296, "Unexpected index entry size");
+    static_assert(sizeof(trailer) == 24, "Unexpected trailer size");
+
+    const std::size_t SAMPLE_SIZE = 2 * sizeof(std::uint32_t);
+
+    chunk_header make_header(const iqz_chunk_info& info)
+    {
+        chunk_header header;
+        header.magic = CHUNK_MAGIC;
+        header.sample_count = info.sample_count;
+        header.data_sample_count = info.data_sample_count;
+        header.reserved = 0;
+        header.start_time = info.start_time;
+        header.end_time = info.end_time;
+        std::memcpy(header.active_bins, info.active_bins,
+            sizeof header.active_bins);
+        return header;
+    }
+
+    iqz_chunk_info make_info(std::uint64_t offset, const chunk_header& header)
+    {
+        iqz_chunk_info info;
+        info.offset = offset;
+        info.sample_count = header.sample_count;
+        info.data_sample_count = header.data_sample_count;
+        info.start_time = header.start_time;
+        info.end_time = header.end_time;
+        std::memcpy(info.active_bins, header.active_bins,
+            sizeof info.active_bins);
+        return info;
+    }
+
+    std::runtime_error io_error(const std::string& message)
+    {
+        return std::runtime_error(message + ": " + std::strerror(errno));
+    }
+
+    void write_all(int fd, const void* data, std::size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        while (size != 0) {
+            const ssize_t result = ::write(fd, bytes, size);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw io_error("Can't write .iqz file");
+            }
+            bytes += result;
+            size -= result;
+        }
+    }
+
+    /*!
+     * \brief Reads exactly size bytes at an offset
+     *
+     * \return false if the file ends first
+     */
+    bool read_all(int fd, void* data, std::size_t size, std::uint64_t offset)
+    {
+        char* bytes = static_cast<char*>(data);
+        while (size != 0) {
+            const ssize_t result = ::pread(fd, bytes, size, offset);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw io_error("Can't read .iqz file");
+            }
+            if (result == 0) {
+                return false;
+            }
+            bytes += result;
+            size -= result;
+            offset += result;
+        }
+        return true;
+    }
+
+    } // namespace
+
+    const std::size_t iqz_chunk_info::BINS;
+
+    bool
+    iqz_chunk_info::has_bins(std::uint16_t first_bin, std::uint16_t end_bin) const
+    {
+        std::size_t bin = first_bin;
+        const std::size_t end = std::min<std::size_t>(end_bin, BINS);
+        while (bin < end) {
+            const std::size_t word = bin / 64;
+            const std::size_t word_end = std::min(end, (word + 1) * 64);
+            const std::size_t width = word_end - bin;
+            const std::uint64_t mask = (width == 64 ? ~std::uint64_t(0)
+                : (std::uint64_t(1) << width) - 1) << (bin % 64);
+            if ((active_bins[word] & mask) != 0) {
+                return true;
+            }
+            bin = word_end;
+        }
+        return false;
+    }
+
+    std::uint64_t
+    iqz_chunk_info::first_sample_time(const std::vector<std::uint32_t>& words) const
+    {
+        decoded_samples samples;
+        decode_samples(words.data(), words.size() / 2, samples);
+        std::size_t first_data = 0;
+        while (first_data < samples.size() && samples.is_average(first_data)) {
+            first_data++;
+        }
+        if (samples.size() == 0) {
+            return start_time;
+        }
+        if (first_data == samples.size()) {
+            // start_time is the time of the last sample before this chunk
+            return start_time + ((samples.time[0] - start_time) & 0xfffff);
+        }
+        // The writer expanded each time from the time of the sample before
+        // it, so the same steps lead back from the first data sample
+        std::uint64_t time = start_time;
+        for (std::size_t i = first_data; i != 0; i--) {
+            time -= (samples.time[i] - samples.time[i - 1]) & 0xfffff;
+        }
+        return time;
+    }
+
+    iqz_writer::iqz_writer(const std::string& path, std::uint32_t chunk_samples,
+        std::uint64_t start_time)
+      : d_fd(-1),
+        d_chunk_samples(std::max<std::uint32_t>(chunk_samples, 1)),
+        d_chunk(),
+        d_chunk_info(),
+        d_last_time(start_time),
+        d_offset(sizeof(file_header)),
+        d_index(),
+        d_decoded()
+    {
+        d_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (d_fd == -1) {
+            throw io_error("Can't open " + path);
+        }
+        file_header header;
+        std::memcpy(header.magic, FILE_MAGIC, sizeof header.magic);
+        header.version = VERSION;
+        header.chunk_samples = d_chunk_samples;
+        try {
+            write_all(d_fd, &header, sizeof header);
+        } catch (...) {
+            ::close(d_fd);
+            throw;
+        }
+        d_chunk.reserve(2 * static_cast<std::size_t>(d_chunk_samples));
+        start_chunk();
+    }
+
+    iqz_writer::~iqz_writer()
+    {
+        try {
+            close();
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to finish .iqz file: " << e.what() << '\n';
+        }
+    }
+
+    void
+    iqz_writer::write(const std::uint32_t* words, std::size_t sample_count)
+    {
+        std::size_t samples_written = 0;
+        while (samples_written < sample_count) {
+            const std::size_t count = std::min<std::size_t>(
+                sample_count - samples_written,
+                d_chunk_samples - d_chunk_info.sample_count);
+            const std::uint32_t* chunk_words = words + 2 * samples_written;
+
+            decode_samples(chunk_words, count, d_decoded);
+            time_expander expander(d_last_time);
+            for (std::size_t i = 0; i < count; i++) {
+                // Averages arrive regularly even when no bin has a signal,
+                // so expanding their times too keeps the expander from
+                // missing rollovers during quiet periods
+                d_last_time = expander.expand(d_decoded.time[i]);
+                if (d_decoded.is_average(i)) {
+                    continue;
+                }
+                if (d_chunk_info.data_sample_count == 0) {
+                    d_chunk_info.start_time = d_last_time;
+                }
+                d_chunk_info.end_time = d_last_time;
+                d_chunk_info.data_sample_count++;
+                const std::uint16_t bin = d_decoded.index[i];
+                d_chunk_info.active_bins[bin / 64] |= std::uint64_t(1) << (bin % 64);
+            }
+
+            d_chunk.insert(d_chunk.end(), chunk_words, chunk_words + 2 * count);
+            d_chunk_info.sample_count += count;
+            samples_written += count;
+            if (d_chunk_info.sample_count == d_chunk_samples) {
+                write_chunk();
+            }
+        }
+    }
+
+    void
+    iqz_writer::close()
+    {
+        if (d_fd == -1) {
+            return;
+        }
+        // Close the file even if this fails
+        const int fd = d_fd;
+        try {
+            write_chunk();
+            d_fd = -1;
+
+            std::vector<index_entry> entries;
+            entries.reserve(d_index.size());
+            for (const iqz_chunk_info& info : d_index) {
+                index_entry entry;
+                entry.offset = info.offset;
+                entry.header = make_header(info);
+                entries.push_back(entry);
+            }
+            write_all(fd, entries.data(), entries.size() * sizeof(index_entry));
+
+            trailer end;
+            end.index_offset = d_offset;
+            end.chunk_count = d_index.size();
+            std::memcpy(end.magic, INDEX_MAGIC, sizeof end.magic);
+            write_all(fd, &end, sizeof end);
+        } catch (...) {
+            d_fd = -1;
+            ::close(fd);
+            throw;
+        }
+        if (::close(fd) != 0) {
+            throw io_error("Can't close .iqz file");
+        }
+    }
+
+    void
+    iqz_writer::start_chunk()
+    {
+        d_chunk.clear();
+        d_chunk_info.offset = d_offset;
+        d_chunk_info.sample_count = 0;
+        d_chunk_info.data_sample_count = 0;
+        d_chunk_info.start_time = d_last_time;
+        d_chunk_info.end_time = d_last_time;
+        std::fill(std::begin(d_chunk_info.active_bins),
+            std::end(d_chunk_info.active_bins), 0);
+    }
+
+    void
+    iqz_writer::write_chunk()
+    {
+        if (d_chunk_info.sample_count == 0) {
+            return;
+        }
+        const chunk_header header = make_header(d_chunk_info);
+        write_all(d_fd, &header, sizeof header);
+        write_all(d_fd, d_chunk.data(), d_chunk.size() * sizeof(std::uint32_t));
+        d_offset += sizeof header + d_chunk_info.sample_count * SAMPLE_SIZE;
+        d_index.push_back(d_chunk_info);
+        start_chunk();
+    }
+
+    iqz_reader::iqz_reader(const std::string& path)
+      : d_fd(-1),
+        d_chunk_samples(0),
+        d_index()
+    {
+        d_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (d_fd == -1) {
+            throw io_error("Can't open " + path);
+        }
+        try {
+            struct stat file_status;
+            if (::fstat(d_fd, &file_status) != 0) {
+                throw io_error("Can't get the size of " + path);
+            }
+            const std::uint64_t file_size = file_status.st_size;
+
+            file_header header;
+            if (!read_all(d_fd, &header, sizeof header, 0)
+                || std::memcmp(header.magic, FILE_MAGIC, sizeof header.magic) != 0) {
+                throw std::runtime_error(path + " is not an .iqz file");
+            }
+            if (header.version != VERSION) {
+                throw std::runtime_error(path + " has unsupported .iqz version "
+                    + std::to_string(header.version));
+            }
+            d_chunk_samples = header.chunk_samples;
+
+            if (!read_index(file_size)) {
+                rebuild_index(file_size);
+            }
+        } catch (...) {
+            ::close(d_fd);
+            throw;
+        }
+    }
+
+    iqz_reader::~iqz_reader()
+    {
+        ::close(d_fd);
+    }
+
+    bool
+    iqz_reader::read_index(std::uint64_t file_size)
+    {
+        if (file_size < sizeof(file_header) + sizeof(trailer)) {
+            return false;
+        }
+        trailer end;
+        if (!read_all(d_fd, &end, sizeof end, file_size - sizeof end)
+            || std::memcmp(end.magic, INDEX_MAGIC, sizeof end.magic) != 0) {
+            return false;
+        }
+        if (end.index_offset < sizeof(file_header)
+            || end.index_offset > file_size - sizeof end
+            || (file_size - sizeof end - end.index_offset)
+                != end.chunk_count * sizeof(index_entry)) {
+            return false;
+        }
+        std::vector<index_entry> entries(end.chunk_count);
+        if (!read_all(d_fd, entries.data(), entries.size() * sizeof(index_entry),
+                end.index_offset)) {
+            return false;
+        }
+        d_index.clear();
+        d_index.reserve(entries.size());
+        for (const index_entry& entry : entries) {
+            d_index.push_back(make_info(entry.offset, entry.header));
+        }
+        return true;
+    }
+
+    void
+    iqz_reader::rebuild_index(std::uint64_t file_size)
+    {
+        // The capture probably stopped before the index was written.
+        // Walk the chunk headers, stopping at the first incomplete chunk.
+        d_index.clear();
+        std::uint64_t offset = sizeof(file_header);
+        chunk_header header;
+        while (offset + sizeof header <= file_size
+            && read_all(d_fd, &header, sizeof header, offset)) {
+            if (header.magic != CHUNK_MAGIC
+                || header.sample_count == 0
+                || header.sample_count > d_chunk_samples) {
+                break;
+            }
+            const std::uint64_t end = offset + sizeof header
+                + header.sample_count * SAMPLE_SIZE;
+            if (end > file_size) {
+                break;
+            }
+            d_index.push_back(make_info(offset, header));
+            offset = end;
+        }
+    }
+
+    std::vector<std::size_t>
+    iqz_reader::find_chunks(std::uint64_t start_time,
+        std::uint64_t end_time,
+        std::uint16_t first_bin,
+        std::uint16_t end_bin) const
+    {
+        std::vector<std::size_t> found;
+        // Chunks are in time order, so the first chunk that ends at or
+        // after start_time can be found with a binary search
+        auto chunk = std::lower_bound(d_index.begin(), d_index.end(), start_time,
+            [](const iqz_chunk_info& info, std::uint64_t time) {
+                return info.end_time < time;
+            });
+        for (; chunk != d_index.end() && chunk->start_time < end_time; ++chunk) {
+            if (chunk->data_sample_count != 0
+                && chunk->has_bins(first_bin, end_bin)) {
+                found.push_back(chunk - d_index.begin());
+            }
+        }
+        return found;
+    }
+
+    void
+    iqz_reader::read_chunk(std::size_t chunk, std::vector<std::uint32_t>& words) const
+    {
+        const iqz_chunk_info& info = d_index.at(chunk);
+        words.resize(2 * static_cast<std::size_t>(info.sample_count));
+        if (!read_all(d_fd, words.data(), info.sample_count * SAMPLE_SIZE,
+                info.offset + sizeof(chunk_header))) {
+            throw std::runtime_error("Unexpected end of .iqz file");
+        }
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
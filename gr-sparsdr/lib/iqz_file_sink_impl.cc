@@ -0,0 +1,81 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "iqz_file_sink_impl.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    iqz_file_sink::sptr
+    iqz_file_sink::make(const std::string& path,
+        std::uint32_t chunk_samples,
+        std::uint64_t start_time)
+    {
+      return gnuradio::get_initial_sptr
+        (new iqz_file_sink_impl(path, chunk_samples, start_time));
+    }
+
+    /*
+     * The private constructor
+     */
+    iqz_file_sink_impl::iqz_file_sink_impl(const std::string& path,
+        std::uint32_t chunk_samples,
+        std::uint64_t start_time)
+      : gr::sync_block("iqz_file_sink",
+              // Each compressed sample is two 4-byte items
+              gr::io_signature::make(1, 1, sizeof(uint32_t)),
+              gr::io_signature::make(0, 0, 0)),
+        d_writer(path, chunk_samples, start_time)
+    {
+        // Never split a sample across calls to work()
+        set_output_multiple(2);
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    iqz_file_sink_impl::~iqz_file_sink_impl()
+    {
+    }
+
+    bool
+    iqz_file_sink_impl::stop()
+    {
+        d_writer.close();
+        return true;
+    }
+
+    int
+    iqz_file_sink_impl::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      const uint32_t* in = static_cast<const uint32_t*>(input_items[0]);
+      d_writer.write(in, noutput_items / 2);
+      return noutput_items;
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
@@ -0,0 +1,52 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_IQZ_FILE_SINK_IMPL_H
+#define INCLUDED_SPARSDR_IQZ_FILE_SINK_IMPL_H
+
+#include <sparsdr/iqz_file_sink.h>
+#include <sparsdr/iqz_file.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    class iqz_file_sink_impl : public iqz_file_sink
+    {
+     private:
+      /*! \brief The file writer */
+      iqz_writer d_writer;
+
+     public:
+      iqz_file_sink_impl(const std::string& path,
+          std::uint32_t chunk_samples,
+          std::uint64_t start_time);
+      ~iqz_file_sink_impl();
+
+      virtual bool stop() override;
+
+      int work(int noutput_items,
+         gr_vector_const_void_star &input_items,
+         gr_vector_void_star &output_items);
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_IQZ_FILE_SINK_IMPL_H */
@@ -0,0 +1,123 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <gnuradio/io_signature.h>
+#include "iqz_file_source_impl.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    iqz_file_source::sptr
+    iqz_file_source::make(const std::string& path,
+        std::uint64_t start_time,
+        std::uint64_t end_time,
+        std::uint16_t first_bin,
+        std::uint16_t end_bin)
+    {
+      return gnuradio::get_initial_sptr
+        (new iqz_file_source_impl(path, start_time, end_time, first_bin,
+            end_bin));
+    }
+
+    /*
+     * The private constructor
+     */
+    iqz_file_source_impl::iqz_file_source_impl(const std::string& path,
+        std::uint64_t start_time,
+        std::uint64_t end_time,
+        std::uint16_t first_bin,
+        std::uint16_t end_bin)
+      : gr::sync_block("iqz_file_source",
+              gr::io_signature::make(0, 0, 0),
+              // Each compressed sample is two 4-byte items
+              gr::io_signature::make(1, 1, sizeof(uint32_t))),
+        d_reader(path),
+        d_chunks(d_reader.find_chunks(start_time, end_time, first_bin, end_bin)),
+        d_next_chunk(0),
+        d_words(),
+        d_words_sent(0),
+        d_chunk_start_key(pmt::intern("chunk_start"))
+    {
+        set_output_multiple(2);
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    iqz_file_source_impl::~iqz_file_source_impl()
+    {
+    }
+
+    std::size_t
+    iqz_file_source_impl::total_chunks() const
+    {
+        return d_reader.chunks().size();
+    }
+
+    std::size_t
+    iqz_file_source_impl::selected_chunks() const
+    {
+        return d_chunks.size();
+    }
+
+    int
+    iqz_file_source_impl::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      uint32_t* out = static_cast<uint32_t*>(output_items[0]);
+
+      int produced = 0;
+      while (produced < noutput_items) {
+          if (d_words_sent == d_words.size()) {
+              if (d_next_chunk == d_chunks.size()) {
+                  break;
+              }
+              const std::size_t chunk = d_chunks[d_next_chunk];
+              d_reader.read_chunk(chunk, d_words);
+              d_next_chunk++;
+              d_words_sent = 0;
+              // The chunk may not follow the previous one in time
+              const std::uint64_t time =
+                  d_reader.chunks()[chunk].first_sample_time(d_words);
+              add_item_tag(0, nitems_written(0) + produced, d_chunk_start_key,
+                  pmt::from_uint64(time), alias_pmt());
+          }
+          const std::size_t count = std::min<std::size_t>(
+              noutput_items - produced, d_words.size() - d_words_sent);
+          std::copy(d_words.begin() + d_words_sent,
+              d_words.begin() + d_words_sent + count, out + produced);
+          d_words_sent += count;
+          produced += count;
+      }
+
+      if (produced == 0) {
+          return WORK_DONE;
+      }
+      return produced;
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
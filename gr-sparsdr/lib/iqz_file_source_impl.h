@@ -0,0 +1,66 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_IQZ_FILE_SOURCE_IMPL_H
+#define INCLUDED_SPARSDR_IQZ_FILE_SOURCE_IMPL_H
+
+#include <vector>
+#include <sparsdr/iqz_file_source.h>
+#include <sparsdr/iqz_file.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    class iqz_file_source_impl : public iqz_file_source
+    {
+     private:
+      /*! \brief The file reader */
+      iqz_reader d_reader;
+      /*! \brief The indexes of the chunks to read */
+      std::vector<std::size_t> d_chunks;
+      /*! \brief The position in d_chunks of the next chunk to read */
+      std::size_t d_next_chunk;
+      /*! \brief The words of the chunk being sent */
+      std::vector<std::uint32_t> d_words;
+      /*! \brief The number of words in d_words already sent */
+      std::size_t d_words_sent;
+      /*! \brief Key of the tag on the first item of each chunk */
+      const pmt::pmt_t d_chunk_start_key;
+
+     public:
+      iqz_file_source_impl(const std::string& path,
+          std::uint64_t start_time,
+          std::uint64_t end_time,
+          std::uint16_t first_bin,
+          std::uint16_t end_bin);
+      ~iqz_file_source_impl();
+
+      virtual std::size_t total_chunks() const override;
+      virtual std::size_t selected_chunks() const override;
+
+      int work(int noutput_items,
+         gr_vector_const_void_star &input_items,
+         gr_vector_void_star &output_items);
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_IQZ_FILE_SOURCE_IMPL_H */
@@ -0,0 +1,89 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_LOG_RATE_LIMITER_H
+#define INCLUDED_SPARSDR_LOG_RATE_LIMITER_H
+
+#include <chrono>
+#include <cstdint>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Limits how often a kind of log message is written
+     *
+     * This is not thread-safe. Each limiter should be used from only one
+     * thread.
+     */
+    class log_rate_limiter
+    {
+    private:
+      typedef std::chrono::steady_clock clock;
+
+      /*! \brief The minimum time between messages */
+      clock::duration d_interval;
+      /*! \brief The earliest time when the next message may be written */
+      clock::time_point d_next;
+      /*! \brief Messages skipped since the last message that was written */
+      std::uint64_t d_skipped;
+      /*! \brief Messages skipped before the last message that was written */
+      std::uint64_t d_suppressed;
+
+    public:
+      inline explicit log_rate_limiter(clock::duration interval)
+        : d_interval(interval),
+          d_next(),
+          d_skipped(0),
+          d_suppressed(0)
+      {}
+
+      /*!
+       * \brief Returns true if a message may be written now
+       *
+       * If this returns false, the message should be skipped.
+       */
+      inline bool allow()
+      {
+          const clock::time_point now = clock::now();
+          if (now < d_next) {
+              d_skipped++;
+              return false;
+          }
+          d_next = now + d_interval;
+          d_suppressed = d_skipped;
+          d_skipped = 0;
+          return true;
+      }
+
+      /*!
+       * \brief Returns the number of messages that were skipped before the
+       * last time allow() returned true
+       */
+      inline std::uint64_t suppressed() const
+      {
+          return d_suppressed;
+      }
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_LOG_RATE_LIMITER_H */
@@ -0,0 +1,293 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <gnuradio/io_signature.h>
+#include <sparsdr/sample_decoder.h>
+#include "multi_device_receiver_impl.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    namespace {
+    /*! \brief The interval between average samples, in hardware time steps */
+    const uint32_t AVERAGE_INTERVAL = 1 << 14;
+    /*! \brief The longest time to wait for a PPS edge */
+    const std::chrono::milliseconds PPS_TIMEOUT(1500);
+    }
+
+    const double multi_device_receiver::DEVICE_BANDWIDTH = 100e6;
+
+    multi_device_receiver::sptr
+    multi_device_receiver::make(
+        const std::vector<compressing_usrp_source::sptr>& usrps,
+        const std::vector<std::string>& output_paths,
+        const std::string& index_path,
+        uint32_t threshold,
+        const std::vector<mask_range>& masks,
+        const std::string& time_source,
+        const std::vector<int>& cores,
+        double start_delay)
+    {
+      return gnuradio::get_initial_sptr
+        (new multi_device_receiver_impl(usrps, output_paths, index_path,
+            threshold, masks, time_source, cores, start_delay));
+    }
+
+    /*
+     * The private constructor
+     */
+    multi_device_receiver_impl::multi_device_receiver_impl(
+        const std::vector<compressing_usrp_source::sptr>& usrps,
+        const std::vector<std::string>& output_paths,
+        const std::string& index_path,
+        uint32_t threshold,
+        const std::vector<mask_range>& masks,
+        const std::string& time_source,
+        const std::vector<int>& cores,
+        double start_delay)
+      : gr::hier_block2("multi_device_receiver",
+              gr::io_signature::make(0, 0, 0),
+              gr::io_signature::make(0, 0, 0)),
+        d_devices(),
+        d_expected_average_interval(std::chrono::nanoseconds(
+            static_cast<uint64_t>(AVERAGE_INTERVAL) * TIME_STEP_NS)),
+        d_start_time(0),
+        d_index(),
+        d_restart_mutex(),
+        d_worker_mutex(),
+        d_restart_worker()
+    {
+        if (usrps.empty()) {
+            throw std::invalid_argument("No USRPs");
+        }
+        if (output_paths.size() != usrps.size()) {
+            throw std::invalid_argument(
+                "The number of output paths must match the number of USRPs");
+        }
+        d_devices.resize(usrps.size());
+        for (std::size_t i = 0; i < usrps.size(); i++) {
+            d_devices[i].usrp = usrps[i];
+        }
+
+        align_device_times(time_source);
+
+        // Configure all devices the same way as real_time_receiver, but
+        // leave compression stopped
+        std::vector<bool> masked(compressing_usrp_source::BIN_COUNT, false);
+        for (const mask_range& mask : masks) {
+            const std::size_t mask_end = std::min<std::size_t>(mask.end,
+                compressing_usrp_source::BIN_COUNT);
+            for (std::size_t i = mask.start; i < mask_end; i++) {
+                masked[i] = true;
+            }
+        }
+        masked[0] = true;
+        masked[1] = true;
+        masked[2047] = true;
+        for (const receive_path& device : d_devices) {
+            device.usrp->set_compression_enabled(true);
+            device.usrp->stop_all();
+            device.usrp->set_thresholds(std::vector<uint32_t>(
+                compressing_usrp_source::BIN_COUNT, threshold));
+            device.usrp->set_mask(masked);
+            device.usrp->set_average_packet_interval(AVERAGE_INTERVAL);
+        }
+
+        // Start compression on all devices at the same step of the
+        // hardware time. The time stamps in the samples are the device time
+        // in steps, so the first sample from every device expands to at
+        // least d_start_time.
+        const double now = d_devices[0].usrp->get_time_now().get_real_secs();
+        d_start_time = static_cast<std::uint64_t>(
+            std::ceil((now + start_delay) / TIME_STEP));
+        const ::uhd::time_spec_t start(d_start_time * TIME_STEP);
+        for (const receive_path& device : d_devices) {
+            compression_config running = device.usrp->config();
+            running.set(compression_config::FFT_SEND_ENABLED, 1);
+            running.set(compression_config::AVERAGE_SEND_ENABLED, 1);
+            running.set(compression_config::FFT_ENABLED, 1);
+            device.usrp->restore(running, start);
+        }
+
+        // Restarts write many registers, so they run on another thread
+        // while the detectors keep checking the streams
+        d_restart_worker.reset(new restart_worker([this](std::size_t device) {
+            restart_compression(device);
+        }));
+        const pmt::pmt_t overflow_port = pmt::intern("overflow");
+        message_port_register_hier_out(overflow_port);
+        for (std::size_t i = 0; i < d_devices.size(); i++) {
+            receive_path& device = d_devices[i];
+
+            device.detector = average_detector::make(AVERAGE_INTERVAL,
+                [this, i]() { handle_overflow(i); });
+            msg_connect(device.detector, overflow_port, self(), overflow_port);
+
+            // Every file expands times from the same start, so they share
+            // a timeline
+            device.sink = iqz_file_sink::make(output_paths[i], 65536,
+                d_start_time);
+
+            connect(device.usrp, 0, device.detector, 0);
+            connect(device.usrp, 0, device.sink, 0);
+
+            if (!cores.empty()) {
+                // Keep each device's receive path on one core
+                const std::vector<int> core(1, cores[i % cores.size()]);
+                device.usrp->set_processor_affinity(core);
+                device.detector->set_processor_affinity(core);
+                device.sink->set_processor_affinity(core);
+            }
+
+            d_index.add(capture_index_entry(output_paths[i],
+                device.usrp->get_center_freq(), DEVICE_BANDWIDTH,
+                d_start_time));
+        }
+        d_index.write(index_path);
+    }
+
+    void
+    multi_device_receiver_impl::align_device_times(
+        const std::string& time_source)
+    {
+        if (time_source == "internal") {
+            // Without a shared PPS signal, this is the best that can be done
+            for (const receive_path& device : d_devices) {
+                device.usrp->set_time_now(::uhd::time_spec_t(0.0));
+            }
+            return;
+        }
+        for (const receive_path& device : d_devices) {
+            device.usrp->set_clock_source(time_source);
+            device.usrp->set_time_source(time_source);
+        }
+        // Wait for a PPS edge, so that there is almost a full second to set
+        // the time on all devices before the next one
+        const compressing_usrp_source::sptr& first = d_devices[0].usrp;
+        const double last_pps = first->get_time_last_pps().get_real_secs();
+        const auto deadline = std::chrono::steady_clock::now() + PPS_TIMEOUT;
+        while (first->get_time_last_pps().get_real_secs() == last_pps) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                throw std::runtime_error("No PPS edge detected from the first USRP");
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        for (const receive_path& device : d_devices) {
+            device.usrp->set_time_next_pps(::uhd::time_spec_t(0.0));
+        }
+        // Wait for the next PPS edge, when the new time takes effect
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    std::size_t
+    multi_device_receiver_impl::device_count() const
+    {
+        return d_devices.size();
+    }
+
+    multi_device_receiver::duration
+    multi_device_receiver_impl::expected_average_interval() const
+    {
+        return d_expected_average_interval;
+    }
+
+    std::uint64_t
+    multi_device_receiver_impl::start_time() const
+    {
+        return d_start_time;
+    }
+
+    capture_index
+    multi_device_receiver_impl::index() const
+    {
+        return d_index;
+    }
+
+    average_detector_stats
+    multi_device_receiver_impl::average_stats(std::size_t device)
+    {
+        return d_devices.at(device).detector->stats();
+    }
+
+    void
+    multi_device_receiver_impl::restart_compression(std::size_t device)
+    {
+        const compressing_usrp_source::sptr& usrp = d_devices.at(device).usrp;
+        std::lock_guard<std::mutex> guard(d_restart_mutex);
+        // Restarting does not reset the hardware time (see TIME_STEP), so
+        // the file's expanded times stay on the shared timeline no matter
+        // when the device starts again
+        usrp->restart();
+        d_devices[device].detector->resync();
+    }
+
+    void
+    multi_device_receiver_impl::handle_overflow(std::size_t device)
+    {
+        // Samples from before the last restart may still be arriving, and
+        // would cause another restart immediately
+        const auto now = std::chrono::steady_clock::now();
+        auto& last_restart = d_devices[device].last_overflow_restart;
+        if (now - last_restart < d_expected_average_interval) {
+            return;
+        }
+        last_restart = now;
+        std::lock_guard<std::mutex> guard(d_worker_mutex);
+        if (!d_restart_worker) {
+            // The receiver is shutting down
+            return;
+        }
+        std::cerr << "Compression overflow detected on device " << device
+            << ", restarting\n";
+        d_restart_worker->request(device);
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    multi_device_receiver_impl::~multi_device_receiver_impl()
+    {
+        // As in real_time_receiver, take the worker away from the average
+        // detectors before waiting for it to stop
+        std::unique_ptr<restart_worker> worker;
+        {
+            std::lock_guard<std::mutex> guard(d_worker_mutex);
+            worker.swap(d_restart_worker);
+        }
+        // Finish any restart before turning compression off
+        worker.reset();
+        // Return the USRPs to normal non-compressing mode
+        for (const receive_path& device : d_devices) {
+            device.usrp->stop_all();
+            device.usrp->set_compression_enabled(false);
+        }
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
@@ -0,0 +1,112 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_MULTI_DEVICE_RECEIVER_IMPL_H
+#define INCLUDED_SPARSDR_MULTI_DEVICE_RECEIVER_IMPL_H
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <sparsdr/iqz_file_sink.h>
+#include <sparsdr/multi_device_receiver.h>
+#include "restart_worker.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    class multi_device_receiver_impl : public multi_device_receiver
+    {
+     private:
+      /*! \brief The blocks and state for one device */
+      struct receive_path
+      {
+        /*! \brief USRP configuration interface */
+        compressing_usrp_source::sptr usrp;
+        /*! \brief Block that detects overflows */
+        average_detector::sptr detector;
+        /*! \brief Block that writes samples to the device's file */
+        iqz_file_sink::sptr sink;
+        /*!
+         * \brief The time of the last restart caused by an overflow
+         *
+         * This is only used from the device's average detector thread.
+         */
+        std::chrono::steady_clock::time_point last_overflow_restart;
+      };
+
+      /*! \brief The devices, in the order they were passed to make() */
+      std::vector<receive_path> d_devices;
+      /*! \brief Expected interval between average samples */
+      duration d_expected_average_interval;
+      /*! \brief The expanded time when compression started */
+      std::uint64_t d_start_time;
+      /*! \brief The captures written */
+      capture_index d_index;
+      /*! \brief Prevents concurrent restarts */
+      std::mutex d_restart_mutex;
+      /*!
+       * \brief Protects d_restart_worker, which the average detector threads
+       * use while the destructor stops it
+       */
+      std::mutex d_worker_mutex;
+      /*!
+       * \brief Restarts compression after overflows, or null after the
+       * destructor has stopped it
+       */
+      std::unique_ptr<restart_worker> d_restart_worker;
+
+      /*!
+       * \brief Sets the same device time on all devices
+       *
+       * \param time_source the clock and time source passed to make()
+       */
+      void align_device_times(const std::string& time_source);
+
+      /*!
+       * \brief Called from a device's average detector thread when it finds
+       * an overflow
+       */
+      void handle_overflow(std::size_t device);
+
+     public:
+      multi_device_receiver_impl(
+          const std::vector<compressing_usrp_source::sptr>& usrps,
+          const std::vector<std::string>& output_paths,
+          const std::string& index_path,
+          uint32_t threshold,
+          const std::vector<mask_range>& masks,
+          const std::string& time_source,
+          const std::vector<int>& cores,
+          double start_delay);
+      ~multi_device_receiver_impl();
+
+      // Implement virtual functions
+      virtual std::size_t device_count() const;
+      virtual duration expected_average_interval() const;
+      virtual std::uint64_t start_time() const;
+      virtual capture_index index() const;
+      virtual average_detector_stats average_stats(std::size_t device);
+      virtual void restart_compression(std::size_t device);
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_MULTI_DEVICE_RECEIVER_IMPL_H */
@@ -0,0 +1,99 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "native_reconstruct_from_file_impl.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    native_reconstruct_from_file::sptr
+    native_reconstruct_from_file::make(std::vector<band_spec> bands,
+        const std::string& input_path,
+        unsigned int threads)
+    {
+      return gnuradio::get_initial_sptr
+        (new native_reconstruct_from_file_impl(bands, input_path, threads));
+    }
+
+    /*
+     * The private constructor
+     */
+    native_reconstruct_from_file_impl::native_reconstruct_from_file_impl(
+        const std::vector<band_spec>& bands,
+        const std::string& input_path,
+        unsigned int threads)
+      : gr::block("native_reconstruct_from_file",
+              gr::io_signature::make(0, 0, 0),
+              // One output per band
+              gr::io_signature::make(bands.size(), bands.size(), sizeof(gr_complex))),
+        d_reconstructor(bands, input_path, threads)
+    {
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    native_reconstruct_from_file_impl::~native_reconstruct_from_file_impl()
+    {
+    }
+
+    int
+    native_reconstruct_from_file_impl::general_work(int noutput_items,
+        gr_vector_int &ninput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      const std::size_t band_count = output_items.size();
+      const std::size_t capacity = noutput_items;
+
+      // Like native_reconstruct, stop adding samples once any band has
+      // enough to fill its output buffer, so that memory use stays bounded
+      auto any_band_full = [&]() {
+          for (std::size_t i = 0; i < band_count; i++) {
+              if (d_reconstructor.available(i) >= capacity) {
+                  return true;
+              }
+          }
+          return false;
+      };
+      while (!any_band_full() && d_reconstructor.stitch_next()) {
+      }
+
+      bool produced_any = false;
+      for (std::size_t i = 0; i < band_count; i++) {
+          const std::size_t count = d_reconstructor.read(i,
+              static_cast<gr_complex*>(output_items[i]), capacity);
+          produce(i, count);
+          produced_any = produced_any || count != 0;
+      }
+
+      if (!produced_any && d_reconstructor.done()) {
+          return WORK_DONE;
+      }
+      return WORK_CALLED_PRODUCE;
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
@@ -0,0 +1,51 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_NATIVE_RECONSTRUCT_FROM_FILE_IMPL_H
+#define INCLUDED_SPARSDR_NATIVE_RECONSTRUCT_FROM_FILE_IMPL_H
+
+#include <sparsdr/native_reconstruct_from_file.h>
+#include "parallel_reconstructor.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    class native_reconstruct_from_file_impl : public native_reconstruct_from_file
+    {
+     private:
+      /*! \brief Reads and reconstructs the file */
+      parallel_reconstructor d_reconstructor;
+
+     public:
+      native_reconstruct_from_file_impl(const std::vector<band_spec>& bands,
+          const std::string& input_path,
+          unsigned int threads);
+      ~native_reconstruct_from_file_impl();
+
+      int general_work(int noutput_items,
+           gr_vector_int &ninput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_NATIVE_RECONSTRUCT_FROM_FILE_IMPL_H */
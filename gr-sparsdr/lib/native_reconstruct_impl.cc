@@ -0,0 +1,414 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <boost/bind.hpp>
+#include <gnuradio/block_detail.h>
+#include <gnuradio/buffer.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/logger.h>
+#include "native_reconstruct_impl.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    const int native_reconstruct_impl::DECODE_BATCH_SIZE;
+    const std::uint64_t native_reconstruct_impl::NO_CHANGE;
+
+    native_reconstruct::sptr
+    native_reconstruct::make(std::vector<band_spec> bands,
+        bool fill_gaps,
+        bool tag_silence,
+        bool tag_bursts,
+        unsigned int max_bands)
+    {
+      return gnuradio::get_initial_sptr
+        (new native_reconstruct_impl(bands, fill_gaps, tag_silence,
+            tag_bursts, max_bands));
+    }
+
+    /*
+     * The private constructor
+     */
+    native_reconstruct_impl::native_reconstruct_impl(const std::vector<band_spec>& bands,
+        bool fill_gaps,
+        bool tag_silence,
+        bool tag_bursts,
+        unsigned int max_bands)
+      : gr::block("native_reconstruct",
+              // Each compressed sample is really 8 bytes, but this also works.
+              // The work function can reassemble each sample from two 4-byte
+              // integers.
+              gr::io_signature::make(1, 1, sizeof(uint32_t)),
+              // One output per band slot
+              gr::io_signature::make(std::max<std::size_t>(bands.size(), max_bands),
+                  std::max<std::size_t>(bands.size(), max_bands),
+                  sizeof(gr_complex))),
+        d_reconstructor(bands, fill_gaps, tag_bursts, max_bands),
+        d_slots(d_reconstructor.band_count()),
+        d_changes_mutex(),
+        d_changes(),
+        d_samples(),
+        d_finished(false),
+        d_tag_silence(fill_gaps && tag_silence),
+        d_silence_key(pmt::intern("silence")),
+        d_tag_bursts(tag_bursts),
+        d_burst_start_key(pmt::intern("burst_start")),
+        d_burst_end_key(pmt::intern("burst_end")),
+        d_time_key(pmt::intern("time")),
+        d_band_key(pmt::intern("band")),
+        d_burst_events(),
+        d_band_open_key(pmt::intern("band_open")),
+        d_frequency_key(pmt::intern("frequency")),
+        d_bins_key(pmt::intern("bins")),
+        d_cmd_key(pmt::intern("cmd")),
+        d_open_symbol(pmt::intern("open")),
+        d_close_symbol(pmt::intern("close")),
+        d_command_port(pmt::intern("command"))
+    {
+        // There is no relationship between input and output items
+        set_tag_propagation_policy(TPP_DONT);
+
+        // Bands from the constructor start at the beginning of their outputs
+        for (std::size_t i = 0; i < bands.size(); i++) {
+            d_slots[i].current.base = 0;
+            d_slots[i].current.started = true;
+            d_slots[i].current.tag_open = false;
+        }
+
+        message_port_register_in(d_command_port);
+        set_msg_handler(d_command_port,
+            boost::bind(&native_reconstruct_impl::handle_command, this, _1));
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    native_reconstruct_impl::~native_reconstruct_impl()
+    {
+    }
+
+    void
+    native_reconstruct_impl::open_band(std::size_t slot, const band_spec& band,
+        std::uint64_t time)
+    {
+        if (slot >= d_slots.size()) {
+            throw std::out_of_range("Band slot out of range");
+        }
+        if (band.bins() == 0 || band.bins() > band_reconstructor::NATIVE_FFT_SIZE) {
+            throw std::out_of_range("bins must be in the range [1, 2048]");
+        }
+        schedule(band_change { true, slot, band, time });
+    }
+
+    void
+    native_reconstruct_impl::close_band(std::size_t slot, std::uint64_t time)
+    {
+        if (slot >= d_slots.size()) {
+            throw std::out_of_range("Band slot out of range");
+        }
+        schedule(band_change { false, slot, band_spec(), time });
+    }
+
+    void
+    native_reconstruct_impl::schedule(const band_change& change)
+    {
+        std::lock_guard<std::mutex> lock(d_changes_mutex);
+        const auto position = std::upper_bound(d_changes.begin(), d_changes.end(),
+            change, [](const band_change& a, const band_change& b) {
+                return a.time < b.time;
+            });
+        d_changes.insert(position, change);
+    }
+
+    std::uint64_t
+    native_reconstruct_impl::next_change_time()
+    {
+        std::lock_guard<std::mutex> lock(d_changes_mutex);
+        return d_changes.empty() ? NO_CHANGE : d_changes.front().time;
+    }
+
+    void
+    native_reconstruct_impl::apply_changes(std::uint64_t time)
+    {
+        std::lock_guard<std::mutex> lock(d_changes_mutex);
+        while (!d_changes.empty() && d_changes.front().time <= time) {
+            const band_change change = d_changes.front();
+            d_changes.pop_front();
+            slot_output& slot = d_slots[change.slot];
+
+            if (d_reconstructor.has_band(change.slot)) {
+                // Keep the old band until it has written all its samples
+                slot.current.band = d_reconstructor.close_band(change.slot);
+                slot.closed.push_back(std::move(slot.current));
+                slot.current = band_output();
+            }
+            if (!change.open) {
+                continue;
+            }
+            try {
+                d_reconstructor.open_band(change.slot, change.band);
+            } catch (const std::exception& e) {
+                GR_LOG_WARN(d_logger, "Can't open band " << change.slot
+                    << ": " << e.what());
+                continue;
+            }
+            pmt::pmt_t value = pmt::make_dict();
+            value = pmt::dict_add(value, d_band_key, pmt::from_uint64(change.slot));
+            value = pmt::dict_add(value, d_time_key, pmt::from_uint64(time));
+            value = pmt::dict_add(value, d_frequency_key,
+                pmt::from_double(change.band.frequency()));
+            value = pmt::dict_add(value, d_bins_key,
+                pmt::from_uint64(change.band.bins()));
+            slot.current.base = 0;
+            slot.current.started = false;
+            slot.current.tag_open = true;
+            slot.current.open_value = value;
+        }
+    }
+
+    void
+    native_reconstruct_impl::handle_command(pmt::pmt_t message)
+    {
+        try {
+            if (!pmt::is_dict(message)) {
+                throw std::invalid_argument("command is not a dictionary");
+            }
+            const pmt::pmt_t cmd = pmt::dict_ref(message, d_cmd_key, pmt::PMT_NIL);
+            const pmt::pmt_t slot = pmt::dict_ref(message, d_band_key, pmt::PMT_NIL);
+            const pmt::pmt_t time = pmt::dict_ref(message, d_time_key,
+                pmt::from_uint64(0));
+            if (pmt::eqv(cmd, d_open_symbol)) {
+                const pmt::pmt_t frequency = pmt::dict_ref(message,
+                    d_frequency_key, pmt::PMT_NIL);
+                const long bins = pmt::to_long(pmt::dict_ref(message,
+                    d_bins_key, pmt::PMT_NIL));
+                if (bins < 1 || bins > band_reconstructor::NATIVE_FFT_SIZE) {
+                    throw std::out_of_range("bins must be in the range [1, 2048]");
+                }
+                open_band(pmt::to_uint64(slot),
+                    band_spec(pmt::to_double(frequency), bins),
+                    pmt::to_uint64(time));
+            } else if (pmt::eqv(cmd, d_close_symbol)) {
+                close_band(pmt::to_uint64(slot), pmt::to_uint64(time));
+            } else {
+                throw std::invalid_argument("cmd must be open or close");
+            }
+        } catch (const std::exception& e) {
+            GR_LOG_WARN(d_logger, "Ignoring command " << message << ": "
+                << e.what());
+        }
+    }
+
+    bool
+    native_reconstruct_impl::input_ended(int items_read) const
+    {
+        const gr::buffer_reader_sptr& reader = detail()->input(0);
+        // The upstream block writes its last items before it is marked
+        // done, so checking done() first means no items can be missed
+        return reader->done() && reader->items_available() - items_read < 2;
+    }
+
+    void
+    native_reconstruct_impl::forecast(int noutput_items, gr_vector_int &ninput_items_required)
+    {
+      // One compressed sample is two input items. If some reconstructed
+      // samples are waiting for output space, no input is needed to make
+      // progress. When the input has ended, one more call is needed to
+      // write the last window of each band.
+      const bool closed_pending = std::any_of(d_slots.begin(), d_slots.end(),
+          [](const slot_output& slot) { return !slot.closed.empty(); });
+      const bool finish_pending = !d_finished && detail()->input(0)->done();
+      ninput_items_required[0] = (closed_pending || d_reconstructor.outputs_full()
+          || finish_pending) ? 0 : 2;
+    }
+
+    void
+    native_reconstruct_impl::begin_slot_output(std::size_t i,
+        gr_complex* output,
+        int capacity)
+    {
+        slot_output& slot = d_slots[i];
+        while (!slot.closed.empty()) {
+            band_output& closed = slot.closed.front();
+            closed.band->begin_output(output + slot.written,
+                capacity - slot.written);
+            start_band(i, closed);
+            end_band_output(i, *closed.band, closed);
+            if (closed.band->pending() != 0) {
+                break;
+            }
+            slot.closed.pop_front();
+        }
+        if (!d_reconstructor.has_band(i)) {
+            return;
+        }
+        band_reconstructor& band = d_reconstructor.band(i);
+        if (slot.closed.empty()) {
+            band.begin_output(output + slot.written, capacity - slot.written);
+            start_band(i, slot.current);
+        } else {
+            // Keep everything pending until the closed bands are finished
+            band.begin_output(nullptr, 0);
+        }
+    }
+
+    void
+    native_reconstruct_impl::end_slot_output(std::size_t i)
+    {
+        if (d_reconstructor.has_band(i)) {
+            end_band_output(i, d_reconstructor.band(i), d_slots[i].current);
+        }
+    }
+
+    void
+    native_reconstruct_impl::start_band(std::size_t i, band_output& output)
+    {
+        if (output.started) {
+            return;
+        }
+        output.base = nitems_written(i) + d_slots[i].written;
+        output.started = true;
+    }
+
+    void
+    native_reconstruct_impl::end_band_output(std::size_t i,
+        band_reconstructor& band,
+        band_output& output)
+    {
+        slot_output& slot = d_slots[i];
+        // The position of the first sample written in this call
+        const std::uint64_t start = nitems_written(i) + slot.written;
+        if (d_tag_silence) {
+            for (const band_reconstructor::output_run& silence : band.silences()) {
+                add_item_tag(i, start + silence.offset,
+                    d_silence_key, pmt::from_uint64(silence.length));
+            }
+        }
+        const int produced = band.end_output();
+        slot.written += produced;
+        if (output.tag_open && produced != 0) {
+            add_item_tag(i, output.base, d_band_open_key, output.open_value);
+            output.tag_open = false;
+        }
+        if (d_tag_bursts && output.started) {
+            // Burst event samples count from the first sample of the band
+            d_burst_events.clear();
+            band.take_burst_events(start + produced - output.base,
+                d_burst_events);
+            for (const band_reconstructor::burst_event& event : d_burst_events) {
+                pmt::pmt_t value = pmt::make_dict();
+                value = pmt::dict_add(value, d_time_key,
+                    pmt::from_uint64(event.time));
+                value = pmt::dict_add(value, d_band_key, pmt::from_uint64(i));
+                add_item_tag(i, output.base + event.sample,
+                    event.start ? d_burst_start_key : d_burst_end_key, value);
+            }
+        }
+    }
+
+    int
+    native_reconstruct_impl::general_work(int noutput_items,
+        gr_vector_int &ninput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      const uint32_t* in = static_cast<const uint32_t*>(input_items[0]);
+
+      for (slot_output& slot : d_slots) {
+          slot.written = 0;
+      }
+
+      const int sample_count = ninput_items[0] / 2;
+      int samples_read = 0;
+      while (true) {
+          for (std::size_t i = 0; i < d_slots.size(); i++) {
+              begin_slot_output(i, static_cast<gr_complex*>(output_items[i]),
+                  noutput_items);
+          }
+
+          // Stop reading samples when a band has run out of output space, so
+          // that the amount of memory used for left-over samples stays
+          // bounded. Samples are decoded in batches so that little decoding
+          // is wasted when that happens.
+          //
+          // Also stop at the window boundary where a scheduled band change
+          // takes effect.
+          const std::uint64_t change_time = next_change_time();
+          bool change_due = false;
+          std::uint64_t window_time = 0;
+          bool full = d_reconstructor.outputs_full();
+          while (samples_read < sample_count && !full && !change_due) {
+              const int batch_size = std::min(sample_count - samples_read,
+                  DECODE_BATCH_SIZE);
+              decode_samples(in + samples_read * 2, batch_size, d_samples);
+              int batch_read = 0;
+              while (batch_read < batch_size && !full) {
+                  if (change_time != NO_CHANGE
+                      && d_reconstructor.peek_time(d_samples, batch_read, window_time)
+                      && window_time >= change_time
+                      && !(d_reconstructor.has_window()
+                          && window_time == d_reconstructor.last_time())) {
+                      // This sample starts a window at or after the change
+                      d_reconstructor.complete_window();
+                      change_due = true;
+                      break;
+                  }
+                  const bool window_finished = d_reconstructor.add_sample(
+                      d_samples, batch_read);
+                  batch_read++;
+                  if (window_finished) {
+                      full = d_reconstructor.outputs_full();
+                  }
+              }
+              samples_read += batch_read;
+          }
+          if (!change_due && !d_finished && samples_read == sample_count
+                  && input_ended(samples_read * 2)) {
+              // Nothing will complete the last window, so write it and the
+              // second half of the window before it
+              d_reconstructor.finish();
+              d_finished = true;
+          }
+
+          for (std::size_t i = 0; i < d_slots.size(); i++) {
+              end_slot_output(i);
+          }
+          if (!change_due) {
+              break;
+          }
+          apply_changes(window_time);
+      }
+
+      for (std::size_t i = 0; i < d_slots.size(); i++) {
+          produce(i, d_slots[i].written);
+      }
+      consume(0, samples_read * 2);
+
+      return WORK_CALLED_PRODUCE;
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
@@ -0,0 +1,200 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_NATIVE_RECONSTRUCT_IMPL_H
+#define INCLUDED_SPARSDR_NATIVE_RECONSTRUCT_IMPL_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <sparsdr/native_reconstruct.h>
+#include <sparsdr/sample_decoder.h>
+#include <pmt/pmt.h>
+#include "window_reconstructor.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    class native_reconstruct_impl : public native_reconstruct
+    {
+     private:
+      /*! \brief Maximum number of samples to decode at a time */
+      static const int DECODE_BATCH_SIZE = 4096;
+      /*! \brief The value of next_change_time() with no changes scheduled */
+      static const std::uint64_t NO_CHANGE = UINT64_MAX;
+
+      /*! \brief A scheduled change to a band slot */
+      struct band_change
+      {
+        /*! \brief True to open band, false to close the band in the slot */
+        bool open;
+        std::size_t slot;
+        band_spec band;
+        /*! \brief The expanded time when the change takes effect */
+        std::uint64_t time;
+      };
+
+      /*!
+       * \brief A band that writes to an output, and the position of its
+       * first sample in the output
+       */
+      struct band_output
+      {
+        /*! \brief The reconstructor, or null for the band in the slot */
+        std::unique_ptr<band_reconstructor> band;
+        /*! \brief The output item index of the first sample of the band */
+        std::uint64_t base = 0;
+        /*!
+         * \brief True if base is known (the band has been given space in an
+         * output buffer)
+         */
+        bool started = false;
+        /*! \brief True to tag the first sample with band_open */
+        bool tag_open = false;
+        /*! \brief The value of the band_open tag */
+        pmt::pmt_t open_value;
+      };
+
+      /*! \brief The output state of one band slot */
+      struct slot_output
+      {
+        /*!
+         * \brief Closed bands that still have samples to write, oldest
+         * first
+         */
+        std::deque<band_output> closed;
+        /*! \brief The band in the slot (band is always null here) */
+        band_output current;
+        /*! \brief The number of samples written in the current call */
+        int written = 0;
+      };
+
+      /*! \brief Assembles windows and reconstructs each band */
+      window_reconstructor d_reconstructor;
+      /*!
+       * \brief Output state for each slot
+       *
+       * Closed bands use the workspace in d_reconstructor, so this must be
+       * declared after it.
+       */
+      std::vector<slot_output> d_slots;
+
+      /*! \brief Protects d_changes */
+      std::mutex d_changes_mutex;
+      /*! \brief Scheduled changes, in time order */
+      std::deque<band_change> d_changes;
+
+      /*! \brief The current batch of decoded samples */
+      decoded_samples d_samples;
+      /*!
+       * \brief True after the input has ended and the last window of each
+       * band has been written
+       */
+      bool d_finished;
+
+      /*! \brief True to tag the start of each run of gap zeros */
+      bool d_tag_silence;
+      /*! \brief The key of silence tags */
+      pmt::pmt_t d_silence_key;
+      /*! \brief True to tag the start and end of each burst */
+      bool d_tag_bursts;
+      /*! \brief Keys of burst tags and their values */
+      pmt::pmt_t d_burst_start_key;
+      pmt::pmt_t d_burst_end_key;
+      pmt::pmt_t d_time_key;
+      pmt::pmt_t d_band_key;
+      /*! \brief Burst events taken from a band */
+      std::vector<band_reconstructor::burst_event> d_burst_events;
+      /*! \brief Keys of band_open tags and command messages */
+      pmt::pmt_t d_band_open_key;
+      pmt::pmt_t d_frequency_key;
+      pmt::pmt_t d_bins_key;
+      pmt::pmt_t d_cmd_key;
+      pmt::pmt_t d_open_symbol;
+      pmt::pmt_t d_close_symbol;
+      pmt::pmt_t d_command_port;
+
+      /*! \brief Adds a change to d_changes after other changes at its time */
+      void schedule(const band_change& change);
+      /*!
+       * \brief Returns the time of the first scheduled change, or
+       * UINT64_MAX if there are none
+       */
+      std::uint64_t next_change_time();
+      /*! \brief Applies all scheduled changes at or before a time */
+      void apply_changes(std::uint64_t time);
+      /*! \brief Handles a message on the command port */
+      void handle_command(pmt::pmt_t message);
+      /*!
+       * \brief Returns true if the upstream block is done and fewer than
+       * two input items (one sample) will be left after consuming
+       * items_read
+       */
+      bool input_ended(int items_read) const;
+
+      /*!
+       * \brief Writes the rest of the closed bands in a slot and sets the
+       * output buffer of the band in the slot
+       */
+      void begin_slot_output(std::size_t i, gr_complex* output, int capacity);
+      /*!
+       * \brief Stops writing the band in a slot to its output buffer and
+       * tags its samples
+       */
+      void end_slot_output(std::size_t i);
+      /*!
+       * \brief Records the position of the first sample of a band that has
+       * just been given space in an output buffer
+       */
+      void start_band(std::size_t i, band_output& output);
+      /*!
+       * \brief Ends output from a band in a slot, tags its samples (and its
+       * first sample if it was opened at run time), and adds the number of
+       * samples it wrote to the slot
+       */
+      void end_band_output(std::size_t i, band_reconstructor& band,
+          band_output& output);
+
+     public:
+      native_reconstruct_impl(const std::vector<band_spec>& bands,
+          bool fill_gaps,
+          bool tag_silence,
+          bool tag_bursts,
+          unsigned int max_bands);
+      ~native_reconstruct_impl();
+
+      void open_band(std::size_t slot, const band_spec& band,
+          std::uint64_t time);
+      void close_band(std::size_t slot, std::uint64_t time);
+
+      void forecast(int noutput_items, gr_vector_int &ninput_items_required);
+
+      int general_work(int noutput_items,
+           gr_vector_int &ninput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_NATIVE_RECONSTRUCT_IMPL_H */
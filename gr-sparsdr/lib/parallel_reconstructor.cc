@@ -0,0 +1,358 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "parallel_reconstructor.h"
+#include "time_expander.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    const std::size_t parallel_reconstructor::DEFAULT_CHUNK_SAMPLES;
+    const std::size_t parallel_reconstructor::DECODE_BATCH_SIZE;
+
+    parallel_reconstructor::parallel_reconstructor(const std::vector<band_spec>& bands,
+        const std::string& path,
+        unsigned int threads,
+        std::size_t chunk_samples)
+      : d_fd(-1),
+        d_map(nullptr),
+        d_map_size(0),
+        d_words(nullptr),
+        d_sample_count(0),
+        d_chunk_starts(),
+        d_bands(bands),
+        d_band_info_workspace(),
+        d_band_info(),
+        d_outputs(bands.size()),
+        d_has_time(false),
+        d_last_time(0),
+        d_done(false),
+        d_mutex(),
+        d_work_ready(),
+        d_result_ready(),
+        d_next_chunk(0),
+        d_next_stitch(0),
+        d_max_ahead(0),
+        d_results(),
+        d_stopping(false),
+        d_workers()
+    {
+        d_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (d_fd == -1) {
+            throw std::runtime_error("Can't open " + path + ": "
+                + std::strerror(errno));
+        }
+        struct stat file_status;
+        if (::fstat(d_fd, &file_status) != 0) {
+            ::close(d_fd);
+            throw std::runtime_error("Can't get the size of " + path + ": "
+                + std::strerror(errno));
+        }
+        d_map_size = file_status.st_size;
+        if (d_map_size != 0) {
+            d_map = ::mmap(nullptr, d_map_size, PROT_READ, MAP_PRIVATE, d_fd, 0);
+            if (d_map == MAP_FAILED) {
+                ::close(d_fd);
+                throw std::runtime_error("Can't map " + path + ": "
+                    + std::strerror(errno));
+            }
+            d_words = static_cast<const std::uint32_t*>(d_map);
+        }
+        // A partial sample at the end of the file is ignored
+        d_sample_count = d_map_size / (2 * sizeof(std::uint32_t));
+
+        // Split into chunks
+        chunk_samples = std::max<std::size_t>(chunk_samples, 1);
+        d_chunk_starts.push_back(0);
+        std::size_t split = next_window_start(chunk_samples);
+        while (split < d_sample_count) {
+            d_chunk_starts.push_back(split);
+            split = next_window_start(split + chunk_samples);
+        }
+        d_chunk_starts.push_back(d_sample_count);
+        if (d_sample_count == 0) {
+            d_chunk_starts.pop_back();
+        }
+
+        for (const band_spec& band : bands) {
+            d_band_info.emplace_back(new band_reconstructor(band,
+                d_band_info_workspace));
+        }
+        for (band_output& output : d_outputs) {
+            output.start = 0;
+            output.total = 0;
+            output.windows = 0;
+            output.have_last = false;
+            output.last_time = 0;
+        }
+
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = std::min<std::size_t>(threads, std::max<std::size_t>(chunk_count(), 1));
+        d_max_ahead = 2 * threads;
+        d_results.resize(chunk_count());
+        for (unsigned int i = 0; i < threads; i++) {
+            d_workers.emplace_back(&parallel_reconstructor::run_worker, this);
+        }
+    }
+
+    parallel_reconstructor::~parallel_reconstructor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            d_stopping = true;
+        }
+        d_work_ready.notify_all();
+        for (std::thread& worker : d_workers) {
+            worker.join();
+        }
+        if (d_map != nullptr) {
+            ::munmap(d_map, d_map_size);
+        }
+        ::close(d_fd);
+    }
+
+    std::size_t
+    parallel_reconstructor::next_window_start(std::size_t position) const
+    {
+        // Skip to the end of the window that contains the first data sample
+        // at or after position
+        bool have_time = false;
+        std::uint32_t window_time = 0;
+        decoded_samples samples;
+        for (std::size_t batch_start = position; batch_start < d_sample_count;
+                batch_start += DECODE_BATCH_SIZE) {
+            const std::size_t batch_size = std::min(d_sample_count - batch_start,
+                DECODE_BATCH_SIZE);
+            decode_samples(d_words + 2 * batch_start, batch_size, samples);
+            for (std::size_t i = 0; i < batch_size; i++) {
+                if (samples.is_average(i)) {
+                    continue;
+                }
+                if (!have_time) {
+                    window_time = samples.time[i];
+                    have_time = true;
+                } else if (samples.time[i] != window_time) {
+                    return batch_start + i;
+                }
+            }
+        }
+        return d_sample_count;
+    }
+
+    void
+    parallel_reconstructor::run_worker()
+    {
+        window_reconstructor reconstructor(d_bands);
+        decoded_samples samples;
+
+        std::unique_lock<std::mutex> lock(d_mutex);
+        while (true) {
+            d_work_ready.wait(lock, [this]() {
+                return d_stopping
+                    || d_next_chunk >= chunk_count()
+                    || d_next_chunk < d_next_stitch + d_max_ahead;
+            });
+            if (d_stopping || d_next_chunk >= chunk_count()) {
+                return;
+            }
+            const std::size_t chunk = d_next_chunk;
+            d_next_chunk++;
+            lock.unlock();
+
+            std::unique_ptr<chunk_result> result(new chunk_result());
+            reconstruct_chunk(chunk, reconstructor, samples, *result);
+
+            lock.lock();
+            d_results[chunk] = std::move(result);
+            d_result_ready.notify_all();
+        }
+    }
+
+    void
+    parallel_reconstructor::reconstruct_chunk(std::size_t chunk,
+        window_reconstructor& reconstructor,
+        decoded_samples& samples,
+        chunk_result& result) const
+    {
+        const std::size_t start = d_chunk_starts[chunk];
+        const std::size_t end = d_chunk_starts[chunk + 1];
+
+        // Start reading the chunk from the disk
+        const std::size_t page_size = ::sysconf(_SC_PAGESIZE);
+        const std::size_t byte_start = start * 2 * sizeof(std::uint32_t);
+        const std::size_t aligned_start = byte_start / page_size * page_size;
+        ::madvise(static_cast<char*>(d_map) + aligned_start,
+            end * 2 * sizeof(std::uint32_t) - aligned_start, MADV_WILLNEED);
+
+        reconstructor.reset();
+        result.has_time = false;
+        result.first_raw_time = 0;
+        for (std::size_t batch_start = start; batch_start < end;
+                batch_start += DECODE_BATCH_SIZE) {
+            const std::size_t batch_size = std::min(end - batch_start,
+                DECODE_BATCH_SIZE);
+            decode_samples(d_words + 2 * batch_start, batch_size, samples);
+            for (std::size_t i = 0; i < batch_size; i++) {
+                if (!result.has_time) {
+                    result.has_time = true;
+                    result.first_raw_time = samples.time[i];
+                }
+                reconstructor.add_sample(samples, i);
+            }
+        }
+        reconstructor.finish();
+        result.last_time = reconstructor.last_sample_time();
+
+        result.bands.resize(reconstructor.band_count());
+        for (std::size_t i = 0; i < reconstructor.band_count(); i++) {
+            band_reconstructor& band = reconstructor.band(i);
+            band_result& band_out = result.bands[i];
+            band_out.windows = band.windows_processed();
+            band_out.first_time = band.first_window_time();
+            band_out.last_time = band.last_window_time();
+            // With no output buffer, all samples are pending
+            band_out.samples.resize(band.pending());
+            band.begin_output(band_out.samples.data(), band_out.samples.size());
+            band.end_output();
+        }
+    }
+
+    bool
+    parallel_reconstructor::stitch_next()
+    {
+        std::unique_ptr<chunk_result> result;
+        {
+            std::unique_lock<std::mutex> lock(d_mutex);
+            if (d_next_stitch == chunk_count()) {
+                d_done = true;
+                return false;
+            }
+            d_result_ready.wait(lock, [this]() {
+                return d_results[d_next_stitch] != nullptr;
+            });
+            result = std::move(d_results[d_next_stitch]);
+            d_next_stitch++;
+        }
+        d_work_ready.notify_all();
+        stitch(*result);
+        return true;
+    }
+
+    void
+    parallel_reconstructor::stitch(const chunk_result& result)
+    {
+        if (!result.has_time) {
+            // Empty chunk
+            return;
+        }
+        // Each worker expands times starting from zero, so the first
+        // sample in the chunk has a relative time equal to its raw time.
+        // Expand that time as if it followed the last sample of the
+        // previous chunk.
+        std::uint64_t base = 0;
+        if (d_has_time) {
+            time_expander expander(d_last_time);
+            base = expander.expand(result.first_raw_time) - result.first_raw_time;
+        }
+        d_last_time = base + result.last_time;
+        d_has_time = true;
+
+        for (std::size_t i = 0; i < d_outputs.size(); i++) {
+            const band_result& band = result.bands[i];
+            band_output& output = d_outputs[i];
+            if (band.windows == 0) {
+                continue;
+            }
+            // If the first window of this chunk follows the last window of
+            // the previous chunk, the first half of the window overlaps
+            // the second half of the previous window
+            std::size_t overlap = 0;
+            if (output.have_last && base + band.first_time == output.last_time + 1) {
+                overlap = std::min<std::size_t>(d_band_info[i]->fft_size() / 2,
+                    band.samples.size());
+            }
+            const gr_complex correction = d_band_info[i]->correction(
+                output.windows, output.total - overlap);
+
+            gr_complex* const tail = output.samples.data()
+                + output.samples.size() - overlap;
+            for (std::size_t j = 0; j < overlap; j++) {
+                tail[j] += band.samples[j] * correction;
+            }
+            output.samples.reserve(output.samples.size() + band.samples.size() - overlap);
+            for (std::size_t j = overlap; j < band.samples.size(); j++) {
+                output.samples.push_back(band.samples[j] * correction);
+            }
+            output.total += band.samples.size() - overlap;
+            output.windows += band.windows;
+            output.last_time = base + band.last_time;
+            output.have_last = true;
+        }
+    }
+
+    std::size_t
+    parallel_reconstructor::available(std::size_t band) const
+    {
+        const band_output& output = d_outputs[band];
+        const std::size_t unread = output.samples.size() - output.start;
+        if (d_done || !output.have_last) {
+            return unread;
+        }
+        const std::size_t held = d_band_info[band]->fft_size() / 2;
+        return unread > held ? unread - held : 0;
+    }
+
+    std::size_t
+    parallel_reconstructor::read(std::size_t band, gr_complex* output_samples,
+        std::size_t capacity)
+    {
+        band_output& output = d_outputs[band];
+        const std::size_t count = std::min(capacity, available(band));
+        std::copy(output.samples.begin() + output.start,
+            output.samples.begin() + output.start + count, output_samples);
+        output.start += count;
+        // Remove samples that have been read once they take up most of
+        // the vector
+        if (output.start > output.samples.size() / 2) {
+            output.samples.erase(output.samples.begin(),
+                output.samples.begin() + output.start);
+            output.start = 0;
+        }
+        return count;
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
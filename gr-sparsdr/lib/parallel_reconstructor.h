@@ -0,0 +1,235 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_PARALLEL_RECONSTRUCTOR_H
+#define INCLUDED_SPARSDR_PARALLEL_RECONSTRUCTOR_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sparsdr/band_spec.h>
+#include <sparsdr/sample_decoder.h>
+#include <boost/noncopyable.hpp>
+#include "band_reconstructor.h"
+#include "window_reconstructor.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Reconstructs bands from a file of compressed samples using
+     * several threads
+     *
+     * The file is memory-mapped and split into chunks at window boundaries
+     * (where the time of the data samples changes). A pool of worker threads
+     * reconstructs each chunk independently, with times relative to the
+     * start of the chunk. The chunks are then stitched together in order:
+     * times are expanded across chunk boundaries, the last half-window of
+     * one chunk is overlapped and added with the first half-window of the
+     * next chunk when the windows are adjacent, and the phase and frequency
+     * corrections are adjusted to continue from the previous chunk.
+     *
+     * Like native_reconstruct at the end of its input, this finishes the
+     * last window in the file.
+     */
+    class parallel_reconstructor : public boost::noncopyable
+    {
+    public:
+      /*! \brief The default approximate number of samples in each chunk */
+      static const std::size_t DEFAULT_CHUNK_SAMPLES = 1 << 20;
+
+      /*!
+       * \brief Opens and maps a file and starts the worker threads
+       *
+       * \param bands the bands to reconstruct
+       * \param path the file of compressed samples
+       * \param threads the number of worker threads, or 0 to use one for
+       * each processor
+       * \param chunk_samples the approximate number of samples in each
+       * chunk
+       *
+       * \throws std::runtime_error if the file can't be opened or mapped
+       */
+      parallel_reconstructor(const std::vector<band_spec>& bands,
+          const std::string& path,
+          unsigned int threads,
+          std::size_t chunk_samples = DEFAULT_CHUNK_SAMPLES);
+      /*! \brief Stops the worker threads and unmaps the file */
+      ~parallel_reconstructor();
+
+      /*! \brief Returns the number of chunks the file was split into */
+      inline std::size_t chunk_count() const { return d_chunk_starts.size() - 1; }
+
+      /*!
+       * \brief Waits for the next chunk to be reconstructed and adds its
+       * samples to the output of each band
+       *
+       * \return false if all chunks have already been stitched
+       */
+      bool stitch_next();
+
+      /*!
+       * \brief Returns true if all chunks have been stitched, so all
+       * remaining samples are available
+       */
+      inline bool done() const { return d_done; }
+
+      /*!
+       * \brief Returns the number of samples for a band that can be read
+       *
+       * The last half-window of the last chunk stitched is not available
+       * until the next chunk is stitched, because the next chunk may need
+       * to be added to it.
+       */
+      std::size_t available(std::size_t band) const;
+
+      /*!
+       * \brief Copies up to capacity available samples for a band
+       *
+       * \return the number of samples copied
+       */
+      std::size_t read(std::size_t band, gr_complex* output, std::size_t capacity);
+
+    private:
+      /*! \brief Maximum number of samples to decode at a time */
+      static const std::size_t DECODE_BATCH_SIZE = 4096;
+
+      /*! \brief The output of one band from one chunk */
+      struct band_result
+      {
+        std::vector<gr_complex> samples;
+        std::uint64_t windows;
+        /*! \brief Time of the first window, relative to the chunk */
+        std::uint64_t first_time;
+        /*! \brief Time of the last window, relative to the chunk */
+        std::uint64_t last_time;
+      };
+
+      /*! \brief The output of one chunk */
+      struct chunk_result
+      {
+        /*! \brief True if the chunk has any samples, data or average */
+        bool has_time;
+        /*! \brief The unexpanded time of the first sample */
+        std::uint32_t first_raw_time;
+        /*! \brief The time of the last sample, relative to the chunk */
+        std::uint64_t last_time;
+        std::vector<band_result> bands;
+      };
+
+      /*! \brief Stitched samples for one band */
+      struct band_output
+      {
+        /*! \brief Samples not yet read */
+        std::vector<gr_complex> samples;
+        /*! \brief The index in samples of the first sample not yet read */
+        std::size_t start;
+        /*! \brief The number of samples stitched so far */
+        std::uint64_t total;
+        /*! \brief The number of windows stitched so far */
+        std::uint64_t windows;
+        /*! \brief True if last_time is valid */
+        bool have_last;
+        /*! \brief The expanded time of the last window stitched */
+        std::uint64_t last_time;
+      };
+
+      /*! \brief The file descriptor of the input file */
+      int d_fd;
+      /*! \brief The mapped file, or null if it is empty */
+      void* d_map;
+      /*! \brief The size of the mapping in bytes */
+      std::size_t d_map_size;
+      /*! \brief The samples in the file, two words each */
+      const std::uint32_t* d_words;
+      /*! \brief The number of complete samples in the file */
+      std::size_t d_sample_count;
+      /*!
+       * \brief The index of the first sample in each chunk, followed by
+       * d_sample_count
+       */
+      std::vector<std::size_t> d_chunk_starts;
+
+      /*! \brief The bands to reconstruct */
+      std::vector<band_spec> d_bands;
+      /*! \brief Workspace for d_band_info */
+      reconstruct_workspace d_band_info_workspace;
+      /*!
+       * \brief One reconstructor for each band, used only to calculate
+       * corrections and overlap sizes
+       */
+      std::vector<std::unique_ptr<band_reconstructor>> d_band_info;
+      /*! \brief Stitched output for each band */
+      std::vector<band_output> d_outputs;
+      /*! \brief True if any samples have been stitched */
+      bool d_has_time;
+      /*!
+       * \brief The expanded time of the last sample stitched, data or
+       * average
+       */
+      std::uint64_t d_last_time;
+      /*! \brief True if all chunks have been stitched */
+      bool d_done;
+
+      /*! \brief Protects the fields below */
+      std::mutex d_mutex;
+      /*! \brief Notified when a chunk may be started or workers should stop */
+      std::condition_variable d_work_ready;
+      /*! \brief Notified when a chunk result is ready */
+      std::condition_variable d_result_ready;
+      /*! \brief The index of the next chunk to give to a worker */
+      std::size_t d_next_chunk;
+      /*! \brief The index of the next chunk to stitch */
+      std::size_t d_next_stitch;
+      /*!
+       * \brief The maximum number of chunks ahead of d_next_stitch that
+       * workers may reconstruct, which limits memory use
+       */
+      std::size_t d_max_ahead;
+      /*! \brief Results of chunks that have not been stitched yet */
+      std::vector<std::unique_ptr<chunk_result>> d_results;
+      /*! \brief True when the workers should exit */
+      bool d_stopping;
+      std::vector<std::thread> d_workers;
+
+      /*!
+       * \brief Returns the index of the first data sample at or after
+       * position that starts a new window, or d_sample_count
+       */
+      std::size_t next_window_start(std::size_t position) const;
+
+      void run_worker();
+
+      void reconstruct_chunk(std::size_t chunk,
+          window_reconstructor& reconstructor,
+          decoded_samples& samples,
+          chunk_result& result) const;
+
+      void stitch(const chunk_result& result);
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_PARALLEL_RECONSTRUCTOR_H */
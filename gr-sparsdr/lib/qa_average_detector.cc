@@ -0,0 +1,135 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <sparsdr/average_detector.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    namespace {
+
+      /*! \brief One in this many samples is an average */
+      const std::uint64_t AVERAGE_PERIOD = 4;
+
+      /*!
+       * \brief Returns the compressed words of count samples, starting
+       * with sample number first
+       *
+       * Sample n has hardware time n (truncated to 20 bits) and is an
+       * average if n is a multiple of AVERAGE_PERIOD.
+       */
+      std::vector<std::uint32_t> make_samples(std::uint64_t first,
+          std::uint64_t count)
+      {
+          std::vector<std::uint32_t> words;
+          for (std::uint64_t n = first; n != first + count; n++) {
+              const std::uint32_t time = n & 0xfffff;
+              const bool average = n % AVERAGE_PERIOD == 0;
+              words.push_back(((time & 0xffff) << 16)
+                  | (average ? (1u << 15) : 0)
+                  | (static_cast<std::uint32_t>(n % 2048) << 4)
+                  | ((time >> 16) & 0xf));
+              words.push_back(0);
+          }
+          return words;
+      }
+
+      /*!
+       * \brief Checks that a snapshot describes exactly the first
+       * averages + data_samples samples from make_samples()
+       *
+       * Returns false if the snapshot mixes values from different calls
+       * to work().
+       */
+      bool consistent(const average_detector_stats& stats)
+      {
+          const std::uint64_t samples = stats.averages + stats.data_samples;
+          if (samples == 0) {
+              return stats.last_hardware_time == 0;
+          }
+          return stats.averages == (samples + AVERAGE_PERIOD - 1) / AVERAGE_PERIOD
+              && stats.last_hardware_time == ((samples - 1) & 0xfffff);
+      }
+
+    } // namespace
+
+    BOOST_AUTO_TEST_CASE(t_stats_concurrent_readers)
+    {
+        // Without an average interval, work() does not need a flow graph
+        const average_detector::sptr detector = average_detector::make();
+        const std::uint64_t total_samples = 1 << 23;
+
+        std::atomic<bool> writing(true);
+        std::atomic<std::uint64_t> inconsistent(0);
+        std::atomic<std::uint64_t> snapshots(0);
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 3; i++) {
+            readers.emplace_back([&] {
+                average_detector_stats previous = detector->stats();
+                while (writing.load()) {
+                    const average_detector_stats stats = detector->stats();
+                    if (!consistent(stats)
+                        || stats.averages < previous.averages
+                        || stats.data_samples < previous.data_samples) {
+                        inconsistent++;
+                    }
+                    previous = stats;
+                    snapshots++;
+                }
+            });
+        }
+
+        gr_vector_void_star outputs;
+        std::uint64_t written = 0;
+        std::uint64_t chunk_size = 1;
+        while (written < total_samples) {
+            const std::uint64_t count = std::min(chunk_size,
+                total_samples - written);
+            const std::vector<std::uint32_t> words = make_samples(written, count);
+            gr_vector_const_void_star inputs(1, words.data());
+            detector->work(static_cast<int>(words.size()), inputs, outputs);
+            written += count;
+            // Sizes that don't divide AVERAGE_PERIOD change the number of
+            // averages in each call
+            chunk_size = chunk_size % 61 + 3;
+        }
+        writing.store(false);
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+
+        BOOST_CHECK_EQUAL(inconsistent.load(), 0u);
+        BOOST_CHECK(snapshots.load() > 0);
+        const average_detector_stats stats = detector->stats();
+        BOOST_CHECK_EQUAL(stats.averages + stats.data_samples, total_samples);
+        BOOST_CHECK(consistent(stats));
+        BOOST_CHECK_EQUAL(stats.overflows, 0u);
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
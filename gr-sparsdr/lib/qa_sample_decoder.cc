@@ -0,0 +1,215 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <sparsdr/sample_decoder.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    namespace {
+
+      typedef std::pair<std::string, detail::decode_function> named_decoder;
+
+      /*!
+       * \brief Returns the vectorized decode functions that this processor
+       * can run
+       */
+      std::vector<named_decoder> vector_decoders()
+      {
+          std::vector<named_decoder> decoders;
+#if defined(SPARSDR_DECODER_X86)
+          __builtin_cpu_init();
+          if (__builtin_cpu_supports("sse4.1")) {
+              decoders.push_back(named_decoder("sse4.1", &detail::decode_sse41));
+          }
+          if (__builtin_cpu_supports("avx2")) {
+              decoders.push_back(named_decoder("avx2", &detail::decode_avx2));
+          }
+#elif defined(SPARSDR_DECODER_NEON)
+          decoders.push_back(named_decoder("neon", &detail::decode_neon));
+#endif
+          return decoders;
+      }
+
+      /*! \brief Appends the two words of a compressed sample to words */
+      void encode(std::vector<std::uint32_t>& words, std::uint32_t time,
+          std::uint16_t index, bool average, std::uint32_t payload)
+      {
+          words.push_back(((time & 0xffff) << 16)
+              | (average ? (1u << 15) : 0)
+              | (static_cast<std::uint32_t>(index) << 4)
+              | ((time >> 16) & 0xf));
+          words.push_back(payload);
+      }
+
+      /*!
+       * \brief Returns samples with the largest and smallest field values,
+       * including a 20-bit time that wraps around
+       */
+      std::vector<std::uint32_t> edge_words()
+      {
+          const std::uint32_t times[] = { 0, 1, 0xffff, 0x10000, 0xffffe, 0xfffff, 0 };
+          const std::uint16_t indexes[] = { 0, 1, 1023, 1024, 2046, 2047 };
+          const std::uint32_t payloads[] = { 0, 1, 0x7fff7fff, 0x80008000,
+              0x80007fff, 0xffffffff, 0x0000ffff, 0xffff0000 };
+          std::vector<std::uint32_t> words;
+          for (const std::uint32_t time : times) {
+              for (const std::uint16_t index : indexes) {
+                  for (const std::uint32_t payload : payloads) {
+                      encode(words, time, index, false, payload);
+                      encode(words, time, index, true, payload);
+                  }
+              }
+          }
+          return words;
+      }
+
+      /*! \brief Returns random words, including header bits 15:4 */
+      std::vector<std::uint32_t> random_words(std::size_t samples)
+      {
+          std::mt19937 random(20200101);
+          std::vector<std::uint32_t> words(2 * samples);
+          for (std::uint32_t& word : words) {
+              word = random();
+          }
+          return words;
+      }
+
+      /*!
+       * \brief Checks that a decode function gives the same results as
+       * decode_scalar for samples [begin, end)
+       */
+      void check_matches_scalar(const named_decoder& decoder,
+          const std::vector<std::uint32_t>& words,
+          std::size_t begin,
+          std::size_t end)
+      {
+          BOOST_TEST_MESSAGE(decoder.first << ": samples " << begin << " to " << end);
+          const std::size_t count = words.size() / 2;
+          decoded_samples expected;
+          expected.resize(count);
+          detail::decode_scalar(words.data(), begin, end, expected);
+          decoded_samples actual;
+          actual.resize(count);
+          decoder.second(words.data(), begin, end, actual);
+
+          BOOST_CHECK_EQUAL_COLLECTIONS(actual.index.begin() + begin,
+              actual.index.begin() + end,
+              expected.index.begin() + begin, expected.index.begin() + end);
+          BOOST_CHECK_EQUAL_COLLECTIONS(actual.time.begin() + begin,
+              actual.time.begin() + end,
+              expected.time.begin() + begin, expected.time.begin() + end);
+          BOOST_CHECK_EQUAL_COLLECTIONS(actual.flags.begin() + begin,
+              actual.flags.begin() + end,
+              expected.flags.begin() + begin, expected.flags.begin() + end);
+          BOOST_CHECK_EQUAL_COLLECTIONS(actual.real.begin() + begin,
+              actual.real.begin() + end,
+              expected.real.begin() + begin, expected.real.begin() + end);
+          BOOST_CHECK_EQUAL_COLLECTIONS(actual.imag.begin() + begin,
+              actual.imag.begin() + end,
+              expected.imag.begin() + begin, expected.imag.begin() + end);
+          BOOST_CHECK_EQUAL_COLLECTIONS(actual.magnitude.begin() + begin,
+              actual.magnitude.begin() + end,
+              expected.magnitude.begin() + begin, expected.magnitude.begin() + end);
+      }
+
+    }
+
+    BOOST_AUTO_TEST_CASE(t_scalar_edge_values)
+    {
+        std::vector<std::uint32_t> words;
+        encode(words, 0xfffff, 2047, true, 0x12345678);
+        encode(words, 0x10000, 0, false, 0x80007fff);
+        decoded_samples samples;
+        samples.resize(2);
+        detail::decode_scalar(words.data(), 0, 2, samples);
+
+        BOOST_CHECK_EQUAL(samples.index[0], 2047);
+        BOOST_CHECK_EQUAL(samples.time[0], 0xfffffu);
+        BOOST_CHECK(samples.is_average(0));
+        // The halves of an average magnitude are swapped
+        BOOST_CHECK_EQUAL(samples.magnitude[0], 0x56781234u);
+
+        BOOST_CHECK_EQUAL(samples.index[1], 0);
+        BOOST_CHECK_EQUAL(samples.time[1], 0x10000u);
+        BOOST_CHECK(!samples.is_average(1));
+        BOOST_CHECK_EQUAL(samples.real[1], 32767);
+        BOOST_CHECK_EQUAL(samples.imag[1], -32768);
+    }
+
+    BOOST_AUTO_TEST_CASE(t_vector_edge_values)
+    {
+        const std::vector<std::uint32_t> words = edge_words();
+        for (const named_decoder& decoder : vector_decoders()) {
+            check_matches_scalar(decoder, words, 0, words.size() / 2);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(t_vector_random)
+    {
+        // Not a multiple of 8, so the scalar tail runs too
+        const std::vector<std::uint32_t> words = random_words(4099);
+        for (const named_decoder& decoder : vector_decoders()) {
+            check_matches_scalar(decoder, words, 0, words.size() / 2);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(t_vector_unaligned_ranges)
+    {
+        const std::vector<std::uint32_t> words = random_words(64);
+        for (const named_decoder& decoder : vector_decoders()) {
+            for (std::size_t begin = 0; begin < 9; begin++) {
+                for (std::size_t end = begin; end <= 32; end++) {
+                    check_matches_scalar(decoder, words, begin, end);
+                }
+            }
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(t_selected_decoder)
+    {
+        const std::vector<std::uint32_t> words = random_words(1000);
+        decoded_samples expected;
+        expected.resize(1000);
+        detail::decode_scalar(words.data(), 0, 1000, expected);
+        decoded_samples actual;
+        decode_samples(words.data(), 1000, actual);
+        BOOST_TEST_MESSAGE("Selected decoder: " << sample_decoder_name());
+        BOOST_CHECK_EQUAL_COLLECTIONS(actual.time.begin(), actual.time.end(),
+            expected.time.begin(), expected.time.end());
+        BOOST_CHECK_EQUAL_COLLECTIONS(actual.index.begin(), actual.index.end(),
+            expected.index.begin(), expected.index.end());
+        BOOST_CHECK_EQUAL_COLLECTIONS(actual.flags.begin(), actual.flags.end(),
+            expected.flags.begin(), expected.flags.end());
+        BOOST_CHECK_EQUAL_COLLECTIONS(actual.magnitude.begin(), actual.magnitude.end(),
+            expected.magnitude.begin(), expected.magnitude.end());
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
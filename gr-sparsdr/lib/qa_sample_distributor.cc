@@ -0,0 +1,499 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <gnuradio/block_detail.h>
+#include <gnuradio/buffer.h>
+#include <gnuradio/top_block.h>
+#include <gnuradio/blocks/vector_sink.h>
+#include <gnuradio/blocks/vector_source.h>
+#include <sparsdr/sample_distributor.h>
+
+namespace gr {
+  namespace sparsdr {
+
+    namespace {
+
+      /*!
+       * \brief A zero-copy decoder that records the items it receives
+       * and the inputs it is released from
+       */
+      class collecting_decoder : public zero_copy_decoder
+      {
+      public:
+        /*! \brief The items received, in order */
+        std::vector<float> d_items;
+        /*! \brief For each item in d_items, the input it came from */
+        std::vector<int> d_inputs;
+        /*! \brief The inputs passed to release(), in order */
+        std::vector<int> d_releases;
+        /*!
+         * \brief The maximum number of items to accept in each call to
+         * decode()
+         *
+         * Setting this to 0 stalls the decoder while it stays assigned.
+         */
+        int d_max_items;
+
+        /*!
+         * \param max_items the maximum number of items to accept in each
+         * call to decode()
+         */
+        explicit collecting_decoder(int max_items = std::numeric_limits<int>::max())
+          : d_items(), d_inputs(), d_releases(), d_max_items(max_items)
+        {}
+
+        virtual int decode(int input, const void* items, int item_count) override
+        {
+            const int count = std::min(item_count, d_max_items);
+            const float* floats = static_cast<const float*>(items);
+            d_items.insert(d_items.end(), floats, floats + count);
+            d_inputs.insert(d_inputs.end(), count, input);
+            return count;
+        }
+
+        virtual void release(int input) override
+        {
+            d_releases.push_back(input);
+        }
+
+        /*! \brief Returns the items received from one input, in order */
+        std::vector<float> items_from(int input) const
+        {
+            std::vector<float> items;
+            for (std::size_t i = 0; i < d_items.size(); i++) {
+                if (d_inputs[i] == input) {
+                    items.push_back(d_items[i]);
+                }
+            }
+            return items;
+        }
+      };
+
+      /*!
+       * \brief A zero-copy decoder that waits in decode() until another
+       * decoder sharing the same counter is also in decode()
+       */
+      class rendezvous_decoder : public zero_copy_decoder
+      {
+      public:
+        /*! \brief True if another decoder was in decode() at the same time */
+        bool d_met;
+        /*! \brief The thread that called decode() */
+        std::thread::id d_thread;
+
+        explicit rendezvous_decoder(std::atomic<int>& arrivals)
+          : d_met(false), d_thread(), d_arrivals(arrivals)
+        {}
+
+        virtual int decode(int input, const void* items, int item_count) override
+        {
+            d_thread = std::this_thread::get_id();
+            d_arrivals++;
+            const auto deadline = std::chrono::steady_clock::now()
+                + std::chrono::seconds(1);
+            while (d_arrivals.load() < 2 && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::yield();
+            }
+            d_met = d_arrivals.load() >= 2;
+            return item_count;
+        }
+
+      private:
+        std::atomic<int>& d_arrivals;
+      };
+
+      std::vector<float> counting_items(float start, std::size_t count)
+      {
+          std::vector<float> items;
+          for (std::size_t i = 0; i < count; i++) {
+              items.push_back(start + i);
+          }
+          return items;
+      }
+
+      /*! \brief Returns a burst_end tag for an item */
+      gr::tag_t release_tag(std::uint64_t offset)
+      {
+          gr::tag_t tag;
+          tag.offset = offset;
+          tag.key = pmt::intern("burst_end");
+          tag.value = pmt::PMT_T;
+          return tag;
+      }
+
+      /*!
+       * \brief A sample_distributor with buffers on its inputs and no
+       * outputs, so that a test can call general_work() directly and
+       * control which items each call sees
+       */
+      class direct_distributor
+      {
+      public:
+        sample_distributor::sptr d_distributor;
+
+        direct_distributor(std::size_t inputs,
+            sample_distributor::allocation_policy policy,
+            int max_queue_items = 0)
+          : d_distributor(sample_distributor::make(sizeof(float), policy,
+                max_queue_items)),
+            d_buffers()
+        {
+            gr::block_detail_sptr detail = gr::make_block_detail(inputs, 0);
+            for (std::size_t i = 0; i < inputs; i++) {
+                gr::buffer_sptr buffer = gr::make_buffer(4096, sizeof(float));
+                detail->set_input(i, gr::buffer_add_reader(buffer, 0, d_distributor));
+                d_buffers.push_back(buffer);
+            }
+            d_distributor->set_detail(detail);
+        }
+
+        /*!
+         * \brief Writes items to an input, with a burst_end tag on the
+         * last item if release is true
+         */
+        void write(int input, const std::vector<float>& items, bool release)
+        {
+            const gr::buffer_sptr& buffer = d_buffers[input];
+            BOOST_REQUIRE_GE(buffer->space_available(), static_cast<int>(items.size()));
+            if (release) {
+                buffer->add_item_tag(release_tag(buffer->nitems_written()
+                    + items.size() - 1));
+            }
+            std::memcpy(buffer->write_pointer(), items.data(),
+                items.size() * sizeof(float));
+            buffer->update_write_pointer(items.size());
+        }
+
+        /*! \brief Calls general_work() once with all items available */
+        void work()
+        {
+            const gr::block_detail_sptr detail = d_distributor->detail();
+            gr_vector_int ninput_items;
+            gr_vector_const_void_star input_items;
+            for (std::size_t i = 0; i < d_buffers.size(); i++) {
+                ninput_items.push_back(detail->input(i)->items_available());
+                input_items.push_back(detail->input(i)->read_pointer());
+            }
+            gr_vector_void_star output_items;
+            d_distributor->general_work(4096, ninput_items, input_items, output_items);
+        }
+
+        /*! \brief Returns the number of unread items in an input buffer */
+        int available(int input)
+        {
+            return d_distributor->detail()->input(input)->items_available();
+        }
+
+      private:
+        std::vector<gr::buffer_sptr> d_buffers;
+      };
+
+      /*!
+       * \brief Stalls the decoder on a holder input, makes first and then
+       * second wait for it, and then lets the holder release it
+       *
+       * \return the input that got the decoder after the holder
+       */
+      int contend(direct_distributor& distributor, collecting_decoder& decoder,
+          int holder, int first, int second)
+      {
+          decoder.d_max_items = 0;
+          distributor.write(holder, counting_items(0, 10), true);
+          distributor.work();
+          distributor.write(first, counting_items(100, 10), false);
+          distributor.work();
+          distributor.write(second, counting_items(200, 10), false);
+          distributor.work();
+          // The holder sends its burst and releases the decoder, and one of
+          // the waiting inputs gets it in the same call
+          decoder.d_max_items = std::numeric_limits<int>::max();
+          distributor.work();
+
+          BOOST_REQUIRE_EQUAL(decoder.d_items.size(), 20u);
+          BOOST_REQUIRE_EQUAL(decoder.d_releases.size(), 1u);
+          BOOST_CHECK_EQUAL(decoder.d_releases.front(), holder);
+          BOOST_CHECK_EQUAL(decoder.items_from(holder).size(), 10u);
+          return decoder.d_inputs.back();
+      }
+
+    } // namespace
+
+    BOOST_AUTO_TEST_CASE(t_zero_copy_receives_items)
+    {
+        const std::vector<float> items = counting_items(0, 100);
+        auto top_block = gr::make_top_block("qa_sample_distributor");
+        auto source = gr::blocks::vector_source_f::make(items, false, 1,
+            std::vector<gr::tag_t>{ release_tag(items.size() - 1) });
+        auto distributor = sample_distributor::make(sizeof(float));
+        auto decoder = boost::make_shared<collecting_decoder>();
+        distributor->add_zero_copy_decoder(decoder);
+        // The distributor has no outputs, so the zero-copy decoder is the
+        // only place the items can go
+        top_block->connect(source, 0, distributor, 0);
+        top_block->run();
+
+        BOOST_CHECK_EQUAL_COLLECTIONS(items.begin(), items.end(),
+            decoder->d_items.begin(), decoder->d_items.end());
+        BOOST_CHECK(std::all_of(decoder->d_inputs.begin(), decoder->d_inputs.end(),
+            [](int input) { return input == 0; }));
+        // The tag on the last item releases the decoder
+        BOOST_REQUIRE_EQUAL(decoder->d_releases.size(), 1u);
+        BOOST_CHECK_EQUAL(decoder->d_releases.front(), 0);
+        const sample_distributor_stats stats = distributor->stats();
+        BOOST_CHECK_EQUAL(stats.assignments, 1u);
+        BOOST_CHECK_EQUAL(stats.releases, 1u);
+    }
+
+    BOOST_AUTO_TEST_CASE(t_zero_copy_partial_decode)
+    {
+        // Items that the decoder does not accept are offered again, in
+        // order and without duplicates
+        const std::vector<float> items = counting_items(0, 1000);
+        auto top_block = gr::make_top_block("qa_sample_distributor");
+        auto source = gr::blocks::vector_source_f::make(items);
+        auto distributor = sample_distributor::make(sizeof(float));
+        auto decoder = boost::make_shared<collecting_decoder>(7);
+        distributor->add_zero_copy_decoder(decoder);
+        top_block->connect(source, 0, distributor, 0);
+        top_block->run();
+
+        BOOST_CHECK_EQUAL_COLLECTIONS(items.begin(), items.end(),
+            decoder->d_items.begin(), decoder->d_items.end());
+    }
+
+    BOOST_AUTO_TEST_CASE(t_zero_copy_preferred_over_output)
+    {
+        const std::vector<float> items = counting_items(0, 100);
+        auto top_block = gr::make_top_block("qa_sample_distributor");
+        auto source = gr::blocks::vector_source_f::make(items);
+        auto distributor = sample_distributor::make(sizeof(float));
+        auto decoder = boost::make_shared<collecting_decoder>();
+        distributor->add_zero_copy_decoder(decoder);
+        auto sink = gr::blocks::vector_sink_f::make();
+        top_block->connect(source, 0, distributor, 0);
+        top_block->connect(distributor, 0, sink, 0);
+        top_block->run();
+
+        // With one input, the zero-copy decoder is always free when the
+        // input needs a decoder
+        BOOST_CHECK_EQUAL_COLLECTIONS(items.begin(), items.end(),
+            decoder->d_items.begin(), decoder->d_items.end());
+        BOOST_CHECK(sink->data().empty());
+    }
+
+    BOOST_AUTO_TEST_CASE(t_zero_copy_released_between_bursts)
+    {
+        // Two inputs with one burst each share one zero-copy decoder. Each
+        // burst ends with a release tag, so the decoder moves to the other
+        // input and every item arrives, with one burst after the other.
+        const std::vector<float> first = counting_items(0, 50);
+        const std::vector<float> second = counting_items(1000, 30);
+        auto top_block = gr::make_top_block("qa_sample_distributor");
+        auto source0 = gr::blocks::vector_source_f::make(first, false, 1,
+            std::vector<gr::tag_t>{ release_tag(first.size() - 1) });
+        auto source1 = gr::blocks::vector_source_f::make(second, false, 1,
+            std::vector<gr::tag_t>{ release_tag(second.size() - 1) });
+        auto distributor = sample_distributor::make(sizeof(float));
+        auto decoder = boost::make_shared<collecting_decoder>();
+        distributor->add_zero_copy_decoder(decoder);
+        top_block->connect(source0, 0, distributor, 0);
+        top_block->connect(source1, 0, distributor, 1);
+        top_block->run();
+
+        BOOST_REQUIRE_EQUAL(decoder->d_items.size(), first.size() + second.size());
+        BOOST_REQUIRE_EQUAL(decoder->d_releases.size(), 2u);
+        // The decoder finishes one burst before it starts the other
+        const int first_input = decoder->d_inputs.front();
+        const std::vector<float>& first_burst = first_input == 0 ? first : second;
+        const std::vector<float>& second_burst = first_input == 0 ? second : first;
+        BOOST_CHECK_EQUAL_COLLECTIONS(first_burst.begin(), first_burst.end(),
+            decoder->d_items.begin(), decoder->d_items.begin() + first_burst.size());
+        BOOST_CHECK_EQUAL_COLLECTIONS(second_burst.begin(), second_burst.end(),
+            decoder->d_items.begin() + first_burst.size(), decoder->d_items.end());
+        BOOST_CHECK_EQUAL(decoder->d_releases[0], first_input);
+        BOOST_CHECK_EQUAL(decoder->d_releases[1], 1 - first_input);
+    }
+
+    BOOST_AUTO_TEST_CASE(t_first_come)
+    {
+        // The input that started waiting first gets the decoder, even with
+        // a higher index
+        direct_distributor distributor(3, sample_distributor::FIRST_COME);
+        auto decoder = boost::make_shared<collecting_decoder>();
+        distributor.d_distributor->add_zero_copy_decoder(decoder);
+        BOOST_CHECK_EQUAL(contend(distributor, *decoder, 1, 2, 0), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(t_round_robin)
+    {
+        // After input 1, input 3 comes before input 0 even though input 0
+        // started waiting first
+        direct_distributor distributor(4, sample_distributor::ROUND_ROBIN);
+        auto decoder = boost::make_shared<collecting_decoder>();
+        distributor.d_distributor->add_zero_copy_decoder(decoder);
+        BOOST_CHECK_EQUAL(contend(distributor, *decoder, 1, 0, 3), 3);
+    }
+
+    BOOST_AUTO_TEST_CASE(t_weighted_priority)
+    {
+        // The input with the higher priority goes first even though it
+        // started waiting later
+        direct_distributor distributor(3, sample_distributor::WEIGHTED_PRIORITY);
+        auto decoder = boost::make_shared<collecting_decoder>();
+        distributor.d_distributor->add_zero_copy_decoder(decoder);
+        distributor.d_distributor->set_priority(2, 2.0f);
+        BOOST_CHECK_EQUAL(contend(distributor, *decoder, 1, 0, 2), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(t_preempt_oldest_idle)
+    {
+        direct_distributor distributor(2, sample_distributor::PREEMPT_OLDEST_IDLE);
+        auto decoder = boost::make_shared<collecting_decoder>();
+        distributor.d_distributor->add_zero_copy_decoder(decoder);
+
+        distributor.write(0, counting_items(0, 10), false);
+        distributor.work();
+        // Input 0 has no items, but keeps its decoder
+        distributor.work();
+        BOOST_CHECK(decoder->d_releases.empty());
+
+        // Input 1 needs a decoder, so it takes the decoder from idle input 0
+        distributor.write(1, counting_items(100, 10), false);
+        distributor.work();
+        const std::vector<float> expected = counting_items(100, 10);
+        const std::vector<float> received = decoder->items_from(1);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+            received.begin(), received.end());
+        BOOST_REQUIRE_EQUAL(decoder->d_releases.size(), 1u);
+        BOOST_CHECK_EQUAL(decoder->d_releases.front(), 0);
+        const sample_distributor_stats stats = distributor.d_distributor->stats();
+        BOOST_CHECK_EQUAL(stats.preemptions, 1u);
+        BOOST_CHECK_EQUAL(stats.releases, 1u);
+        BOOST_CHECK_EQUAL(stats.assignments, 2u);
+    }
+
+    BOOST_AUTO_TEST_CASE(t_first_come_releases_idle)
+    {
+        // Without preemption, an input with no items gives up its decoder
+        direct_distributor distributor(1, sample_distributor::FIRST_COME);
+        auto decoder = boost::make_shared<collecting_decoder>();
+        distributor.d_distributor->add_zero_copy_decoder(decoder);
+        distributor.write(0, counting_items(0, 10), false);
+        distributor.work();
+        BOOST_CHECK(decoder->d_releases.empty());
+        distributor.work();
+        BOOST_REQUIRE_EQUAL(decoder->d_releases.size(), 1u);
+        BOOST_CHECK_EQUAL(decoder->d_releases.front(), 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(t_queue_limit)
+    {
+        direct_distributor distributor(2, sample_distributor::FIRST_COME, 4);
+        auto decoder = boost::make_shared<collecting_decoder>();
+        distributor.d_distributor->add_zero_copy_decoder(decoder);
+
+        // Input 0 holds the stalled decoder
+        decoder->d_max_items = 0;
+        distributor.write(0, counting_items(0, 10), true);
+        distributor.work();
+        // Input 1 can queue only 4 of its items. The rest stay in its
+        // input buffer.
+        distributor.write(1, counting_items(100, 10), false);
+        distributor.work();
+        BOOST_CHECK_EQUAL(distributor.d_distributor->stats().queued_items, 4u);
+        BOOST_CHECK_EQUAL(distributor.available(1), 6);
+        // The queue is full, so nothing more is queued
+        distributor.work();
+        BOOST_CHECK_EQUAL(distributor.d_distributor->stats().queued_items, 4u);
+        BOOST_CHECK_EQUAL(distributor.available(1), 6);
+        BOOST_CHECK_LT(distributor.d_distributor->decoder_surplus(), 0);
+
+        // When input 1 gets the decoder, the queued items go first
+        decoder->d_max_items = std::numeric_limits<int>::max();
+        distributor.work();
+        const std::vector<float> expected = counting_items(100, 10);
+        const std::vector<float> received = decoder->items_from(1);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+            received.begin(), received.end());
+        BOOST_CHECK_EQUAL(distributor.available(1), 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(t_burst_end_release)
+    {
+        direct_distributor distributor(1, sample_distributor::FIRST_COME);
+        auto decoder = boost::make_shared<collecting_decoder>();
+        distributor.d_distributor->add_zero_copy_decoder(decoder);
+
+        // Two bursts arrive together. The decoder stops after the tagged
+        // item and is released, even though more items are available.
+        distributor.write(0, counting_items(0, 5), true);
+        distributor.write(0, counting_items(5, 5), true);
+        distributor.work();
+        BOOST_CHECK_EQUAL(decoder->d_items.size(), 5u);
+        BOOST_CHECK_EQUAL(decoder->d_releases.size(), 1u);
+        BOOST_CHECK_EQUAL(distributor.available(0), 5);
+
+        // The second burst gets the decoder again
+        distributor.work();
+        const std::vector<float> expected = counting_items(0, 10);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+            decoder->d_items.begin(), decoder->d_items.end());
+        BOOST_CHECK_EQUAL(decoder->d_releases.size(), 2u);
+        const sample_distributor_stats stats = distributor.d_distributor->stats();
+        BOOST_CHECK_EQUAL(stats.assignments, 2u);
+        BOOST_CHECK_EQUAL(stats.releases, 2u);
+    }
+
+    BOOST_AUTO_TEST_CASE(t_zero_copy_decoders_run_concurrently)
+    {
+        // Each zero-copy decoder runs on its own thread, so two decoders
+        // busy with two inputs are in decode() at the same time
+        direct_distributor distributor(2, sample_distributor::FIRST_COME);
+        std::atomic<int> arrivals(0);
+        auto decoder0 = boost::make_shared<rendezvous_decoder>(arrivals);
+        auto decoder1 = boost::make_shared<rendezvous_decoder>(arrivals);
+        distributor.d_distributor->add_zero_copy_decoder(decoder0);
+        distributor.d_distributor->add_zero_copy_decoder(decoder1);
+        distributor.write(0, counting_items(0, 10), false);
+        distributor.write(1, counting_items(100, 10), false);
+        distributor.work();
+
+        BOOST_CHECK(decoder0->d_met);
+        BOOST_CHECK(decoder1->d_met);
+        BOOST_CHECK(decoder0->d_thread != decoder1->d_thread);
+        BOOST_CHECK(decoder0->d_thread != std::this_thread::get_id());
+        // The items are consumed after both decoders return
+        BOOST_CHECK_EQUAL(distributor.available(0), 0);
+        BOOST_CHECK_EQUAL(distributor.available(1), 0);
+    }
+
+  } // namespace sparsdr
+} // namespace gr
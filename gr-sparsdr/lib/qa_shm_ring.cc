@@ -0,0 +1,219 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "shm_ring.h"
+#include "shm_ring_sink.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    namespace {
+
+      const std::chrono::milliseconds TIMEOUT(100);
+
+      /*!
+       * \brief Writes count consecutive numbers to a ring in chunks of
+       * varying sizes, then closes it
+       */
+      void write_sequence(shm_ring& ring, std::uint32_t count)
+      {
+          std::vector<std::uint32_t> chunk;
+          std::uint32_t next = 0;
+          std::size_t chunk_size = 1;
+          while (next < count) {
+              chunk.clear();
+              for (std::size_t i = 0; i < chunk_size && next + i < count; i++) {
+                  chunk.push_back(next + i);
+              }
+              std::size_t offset = 0;
+              while (offset < chunk.size()) {
+                  offset += ring.write(chunk.data() + offset, chunk.size() - offset,
+                      sizeof(std::uint32_t), TIMEOUT);
+              }
+              next += chunk.size();
+              // Sizes that don't divide the capacity move the wraparound
+              // point around
+              chunk_size = chunk_size % 1021 + 7;
+          }
+          ring.close_writer();
+      }
+
+      /*!
+       * \brief Reads from a ring in chunks of varying sizes until it is
+       * finished
+       */
+      std::vector<std::uint32_t> read_all(shm_ring& ring)
+      {
+          std::vector<std::uint32_t> items;
+          std::vector<std::uint32_t> chunk;
+          std::size_t chunk_size = 3;
+          while (!ring.finished()) {
+              chunk.resize(chunk_size);
+              const std::size_t read = ring.read(chunk.data(), chunk.size(),
+                  sizeof(std::uint32_t), TIMEOUT);
+              items.insert(items.end(), chunk.begin(), chunk.begin() + read);
+              chunk_size = chunk_size % 1499 + 11;
+          }
+          return items;
+      }
+
+    }
+
+    BOOST_AUTO_TEST_CASE(t_capacity_rounded_up)
+    {
+        BOOST_CHECK_EQUAL(shm_ring(1).capacity(), 4096u);
+        BOOST_CHECK_EQUAL(shm_ring(5000).capacity(), 8192u);
+    }
+
+    BOOST_AUTO_TEST_CASE(t_wraparound)
+    {
+        // Many times the capacity, so the positions wrap around often
+        const std::uint32_t count = 200000;
+        shm_ring ring(4096);
+        std::thread writer([&]() { write_sequence(ring, count); });
+        const std::vector<std::uint32_t> items = read_all(ring);
+        writer.join();
+
+        BOOST_REQUIRE_EQUAL(items.size(), count);
+        for (std::uint32_t i = 0; i < count; i++) {
+            BOOST_REQUIRE_EQUAL(items[i], i);
+        }
+        BOOST_CHECK_EQUAL(ring.buffered(), 0u);
+    }
+
+    BOOST_AUTO_TEST_CASE(t_whole_items)
+    {
+        shm_ring ring(4096);
+        // Leave 12 bytes of space, which holds one 8-byte item
+        const std::vector<char> fill(ring.capacity() - 12, 1);
+        BOOST_REQUIRE_EQUAL(ring.write(fill.data(), fill.size(), 1, TIMEOUT),
+            fill.size());
+        const std::uint64_t items[2] = {1, 2};
+        BOOST_CHECK_EQUAL(ring.write(items, 2, sizeof(std::uint64_t), TIMEOUT), 1u);
+        BOOST_CHECK_EQUAL(ring.buffered(), ring.capacity() - 4);
+
+        // Reading also stops at an item boundary, leaving 2 bytes
+        std::vector<char> out(ring.capacity());
+        BOOST_CHECK_EQUAL(ring.read(out.data(), 2000, 5, TIMEOUT), 818u);
+        BOOST_CHECK_EQUAL(ring.buffered(), 2u);
+    }
+
+    BOOST_AUTO_TEST_CASE(t_end_of_data)
+    {
+        shm_ring ring(4096);
+        const std::uint32_t items[3] = {10, 20, 30};
+        std::thread writer([&]() {
+            // Give the reader time to start waiting
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            ring.write(items, 3, sizeof(std::uint32_t), TIMEOUT);
+            ring.close_writer();
+        });
+        std::uint32_t out[4] = {0, 0, 0, 0};
+        std::size_t read = 0;
+        while (read < 3) {
+            read += ring.read(out + read, 4 - read, sizeof(std::uint32_t),
+                std::chrono::milliseconds(1000));
+        }
+        writer.join();
+        BOOST_CHECK_EQUAL(out[0], 10u);
+        BOOST_CHECK_EQUAL(out[1], 20u);
+        BOOST_CHECK_EQUAL(out[2], 30u);
+
+        // The ring is finished, so reading returns at once without data
+        BOOST_CHECK(ring.finished());
+        const auto start = std::chrono::steady_clock::now();
+        BOOST_CHECK_EQUAL(ring.read(out, 4, sizeof(std::uint32_t),
+            std::chrono::milliseconds(5000)), 0u);
+        BOOST_CHECK(std::chrono::steady_clock::now() - start
+            < std::chrono::milliseconds(1000));
+    }
+
+    BOOST_AUTO_TEST_CASE(t_close_wakes_reader)
+    {
+        shm_ring ring(4096);
+        std::thread writer([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            ring.close_writer();
+        });
+        // Without the wake, this would wait for the whole timeout
+        std::uint32_t out;
+        const auto start = std::chrono::steady_clock::now();
+        BOOST_CHECK_EQUAL(ring.read(&out, 1, sizeof out,
+            std::chrono::milliseconds(5000)), 0u);
+        BOOST_CHECK(std::chrono::steady_clock::now() - start
+            < std::chrono::milliseconds(1000));
+        writer.join();
+        BOOST_CHECK(ring.finished());
+    }
+
+    BOOST_AUTO_TEST_CASE(t_reader_close_wakes_writer)
+    {
+        shm_ring ring(4096);
+        const std::vector<char> fill(ring.capacity(), 1);
+        BOOST_REQUIRE_EQUAL(ring.write(fill.data(), fill.size(), 1, TIMEOUT),
+            fill.size());
+        std::thread reader([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            ring.close_reader();
+        });
+        // The ring is full, so this waits until the reader closes
+        const char item = 2;
+        const auto start = std::chrono::steady_clock::now();
+        BOOST_CHECK_EQUAL(ring.write(&item, 1, 1,
+            std::chrono::milliseconds(5000)), 0u);
+        BOOST_CHECK(std::chrono::steady_clock::now() - start
+            < std::chrono::milliseconds(1000));
+        reader.join();
+
+        BOOST_CHECK(ring.reader_closed());
+        BOOST_CHECK_EQUAL(ring.write(&item, 1, 1, TIMEOUT), 0u);
+    }
+
+    BOOST_AUTO_TEST_CASE(t_full_ring_times_out)
+    {
+        shm_ring ring(4096);
+        const std::vector<char> fill(ring.capacity(), 1);
+        BOOST_REQUIRE_EQUAL(ring.write(fill.data(), fill.size(), 1, TIMEOUT),
+            fill.size());
+        const char item = 2;
+        BOOST_CHECK_EQUAL(ring.write(&item, 1, 1, std::chrono::milliseconds(10)), 0u);
+        BOOST_CHECK(!ring.reader_closed());
+    }
+
+    BOOST_AUTO_TEST_CASE(t_sink_item_size)
+    {
+        // Items must make up whole 8-byte compressed samples
+        BOOST_CHECK_NO_THROW(shm_ring_sink::make(4, nullptr));
+        BOOST_CHECK_NO_THROW(shm_ring_sink::make(8, nullptr));
+        BOOST_CHECK_THROW(shm_ring_sink::make(3, nullptr), std::invalid_argument);
+        BOOST_CHECK_THROW(shm_ring_sink::make(16, nullptr), std::invalid_argument);
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
@@ -0,0 +1,324 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <boost/bind.hpp>
+#include <gnuradio/io_signature.h>
+#include "rate_governor_impl.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    namespace {
+    /*! \brief The number of bytes in each compressed sample */
+    const std::uint64_t SAMPLE_BYTES = 8;
+    }
+
+    const std::uint32_t rate_governor::MAX_THRESHOLD_SHIFT;
+
+    rate_governor::sptr
+    rate_governor::make(compressing_usrp_source::sptr usrp,
+        double ceiling,
+        std::uint32_t period,
+        double window_duration)
+    {
+      return gnuradio::get_initial_sptr
+        (new rate_governor_impl(usrp, ceiling, period, window_duration));
+    }
+
+    /*
+     * The private constructor
+     */
+    rate_governor_impl::rate_governor_impl(compressing_usrp_source::sptr usrp,
+        double ceiling,
+        std::uint32_t period,
+        double window_duration)
+      : gr::sync_block("rate_governor",
+              gr::io_signature::make(1, 1, sizeof(uint32_t)),
+              gr::io_signature::make(0, 0, 0)),
+        d_usrp(usrp),
+        d_period(period),
+        d_window_duration(window_duration),
+        d_mutex(),
+        d_threshold_scaling(true),
+        d_ceiling(ceiling),
+        d_engage(0.9),
+        d_relax(0.5),
+        d_relax_periods(10),
+        d_low_priority(),
+        d_level(0),
+        d_raises(0),
+        d_relaxes(0),
+        d_measured_rate(0.0),
+        d_overflow_pending(false),
+        d_active_low_priority(),
+        d_have_low_priority(false),
+        d_active_threshold_scaling(true),
+        d_saved(),
+        d_samples(),
+        d_time_expander(),
+        d_started(false),
+        d_period_start(0),
+        d_period_samples(0),
+        d_quiet_periods(0),
+        d_throttle_port(pmt::intern("throttle")),
+        d_raise_port(pmt::intern("raise")),
+        d_level_key(pmt::intern("level")),
+        d_rate_key(pmt::intern("rate"))
+    {
+        if (!(ceiling > 0.0) || period == 0 || !(window_duration > 0.0)) {
+            throw std::invalid_argument(
+                "Ceiling, period, and window duration must be positive");
+        }
+        // Never split a sample across calls to work()
+        set_output_multiple(2);
+        const pmt::pmt_t overflow_port = pmt::intern("overflow");
+        message_port_register_in(overflow_port);
+        set_msg_handler(overflow_port,
+            boost::bind(&rate_governor_impl::handle_overflow, this, _1));
+        message_port_register_out(d_throttle_port);
+        message_port_register_out(d_raise_port);
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    rate_governor_impl::~rate_governor_impl()
+    {
+    }
+
+    int
+    rate_governor_impl::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      const uint32_t* in = reinterpret_cast<const uint32_t*>(input_items[0]);
+      const int sample_count = noutput_items / 2;
+
+      decode_samples(in, sample_count, d_samples);
+      for (int i = 0; i < sample_count; i++) {
+          const std::uint64_t time = d_time_expander.expand(d_samples.time[i]);
+          if (!d_started) {
+              d_started = true;
+              d_period_start = time;
+          } else if (time - d_period_start >= d_period) {
+              end_period(time - d_period_start);
+              d_period_start = time;
+              d_period_samples = 0;
+          }
+          d_period_samples++;
+      }
+
+      // Tell runtime system how many output items we produced.
+      return noutput_items;
+    }
+
+    void
+    rate_governor_impl::end_period(std::uint64_t elapsed)
+    {
+        std::uint32_t previous;
+        std::uint32_t level;
+        double rate;
+        {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            rate = d_period_samples * SAMPLE_BYTES / (elapsed * d_window_duration);
+            d_measured_rate = rate;
+            previous = d_level;
+            if (d_overflow_pending || rate > d_engage * d_ceiling) {
+                d_quiet_periods = 0;
+                if (d_level == 0) {
+                    d_active_low_priority = d_low_priority;
+                    d_have_low_priority = unmasked_low_priority();
+                    d_active_threshold_scaling = d_threshold_scaling;
+                }
+                if (d_level < max_level()) {
+                    d_level++;
+                    d_raises++;
+                }
+            } else if (rate < d_relax * d_ceiling) {
+                d_quiet_periods++;
+                if (d_quiet_periods >= d_relax_periods && d_level != 0) {
+                    d_quiet_periods = 0;
+                    d_level--;
+                    d_relaxes++;
+                }
+            } else {
+                d_quiet_periods = 0;
+            }
+            d_overflow_pending = false;
+            level = d_level;
+        }
+        if (level == previous) {
+            return;
+        }
+
+        apply_level(previous, level);
+
+        pmt::pmt_t info = pmt::make_dict();
+        info = pmt::dict_add(info, d_level_key, pmt::from_uint64(level));
+        info = pmt::dict_add(info, d_rate_key, pmt::from_double(rate));
+        message_port_pub(d_throttle_port, info);
+        if (level > previous) {
+            message_port_pub(d_raise_port, info);
+        }
+    }
+
+    void
+    rate_governor_impl::apply_level(std::uint32_t previous, std::uint32_t level)
+    {
+        if (!d_usrp) {
+            return;
+        }
+        if (previous == 0) {
+            // Save what this block will change
+            const compression_config current = d_usrp->config();
+            d_saved.clear();
+            for (std::uint16_t i = 0; i < BIN_COUNT; i++) {
+                if (d_active_threshold_scaling && current.has_threshold(i)) {
+                    d_saved.set_threshold(i, current.threshold(i));
+                }
+                // Bins that are already masked belong to something else
+                // (for example, an auto_masker), which may unmask them
+                // later, so this block leaves them alone
+                if (i < d_active_low_priority.size() && d_active_low_priority[i]
+                        && !(current.has_mask(i) && current.mask(i))) {
+                    d_saved.set_mask(i, false);
+                }
+            }
+        }
+        if (level == 0) {
+            d_usrp->restore(d_saved);
+            return;
+        }
+
+        // Level 1 masks the low-priority bins if any were unmasked. The other
+        // levels double the thresholds.
+        const std::uint32_t shift = d_have_low_priority ? level - 1 : level;
+        compression_config target;
+        for (std::uint16_t i = 0; i < BIN_COUNT; i++) {
+            if (d_saved.has_threshold(i)) {
+                const std::uint64_t threshold =
+                    static_cast<std::uint64_t>(d_saved.threshold(i)) << shift;
+                target.set_threshold(i, static_cast<std::uint32_t>(
+                    std::min<std::uint64_t>(threshold, 0xffffffffu)));
+            }
+            if (d_saved.has_mask(i)) {
+                target.set_mask(i, true);
+            }
+        }
+        d_usrp->restore(target);
+    }
+
+    std::uint32_t
+    rate_governor_impl::max_level() const
+    {
+        return MAX_THRESHOLD_SHIFT + (d_have_low_priority ? 1 : 0);
+    }
+
+    bool
+    rate_governor_impl::unmasked_low_priority() const
+    {
+        if (!d_usrp) {
+            return std::find(d_active_low_priority.begin(),
+                d_active_low_priority.end(), true) != d_active_low_priority.end();
+        }
+        const compression_config current = d_usrp->config();
+        for (std::uint16_t i = 0; i < d_active_low_priority.size(); i++) {
+            if (d_active_low_priority[i] && !(current.has_mask(i) && current.mask(i))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void
+    rate_governor_impl::handle_overflow(pmt::pmt_t)
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_overflow_pending = true;
+    }
+
+    rate_governor_stats
+    rate_governor_impl::stats() const
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        rate_governor_stats stats;
+        stats.level = d_level;
+        stats.raises = d_raises;
+        stats.relaxes = d_relaxes;
+        stats.measured_rate = d_measured_rate;
+        return stats;
+    }
+
+    void
+    rate_governor_impl::set_low_priority(const std::vector<bool>& low_priority)
+    {
+        if (low_priority.size() > BIN_COUNT) {
+            throw std::invalid_argument("Too many low-priority entries");
+        }
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_low_priority = low_priority;
+    }
+
+    void
+    rate_governor_impl::set_ceiling(double ceiling)
+    {
+        if (!(ceiling > 0.0)) {
+            throw std::invalid_argument("Ceiling must be positive");
+        }
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_ceiling = ceiling;
+    }
+
+    void
+    rate_governor_impl::set_fractions(double engage, double relax)
+    {
+        if (!(relax > 0.0 && relax < engage && engage <= 1.0)) {
+            throw std::invalid_argument("Fractions must satisfy 0 < relax < engage <= 1");
+        }
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_engage = engage;
+        d_relax = relax;
+    }
+
+    void
+    rate_governor_impl::set_relax_periods(std::uint32_t periods)
+    {
+        if (periods == 0) {
+            throw std::invalid_argument("Relax periods must not be 0");
+        }
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_relax_periods = periods;
+    }
+
+    void
+    rate_governor_impl::set_threshold_scaling(bool enabled)
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_threshold_scaling = enabled;
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
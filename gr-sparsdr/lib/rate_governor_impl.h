@@ -0,0 +1,147 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_RATE_GOVERNOR_IMPL_H
+#define INCLUDED_SPARSDR_RATE_GOVERNOR_IMPL_H
+
+#include <mutex>
+#include <sparsdr/rate_governor.h>
+#include <sparsdr/sample_decoder.h>
+#include "time_expander.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    class rate_governor_impl : public rate_governor
+    {
+     private:
+      static const std::size_t BIN_COUNT = compressing_usrp_source::BIN_COUNT;
+
+      /*! \brief The USRP to throttle, or null */
+      compressing_usrp_source::sptr d_usrp;
+      /*! \brief The measurement period, in hardware time steps */
+      std::uint32_t d_period;
+      /*! \brief The duration of one hardware time step, in seconds */
+      double d_window_duration;
+      /*! \brief Protects the settings and state below */
+      mutable std::mutex d_mutex;
+      /*! \brief True to scale thresholds */
+      bool d_threshold_scaling;
+      double d_ceiling;
+      double d_engage;
+      double d_relax;
+      std::uint32_t d_relax_periods;
+      std::vector<bool> d_low_priority;
+      std::uint32_t d_level;
+      std::uint64_t d_raises;
+      std::uint64_t d_relaxes;
+      double d_measured_rate;
+      /*! \brief Set when an overflow is reported, cleared at each period */
+      bool d_overflow_pending;
+
+      /*!
+       * \brief The low-priority bins that were in effect when throttling
+       * started
+       */
+      std::vector<bool> d_active_low_priority;
+      /*!
+       * \brief True if any of d_active_low_priority was unmasked when
+       * throttling started, so that level 1 masks bins
+       */
+      bool d_have_low_priority;
+      /*!
+       * \brief The value of d_threshold_scaling when throttling started
+       */
+      bool d_active_threshold_scaling;
+      /*!
+       * \brief The thresholds from before throttling started, and the
+       * low-priority bins that this block masks
+       */
+      compression_config d_saved;
+      /*! \brief Samples decoded from the input */
+      decoded_samples d_samples;
+      /*! \brief Expands the hardware time of each sample */
+      time_expander d_time_expander;
+      /*! \brief True if a sample has been seen */
+      bool d_started;
+      /*! \brief The expanded time when the current period started */
+      std::uint64_t d_period_start;
+      /*! \brief Samples seen in the current period */
+      std::uint64_t d_period_samples;
+      /*! \brief Consecutive periods below the relax fraction */
+      std::uint32_t d_quiet_periods;
+
+      const pmt::pmt_t d_throttle_port;
+      const pmt::pmt_t d_raise_port;
+      const pmt::pmt_t d_level_key;
+      const pmt::pmt_t d_rate_key;
+
+      /*! \brief Handles a message on the overflow port */
+      void handle_overflow(pmt::pmt_t message);
+
+      /*!
+       * \brief Measures the rate of a period that has ended and changes
+       * the level if needed
+       *
+       * \param elapsed the length of the period, in hardware time steps
+       */
+      void end_period(std::uint64_t elapsed);
+
+      /*!
+       * \brief Writes the thresholds and masks for a new level
+       *
+       * \param previous the level before the change
+       * \param level the new level
+       */
+      void apply_level(std::uint32_t previous, std::uint32_t level);
+
+      /*! \brief Returns the highest level, with d_mutex locked */
+      std::uint32_t max_level() const;
+
+      /*!
+       * \brief Returns true if any bin in d_active_low_priority is not
+       * masked on the USRP, with d_mutex locked
+       */
+      bool unmasked_low_priority() const;
+
+     public:
+      rate_governor_impl(compressing_usrp_source::sptr usrp,
+          double ceiling,
+          std::uint32_t period,
+          double window_duration);
+      ~rate_governor_impl();
+
+      // Where all the action really happens
+      int work(int noutput_items,
+         gr_vector_const_void_star &input_items,
+         gr_vector_void_star &output_items);
+
+      virtual rate_governor_stats stats() const;
+      virtual void set_low_priority(const std::vector<bool>& low_priority);
+      virtual void set_ceiling(double ceiling);
+      virtual void set_fractions(double engage, double relax);
+      virtual void set_relax_periods(std::uint32_t periods);
+      virtual void set_threshold_scaling(bool enabled);
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_RATE_GOVERNOR_IMPL_H */
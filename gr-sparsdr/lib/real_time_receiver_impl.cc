@@ -2,21 +2,45 @@
 #include "config.h"
 #endif
 
+#include <algorithm>
+#include <iostream>
+#include <vector>
 #include <gnuradio/io_signature.h>
-#include <gnuradio/blocks/file_sink.h>
 #include "real_time_receiver_impl.h"
 
 namespace gr {
   namespace sparsdr {
 
+    namespace {
+    /*! \brief The maximum number of configuration changes logged on restart */
+    const std::size_t MAX_LOGGED_DIFFERENCES = 8;
+    }
+
+    real_time_receiver::sptr
+    real_time_receiver::make(compressing_usrp_source::sptr usrp,
+        const std::string& output_path,
+        uint32_t threshold,
+        mask_range mask,
+        restart_policy policy,
+        double target_rate)
+    {
+      return make(usrp, output_path, threshold, std::vector<mask_range>(1, mask),
+          policy, target_rate);
+    }
+
     real_time_receiver::sptr
     real_time_receiver::make(compressing_usrp_source::sptr usrp,
         const std::string& output_path,
         uint32_t threshold,
-        mask_range mask)
+        const std::vector<mask_range>& masks,
+        restart_policy policy,
+        double target_rate,
+        double auto_mask_level,
+        double rate_ceiling)
     {
       return gnuradio::get_initial_sptr
-        (new real_time_receiver_impl(usrp, output_path, threshold, mask));
+        (new real_time_receiver_impl(usrp, output_path, threshold, masks, policy,
+            target_rate, auto_mask_level, rate_ceiling));
     }
 
     /*
@@ -26,32 +50,49 @@ namespace gr {
         compressing_usrp_source::sptr usrp,
         const std::string& output_path,
         uint32_t threshold,
-        mask_range mask)
+        const std::vector<mask_range>& masks,
+        restart_policy policy,
+        double target_rate,
+        double auto_mask_level,
+        double rate_ceiling)
       : gr::hier_block2("real_time_receiver",
               gr::io_signature::make(0, 0, 0),
               gr::io_signature::make(0, 0, 0)),
-        d_average_detector(average_detector::make()),
+        d_average_detector(),
+        d_capture_sink(),
+        d_controller(),
+        d_masker(),
+        d_governor(),
         d_usrp(usrp),
-        d_expected_average_interval()
+        d_expected_average_interval(),
+        d_restart_policy(policy),
+        d_last_overflow_restart(),
+        d_restart_mutex(),
+        d_initial_config(),
+        d_worker_mutex(),
+        d_restart_worker()
     {
         // Configure USRP
         d_usrp->set_compression_enabled(true);
         d_usrp->stop_all();
 
-        // Clear masks and set threshold
-        for (uint16_t i = 0; i < 2048; i++) {
-            d_usrp->set_mask_enabled(i, false);
-            d_usrp->set_threshold(i, threshold);
-        }
-        // Set masks
-        for (uint16_t i = mask.start; i < mask.end; i++) {
-            d_usrp->set_mask_enabled(i, true);
-        }
-        // Mask bins 0, 1, and 2047
+        // Set the same threshold for all bins
+        d_usrp->set_thresholds(std::vector<uint32_t>(
+            compressing_usrp_source::BIN_COUNT, threshold));
+        // Mask the bins in the mask ranges, and bins 0, 1, and 2047
         // These have some special properties.
-        d_usrp->set_mask_enabled(0, true);
-        d_usrp->set_mask_enabled(1, true);
-        d_usrp->set_mask_enabled(2047, true);
+        std::vector<bool> masked(compressing_usrp_source::BIN_COUNT, false);
+        for (const mask_range& mask : masks) {
+            const std::size_t mask_end = std::min<std::size_t>(mask.end,
+                compressing_usrp_source::BIN_COUNT);
+            for (std::size_t i = mask.start; i < mask_end; i++) {
+                masked[i] = true;
+            }
+        }
+        masked[0] = true;
+        masked[1] = true;
+        masked[2047] = true;
+        d_usrp->set_mask(masked);
 
         // Set average interval
         const uint32_t average_interval = 1 << 14;
@@ -62,13 +103,61 @@ namespace gr {
         d_usrp->set_average_packet_interval(average_interval);
         // Start compression
         d_usrp->start_all();
+        d_initial_config = d_usrp->config();
 
-        // File output
-        auto file_sink = gr::blocks::file_sink::make(4, output_path.c_str());
+        // Overflow detection
+        // Restarts write many registers, so they run on another thread
+        // while the detector keeps checking the stream
+        d_restart_worker.reset(new restart_worker([this](std::size_t) {
+            restart_compression();
+        }));
+        d_average_detector = average_detector::make(average_interval,
+            [this]() { handle_overflow(); });
+        const pmt::pmt_t overflow_port = pmt::intern("overflow");
+        message_port_register_hier_out(overflow_port);
+        msg_connect(d_average_detector, overflow_port, self(), overflow_port);
+
+        // File output, which buffers samples so that a slow disk does not
+        // stop the stream from the USRP
+        d_capture_sink = capture_sink::make(output_path);
 
         // Connect
         connect(d_usrp, 0, d_average_detector, 0);
-        connect(d_usrp, 0, file_sink, 0);
+        connect(d_usrp, 0, d_capture_sink, 0);
+
+        if (target_rate != 0.0) {
+            // The controller starts from the thresholds written above
+            d_controller = threshold_controller::make(d_usrp, target_rate,
+                average_interval);
+            connect(d_usrp, 0, d_controller, 0);
+            msg_connect(d_average_detector, overflow_port, d_controller,
+                overflow_port);
+        }
+        if (auto_mask_level != 0.0) {
+            // The masker leaves the masks written above alone
+            d_masker = auto_masker::make(d_usrp, average_interval,
+                auto_mask_level);
+            connect(d_usrp, 0, d_masker, 0);
+            const pmt::pmt_t mask_port = pmt::intern("mask");
+            message_port_register_hier_out(mask_port);
+            msg_connect(d_masker, mask_port, self(), mask_port);
+        }
+        if (rate_ceiling != 0.0) {
+            d_governor = rate_governor::make(d_usrp, rate_ceiling);
+            connect(d_usrp, 0, d_governor, 0);
+            msg_connect(d_average_detector, overflow_port, d_governor,
+                overflow_port);
+            const pmt::pmt_t throttle_port = pmt::intern("throttle");
+            message_port_register_hier_out(throttle_port);
+            msg_connect(d_governor, throttle_port, self(), throttle_port);
+            if (d_controller) {
+                // Leave the thresholds to the controller, but make it raise
+                // its margin whenever the governor throttles
+                d_governor->set_threshold_scaling(false);
+                msg_connect(d_governor, pmt::intern("raise"), d_controller,
+                    overflow_port);
+            }
+        }
     }
 
     real_time_receiver::time_point
@@ -77,6 +166,18 @@ namespace gr {
         return d_average_detector->last_average();
     }
 
+    average_detector_stats
+    real_time_receiver_impl::average_stats()
+    {
+        return d_average_detector->stats();
+    }
+
+    capture_sink_stats
+    real_time_receiver_impl::capture_stats()
+    {
+        return d_capture_sink->stats();
+    }
+
     real_time_receiver::duration
     real_time_receiver_impl::expected_average_interval() const
     {
@@ -86,8 +187,72 @@ namespace gr {
     void
     real_time_receiver_impl::restart_compression()
     {
-        d_usrp->stop_all();
-        d_usrp->start_all();
+        std::lock_guard<std::mutex> guard(d_restart_mutex);
+        const compression_config running = d_usrp->config();
+        // A threshold controller can change every bin, so only the first
+        // few differences are logged
+        const std::vector<std::string> differences =
+            d_initial_config.differences(running);
+        const std::size_t logged = std::min<std::size_t>(differences.size(),
+            MAX_LOGGED_DIFFERENCES);
+        for (std::size_t i = 0; i < logged; i++) {
+            std::cerr << "Compression configuration changed since startup: "
+                << differences[i] << '\n';
+        }
+        if (differences.size() > logged) {
+            std::cerr << "... and " << (differences.size() - logged)
+                << " more changes\n";
+        }
+        d_usrp->restart();
+        // No averages were sent while compression was stopped, so the next
+        // row will not follow the last one by one average interval
+        d_average_detector->resync();
+    }
+
+    void
+    real_time_receiver_impl::set_restart_policy(restart_policy policy)
+    {
+        d_restart_policy.store(policy);
+    }
+
+    threshold_controller::sptr
+    real_time_receiver_impl::controller() const
+    {
+        return d_controller;
+    }
+
+    auto_masker::sptr
+    real_time_receiver_impl::masker() const
+    {
+        return d_masker;
+    }
+
+    rate_governor::sptr
+    real_time_receiver_impl::governor() const
+    {
+        return d_governor;
+    }
+
+    void
+    real_time_receiver_impl::handle_overflow()
+    {
+        if (d_restart_policy.load() != RESTART_ON_OVERFLOW) {
+            return;
+        }
+        // Samples from before the last restart may still be arriving, and
+        // would cause another restart immediately
+        const auto now = std::chrono::steady_clock::now();
+        if (now - d_last_overflow_restart < d_expected_average_interval) {
+            return;
+        }
+        d_last_overflow_restart = now;
+        std::lock_guard<std::mutex> guard(d_worker_mutex);
+        if (!d_restart_worker) {
+            // The receiver is shutting down
+            return;
+        }
+        std::cerr << "Compression overflow detected, restarting\n";
+        d_restart_worker->request(0);
     }
 
     /*
@@ -95,6 +260,17 @@ namespace gr {
      */
     real_time_receiver_impl::~real_time_receiver_impl()
     {
+        // The average detector can still report overflows, so take the
+        // worker away from it before stopping it. Stopping the worker
+        // waits for any restart in progress, which must not happen with
+        // d_worker_mutex locked.
+        std::unique_ptr<restart_worker> worker;
+        {
+            std::lock_guard<std::mutex> guard(d_worker_mutex);
+            worker.swap(d_restart_worker);
+        }
+        // Finish any restart before turning compression off
+        worker.reset();
         // Return the USRP to normal non-compressing mode
         d_usrp->stop_all();
         d_usrp->set_compression_enabled(false);
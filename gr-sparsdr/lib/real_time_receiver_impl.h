@@ -1,9 +1,13 @@
 #ifndef INCLUDED_SPARSDR_REAL_TIME_RECEIVER_IMPL_H
 #define INCLUDED_SPARSDR_REAL_TIME_RECEIVER_IMPL_H
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <sparsdr/real_time_receiver.h>
-#include <sparsdr/average_detector.h>
 #include <sparsdr/compressing_usrp_source.h>
+#include <sparsdr/capture_sink.h>
+#include "restart_worker.h"
 
 namespace gr {
   namespace sparsdr {
@@ -13,22 +17,68 @@ namespace gr {
      private:
       /*! \brief Average detector block */
       average_detector::sptr d_average_detector;
+      /*! \brief Block that writes samples to the output file */
+      capture_sink::sptr d_capture_sink;
+      /*! \brief Block that adjusts thresholds, or null */
+      threshold_controller::sptr d_controller;
+      /*! \brief Block that masks occupied bins, or null */
+      auto_masker::sptr d_masker;
+      /*! \brief Block that throttles the USRP, or null */
+      rate_governor::sptr d_governor;
       /*! \brief USRP configuration interface */
       compressing_usrp_source::sptr d_usrp;
       /*! \brief Expected interval between average samples */
       duration d_expected_average_interval;
+      /*! \brief What to do when the average detector finds an overflow */
+      std::atomic<restart_policy> d_restart_policy;
+      /*!
+       * \brief The time of the last restart caused by an overflow
+       *
+       * This is only used from the average detector thread.
+       */
+      std::chrono::steady_clock::time_point d_last_overflow_restart;
+      /*! \brief Prevents concurrent restarts */
+      std::mutex d_restart_mutex;
+      /*! \brief The compression configuration after startup */
+      compression_config d_initial_config;
+      /*!
+       * \brief Protects d_restart_worker, which the average detector thread
+       * uses while the destructor stops it
+       */
+      std::mutex d_worker_mutex;
+      /*!
+       * \brief Restarts compression after overflows, or null after the
+       * destructor has stopped it
+       */
+      std::unique_ptr<restart_worker> d_restart_worker;
+
+      /*!
+       * \brief Called from the average detector thread when it finds an
+       * overflow
+       */
+      void handle_overflow();
 
      public:
       real_time_receiver_impl(compressing_usrp_source::sptr usrp,
           const std::string& output_path,
           uint32_t threshold,
-          mask_range mask);
+          const std::vector<mask_range>& masks,
+          restart_policy policy,
+          double target_rate,
+          double auto_mask_level,
+          double rate_ceiling);
       ~real_time_receiver_impl();
 
       // Implement virtual functions
       virtual time_point last_average();
+      virtual average_detector_stats average_stats();
+      virtual capture_sink_stats capture_stats();
       virtual duration expected_average_interval() const;
       virtual void restart_compression();
+      virtual void set_restart_policy(restart_policy policy);
+      virtual threshold_controller::sptr controller() const;
+      virtual auto_masker::sptr masker() const;
+      virtual rate_governor::sptr governor() const;
     };
 
   } // namespace sparsdr
@@ -32,6 +32,7 @@
 #include <gnuradio/io_signature.h>
 #include <gnuradio/blocks/file_source.h>
 #include <gnuradio/blocks/file_sink.h>
+#include <sparsdr/native_reconstruct_from_file.h>
 #include "reconstruct_from_file_impl.h"
 
 namespace gr {
@@ -49,16 +50,16 @@ namespace gr {
     }
 
     reconstruct_from_file::sptr
-    reconstruct_from_file::make(std::vector<band_spec> bands, const std::string& input_path, const std::string& reconstruct_path)
+    reconstruct_from_file::make(std::vector<band_spec> bands, const std::string& input_path, const std::string& reconstruct_path, bool in_process, unsigned int threads)
     {
       return gnuradio::get_initial_sptr
-        (new reconstruct_from_file_impl(bands, input_path, reconstruct_path));
+        (new reconstruct_from_file_impl(bands, input_path, reconstruct_path, in_process, threads));
     }
 
     /*
      * The private constructor
      */
-    reconstruct_from_file_impl::reconstruct_from_file_impl(const std::vector<band_spec>& bands, const std::string& input_path, const std::string& reconstruct_path)
+    reconstruct_from_file_impl::reconstruct_from_file_impl(const std::vector<band_spec>& bands, const std::string& input_path, const std::string& reconstruct_path, bool in_process, unsigned int threads)
       : gr::hier_block2("reconstruct",
             // One input for compressed samples
             gr::io_signature::make(0, 0, 0),
@@ -72,7 +73,21 @@ namespace gr {
         d_temp_dir(),
         d_child(0)
     {
-        start_subprocess(bands, input_path, reconstruct_path);
+        if (in_process) {
+            start_in_process(bands, input_path, threads);
+        } else {
+            start_subprocess(bands, input_path, reconstruct_path);
+        }
+    }
+
+    void
+    reconstruct_from_file_impl::start_in_process(const std::vector<band_spec>& bands, const std::string& input_path, unsigned int threads)
+    {
+        const auto reconstruct = native_reconstruct_from_file::make(bands,
+            input_path, threads);
+        for (std::size_t i = 0; i < bands.size(); i++) {
+            connect(reconstruct, i, this->to_basic_block(), i);
+        }
     }
 
     void
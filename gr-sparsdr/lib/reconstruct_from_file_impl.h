@@ -46,10 +46,11 @@ namespace gr {
       /*! \brief The sparsdr_reconstruct child process, or 0 if none exists */
       pid_t d_child;
 
+      void start_in_process(const std::vector<band_spec>& bands, const std::string& input_path, unsigned int threads);
       void start_subprocess(const std::vector<band_spec>& bands, const std::string& reconstruct_path, const std::string& input_path);
 
      public:
-      reconstruct_from_file_impl(const std::vector<band_spec>& bands, const std::string& reconstruct_path, const std::string& input_path);
+      reconstruct_from_file_impl(const std::vector<band_spec>& bands, const std::string& reconstruct_path, const std::string& input_path, bool in_process, unsigned int threads);
       ~reconstruct_from_file_impl();
     };
 
@@ -22,16 +22,21 @@
 #include "config.h"
 #endif
 
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <cstdlib>
 #include <sys/types.h>
-#include <sys/stat.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <unistd.h>
 #include <gnuradio/io_signature.h>
-#include <gnuradio/blocks/file_source.h>
-#include <gnuradio/blocks/file_sink.h>
+#include <gnuradio/block_detail.h>
+#include <sparsdr/native_reconstruct.h>
 #include "reconstruct_impl.h"
 
 namespace gr {
@@ -39,44 +44,155 @@ namespace gr {
 
     namespace {
     /*!
-     * \brief Creates a name for an output pipe file in temp_dir
+     * \brief Describes how a process stopped, based on its status from
+     * waitpid
      */
-    std::string make_pipe_path(const std::string& temp_dir, std::size_t index) {
+    std::string describe_status(int status) {
         std::stringstream stream;
-        stream << temp_dir << "/" << index << ".pipe";
+        if (WIFEXITED(status)) {
+            stream << "exited with status " << WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+            stream << "was killed by signal " << WTERMSIG(status)
+                << " (" << ::strsignal(WTERMSIG(status)) << ")";
+        } else {
+            stream << "stopped with status " << status;
+        }
         return stream.str();
     }
     }
 
+    const std::size_t reconstruct_impl::COMPRESSED_RING_CAPACITY;
+
     reconstruct::sptr
-    reconstruct::make(std::vector<band_spec> bands, const std::string& reconstruct_path, bool unbuffered)
+    reconstruct::make(std::vector<band_spec> bands, const std::string& reconstruct_path, bool unbuffered, bool in_process, bool fill_gaps, bool tag_silence, bool tag_bursts, unsigned int max_restarts, std::vector<band_buffering> buffering, unsigned int max_bands)
     {
       return gnuradio::get_initial_sptr
-        (new reconstruct_impl(bands, reconstruct_path, unbuffered));
+        (new reconstruct_impl(bands, reconstruct_path, unbuffered, in_process, fill_gaps, tag_silence, tag_bursts, max_restarts, buffering, max_bands));
     }
 
     /*
      * The private constructor
      */
-    reconstruct_impl::reconstruct_impl(const std::vector<band_spec>& bands, const std::string& reconstruct_path, bool unbuffered)
+    reconstruct_impl::reconstruct_impl(const std::vector<band_spec>& bands, const std::string& reconstruct_path, bool unbuffered, bool in_process, bool fill_gaps, bool tag_silence, bool tag_bursts, unsigned int max_restarts, const std::vector<band_buffering>& buffering, unsigned int max_bands)
       : gr::hier_block2("reconstruct",
             // One input for compressed samples
             gr::io_signature::make(1, 1, sizeof(uint32_t)),
-            // One output per band
-            gr::io_signature::make(bands.size(), bands.size(), sizeof(gr_complex))
+            // One output per band slot
+            gr::io_signature::make(std::max<std::size_t>(bands.size(), max_bands),
+                std::max<std::size_t>(bands.size(), max_bands),
+                sizeof(gr_complex))
         ),
         // Begin fields
         d_reconstruct_path(reconstruct_path),
         d_bands(bands),
-        d_pipes(),
-        d_temp_dir(),
-        d_child(0)
+        d_buffering(buffering),
+        d_unbuffered(unbuffered),
+        d_child(0),
+        d_current(),
+        d_compressed_sink(),
+        d_band_sources(),
+        d_native(),
+        d_max_restarts(max_restarts),
+        d_restarts(0),
+        d_supervisor(),
+        d_mutex(),
+        d_wake(),
+        d_stopping(false),
+        d_stats { false, 0, { 0, 0 } },
+        d_band_stats()
     {
-        start_subprocess(bands, reconstruct_path, unbuffered);
+        if (d_buffering.empty()) {
+            d_buffering.resize(bands.size());
+        } else if (d_buffering.size() != bands.size()) {
+            throw std::invalid_argument("reconstruct needs one buffering setting for each band");
+        }
+        if (in_process) {
+            start_in_process(bands, fill_gaps, tag_silence, tag_bursts, max_bands);
+        } else {
+            if (max_bands > bands.size()) {
+                throw std::invalid_argument("Bands can only be added at run time when reconstructing in process");
+            }
+            start_subprocess(bands, reconstruct_path, unbuffered);
+        }
+    }
+
+    void
+    reconstruct_impl::start_in_process(const std::vector<band_spec>& bands, bool fill_gaps, bool tag_silence, bool tag_bursts, unsigned int max_bands)
+    {
+        const auto reconstruct = native_reconstruct::make(bands, fill_gaps,
+            tag_silence, tag_bursts, max_bands);
+        d_native = reconstruct;
+        connect(this->to_basic_block(), 0, reconstruct, 0);
+        const pmt::pmt_t command_port = pmt::intern("command");
+        message_port_register_hier_in(command_port);
+        msg_connect(self(), command_port, reconstruct, command_port);
+        // Empty slots use the default buffering
+        d_buffering.resize(std::max<std::size_t>(bands.size(), max_bands));
+        for (std::size_t i = 0; i < d_buffering.size(); i++) {
+            if (d_buffering[i].min_output_buffer() != 0) {
+                reconstruct->set_min_output_buffer(i, d_buffering[i].min_output_buffer());
+            }
+            if (d_buffering[i].max_output_buffer() != 0) {
+                reconstruct->set_max_output_buffer(i, d_buffering[i].max_output_buffer());
+            }
+            connect(reconstruct, i, this->to_basic_block(), i);
+        }
     }
 
     void
     reconstruct_impl::start_subprocess(const std::vector<band_spec>& bands, const std::string& reconstruct_path, bool unbuffered)
+    {
+        d_current = create_rings();
+        d_child = spawn(d_current);
+
+        // Create a ring sink to write the compressed samples
+        d_compressed_sink = shm_ring_sink::make(sizeof(uint32_t), d_current.compressed);
+        connect(this->to_basic_block(), 0, d_compressed_sink, 0);
+
+        for (std::size_t i = 0; i < d_bands.size(); i++) {
+            // Create a ring source to read this band
+            const auto band_source = shm_ring_source::make(sizeof(gr_complex), d_current.bands[i]);
+            if (d_buffering[i].min_output_buffer() != 0) {
+                band_source->set_min_output_buffer(d_buffering[i].min_output_buffer());
+            }
+            if (d_buffering[i].max_output_buffer() != 0) {
+                band_source->set_max_output_buffer(d_buffering[i].max_output_buffer());
+            }
+            // Connect it to the appropriate output of this block
+            connect(band_source, 0, this->to_basic_block(), i);
+            d_band_sources.push_back(band_source);
+        }
+
+        d_stats.running = d_child != 0;
+        d_band_stats.resize(d_bands.size(), reconstruct_pipe_stats { 0, 0 });
+        if (d_child == 0) {
+            // Let the outputs end
+            close_band_rings(d_current);
+        }
+        d_supervisor = std::thread(&reconstruct_impl::supervise, this);
+    }
+
+    reconstruct_impl::ring_set
+    reconstruct_impl::create_rings() const
+    {
+        ring_set rings;
+        rings.compressed = std::make_shared<shm_ring>(COMPRESSED_RING_CAPACITY);
+        for (std::size_t i = 0; i < d_bands.size(); i++) {
+            rings.bands.push_back(std::make_shared<shm_ring>(d_buffering[i].ring_size()));
+        }
+        return rings;
+    }
+
+    void
+    reconstruct_impl::close_band_rings(const ring_set& rings)
+    {
+        for (const auto& ring : rings.bands) {
+            ring->close_writer();
+        }
+    }
+
+    pid_t
+    reconstruct_impl::spawn(const ring_set& rings)
     {
         // Start assembling the command
         std::vector<std::string> arguments;
@@ -87,50 +203,30 @@ namespace gr {
         arguments.push_back("--log-level");
         arguments.push_back("WARN");
 
-        if (unbuffered) {
+        if (d_unbuffered) {
             arguments.push_back("--unbuffered");
         }
 
-        // Create a temporary directory for the pipes
-        std::string temp_dir("sparsdr_reconstruct_XXXXXX");
-        const auto mkdtemp_status = ::mkdtemp(&temp_dir.front());
-        if (mkdtemp_status == nullptr) {
-            std::cerr << "sparsdr::reconstruct failed to create temporary \
-                directory: " << ::strerror(errno) << '\n';
-            return;
-        }
-        d_temp_dir = temp_dir;
-        // Create a pipe for compressed things
-        const auto compressed_pipe = d_temp_dir + "/compressed.pipe";
-        const auto compressed_pipe_status = ::mkfifo(compressed_pipe.c_str(), 0600);
-        if (compressed_pipe_status != 0) {
-            std::cerr << "sparsdr::reconstruct failed to create a named pipe: "
-                 << ::strerror(errno) << '\n';
-            return;
-        }
-        d_pipes.emplace_back(std::move(compressed_pipe));
+        // The source and band paths refer to shared-memory rings
+        arguments.push_back("--shared-memory");
         // Add the source argument to the command
         arguments.push_back("--source");
-        arguments.push_back(compressed_pipe);
-
-        // Create a pipe for each band
-        for (auto iter = d_bands.begin(); iter != d_bands.end(); ++iter) {
-            // Get index for file name
-            const auto i = std::distance(d_bands.begin(), iter);
-            const auto pipe_path = make_pipe_path(d_temp_dir, i);
-            const auto pipe_status = ::mkfifo(pipe_path.c_str(), 0600);
-            if (pipe_status != 0) {
-                std::cerr << "sparsdr::reconstruct failed to create a named pipe: "
-                     << ::strerror(errno) << '\n';
-                return;
-            }
-            d_pipes.emplace_back(std::move(pipe_path));
+        arguments.push_back(rings.compressed->path());
 
+        for (std::size_t i = 0; i < d_bands.size(); i++) {
             // Add this band to the command
             arguments.push_back("--decompress-band");
             std::stringstream arg_stream;
-            arg_stream << iter->bins() << ":" << iter->frequency()
-                << ":" << pipe_path;
+            arg_stream << d_bands[i].bins() << ":" << d_bands[i].frequency()
+                << ":" << rings.bands[i]->path();
+            arguments.push_back(arg_stream.str());
+        }
+        // Buffering for each band, in the same order
+        for (const band_buffering& buffering : d_buffering) {
+            arguments.push_back("--band-buffering");
+            std::stringstream arg_stream;
+            arg_stream << (d_unbuffered ? 0 : buffering.buffer_size())
+                << ":" << buffering.flush_interval_ms();
             arguments.push_back(arg_stream.str());
         }
 
@@ -143,62 +239,212 @@ namespace gr {
         }
         exec_args.push_back(nullptr);
         char* envp[] = {nullptr};
+        // After fork() the child may only call async-signal-safe functions,
+        // so the message is prepared here
+        const std::string exec_error = "sparsdr_reconstruct failed to exec "
+            + d_reconstruct_path + "\n";
 
         const auto pid = ::fork();
         if (pid == -1) {
             std::cerr << "sparsdr_reconstruct failed to fork: "
                 << ::strerror(errno) << '\n';
+            return 0;
         } else if (pid == 0) {
             // This is the child
 
+            // Keep the rings open in the new program
+            rings.compressed->clear_cloexec();
+            for (const auto& ring : rings.bands) {
+                ring->clear_cloexec();
+            }
             const auto exec_status = ::execve(d_reconstruct_path.c_str(),
                 exec_args.data(), envp);
             if (exec_status == -1) {
-                std::cerr << "sparsdr_reconstruct failed to exec "
-                    << d_reconstruct_path << ": "<< ::strerror(errno) << '\n';
-                std::exit(-1);
+                const ssize_t written = ::write(STDERR_FILENO, exec_error.data(),
+                    exec_error.size());
+                (void) written;
+                ::_exit(-1);
             }
-        } else {
-            // Successfully started
-            d_child = pid;
         }
+        // Successfully started
+        return pid;
+    }
+
+    void
+    reconstruct_impl::supervise()
+    {
+        typedef std::chrono::steady_clock clock;
+        auto rate_start = clock::now();
+        std::uint64_t compressed_items = 0;
+        std::vector<std::uint64_t> band_items(d_bands.size(), 0);
 
-        // Now that the reconstruct process has started, open the named pipes
-        // here
+        std::unique_lock<std::mutex> lock(d_mutex);
+        while (!d_stopping) {
+            d_wake.wait_for(lock, std::chrono::milliseconds(100));
+            if (d_stopping) {
+                break;
+            }
+            lock.unlock();
 
-        // Create a file sink to write the compressed samples
-        const auto compressed_file_sink = gr::blocks::file_sink::make(sizeof(uint32_t), compressed_pipe.c_str());
-        connect(this->to_basic_block(), 0, compressed_file_sink, 0);
+            check_child();
 
-        for (auto iter = d_bands.begin(); iter != d_bands.end(); ++iter) {
-            // Get index for file name
-            const auto i = std::distance(d_bands.begin(), iter);
-            const auto pipe_path = make_pipe_path(d_temp_dir, i);
-            // Create a file source to read this band
-            const auto band_file_source = gr::blocks::file_source::make(sizeof(gr_complex), pipe_path.c_str());
-            // Connect it to the appropriate output of this block
-            connect(band_file_source, 0, this->to_basic_block(), i);
+            const auto now = clock::now();
+            const auto elapsed = now - rate_start;
+            if (elapsed >= std::chrono::seconds(1)) {
+                const double seconds = std::chrono::duration<double>(elapsed).count();
+                // The blocks only have details while the flowgraph is running
+                std::uint64_t new_compressed_items = compressed_items;
+                if (const auto detail = d_compressed_sink->detail()) {
+                    new_compressed_items = detail->nitems_read(0);
+                }
+                std::vector<std::uint64_t> new_band_items(band_items);
+                for (std::size_t i = 0; i < d_band_sources.size(); i++) {
+                    if (const auto detail = d_band_sources[i]->detail()) {
+                        new_band_items[i] = detail->nitems_written(0);
+                    }
+                }
+
+                lock.lock();
+                d_stats.running = d_child != 0;
+                d_stats.compressed.bytes_buffered = d_current.compressed->buffered();
+                d_stats.compressed.bytes_per_second = static_cast<std::uint64_t>(
+                    (new_compressed_items - compressed_items) * sizeof(uint32_t) / seconds);
+                for (std::size_t i = 0; i < d_band_stats.size(); i++) {
+                    d_band_stats[i].bytes_buffered = d_current.bands[i]->buffered();
+                    d_band_stats[i].bytes_per_second = static_cast<std::uint64_t>(
+                        (new_band_items[i] - band_items[i]) * sizeof(gr_complex) / seconds);
+                }
+                lock.unlock();
+
+                rate_start = now;
+                compressed_items = new_compressed_items;
+                band_items = new_band_items;
+            }
+            lock.lock();
         }
     }
 
+    void
+    reconstruct_impl::check_child()
+    {
+        if (d_child == 0) {
+            return;
+        }
+        int status = 0;
+        if (::waitpid(d_child, &status, WNOHANG) != d_child) {
+            // Still running
+            return;
+        }
+        d_child = 0;
+        // Nothing will read the compressed samples now
+        d_current.compressed->close_reader();
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            // Finished normally at the end of the compressed samples.
+            // When the ring sources have read everything, the outputs end.
+            close_band_rings(d_current);
+            return;
+        }
+
+        std::cerr << "sparsdr_reconstruct " << describe_status(status) << '\n';
+        if (d_restarts >= d_max_restarts) {
+            std::cerr << "sparsdr::reconstruct: not restarting sparsdr_reconstruct after "
+                << d_restarts << " restarts\n";
+            close_band_rings(d_current);
+            return;
+        }
+        restart();
+    }
+
+    void
+    reconstruct_impl::restart()
+    {
+        d_restarts++;
+        {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            d_stats.restarts = d_restarts;
+        }
+        ring_set next;
+        try {
+            next = create_rings();
+        } catch (const std::runtime_error& e) {
+            std::cerr << "sparsdr::reconstruct: " << e.what() << '\n';
+            close_band_rings(d_current);
+            return;
+        }
+        const pid_t child = spawn(next);
+        if (child == 0) {
+            close_band_rings(d_current);
+            return;
+        }
+        std::cerr << "sparsdr::reconstruct: restarted sparsdr_reconstruct\n";
+
+        // Switch the blocks to the new rings. Samples left in the old rings
+        // are lost.
+        d_compressed_sink->set_ring(next.compressed);
+        for (std::size_t i = 0; i < d_band_sources.size(); i++) {
+            d_band_sources[i]->set_ring(next.bands[i]);
+        }
+
+        d_current = next;
+        d_child = child;
+    }
+
+    reconstruct_stats
+    reconstruct_impl::stats() const
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        return d_stats;
+    }
+
+    std::vector<reconstruct_pipe_stats>
+    reconstruct_impl::band_stats() const
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        return d_band_stats;
+    }
+
+    void
+    reconstruct_impl::open_band(std::size_t slot, const band_spec& band,
+        std::uint64_t time)
+    {
+        if (!d_native) {
+            throw std::logic_error("Bands can only be opened when reconstructing in process");
+        }
+        d_native->open_band(slot, band, time);
+    }
+
+    void
+    reconstruct_impl::close_band(std::size_t slot, std::uint64_t time)
+    {
+        if (!d_native) {
+            throw std::logic_error("Bands can only be closed when reconstructing in process");
+        }
+        d_native->close_band(slot, time);
+    }
+
     /*
      * Our virtual destructor.
      */
     reconstruct_impl::~reconstruct_impl()
     {
+        if (d_supervisor.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(d_mutex);
+                d_stopping = true;
+            }
+            d_wake.notify_one();
+            d_supervisor.join();
+        }
         // Stop reconstruct process
         if (d_child != 0) {
+            // Wake the process if it is waiting on a ring
+            d_current.compressed->close_writer();
+            for (const auto& ring : d_current.bands) {
+                ring->close_reader();
+            }
             ::kill(d_child, SIGINT);
             ::waitpid(d_child, nullptr, 0);
         }
-        // Clean up pipes
-        for (const auto& path : d_pipes) {
-            ::unlink(path.c_str());
-        }
-        // Delete temporary directory
-        if (!d_temp_dir.empty()) {
-            ::rmdir(d_temp_dir.c_str());
-        }
     }
 
   } /* namespace sparsdr */
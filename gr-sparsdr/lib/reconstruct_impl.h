@@ -22,8 +22,16 @@
 #define INCLUDED_SPARSDR_RECONSTRUCT_IMPL_H
 
 #include <sparsdr/reconstruct.h>
+#include <sparsdr/native_reconstruct.h>
 #include <unistd.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <boost/noncopyable.hpp>
+#include "shm_ring.h"
+#include "shm_ring_sink.h"
+#include "shm_ring_source.h"
 
 namespace gr {
   namespace sparsdr {
@@ -32,25 +40,98 @@ namespace gr {
     class reconstruct_impl : public reconstruct, public boost::noncopyable
     {
      private:
+      /*! \brief The rings used with one sparsdr_reconstruct process */
+      struct ring_set {
+        /*! \brief The ring for compressed samples */
+        std::shared_ptr<shm_ring> compressed;
+        /*! \brief The ring for each band */
+        std::vector<std::shared_ptr<shm_ring>> bands;
+      };
+
+      /*! \brief Capacity of the compressed sample ring, in bytes */
+      static const std::size_t COMPRESSED_RING_CAPACITY = 4 * 1024 * 1024;
+
       /*! \brief Path to the sparsdr_reconstruct executable */
       std::string d_reconstruct_path;
       /*! \brief The bands to decompress */
       std::vector<band_spec> d_bands;
-      /*! \brief Named pipes created that should be cleaned up */
-      std::vector<std::string> d_pipes;
-      /*!
-       * \brief Temporary directory that should be cleaned up, or an empty
-       * string if no temporary directory exists
-       */
-      std::string d_temp_dir;
+      /*! \brief Buffering settings for each band */
+      std::vector<band_buffering> d_buffering;
+      /*! \brief If sparsdr_reconstruct should be started with --unbuffered */
+      bool d_unbuffered;
       /*! \brief The sparsdr_reconstruct child process, or 0 if none exists */
       pid_t d_child;
 
+      /*! \brief The rings used with the current process */
+      ring_set d_current;
+      /*! \brief The block that writes compressed samples to a ring */
+      shm_ring_sink::sptr d_compressed_sink;
+      /*! \brief The blocks that read samples from each band ring */
+      std::vector<shm_ring_source::sptr> d_band_sources;
+      /*! \brief The in-process reconstruct block, or null */
+      native_reconstruct::sptr d_native;
+      /*! \brief The maximum number of times to restart the process */
+      unsigned int d_max_restarts;
+      /*! \brief The number of times the process has been restarted */
+      unsigned int d_restarts;
+
+      /*! \brief Thread that checks the process and updates the stats */
+      std::thread d_supervisor;
+      /*! \brief Protects d_stopping, d_stats, and d_band_stats */
+      mutable std::mutex d_mutex;
+      /*! \brief Wakes up the supervisor when it should stop */
+      std::condition_variable d_wake;
+      /*! \brief Set to true when the supervisor should stop */
+      bool d_stopping;
+      /*! \brief The latest stats for the process and compressed ring */
+      reconstruct_stats d_stats;
+      /*! \brief The latest stats for each band ring */
+      std::vector<reconstruct_pipe_stats> d_band_stats;
+
       void start_subprocess(const std::vector<band_spec>& bands, const std::string& reconstruct_path, bool unbuffered);
+      /*!
+       * \brief Creates and connects a native_reconstruct block and applies
+       * the output buffer hints to it
+       */
+      void start_in_process(const std::vector<band_spec>& bands, bool fill_gaps, bool tag_silence, bool tag_bursts, unsigned int max_bands);
+
+      /*!
+       * \brief Creates the rings for a process
+       *
+       * \throws std::runtime_error if a ring could not be created
+       */
+      ring_set create_rings() const;
+      /*! \brief Closes the band rings, so that the outputs end */
+      static void close_band_rings(const ring_set& rings);
+      /*!
+       * \brief Starts a sparsdr_reconstruct process that uses rings
+       *
+       * \return the process ID, or 0 if the process could not be started
+       */
+      pid_t spawn(const ring_set& rings);
+
+      /*! \brief The main function of the supervisor thread */
+      void supervise();
+      /*!
+       * \brief Checks if the process has stopped, and restarts it if it
+       * stopped unexpectedly
+       */
+      void check_child();
+      /*!
+       * \brief Starts a new process with new rings and switches the ring
+       * sink and sources to them
+       */
+      void restart();
 
      public:
-      reconstruct_impl(const std::vector<band_spec>& bands, const std::string& reconstruct_path, bool unbuffered);
+      reconstruct_impl(const std::vector<band_spec>& bands, const std::string& reconstruct_path, bool unbuffered, bool in_process, bool fill_gaps, bool tag_silence, bool tag_bursts, unsigned int max_restarts, const std::vector<band_buffering>& buffering, unsigned int max_bands);
       ~reconstruct_impl();
+
+      virtual reconstruct_stats stats() const override;
+      virtual std::vector<reconstruct_pipe_stats> band_stats() const override;
+      virtual void open_band(std::size_t slot, const band_spec& band,
+          std::uint64_t time) override;
+      virtual void close_band(std::size_t slot, std::uint64_t time) override;
     };
 
   } // namespace sparsdr
@@ -0,0 +1,112 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "fft_plan_cache.h"
+#include "reconstruct_workspace.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    const std::size_t reconstruct_workspace::ALIGNMENT;
+    const std::size_t reconstruct_workspace::BLOCK_SIZE;
+
+    reconstruct_workspace::reconstruct_workspace()
+      : d_plans(),
+        d_blocks(),
+        d_next(nullptr),
+        d_remaining(0),
+        d_free()
+    {
+    }
+
+    reconstruct_workspace::~reconstruct_workspace()
+    {
+        for (void* block : d_blocks) {
+            std::free(block);
+        }
+    }
+
+    std::shared_ptr<gr::fft::fft_complex>
+    reconstruct_workspace::inverse_fft(std::uint16_t size)
+    {
+        for (const auto& plan : d_plans) {
+            if (plan.first == size) {
+                return plan.second;
+            }
+        }
+        d_plans.emplace_back(size, fft_plan_cache::acquire(size));
+        return d_plans.back().second;
+    }
+
+    gr_complex*
+    reconstruct_workspace::allocate(std::size_t count)
+    {
+        const std::size_t size = buffer_size(count);
+        for (auto it = d_free.begin(); it != d_free.end(); ++it) {
+            if (it->first == size) {
+                char* const buffer = it->second;
+                d_free.erase(it);
+                std::memset(buffer, 0, size);
+                return reinterpret_cast<gr_complex*>(buffer);
+            }
+        }
+        if (size > d_remaining) {
+            const std::size_t block_size = std::max(size, BLOCK_SIZE);
+            void* block = nullptr;
+            if (::posix_memalign(&block, ALIGNMENT, block_size) != 0) {
+                throw std::bad_alloc();
+            }
+            d_blocks.push_back(block);
+            d_next = static_cast<char*>(block);
+            d_remaining = block_size;
+        }
+        gr_complex* const buffer = reinterpret_cast<gr_complex*>(d_next);
+        std::memset(d_next, 0, size);
+        d_next += size;
+        d_remaining -= size;
+        return buffer;
+    }
+
+    void
+    reconstruct_workspace::release(gr_complex* buffer, std::size_t count)
+    {
+        if (buffer != nullptr) {
+            d_free.emplace_back(buffer_size(count), reinterpret_cast<char*>(buffer));
+        }
+    }
+
+    std::size_t
+    reconstruct_workspace::buffer_size(std::size_t count)
+    {
+        // Round up so that the next buffer is also aligned
+        return (count * sizeof(gr_complex) + ALIGNMENT - 1)
+            / ALIGNMENT * ALIGNMENT;
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
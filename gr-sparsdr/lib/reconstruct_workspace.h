@@ -0,0 +1,100 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_RECONSTRUCT_WORKSPACE_H
+#define INCLUDED_SPARSDR_RECONSTRUCT_WORKSPACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/fft/fft.h>
+#include <boost/noncopyable.hpp>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief FFT plans and window buffers shared by a group of band
+     * reconstructors that run on the same thread
+     *
+     * Bands with the same FFT size share one plan. Window buffers come from
+     * an arena of large aligned blocks, so all memory is allocated while
+     * the reconstructors are created and none while they run. Buffers
+     * released by reconstructors that are destroyed are reused by later
+     * reconstructors of the same size, so opening and closing bands does
+     * not make the arena grow.
+     *
+     * The workspace must outlive the reconstructors that use it.
+     */
+    class reconstruct_workspace : public boost::noncopyable
+    {
+    public:
+      /*! \brief Alignment of buffers from allocate(), in bytes */
+      static const std::size_t ALIGNMENT = 64;
+
+      reconstruct_workspace();
+      ~reconstruct_workspace();
+
+      /*!
+       * \brief Returns the inverse FFT plan of the provided size for this
+       * workspace
+       */
+      std::shared_ptr<gr::fft::fft_complex> inverse_fft(std::uint16_t size);
+
+      /*!
+       * \brief Allocates a zeroed, aligned buffer that remains valid until
+       * the workspace is destroyed
+       *
+       * \param count the number of samples in the buffer
+       */
+      gr_complex* allocate(std::size_t count);
+
+      /*!
+       * \brief Returns a buffer from allocate() to the workspace so that a
+       * later call to allocate() with the same count can reuse it
+       */
+      void release(gr_complex* buffer, std::size_t count);
+
+    private:
+      /*! \brief The size of each arena block, unless one buffer is larger */
+      static const std::size_t BLOCK_SIZE = 64 * 1024;
+
+      /*! \brief Plans for each size */
+      std::vector<std::pair<std::uint16_t, std::shared_ptr<gr::fft::fft_complex>>> d_plans;
+      /*! \brief Arena blocks */
+      std::vector<void*> d_blocks;
+      /*! \brief The next free byte in the last block */
+      char* d_next;
+      /*! \brief The number of free bytes after d_next */
+      std::size_t d_remaining;
+      /*! \brief Released buffers and their sizes in bytes */
+      std::vector<std::pair<std::size_t, char*>> d_free;
+
+      /*! \brief Returns the size in bytes of a buffer of count samples */
+      static std::size_t buffer_size(std::size_t count);
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_RECONSTRUCT_WORKSPACE_H */
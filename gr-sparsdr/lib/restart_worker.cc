@@ -0,0 +1,93 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include "restart_worker.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    restart_worker::restart_worker(
+        const std::function<void(std::size_t)>& restart)
+      : d_restart(restart),
+        d_mutex(),
+        d_wake(),
+        d_pending(),
+        d_stopping(false),
+        d_thread()
+    {
+        d_thread = std::thread(&restart_worker::run, this);
+    }
+
+    restart_worker::~restart_worker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            d_stopping = true;
+        }
+        d_wake.notify_one();
+        d_thread.join();
+    }
+
+    void
+    restart_worker::request(std::size_t device)
+    {
+        {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            if (std::find(d_pending.begin(), d_pending.end(), device)
+                != d_pending.end()) {
+                return;
+            }
+            d_pending.push_back(device);
+        }
+        d_wake.notify_one();
+    }
+
+    void
+    restart_worker::run()
+    {
+        std::unique_lock<std::mutex> lock(d_mutex);
+        while (true) {
+            d_wake.wait(lock, [this] { return d_stopping || !d_pending.empty(); });
+            if (d_stopping) {
+                return;
+            }
+            const std::size_t device = d_pending.front();
+            d_pending.pop_front();
+            // Other devices can be queued during the restart
+            lock.unlock();
+            try {
+                d_restart(device);
+            } catch (const std::exception& e) {
+                std::cerr << "Failed to restart compression: " << e.what()
+                    << '\n';
+            }
+            lock.lock();
+        }
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
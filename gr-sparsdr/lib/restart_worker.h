@@ -0,0 +1,87 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_RESTART_WORKER_H
+#define INCLUDED_SPARSDR_RESTART_WORKER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Restarts compression on USRPs from a separate thread
+     *
+     * Restarting compression writes many USRP registers, which blocks.
+     * Overflows are detected on a block's work thread, which should not
+     * wait for that. request() only queues a restart and returns.
+     */
+    class restart_worker
+    {
+    private:
+      /*! \brief Restarts compression on one device */
+      std::function<void(std::size_t)> d_restart;
+      /*! \brief Protects d_pending and d_stopping, used with d_wake */
+      std::mutex d_mutex;
+      /*! \brief Notified when a restart is requested or the worker stops */
+      std::condition_variable d_wake;
+      /*! \brief Devices waiting to be restarted, each at most once */
+      std::deque<std::size_t> d_pending;
+      /*! \brief Set to make the thread exit */
+      bool d_stopping;
+      /*! \brief The thread that runs d_restart */
+      std::thread d_thread;
+
+      void run();
+
+    public:
+      /*!
+       * \brief Starts the worker thread
+       *
+       * \param restart a function that restarts compression on a device
+       */
+      explicit restart_worker(const std::function<void(std::size_t)>& restart);
+      /*!
+       * \brief Waits for any restart in progress, discards the others, and
+       * stops the thread
+       */
+      ~restart_worker();
+
+      restart_worker(const restart_worker&) = delete;
+      restart_worker& operator=(const restart_worker&) = delete;
+
+      /*!
+       * \brief Queues a restart of a device, unless one is already waiting
+       *
+       * This function is safe to call from any thread and does not wait
+       * for the restart.
+       */
+      void request(std::size_t device);
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_RESTART_WORKER_H */
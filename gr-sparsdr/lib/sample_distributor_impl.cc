@@ -23,32 +23,68 @@
 #endif
 
 #include <algorithm>
-#include <iostream>
+#include <cstring>
+#include <limits>
 
 #include <gnuradio/io_signature.h>
+#include <gnuradio/logger.h>
 #include "sample_distributor_impl.h"
 
 namespace gr {
   namespace sparsdr {
 
+    const int sample_distributor_impl::decoder_info::NO_INPUT;
+
     sample_distributor::sptr
-    sample_distributor::make(int inputs)
+    sample_distributor::make(int item_size,
+        allocation_policy policy,
+        int max_queue_items)
     {
       return gnuradio::get_initial_sptr
-        (new sample_distributor_impl(inputs));
+        (new sample_distributor_impl(item_size, policy, max_queue_items));
     }
 
     /*
      * The private constructor
      */
-    sample_distributor_impl::sample_distributor_impl(int item_size)
+    sample_distributor_impl::sample_distributor_impl(int item_size,
+        allocation_policy policy,
+        int max_queue_items)
       : gr::block("sample_distributor",
               // Any number of inputs
               gr::io_signature::make(0, gr::io_signature::IO_INFINITE, item_size),
               // Any number of outputs
               gr::io_signature::make(0, gr::io_signature::IO_INFINITE, item_size)),
         d_item_size(item_size),
+        d_policy(policy),
+        d_max_queue_items(std::max(0, max_queue_items)),
         d_decoders(),
+        d_output_count(0),
+        d_free_zero_copy(),
+        d_free_outputs(),
+        d_inputs(),
+        d_assigned_inputs(),
+        d_waiting(),
+        d_transfers(),
+        d_input_consumed(),
+        d_output_produced(),
+        d_call_count(0),
+        d_round_robin_next(0),
+        d_new_priorities(),
+        d_new_priorities_mutex(),
+        d_have_new_priorities(false),
+        d_release_key(pmt::intern("burst_end")),
+        d_source_key(pmt::intern("source")),
+        d_source_id(pmt::intern("sample_distributor")),
+        d_output_sources(),
+        d_assignment_log_limiter(std::chrono::seconds(1)),
+        d_deficit_log_limiter(std::chrono::seconds(1)),
+        d_assignments(0),
+        d_releases(0),
+        d_preemptions(0),
+        d_deficits(0),
+        d_queued_items(0),
+        d_tags(),
         d_decoder_surplus(0)
     {}
 
@@ -79,97 +115,104 @@ namespace gr {
       // ninput_items: Number of items available to read from the various
       //     inputs
 
-      // const <+ITYPE+> *in = (const <+ITYPE+> *) input_items[0];
-      // <+OTYPE+> *out = (<+OTYPE+> *) output_items[0];
-
       // Ensure that the number of decoders equals the actual number of
       // outputs connected
-      update_decoders(output_items.size());
-
-      // Keep track of the decoder surplus in this call to general_work()
-      int local_decoder_surplus = 0;
-
-      // If any decoder is being used for an input that has no samples,
-      // disassociate the input from the decoder and make it available again
-      for (decoder_info& decoder : d_decoders) {
-          if (decoder.d_input != decoder_info::NO_INPUT) {
-              if (ninput_items.at(decoder.d_input) == 0) {
-                  std::cerr << "No samples on input " << decoder.d_input << ", deallocating a decoder\n";
-                  decoder.d_input = decoder_info::NO_INPUT;
-                  local_decoder_surplus += 1;
+      update_decoders(ninput_items.size(), output_items.size());
+      if (d_have_new_priorities.load()) {
+          apply_new_priorities();
+      }
+      const allocation_policy policy = d_policy.load();
+      d_call_count++;
+      d_input_consumed.assign(ninput_items.size(), 0);
+      d_output_produced.assign(output_items.size(), 0);
+      d_waiting.clear();
+
+      // First, send items to inputs that already have decoders. Each input
+      // is handled in constant time.
+      for (std::size_t in_index = 0; in_index < ninput_items.size(); in_index++) {
+          input_info& input = d_inputs[in_index];
+          if (input.d_decoder == NO_DECODER) {
+              continue;
+          }
+          if (ninput_items[in_index] == 0 && input.queued_items() == 0) {
+              // If a decoder is being used for an input that has no
+              // samples, disassociate the input from the decoder and make
+              // it available again (unless the policy keeps it until
+              // another input needs it)
+              if (policy != PREEMPT_OLDEST_IDLE) {
+                  release_decoder(in_index);
               }
+              continue;
           }
+          start_transfer(in_index, noutput_items, ninput_items, input_items,
+              output_items);
       }
-
-      // Copy items across each connection
-      for (int out_index = 0; out_index < d_decoders.size(); out_index++) {
-          const decoder_info& decoder = d_decoders[out_index];
-          if (decoder.d_input != decoder_info::NO_INPUT) {
-              const int in_index = decoder.d_input;
-
-              // Calculate the number of items to process
-              const int item_count = std::min(ninput_items.at(in_index), noutput_items);
-
-              const void* input = input_items.at(in_index);
-              void* output = output_items.at(out_index);
-
-              // Add a stream tag to this output, specifying which input the
-              // samples came from
-              add_source_tag(in_index, out_index);
-
-              std::memcpy(output, input, item_count * d_item_size);
-              // Tell the scheduler that items were processed
-              consume(in_index, item_count);
-              produce(out_index, item_count);
+      finish_transfers();
+
+      // Find the inputs that are waiting for decoders
+      for (std::size_t in_index = 0; in_index < ninput_items.size(); in_index++) {
+          input_info& input = d_inputs[in_index];
+          const bool has_items = ninput_items[in_index] > d_input_consumed[in_index]
+              || input.queued_items() != 0;
+          if (input.d_decoder == NO_DECODER && has_items) {
+              if (!input.d_waiting) {
+                  input.d_waiting = true;
+                  input.d_wait_since = d_call_count;
+              }
+              d_waiting.push_back(in_index);
           }
       }
 
-      // Existing connections have been processed. Look for inputs that still
-      // need to be handled
-      for (int in_index = 0; in_index < ninput_items.size(); in_index++) {
-          const auto items_read = nitems_read(in_index);
-          const auto items_in = ninput_items.at(in_index);
-
-          if (items_in != 0 && items_in != items_read) {
-              // This input has new samples that have not been processed
-              // Look for an available decoder
-              std::vector<decoder_info>::iterator new_decoder = find_unused_decoder();
-              if (new_decoder != d_decoders.end()) {
-                  // Found one. Connect it and copy samples.
-                  const size_t out_index = std::distance(d_decoders.begin(), new_decoder);
-
-                  new_decoder->d_input = in_index;
-
-                  // Calculate the number of items to process
-                  const int item_count = std::min(ninput_items.at(in_index), noutput_items);
-
-                  // Add a stream tag to this output, specifying which input the
-                  // samples came from
-                  add_source_tag(in_index, out_index);
-
-                  std::cerr << "Assigning input " << in_index << " to output " << out_index << " and copying " << item_count << " items\n";
-
-                  const void* input = input_items.at(in_index);
-                  void* output = output_items.at(out_index);
-
-                  std::memcpy(output, input, item_count * d_item_size);
-                  // Tell the scheduler that items were processed
-                  consume(in_index, item_count);
-                  produce(out_index, item_count);
-
-              } else {
-                  // No decoder found
-                  // Nothing to do but indicate a decoder deficit
-                  local_decoder_surplus -= 1;
+      // Then give decoders to waiting inputs, in the order that the policy
+      // chooses
+      const std::size_t free_decoders = d_free_zero_copy.size() + d_free_outputs.size();
+      if (d_waiting.size() > free_decoders || policy == PREEMPT_OLDEST_IDLE) {
+          order_waiting_inputs(policy);
+      }
+      std::size_t next_waiting = 0;
+      while (next_waiting < d_waiting.size()) {
+          for (; next_waiting < d_waiting.size(); next_waiting++) {
+              const int in_index = d_waiting[next_waiting];
+              int decoder_index = assign_decoder(in_index);
+              if (decoder_index == NO_DECODER && policy == PREEMPT_OLDEST_IDLE) {
+                  decoder_index = preempt_decoder(in_index, ninput_items);
               }
+              if (decoder_index == NO_DECODER) {
+                  break;
+              }
+              d_inputs[in_index].d_waiting = false;
+              d_round_robin_next = in_index + 1;
+              start_transfer(in_index, noutput_items, ninput_items, input_items,
+                  output_items);
+          }
+          if (d_transfers.empty()) {
+              break;
           }
+          // Decoders that these transfers release can go to the inputs that
+          // are still waiting
+          finish_transfers();
+      }
+      int unserved_inputs = 0;
+      for (; next_waiting < d_waiting.size(); next_waiting++) {
+          // No decoder found
+          // Keep as many items as possible here instead of upstream,
+          // and indicate a decoder deficit
+          enqueue_items(d_waiting[next_waiting], ninput_items, input_items);
+          unserved_inputs += 1;
       }
 
       // Update the atomic decoder surplus value
+      const int local_decoder_surplus = static_cast<int>(
+          d_free_zero_copy.size() + d_free_outputs.size()) - unserved_inputs;
       d_decoder_surplus = local_decoder_surplus;
 
-      if (local_decoder_surplus < 0) {
-          std::cerr << "Decoder surplus " << local_decoder_surplus << '\n';
+      if (unserved_inputs != 0) {
+          increment(d_deficits);
+          if (d_deficit_log_limiter.allow()) {
+              GR_LOG_WARN(d_logger, "Decoder surplus " << local_decoder_surplus
+                  << " (" << d_deficit_log_limiter.suppressed()
+                  << " similar messages suppressed)");
+          }
       }
 
       // This special value allows different numbers of output samples for
@@ -179,34 +222,379 @@ namespace gr {
 
     void
     sample_distributor_impl::add_source_tag(int in_index, int out_index) {
+        if (d_output_sources[out_index] == in_index) {
+            // The last tag on this output still applies
+            return;
+        }
+        d_output_sources[out_index] = in_index;
         gr::tag_t tag;
         tag.offset = nitems_written(out_index);
-        tag.key = pmt::intern("source");
+        tag.key = d_source_key;
         tag.value = pmt::from_long(in_index);
-        tag.srcid = pmt::intern("sample_distributor");
+        tag.srcid = d_source_id;
         add_item_tag(out_index, tag);
     }
 
-    std::vector<sample_distributor_impl::decoder_info>::iterator
-    sample_distributor_impl::find_unused_decoder()
+    void
+    sample_distributor_impl::start_transfer(int in_index,
+        int noutput_items,
+        const gr_vector_int& ninput_items,
+        const gr_vector_const_void_star& input_items,
+        const gr_vector_void_star& output_items)
+    {
+        const input_info& input = d_inputs[in_index];
+        const decoder_info& decoder = d_decoders[input.d_decoder];
+        item_transfer transfer = item_transfer();
+        transfer.input = in_index;
+        transfer.decoder = input.d_decoder;
+
+        // Queued items go first
+        if (input.queued_items() != 0) {
+            transfer.queue_count = static_cast<int>(std::min<std::size_t>(
+                input.queued_items(), std::numeric_limits<int>::max()));
+            if (!input.d_queue_releases.empty()) {
+                const std::uint64_t until_release = input.d_queue_releases.front()
+                    - input.d_queue_popped + 1;
+                if (until_release <= static_cast<std::uint64_t>(transfer.queue_count)) {
+                    transfer.queue_count = static_cast<int>(until_release);
+                    transfer.queue_release = true;
+                }
+            }
+            transfer.queue_items = input.d_queue.data()
+                + input.d_queue_start * d_item_size;
+        }
+
+        // Then new items from the input buffer, unless the queued items end
+        // with a release tag
+        const int already_consumed = d_input_consumed[in_index];
+        if (!transfer.queue_release && ninput_items[in_index] > already_consumed) {
+            transfer.item_count = ninput_items[in_index] - already_consumed;
+            // A release tag ends the use of this decoder after the tagged item
+            const int release_offset = find_release_tag(in_index,
+                nitems_read(in_index), transfer.item_count);
+            if (release_offset != -1) {
+                transfer.item_count = release_offset + 1;
+                transfer.release = true;
+            }
+            transfer.items = static_cast<const char*>(input_items[in_index])
+                + already_consumed * d_item_size;
+        }
+
+        if (decoder.d_zero_copy) {
+            decoder.d_zero_copy->start(transfer);
+        } else {
+            const int out_index = decoder.d_output;
+            transfer.run([&](const char* items, int item_count) {
+                return send_to_output(in_index, out_index, items, item_count,
+                    noutput_items, output_items);
+            });
+        }
+        d_transfers.push_back(transfer);
+    }
+
+    void
+    sample_distributor_impl::finish_transfers()
+    {
+        for (const item_transfer& started : d_transfers) {
+            const std::shared_ptr<decoder_thread>& thread =
+                d_decoders[started.decoder].d_zero_copy;
+            const bool release = finish_transfer(thread ? thread->wait() : started);
+            if (release) {
+                release_decoder(started.input);
+            }
+        }
+        d_transfers.clear();
+    }
+
+    bool
+    sample_distributor_impl::finish_transfer(const item_transfer& transfer)
+    {
+        const int in_index = transfer.input;
+        input_info& input = d_inputs[in_index];
+        bool release = false;
+        if (transfer.queue_count != 0) {
+            input.d_queue_start += transfer.queue_sent;
+            input.d_queue_popped += transfer.queue_sent;
+            if (input.queued_items() == 0) {
+                input.d_queue.clear();
+                input.d_queue_start = 0;
+            }
+            if (transfer.queue_release && transfer.queue_sent == transfer.queue_count) {
+                input.d_queue_releases.pop_front();
+                release = true;
+            }
+        }
+        if (transfer.sent != 0) {
+            // Items that were not sent stay in the input buffer and will
+            // be offered again
+            consume(in_index, transfer.sent);
+            d_input_consumed[in_index] += transfer.sent;
+            release = release
+                || (transfer.release && transfer.sent == transfer.item_count);
+        }
+        if (transfer.queue_sent != 0 || transfer.sent != 0) {
+            mark_active(in_index);
+        }
+        return release;
+    }
+
+    void
+    sample_distributor_impl::mark_active(int in_index)
+    {
+        input_info& input = d_inputs[in_index];
+        // Most recently active inputs are at the end
+        d_assigned_inputs.splice(d_assigned_inputs.end(), d_assigned_inputs,
+            input.d_assigned_position);
+        input.d_last_active = d_call_count;
+    }
+
+    int
+    sample_distributor_impl::send_to_output(int in_index, int out_index,
+        const char* items, int item_count, int noutput_items,
+        const gr_vector_void_star& output_items)
+    {
+        // An output can be used by more than one input in one call if a
+        // decoder is released and assigned again
+        const int produced = d_output_produced[out_index];
+        const int count = std::min(item_count, noutput_items - produced);
+        if (count == 0) {
+            return 0;
+        }
+        // Add a stream tag to this output, specifying which input the
+        // samples came from
+        add_source_tag(in_index, out_index);
+
+        char* output = static_cast<char*>(output_items[out_index])
+            + produced * d_item_size;
+        std::memcpy(output, items, count * d_item_size);
+        // Tell the scheduler that items were processed
+        produce(out_index, count);
+        d_output_produced[out_index] += count;
+        return count;
+    }
+
+    void
+    sample_distributor_impl::enqueue_items(int in_index,
+        const gr_vector_int& ninput_items,
+        const gr_vector_const_void_star& input_items)
+    {
+        input_info& input = d_inputs[in_index];
+        const int already_consumed = d_input_consumed[in_index];
+        const std::size_t space = d_max_queue_items - std::min(d_max_queue_items,
+            input.queued_items());
+        const int item_count = static_cast<int>(std::min<std::size_t>(space,
+            ninput_items[in_index] - already_consumed));
+        if (item_count == 0) {
+            return;
+        }
+
+        // Remember where the release tags were
+        const std::uint64_t start = nitems_read(in_index);
+        get_tags_in_range(d_tags, in_index, start, start + item_count, d_release_key);
+        std::sort(d_tags.begin(), d_tags.end(), gr::tag_t::offset_compare);
+        for (const gr::tag_t& tag : d_tags) {
+            input.d_queue_releases.push_back(input.d_queue_pushed + (tag.offset - start));
+        }
+
+        // Discard sent items before adding more
+        if (input.d_queue_start != 0) {
+            input.d_queue.erase(input.d_queue.begin(),
+                input.d_queue.begin() + input.d_queue_start * d_item_size);
+            input.d_queue_start = 0;
+        }
+        const char* items = static_cast<const char*>(input_items[in_index])
+            + already_consumed * d_item_size;
+        input.d_queue.insert(input.d_queue.end(), items, items + item_count * d_item_size);
+        input.d_queue_pushed += item_count;
+        increment(d_queued_items, item_count);
+        consume(in_index, item_count);
+        d_input_consumed[in_index] += item_count;
+    }
+
+    int
+    sample_distributor_impl::find_release_tag(int in_index, std::uint64_t start, int count)
+    {
+        get_tags_in_range(d_tags, in_index, start, start + count, d_release_key);
+        if (d_tags.empty()) {
+            return -1;
+        }
+        std::uint64_t first_tag_offset = d_tags.front().offset;
+        for (const gr::tag_t& tag : d_tags) {
+            first_tag_offset = std::min(first_tag_offset, tag.offset);
+        }
+        return static_cast<int>(first_tag_offset - start);
+    }
+
+    void
+    sample_distributor_impl::order_waiting_inputs(allocation_policy policy)
+    {
+        const std::vector<input_info>& inputs = d_inputs;
+        switch (policy) {
+        case ROUND_ROBIN:
+        {
+            const std::size_t input_count = inputs.size();
+            const std::size_t next = d_round_robin_next % std::max<std::size_t>(input_count, 1);
+            std::sort(d_waiting.begin(), d_waiting.end(), [=](int a, int b) {
+                return (a + input_count - next) % input_count
+                    < (b + input_count - next) % input_count;
+            });
+            break;
+        }
+        case WEIGHTED_PRIORITY:
+            std::sort(d_waiting.begin(), d_waiting.end(), [&](int a, int b) {
+                if (inputs[a].d_priority != inputs[b].d_priority) {
+                    return inputs[a].d_priority > inputs[b].d_priority;
+                }
+                return inputs[a].d_wait_since < inputs[b].d_wait_since;
+            });
+            break;
+        case FIRST_COME:
+        case PREEMPT_OLDEST_IDLE:
+        default:
+            // Stable so that inputs that started waiting at the same time
+            // go in order of index
+            std::stable_sort(d_waiting.begin(), d_waiting.end(), [&](int a, int b) {
+                return inputs[a].d_wait_since < inputs[b].d_wait_since;
+            });
+            break;
+        }
+    }
+
+    int
+    sample_distributor_impl::assign_decoder(int in_index)
+    {
+        std::vector<int>* free_list = nullptr;
+        // Prefer a decoder that does not need the samples copied
+        if (!d_free_zero_copy.empty()) {
+            free_list = &d_free_zero_copy;
+        } else if (!d_free_outputs.empty()) {
+            free_list = &d_free_outputs;
+        } else {
+            return NO_DECODER;
+        }
+        const int decoder_index = free_list->back();
+        free_list->pop_back();
+
+        decoder_info& decoder = d_decoders[decoder_index];
+        input_info& input = d_inputs[in_index];
+        decoder.d_input = in_index;
+        input.d_decoder = decoder_index;
+        input.d_assigned_position = d_assigned_inputs.insert(d_assigned_inputs.end(), in_index);
+        input.d_last_active = d_call_count;
+        increment(d_assignments);
+        if (d_assignment_log_limiter.allow()) {
+            GR_LOG_DEBUG(d_logger, "Assigning input " << in_index << " to "
+                << (decoder.d_zero_copy ? "zero-copy decoder " : "output ")
+                << (decoder.d_zero_copy ? decoder_index : decoder.d_output)
+                << " (" << d_assignment_log_limiter.suppressed()
+                << " similar messages suppressed)");
+        }
+        return decoder_index;
+    }
+
+    int
+    sample_distributor_impl::preempt_decoder(int in_index,
+        const gr_vector_int& ninput_items)
+    {
+        if (d_assigned_inputs.empty()) {
+            return NO_DECODER;
+        }
+        // The first input is the one that least recently sent items. Only
+        // take its decoder if it has nothing to send and did not send
+        // anything in this call.
+        const int idle_input = d_assigned_inputs.front();
+        if (ninput_items[idle_input] != d_input_consumed[idle_input]
+                || d_inputs[idle_input].queued_items() != 0
+                || d_inputs[idle_input].d_last_active == d_call_count) {
+            return NO_DECODER;
+        }
+        increment(d_preemptions);
+        release_decoder(idle_input);
+        return assign_decoder(in_index);
+    }
+
+    void
+    sample_distributor_impl::release_decoder(int in_index)
+    {
+        input_info& input = d_inputs[in_index];
+        const int decoder_index = input.d_decoder;
+        decoder_info& decoder = d_decoders[decoder_index];
+        increment(d_releases);
+        decoder.d_input = decoder_info::NO_INPUT;
+        input.d_decoder = NO_DECODER;
+        d_assigned_inputs.erase(input.d_assigned_position);
+        if (decoder.d_zero_copy) {
+            decoder.d_zero_copy->decoder()->release(in_index);
+            d_free_zero_copy.push_back(decoder_index);
+        } else {
+            d_free_outputs.push_back(decoder_index);
+        }
+    }
+
+    void
+    sample_distributor_impl::update_decoders(std::size_t num_inputs,
+        std::size_t num_outputs)
     {
-        for (auto iter = d_decoders.begin(); iter != d_decoders.end(); ++iter) {
-            if (iter->d_input == decoder_info::NO_INPUT) {
-                return iter;
+        if (num_inputs != d_inputs.size()) {
+            // Release decoders of inputs that no longer exist
+            for (std::size_t in_index = num_inputs; in_index < d_inputs.size(); in_index++) {
+                if (d_inputs[in_index].d_decoder != NO_DECODER) {
+                    release_decoder(in_index);
+                }
+            }
+            d_inputs.resize(num_inputs);
+            apply_new_priorities();
+        }
+        if (num_outputs == d_output_count) {
+            return;
+        }
+        GR_LOG_INFO(d_logger, "Changing number of output decoders to " << num_outputs);
+
+        // Start again with all decoders unused
+        for (std::size_t in_index = 0; in_index < d_inputs.size(); in_index++) {
+            if (d_inputs[in_index].d_decoder != NO_DECODER) {
+                release_decoder(in_index);
+            }
+        }
+        d_decoders.erase(std::remove_if(d_decoders.begin(), d_decoders.end(),
+            [](const decoder_info& decoder) {
+                return decoder.d_output != decoder_info::NO_OUTPUT;
+            }), d_decoders.end());
+        for (std::size_t out_index = 0; out_index < num_outputs; out_index++) {
+            decoder_info decoder;
+            decoder.d_output = out_index;
+            d_decoders.push_back(decoder);
+        }
+        d_output_count = num_outputs;
+        d_output_sources.assign(num_outputs, decoder_info::NO_INPUT);
+
+        // Lower-numbered decoders are at the end of the free lists, so they
+        // get used first
+        d_free_zero_copy.clear();
+        d_free_outputs.clear();
+        for (int i = static_cast<int>(d_decoders.size()) - 1; i >= 0; i--) {
+            if (d_decoders[i].d_zero_copy) {
+                d_free_zero_copy.push_back(i);
+            } else {
+                d_free_outputs.push_back(i);
             }
         }
-        // None found
-        return d_decoders.end();
     }
 
     void
-    sample_distributor_impl::update_decoders(std::size_t num_outputs)
+    sample_distributor_impl::apply_new_priorities()
     {
-        if (num_outputs != d_decoders.size()) {
-            std::cerr << "Changing number of decoders to " << num_outputs << '\n';
+        std::lock_guard<std::mutex> guard(d_new_priorities_mutex);
+        // Priorities for inputs that are not connected yet stay in the map
+        for (auto iter = d_new_priorities.begin(); iter != d_new_priorities.end();) {
+            if (iter->first >= 0 && static_cast<std::size_t>(iter->first) < d_inputs.size()) {
+                d_inputs[iter->first].d_priority = iter->second;
+                iter = d_new_priorities.erase(iter);
+            } else {
+                ++iter;
+            }
         }
-        // Resize, default-constructing new elements if needed
-        d_decoders.resize(num_outputs);
+        d_have_new_priorities.store(false);
     }
 
     int
@@ -216,5 +604,42 @@ namespace gr {
         return d_decoder_surplus;
     }
 
+    void
+    sample_distributor_impl::add_zero_copy_decoder(zero_copy_decoder::sptr decoder)
+    {
+        decoder_info info;
+        info.d_zero_copy = std::make_shared<decoder_thread>(decoder);
+        d_decoders.push_back(info);
+        // Lower-numbered zero-copy decoders get used first
+        d_free_zero_copy.insert(d_free_zero_copy.begin(),
+            static_cast<int>(d_decoders.size() - 1));
+    }
+
+    void
+    sample_distributor_impl::set_allocation_policy(allocation_policy policy)
+    {
+        d_policy.store(policy);
+    }
+
+    void
+    sample_distributor_impl::set_priority(int input, float priority)
+    {
+        std::lock_guard<std::mutex> guard(d_new_priorities_mutex);
+        d_new_priorities[input] = priority;
+        d_have_new_priorities.store(true);
+    }
+
+    sample_distributor_stats
+    sample_distributor_impl::stats() const
+    {
+        sample_distributor_stats stats;
+        stats.assignments = d_assignments.load(std::memory_order_relaxed);
+        stats.releases = d_releases.load(std::memory_order_relaxed);
+        stats.preemptions = d_preemptions.load(std::memory_order_relaxed);
+        stats.deficits = d_deficits.load(std::memory_order_relaxed);
+        stats.queued_items = d_queued_items.load(std::memory_order_relaxed);
+        return stats;
+    }
+
   } /* namespace sparsdr */
 } /* namespace gr */
@@ -22,8 +22,15 @@
 #define INCLUDED_SPARSDR_SAMPLE_DISTRIBUTOR_IMPL_H
 
 #include <sparsdr/sample_distributor.h>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
 #include <vector>
 #include <atomic>
+#include <memory>
+#include "decoder_thread.h"
+#include "log_rate_limiter.h"
 
 namespace gr {
   namespace sparsdr {
@@ -41,26 +48,192 @@ namespace gr {
       public:
         /** Special value that indicates that this decoder is not in use */
         static const int NO_INPUT = -1;
+        /** Special value of d_output for a zero-copy decoder */
+        static const int NO_OUTPUT = -1;
         /** The index of the input that is using this decoder */
         int d_input;
+        /** The output that leads to this decoder, or NO_OUTPUT */
+        int d_output;
+        /**
+         * The thread that runs the decoder that reads samples in place, or
+         * null if this decoder reads samples copied to an output
+         */
+        std::shared_ptr<decoder_thread> d_zero_copy;
 
         /** Creates a decoder_info with d_input set to NO_INPUT */
-        inline decoder_info() : d_input(NO_INPUT) {}
+        inline decoder_info() : d_input(NO_INPUT), d_output(NO_OUTPUT), d_zero_copy() {}
+      };
+
+      /** Special value of input_info::d_decoder for an input with no decoder */
+      static const int NO_DECODER = -1;
+
+      /**
+       * Information about an input
+       */
+      class input_info
+      {
+      public:
+        /** The index in d_decoders of the decoder this input is using, or NO_DECODER */
+        int d_decoder;
+        /** True if this input has samples and is waiting for a decoder */
+        bool d_waiting;
+        /** The call to general_work() when this input started waiting */
+        std::uint64_t d_wait_since;
+        /** Priority for the WEIGHTED_PRIORITY policy */
+        float d_priority;
+        /**
+         * The last call to general_work() when this input got a decoder or
+         * sent items to its decoder
+         */
+        std::uint64_t d_last_active;
+        /**
+         * Position of this input in d_assigned_inputs (only valid if
+         * d_decoder is not NO_DECODER)
+         */
+        std::list<int>::iterator d_assigned_position;
+
+        /**
+         * Items queued while waiting for a decoder. The items start at
+         * d_queue_start items from the beginning.
+         */
+        std::vector<char> d_queue;
+        /** The number of items at the beginning of d_queue that have been sent */
+        std::size_t d_queue_start;
+        /** The total number of items that have been removed from the queue */
+        std::uint64_t d_queue_popped;
+        /**
+         * For each queued item with a release tag, the number of items that
+         * had been added to the queue before it
+         */
+        std::deque<std::uint64_t> d_queue_releases;
+        /** The total number of items that have been added to the queue */
+        std::uint64_t d_queue_pushed;
+
+        inline input_info()
+          : d_decoder(NO_DECODER),
+            d_waiting(false),
+            d_wait_since(0),
+            d_priority(0),
+            d_last_active(0),
+            d_assigned_position(),
+            d_queue(),
+            d_queue_start(0),
+            d_queue_popped(0),
+            d_queue_releases(),
+            d_queue_pushed(0)
+        {}
+
+        /** Returns the number of items in the queue */
+        inline std::size_t queued_items() const
+        {
+            return d_queue_pushed - d_queue_popped;
+        }
       };
 
       /** The size of stream items this block processes */
       int d_item_size;
 
+      /** The allocation policy */
+      std::atomic<allocation_policy> d_policy;
+
+      /** The maximum number of items to queue for each input */
+      std::size_t d_max_queue_items;
+
       /**
-       * The decoders available for this block to use
-       *
-       * Each index in this vector is also an output index for this block.
+       * All decoders available for this block to use: zero-copy decoders
+       * and one decoder for each connected output
        *
        * Thread safety: Access only from the general_work function in the
-       * block thread
+       * block thread (after the flowgraph has started)
        */
       std::vector<decoder_info> d_decoders;
 
+      /** The number of outputs that have entries in d_decoders */
+      std::size_t d_output_count;
+
+      /**
+       * Indexes in d_decoders of zero-copy decoders that are not in use
+       *
+       * This is a stack. Decoders are taken from and returned to the end.
+       */
+      std::vector<int> d_free_zero_copy;
+
+      /**
+       * Indexes in d_decoders of output decoders that are not in use
+       *
+       * This is a stack. Decoders are taken from and returned to the end.
+       */
+      std::vector<int> d_free_outputs;
+
+      /** Information about each input */
+      std::vector<input_info> d_inputs;
+
+      /**
+       * Inputs that have decoders, ordered from the one that least recently
+       * sent items to its decoder to the one that most recently did
+       */
+      std::list<int> d_assigned_inputs;
+
+      /** Inputs waiting for decoders in the current call to general_work() */
+      std::vector<int> d_waiting;
+
+      /**
+       * Transfers started and not yet finished in the current call
+       *
+       * Zero-copy decoders run these on their own threads, so all the
+       * transfers in this list can run at the same time.
+       */
+      std::vector<item_transfer> d_transfers;
+
+      /** The number of items consumed from each input in the current call */
+      std::vector<int> d_input_consumed;
+      /** The number of items produced on each output in the current call */
+      std::vector<int> d_output_produced;
+
+      /** The number of calls to general_work() so far */
+      std::uint64_t d_call_count;
+
+      /**
+       * The input after the one that most recently got a decoder
+       * (for the ROUND_ROBIN policy)
+       */
+      std::size_t d_round_robin_next;
+
+      /** Priorities from set_priority() that have not been applied yet */
+      std::map<int, float> d_new_priorities;
+      /** Controls access to d_new_priorities */
+      std::mutex d_new_priorities_mutex;
+      /** True if d_new_priorities is not empty */
+      std::atomic<bool> d_have_new_priorities;
+
+      /** Key of the tag that marks the last item before a decoder release */
+      const pmt::pmt_t d_release_key;
+      /** Key of the tag that identifies the input of the items on an output */
+      const pmt::pmt_t d_source_key;
+      /** Source ID for tags that this block adds */
+      const pmt::pmt_t d_source_id;
+
+      /**
+       * For each output, the input that the last source tag identified, or
+       * decoder_info::NO_INPUT
+       */
+      std::vector<int> d_output_sources;
+
+      /** Limits the rate of messages about decoder assignment */
+      log_rate_limiter d_assignment_log_limiter;
+      /** Limits the rate of messages about decoder deficits */
+      log_rate_limiter d_deficit_log_limiter;
+
+      /** Statistics, written only by the block thread */
+      std::atomic<std::uint64_t> d_assignments;
+      std::atomic<std::uint64_t> d_releases;
+      std::atomic<std::uint64_t> d_preemptions;
+      std::atomic<std::uint64_t> d_deficits;
+      std::atomic<std::uint64_t> d_queued_items;
+
+      /** Tags found on the current input (kept to avoid reallocation) */
+      std::vector<gr::tag_t> d_tags;
+
       /**
        * The number of decoders this block has available but did not use
        * in the last call to general_work()
@@ -71,23 +244,108 @@ namespace gr {
       std::atomic_int d_decoder_surplus;
 
       /**
-       * Finds a decoder in d_decoders that is not connected to any input.
+       * Takes a decoder from the free lists, preferring a zero-copy decoder,
+       * and assigns it to an input
        *
-       * If an unused decoder is found, this function returns an iterator that
-       * points to it. Otherwise, this function returns d_decoders.end().
+       * @return the index of the decoder in d_decoders, or NO_DECODER if
+       * none is available
        */
-      std::vector<decoder_info>::iterator find_unused_decoder();
+      int assign_decoder(int in_index);
+
+      /**
+       * Releases the decoder of the input that has been idle for the
+       * longest time and assigns it to another input
+       *
+       * @return the index of the decoder in d_decoders, or NO_DECODER if
+       * no input with a decoder is idle
+       */
+      int preempt_decoder(int in_index, const gr_vector_int& ninput_items);
+
+      /**
+       * Disassociates the decoder that an input is using and returns it to
+       * its free list
+       */
+      void release_decoder(int in_index);
 
       /**
        * Updates d_decoders, adding and removing decoder information objects
-       * so that the size of d_decoders matches this block's number of connected
-       * outputs
+       * so that the number of output decoders matches this block's number of
+       * connected outputs, and resizes d_inputs to the number of
+       * connected inputs
+       */
+      void update_decoders(std::size_t num_inputs, std::size_t num_outputs);
+
+      /** Copies priorities from d_new_priorities into d_inputs */
+      void apply_new_priorities();
+
+      /**
+       * Sorts d_waiting so that the inputs that should get decoders first
+       * come first
+       */
+      void order_waiting_inputs(allocation_policy policy);
+
+      /**
+       * Starts sending queued and then new items from an input to its
+       * assigned decoder, and adds the transfer to d_transfers
+       *
+       * Items copied to an output are sent before this function returns.
+       * A zero-copy decoder receives the items on its own thread, and the
+       * items stay in place until finish_transfers() returns.
+       */
+      void start_transfer(int in_index, int noutput_items,
+          const gr_vector_int& ninput_items,
+          const gr_vector_const_void_star& input_items,
+          const gr_vector_void_star& output_items);
+
+      /**
+       * Waits for all transfers in d_transfers, removes the items that the
+       * decoders accepted from the queues and input buffers, and releases
+       * the decoders that processed all items up to a release tag
        */
-      void update_decoders(std::size_t num_outputs);
+      void finish_transfers();
+
+      /**
+       * Removes the items that a decoder accepted from the queue and input
+       * buffer of its input
+       *
+       * @return true if the items included a release tag and the decoder
+       * processed all items up to it
+       */
+      bool finish_transfer(const item_transfer& transfer);
+
+      /**
+       * Records that an input has sent items to its decoder
+       */
+      void mark_active(int in_index);
+
+      /**
+       * Copies items to an output, up to the space available
+       *
+       * @return the number of items copied
+       */
+      int send_to_output(int in_index, int out_index,
+          const char* items, int item_count, int noutput_items,
+          const gr_vector_void_star& output_items);
+
+      /**
+       * Moves new items from an input into its queue, up to the queue size
+       * limit
+       */
+      void enqueue_items(int in_index, const gr_vector_int& ninput_items,
+          const gr_vector_const_void_star& input_items);
+
+      /**
+       * Finds the first release tag in a range of items on an input
+       *
+       * @return the offset of the tagged item relative to start, or -1 if
+       * there is no release tag
+       */
+      int find_release_tag(int in_index, std::uint64_t start, int count);
 
       /**
        * Adds a stream tag to the next output sample, specifying that the sample
-       * came from a particular source
+       * came from a particular source, if the last tag on the output specified
+       * a different source
        *
        * @param in_index The index of the input where the sample came in
        * @param out_index The index of the output where the sample and the
@@ -95,8 +353,19 @@ namespace gr {
        */
       void add_source_tag(int in_index, int out_index);
 
+      /** Adds to a statistic (only called from the block thread) */
+      static inline void increment(std::atomic<std::uint64_t>& counter,
+          std::uint64_t amount = 1)
+      {
+          // Only one thread writes, so this does not need a read-modify-write
+          // operation
+          counter.store(counter.load(std::memory_order_relaxed) + amount,
+              std::memory_order_relaxed);
+      }
+
      public:
-      sample_distributor_impl(int item_size);
+      sample_distributor_impl(int item_size, allocation_policy policy,
+          int max_queue_items);
       ~sample_distributor_impl();
 
       void forecast (int noutput_items, gr_vector_int &ninput_items_required);
@@ -107,6 +376,10 @@ namespace gr {
            gr_vector_void_star &output_items);
 
       virtual int decoder_surplus() const override;
+      virtual void add_zero_copy_decoder(zero_copy_decoder::sptr decoder) override;
+      virtual void set_allocation_policy(allocation_policy policy) override;
+      virtual void set_priority(int input, float priority) override;
+      virtual sample_distributor_stats stats() const override;
     };
 
   } // namespace sparsdr
@@ -0,0 +1,287 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shm_ring.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    namespace {
+    const std::uint32_t MAGIC = 0x474e5253;
+    const std::uint32_t VERSION = 1;
+
+    // Header field offsets (see shm_ring.h)
+    const std::size_t MAGIC_OFFSET = 0;
+    const std::size_t VERSION_OFFSET = 4;
+    const std::size_t CAPACITY_OFFSET = 8;
+    const std::size_t WRITE_POSITION_OFFSET = 64;
+    const std::size_t DATA_FUTEX_OFFSET = 72;
+    const std::size_t READER_WAITING_OFFSET = 76;
+    const std::size_t WRITER_CLOSED_OFFSET = 80;
+    const std::size_t READ_POSITION_OFFSET = 128;
+    const std::size_t SPACE_FUTEX_OFFSET = 136;
+    const std::size_t WRITER_WAITING_OFFSET = 140;
+    const std::size_t READER_CLOSED_OFFSET = 144;
+
+    static_assert(sizeof(std::atomic<std::uint64_t>) == 8
+        && sizeof(std::atomic<std::uint32_t>) == 4,
+        "Header fields must be plain integers");
+
+    void futex_wait(std::atomic<std::uint32_t>& word, std::uint32_t expected,
+        std::chrono::milliseconds timeout)
+    {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+        struct timespec relative;
+        relative.tv_sec = ns / 1000000000;
+        relative.tv_nsec = ns % 1000000000;
+        ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT,
+            expected, &relative, nullptr, 0);
+    }
+
+    void futex_wake(std::atomic<std::uint32_t>& word)
+    {
+        ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE,
+            INT_MAX, nullptr, nullptr, 0);
+    }
+    }
+
+    const std::size_t shm_ring::HEADER_SIZE;
+
+    shm_ring::shm_ring(std::size_t capacity)
+      : d_fd(-1),
+        d_capacity(4096),
+        d_base(nullptr)
+    {
+        while (d_capacity < capacity) {
+            d_capacity *= 2;
+        }
+        const std::size_t length = HEADER_SIZE + d_capacity;
+        d_fd = ::memfd_create("sparsdr_ring", MFD_CLOEXEC);
+        if (d_fd == -1) {
+            throw std::runtime_error(std::string("Can't create shared memory: ")
+                + std::strerror(errno));
+        }
+        if (::ftruncate(d_fd, length) != 0) {
+            const int error = errno;
+            ::close(d_fd);
+            throw std::runtime_error(std::string("Can't resize shared memory: ")
+                + std::strerror(error));
+        }
+        void* base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, d_fd, 0);
+        if (base == MAP_FAILED) {
+            const int error = errno;
+            ::close(d_fd);
+            throw std::runtime_error(std::string("Can't map shared memory: ")
+                + std::strerror(error));
+        }
+        d_base = static_cast<char*>(base);
+        // The new file is all zeros, so only the constant fields need to be
+        // written
+        field32(VERSION_OFFSET).store(VERSION, std::memory_order_relaxed);
+        field64(CAPACITY_OFFSET).store(d_capacity, std::memory_order_relaxed);
+        field32(MAGIC_OFFSET).store(MAGIC, std::memory_order_release);
+    }
+
+    shm_ring::~shm_ring()
+    {
+        ::munmap(d_base, HEADER_SIZE + d_capacity);
+        ::close(d_fd);
+    }
+
+    std::string
+    shm_ring::path() const
+    {
+        std::stringstream stream;
+        stream << "/dev/fd/" << d_fd;
+        return stream.str();
+    }
+
+    void
+    shm_ring::clear_cloexec() const
+    {
+        ::fcntl(d_fd, F_SETFD, 0);
+    }
+
+    std::atomic<std::uint64_t>&
+    shm_ring::field64(std::size_t offset) const
+    {
+        return *reinterpret_cast<std::atomic<std::uint64_t>*>(d_base + offset);
+    }
+
+    std::atomic<std::uint32_t>&
+    shm_ring::field32(std::size_t offset) const
+    {
+        return *reinterpret_cast<std::atomic<std::uint32_t>*>(d_base + offset);
+    }
+
+    std::size_t
+    shm_ring::buffered() const
+    {
+        const std::uint64_t read_position = field64(READ_POSITION_OFFSET).load(std::memory_order_acquire);
+        const std::uint64_t write_position = field64(WRITE_POSITION_OFFSET).load(std::memory_order_acquire);
+        return write_position - read_position;
+    }
+
+    template <typename Ready>
+    void
+    shm_ring::wait(std::size_t waiting_offset, std::size_t futex_offset,
+        std::chrono::milliseconds timeout, Ready ready) const
+    {
+        std::atomic<std::uint32_t>& futex = field32(futex_offset);
+        const std::uint32_t sequence = futex.load(std::memory_order_acquire);
+        field32(waiting_offset).store(1, std::memory_order_seq_cst);
+        // Check again after setting the flag, so that a wake from the other
+        // side can't be missed
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ready()) {
+            futex_wait(futex, sequence, timeout);
+        }
+        field32(waiting_offset).store(0, std::memory_order_relaxed);
+    }
+
+    void
+    shm_ring::wake(std::size_t waiting_offset, std::size_t futex_offset) const
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (field32(waiting_offset).load(std::memory_order_relaxed) != 0) {
+            std::atomic<std::uint32_t>& futex = field32(futex_offset);
+            futex.fetch_add(1, std::memory_order_release);
+            futex_wake(futex);
+        }
+    }
+
+    std::size_t
+    shm_ring::write(const void* items, std::size_t count, std::size_t item_size,
+        std::chrono::milliseconds timeout)
+    {
+        std::atomic<std::uint64_t>& write_field = field64(WRITE_POSITION_OFFSET);
+        std::atomic<std::uint64_t>& read_field = field64(READ_POSITION_OFFSET);
+        const std::uint64_t write_position = write_field.load(std::memory_order_relaxed);
+        const auto space = [&]() {
+            return d_capacity - (write_position - read_field.load(std::memory_order_acquire));
+        };
+        if (reader_closed()) {
+            return 0;
+        }
+        if (space() < item_size) {
+            wait(WRITER_WAITING_OFFSET, SPACE_FUTEX_OFFSET, timeout, [&]() {
+                return space() >= item_size || reader_closed();
+            });
+            if (reader_closed()) {
+                return 0;
+            }
+        }
+        const std::size_t written = std::min(count, space() / item_size);
+        if (written == 0) {
+            return 0;
+        }
+
+        const std::size_t bytes = written * item_size;
+        const std::size_t offset = write_position & (d_capacity - 1);
+        const std::size_t first = std::min(bytes, d_capacity - offset);
+        char* const data = d_base + HEADER_SIZE;
+        std::memcpy(data + offset, items, first);
+        std::memcpy(data, static_cast<const char*>(items) + first, bytes - first);
+        write_field.store(write_position + bytes, std::memory_order_release);
+        wake(READER_WAITING_OFFSET, DATA_FUTEX_OFFSET);
+        return written;
+    }
+
+    bool
+    shm_ring::reader_closed() const
+    {
+        return field32(READER_CLOSED_OFFSET).load(std::memory_order_acquire) != 0;
+    }
+
+    void
+    shm_ring::close_writer()
+    {
+        field32(WRITER_CLOSED_OFFSET).store(1, std::memory_order_release);
+        wake(READER_WAITING_OFFSET, DATA_FUTEX_OFFSET);
+    }
+
+    std::size_t
+    shm_ring::read(void* items, std::size_t count, std::size_t item_size,
+        std::chrono::milliseconds timeout)
+    {
+        std::atomic<std::uint64_t>& write_field = field64(WRITE_POSITION_OFFSET);
+        std::atomic<std::uint64_t>& read_field = field64(READ_POSITION_OFFSET);
+        const std::uint64_t read_position = read_field.load(std::memory_order_relaxed);
+        const auto available = [&]() {
+            return write_field.load(std::memory_order_acquire) - read_position;
+        };
+        if (available() < item_size) {
+            wait(READER_WAITING_OFFSET, DATA_FUTEX_OFFSET, timeout, [&]() {
+                return available() >= item_size
+                    || field32(WRITER_CLOSED_OFFSET).load(std::memory_order_acquire) != 0;
+            });
+        }
+        const std::size_t read_count = std::min<std::size_t>(count, available() / item_size);
+        if (read_count == 0) {
+            return 0;
+        }
+
+        const std::size_t bytes = read_count * item_size;
+        const std::size_t offset = read_position & (d_capacity - 1);
+        const std::size_t first = std::min(bytes, d_capacity - offset);
+        const char* const data = d_base + HEADER_SIZE;
+        std::memcpy(items, data + offset, first);
+        std::memcpy(static_cast<char*>(items) + first, data, bytes - first);
+        read_field.store(read_position + bytes, std::memory_order_release);
+        wake(WRITER_WAITING_OFFSET, SPACE_FUTEX_OFFSET);
+        return read_count;
+    }
+
+    bool
+    shm_ring::finished() const
+    {
+        // Check the flag first, so that data written before the writer
+        // closed the ring is seen
+        return field32(WRITER_CLOSED_OFFSET).load(std::memory_order_acquire) != 0
+            && buffered() == 0;
+    }
+
+    void
+    shm_ring::close_reader()
+    {
+        field32(READER_CLOSED_OFFSET).store(1, std::memory_order_release);
+        wake(WRITER_WAITING_OFFSET, SPACE_FUTEX_OFFSET);
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
@@ -0,0 +1,189 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_SHM_RING_H
+#define INCLUDED_SPARSDR_SHM_RING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <boost/noncopyable.hpp>
+
+/*
+ * Shared-memory ring buffer layout, version 1
+ *
+ * A ring is a memfd that one process writes to and another process reads
+ * from. The other process maps it by opening /dev/fd/[descriptor].
+ * All integers use the native byte order and are accessed atomically.
+ *
+ *   offset 0 : u32 magic ("SRNG", 0x474e5253)
+ *   offset 4 : u32 version (1)
+ *   offset 8 : u64 capacity of the data area in bytes (a power of two)
+ *
+ * Written by the writer:
+ *   offset 64 : u64 write position (total bytes written)
+ *   offset 72 : u32 data futex, incremented to wake the reader
+ *   offset 76 : u32 1 if the reader is waiting for data
+ *   offset 80 : u32 1 if the writer has closed the ring
+ *
+ * Written by the reader:
+ *   offset 128 : u64 read position (total bytes read)
+ *   offset 136 : u32 space futex, incremented to wake the writer
+ *   offset 140 : u32 1 if the writer is waiting for space
+ *   offset 144 : u32 1 if the reader has closed the ring
+ *
+ * The data area starts at offset 4096. Byte n of the stream is at
+ * 4096 + n % capacity.
+ *
+ * After changing a position or a closed flag, each side checks if the
+ * other side is waiting. If it is, it increments the other side's futex
+ * and wakes it with FUTEX_WAKE. A side that has nothing to do sets its
+ * waiting flag, checks again, and then waits with FUTEX_WAIT and a
+ * timeout.
+ */
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief A single-producer single-consumer ring buffer in shared
+     * memory, used to exchange samples with another process
+     *
+     * This process may be either the writer or the reader. The other
+     * process must inherit fd() (see clear_cloexec()) and open path().
+     *
+     * All functions are safe to call from any thread, but only one thread
+     * may write and only one thread may read at a time.
+     */
+    class shm_ring : public boost::noncopyable
+    {
+    public:
+      /*! \brief The size of the header before the data area, in bytes */
+      static const std::size_t HEADER_SIZE = 4096;
+
+      /*!
+       * \brief Creates a ring
+       *
+       * \param capacity the minimum capacity in bytes. This is rounded up
+       * to a power of two.
+       *
+       * \throws std::runtime_error if the memory could not be created or
+       * mapped
+       */
+      explicit shm_ring(std::size_t capacity);
+      ~shm_ring();
+
+      /*! \brief Returns the file descriptor of the shared memory */
+      inline int fd() const
+      {
+          return d_fd;
+      }
+      /*!
+       * \brief Returns a path that a child process can open to map the
+       * ring, if it inherited fd()
+       */
+      std::string path() const;
+      /*!
+       * \brief Lets a child process inherit fd() when it calls exec
+       *
+       * This is intended to be called in a child process after fork.
+       */
+      void clear_cloexec() const;
+
+      /*! \brief Returns the capacity of the data area in bytes */
+      inline std::size_t capacity() const
+      {
+          return d_capacity;
+      }
+      /*! \brief Returns the number of bytes waiting to be read */
+      std::size_t buffered() const;
+
+      /*!
+       * \brief Writes whole items to the ring, waiting up to timeout for
+       * space if the ring is full
+       *
+       * \return the number of items written, which is 0 if the reader has
+       * closed the ring or no space became available
+       */
+      std::size_t write(const void* items, std::size_t count, std::size_t item_size,
+          std::chrono::milliseconds timeout);
+      /*! \brief Returns true if the reader has closed the ring */
+      bool reader_closed() const;
+      /*!
+       * \brief Marks the end of the data and wakes the reader
+       *
+       * The reader reads the remaining data and then gets an end of file.
+       */
+      void close_writer();
+
+      /*!
+       * \brief Reads whole items from the ring, waiting up to timeout for
+       * data if the ring is empty
+       *
+       * \return the number of items read, which is 0 if no data became
+       * available or the ring is finished
+       */
+      std::size_t read(void* items, std::size_t count, std::size_t item_size,
+          std::chrono::milliseconds timeout);
+      /*!
+       * \brief Returns true if the writer has closed the ring and all data
+       * has been read
+       */
+      bool finished() const;
+      /*!
+       * \brief Tells the writer that nothing more will be read and wakes
+       * it
+       *
+       * Later writes fail.
+       */
+      void close_reader();
+
+    private:
+      /*! \brief The shared memory file */
+      int d_fd;
+      /*! \brief The capacity of the data area in bytes */
+      std::size_t d_capacity;
+      /*! \brief The start of the mapped header */
+      char* d_base;
+
+      /*! \brief Returns the 64-bit field at an offset in the header */
+      std::atomic<std::uint64_t>& field64(std::size_t offset) const;
+      /*! \brief Returns the 32-bit field at an offset in the header */
+      std::atomic<std::uint32_t>& field32(std::size_t offset) const;
+
+      /*!
+       * \brief Waits on a futex until ready() returns true, the futex
+       * changes, or the timeout passes
+       */
+      template <typename Ready>
+      void wait(std::size_t waiting_offset, std::size_t futex_offset,
+          std::chrono::milliseconds timeout, Ready ready) const;
+      /*!
+       * \brief Wakes the other side if its waiting flag is set
+       */
+      void wake(std::size_t waiting_offset, std::size_t futex_offset) const;
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_SHM_RING_H */
@@ -0,0 +1,111 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cstdint>
+#include <stdexcept>
+#include <gnuradio/io_signature.h>
+#include "shm_ring_sink.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    namespace {
+    /*! \brief The longest time that work() waits for space */
+    const std::chrono::milliseconds WAIT_TIMEOUT(100);
+    /*! \brief The size of one compressed sample in bytes */
+    const std::size_t SAMPLE_BYTES = 2 * sizeof(std::uint32_t);
+
+    std::size_t
+    check_item_size(std::size_t item_size)
+    {
+        if (item_size == 0 || SAMPLE_BYTES % item_size != 0) {
+            throw std::invalid_argument(
+                "shm_ring_sink item size must evenly divide the size of a "
+                "compressed sample (8 bytes)");
+        }
+        return item_size;
+    }
+    }
+
+    shm_ring_sink::sptr
+    shm_ring_sink::make(std::size_t item_size, std::shared_ptr<shm_ring> ring)
+    {
+      return gnuradio::get_initial_sptr
+        (new shm_ring_sink(item_size, std::move(ring)));
+    }
+
+    shm_ring_sink::shm_ring_sink(std::size_t item_size, std::shared_ptr<shm_ring> ring)
+      : gr::sync_block("shm_ring_sink",
+              gr::io_signature::make(1, 1, check_item_size(item_size)),
+              gr::io_signature::make(0, 0, 0)),
+        d_item_size(item_size),
+        d_items_per_sample(static_cast<int>(SAMPLE_BYTES / item_size)),
+        d_mutex(),
+        d_ring(std::move(ring))
+    {
+        set_output_multiple(d_items_per_sample);
+    }
+
+    std::shared_ptr<shm_ring>
+    shm_ring_sink::ring()
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        return d_ring;
+    }
+
+    void
+    shm_ring_sink::set_ring(std::shared_ptr<shm_ring> ring)
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_ring = std::move(ring);
+    }
+
+    bool
+    shm_ring_sink::stop()
+    {
+        const std::shared_ptr<shm_ring> current = ring();
+        if (current) {
+            current->close_writer();
+        }
+        return true;
+    }
+
+    int
+    shm_ring_sink::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      const std::shared_ptr<shm_ring> current = ring();
+      if (!current || current->reader_closed()) {
+          // Nothing will read these items
+          return noutput_items;
+      }
+      // Write whole samples, so that the reader never gets half of one
+      const std::size_t samples = noutput_items / d_items_per_sample;
+      return d_items_per_sample * current->write(input_items[0], samples,
+          SAMPLE_BYTES, WAIT_TIMEOUT);
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
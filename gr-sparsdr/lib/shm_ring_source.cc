@@ -0,0 +1,80 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "shm_ring_source.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    namespace {
+    /*! \brief The longest time that work() waits for data */
+    const std::chrono::milliseconds WAIT_TIMEOUT(100);
+    }
+
+    shm_ring_source::sptr
+    shm_ring_source::make(std::size_t item_size, std::shared_ptr<shm_ring> ring)
+    {
+      return gnuradio::get_initial_sptr
+        (new shm_ring_source(item_size, std::move(ring)));
+    }
+
+    shm_ring_source::shm_ring_source(std::size_t item_size, std::shared_ptr<shm_ring> ring)
+      : gr::sync_block("shm_ring_source",
+              gr::io_signature::make(0, 0, 0),
+              gr::io_signature::make(1, 1, item_size)),
+        d_item_size(item_size),
+        d_mutex(),
+        d_ring(std::move(ring))
+    {
+    }
+
+    std::shared_ptr<shm_ring>
+    shm_ring_source::ring()
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        return d_ring;
+    }
+
+    void
+    shm_ring_source::set_ring(std::shared_ptr<shm_ring> ring)
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_ring = std::move(ring);
+    }
+
+    int
+    shm_ring_source::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      const std::shared_ptr<shm_ring> current = ring();
+      if (!current || current->finished()) {
+          return WORK_DONE;
+      }
+      return current->read(output_items[0], noutput_items, d_item_size, WAIT_TIMEOUT);
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
@@ -0,0 +1,76 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_SHM_RING_SOURCE_H
+#define INCLUDED_SPARSDR_SHM_RING_SOURCE_H
+
+#include <memory>
+#include <mutex>
+#include <gnuradio/sync_block.h>
+#include "shm_ring.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Reads items from a shared-memory ring
+     *
+     * If the ring is empty, work() waits for a short time and then returns
+     * without producing anything. When the writer has closed the ring and
+     * all items have been read, the output ends.
+     *
+     * This block is used only inside the reconstruct block.
+     */
+    class shm_ring_source : public gr::sync_block
+    {
+    public:
+      typedef boost::shared_ptr<shm_ring_source> sptr;
+
+      static sptr make(std::size_t item_size, std::shared_ptr<shm_ring> ring);
+
+      shm_ring_source(std::size_t item_size, std::shared_ptr<shm_ring> ring);
+
+      /*!
+       * \brief Switches to another ring
+       *
+       * This function is safe to call from any thread. Items left in the
+       * old ring are not read.
+       */
+      void set_ring(std::shared_ptr<shm_ring> ring);
+
+      int work(int noutput_items,
+         gr_vector_const_void_star &input_items,
+         gr_vector_void_star &output_items);
+
+    private:
+      /*! \brief The size of each item in bytes */
+      std::size_t d_item_size;
+      /*! \brief Protects d_ring */
+      std::mutex d_mutex;
+      /*! \brief The ring to read from */
+      std::shared_ptr<shm_ring> d_ring;
+
+      std::shared_ptr<shm_ring> ring();
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_SHM_RING_SOURCE_H */
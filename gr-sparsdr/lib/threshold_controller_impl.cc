@@ -0,0 +1,409 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <boost/bind.hpp>
+#include <gnuradio/io_signature.h>
+#include "threshold_controller_impl.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    namespace {
+    /*! \brief Limits on the margin, so that it can recover quickly */
+    const double MIN_MARGIN = 1.0 / 16.0;
+    const double MAX_MARGIN = 65536.0;
+    /*!
+     * \brief Periods longer than this many times the expected length are
+     * discarded (compression probably stopped or restarted)
+     */
+    const std::uint64_t MAX_PERIOD_FACTOR = 4;
+    }
+
+    threshold_controller::sptr
+    threshold_controller::make(compressing_usrp_source::sptr usrp,
+        double target_rate,
+        std::uint32_t average_interval,
+        double initial_margin,
+        double window_duration)
+    {
+      return gnuradio::get_initial_sptr
+        (new threshold_controller_impl(usrp, target_rate, average_interval,
+            initial_margin, window_duration));
+    }
+
+    /*
+     * The private constructor
+     */
+    threshold_controller_impl::threshold_controller_impl(
+        compressing_usrp_source::sptr usrp,
+        double target_rate,
+        std::uint32_t average_interval,
+        double initial_margin,
+        double window_duration)
+      : gr::sync_block("threshold_controller",
+              gr::io_signature::make(1, 1, sizeof(uint32_t)),
+              gr::io_signature::make(0, 0, 0)),
+        d_usrp(usrp),
+        d_window_duration(window_duration),
+        d_average_interval(average_interval),
+        d_tolerance(average_interval / 8),
+        d_mutex(),
+        d_target_rate(target_rate),
+        d_min_threshold(1 << 11),
+        d_max_threshold(0xffffffffu),
+        d_hysteresis(0.2),
+        d_max_step(2.0),
+        d_max_writes(256),
+        d_update_rows(4),
+        d_margin(initial_margin),
+        d_thresholds(BIN_COUNT, 0),
+        d_thresholds_known(),
+        d_updates(0),
+        d_threshold_writes(0),
+        d_measured_rate(0.0),
+        d_overflow_pending(false),
+        d_samples(),
+        d_time_expander(),
+        d_floor(BIN_COUNT, 0),
+        d_floor_known(),
+        d_have_row(false),
+        d_row_time(0),
+        d_period_start(0),
+        d_period_samples(0),
+        d_update_key(pmt::intern("update")),
+        d_margin_key(pmt::intern("margin")),
+        d_rate_key(pmt::intern("rate")),
+        d_writes_key(pmt::intern("writes"))
+    {
+        if (target_rate <= 0.0) {
+            throw std::invalid_argument("Target rate must be positive");
+        }
+        if (average_interval == 0) {
+            throw std::invalid_argument("Average interval must not be 0");
+        }
+        if (initial_margin <= 0.0 || window_duration <= 0.0) {
+            throw std::invalid_argument(
+                "Initial margin and window duration must be positive");
+        }
+        // Start from the thresholds that are already on the USRP, so that
+        // the first update does not rewrite all of them
+        if (d_usrp) {
+            const compression_config config = d_usrp->config();
+            for (std::uint16_t i = 0; i < BIN_COUNT; i++) {
+                if (config.has_threshold(i)) {
+                    d_thresholds[i] = config.threshold(i);
+                    d_thresholds_known.set(i);
+                }
+            }
+        }
+
+        // Never split a sample across calls to work()
+        set_output_multiple(2);
+        const pmt::pmt_t overflow_port = pmt::intern("overflow");
+        message_port_register_in(overflow_port);
+        set_msg_handler(overflow_port,
+            boost::bind(&threshold_controller_impl::handle_overflow, this, _1));
+        message_port_register_out(d_update_key);
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    threshold_controller_impl::~threshold_controller_impl()
+    {
+    }
+
+    int
+    threshold_controller_impl::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      const uint32_t* in = reinterpret_cast<const uint32_t*>(input_items[0]);
+      const int sample_count = noutput_items / 2;
+      decode_samples(in, sample_count, d_samples);
+
+      for (int i = 0; i < sample_count; i++) {
+          const std::uint64_t time = d_time_expander.expand(d_samples.time[i]);
+          if (!d_samples.is_average(i)) {
+              d_period_samples++;
+              continue;
+          }
+          if (!d_have_row || time - d_row_time > d_tolerance) {
+              start_row(time);
+          }
+          // Follow decreases quickly and increases slowly, so that signals
+          // in a bin do not raise its noise floor much
+          const std::uint16_t bin = d_samples.index[i];
+          const std::uint32_t magnitude = d_samples.magnitude[i];
+          std::uint32_t& floor = d_floor[bin];
+          if (!d_floor_known.test(bin)) {
+              floor = magnitude;
+              d_floor_known.set(bin);
+          } else if (magnitude < floor) {
+              floor -= (floor - magnitude) / 2;
+          } else {
+              floor += (magnitude - floor) / 16;
+          }
+      }
+
+      // Tell runtime system how many output items we produced.
+      return noutput_items;
+    }
+
+    void
+    threshold_controller_impl::start_row(std::uint64_t time)
+    {
+        if (!d_have_row) {
+            d_have_row = true;
+            d_row_time = time;
+            d_period_start = time;
+            d_period_samples = 0;
+            return;
+        }
+        d_row_time = time;
+
+        std::uint64_t period_length;
+        {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            period_length = static_cast<std::uint64_t>(d_update_rows)
+                * d_average_interval;
+        }
+        const std::uint64_t elapsed = time - d_period_start;
+        if (elapsed + d_tolerance < period_length) {
+            return;
+        }
+        if (elapsed <= period_length * MAX_PERIOD_FACTOR) {
+            update(elapsed);
+        }
+        d_period_start = time;
+        d_period_samples = 0;
+    }
+
+    void
+    threshold_controller_impl::update(std::uint64_t elapsed)
+    {
+        // (bin, threshold) for each threshold to write
+        std::vector<std::pair<std::uint16_t, std::uint32_t>> writes;
+        // The thresholds of bins 0 through the last one written
+        std::vector<std::uint32_t> table;
+        double margin;
+        double rate;
+        {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            rate = d_period_samples / (elapsed * d_window_duration);
+            d_measured_rate = rate;
+
+            double factor = 1.0;
+            if (d_overflow_pending) {
+                factor = d_max_step;
+            } else if (rate > d_target_rate * (1.0 + d_hysteresis)) {
+                factor = std::min(rate / d_target_rate, d_max_step);
+            } else if (rate < d_target_rate * (1.0 - d_hysteresis)) {
+                factor = std::max(rate / d_target_rate, 1.0 / d_max_step);
+            }
+            d_overflow_pending = false;
+            d_margin = std::min(std::max(d_margin * factor, MIN_MARGIN), MAX_MARGIN);
+            margin = d_margin;
+
+            // Bins with unknown thresholds are always written. Of the others,
+            // the ones with the largest relative changes are written first.
+            // (relative change, bin, threshold)
+            std::vector<std::pair<double, std::pair<std::uint16_t, std::uint32_t>>>
+                changes;
+            // set_thresholds() writes a table that starts at bin 0, so only
+            // the bins before the first one with no known floor or threshold
+            // can be in it
+            std::uint16_t known_end = 0;
+            while (known_end < BIN_COUNT && (d_floor_known.test(known_end)
+                    || d_thresholds_known.test(known_end))) {
+                known_end++;
+            }
+            for (std::uint16_t i = 0; i < known_end; i++) {
+                if (!d_floor_known.test(i)) {
+                    continue;
+                }
+                const double ideal = std::min(std::max(margin * d_floor[i],
+                    static_cast<double>(d_min_threshold)),
+                    static_cast<double>(d_max_threshold));
+                const std::uint32_t threshold = static_cast<std::uint32_t>(ideal);
+                if (!d_thresholds_known.test(i)) {
+                    writes.push_back(std::make_pair(i, threshold));
+                    continue;
+                }
+                const double current = std::max<std::uint32_t>(d_thresholds[i], 1);
+                const double change = std::abs(ideal - current) / current;
+                if (change > d_hysteresis) {
+                    changes.push_back(std::make_pair(change,
+                        std::make_pair(i, threshold)));
+                }
+            }
+            if (changes.size() > d_max_writes) {
+                std::partial_sort(changes.begin(), changes.begin() + d_max_writes,
+                    changes.end(),
+                    [](const std::pair<double, std::pair<std::uint16_t, std::uint32_t>>& a,
+                        const std::pair<double, std::pair<std::uint16_t, std::uint32_t>>& b) {
+                        return a.first > b.first;
+                    });
+                changes.resize(d_max_writes);
+            }
+            for (const auto& change : changes) {
+                writes.push_back(change.second);
+            }
+            std::size_t table_size = 0;
+            for (const auto& write : writes) {
+                d_thresholds[write.first] = write.second;
+                d_thresholds_known.set(write.first);
+                table_size = std::max<std::size_t>(table_size, write.first + 1);
+            }
+            table.assign(d_thresholds.begin(), d_thresholds.begin() + table_size);
+            d_updates++;
+            d_threshold_writes += writes.size();
+        }
+
+        // Write without holding the lock, so that stats() does not wait
+        // for the USRP
+        if (d_usrp && !table.empty()) {
+            // Bins that this update does not change keep the thresholds
+            // that the USRP has, so that only the changed bins are written
+            const compression_config current = d_usrp->config();
+            std::vector<bool> changed(table.size(), false);
+            for (const auto& write : writes) {
+                changed[write.first] = true;
+            }
+            for (std::uint16_t i = 0; i < table.size(); i++) {
+                if (!changed[i] && current.has_threshold(i)) {
+                    table[i] = current.threshold(i);
+                }
+            }
+            d_usrp->set_thresholds(table);
+        }
+
+        pmt::pmt_t info = pmt::make_dict();
+        info = pmt::dict_add(info, d_margin_key, pmt::from_double(margin));
+        info = pmt::dict_add(info, d_rate_key, pmt::from_double(rate));
+        info = pmt::dict_add(info, d_writes_key, pmt::from_uint64(writes.size()));
+        message_port_pub(d_update_key, info);
+    }
+
+    void
+    threshold_controller_impl::handle_overflow(pmt::pmt_t)
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_overflow_pending = true;
+    }
+
+    threshold_controller_stats
+    threshold_controller_impl::stats() const
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        threshold_controller_stats stats;
+        stats.updates = d_updates;
+        stats.threshold_writes = d_threshold_writes;
+        stats.margin = d_margin;
+        stats.measured_rate = d_measured_rate;
+        return stats;
+    }
+
+    std::vector<std::uint32_t>
+    threshold_controller_impl::thresholds() const
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        std::vector<std::uint32_t> thresholds(BIN_COUNT, 0);
+        for (std::size_t i = 0; i < BIN_COUNT; i++) {
+            if (d_thresholds_known.test(i)) {
+                thresholds[i] = d_thresholds[i];
+            }
+        }
+        return thresholds;
+    }
+
+    void
+    threshold_controller_impl::set_target_rate(double rate)
+    {
+        if (rate <= 0.0) {
+            throw std::invalid_argument("Target rate must be positive");
+        }
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_target_rate = rate;
+    }
+
+    void
+    threshold_controller_impl::set_threshold_range(std::uint32_t min,
+        std::uint32_t max)
+    {
+        if (min > max) {
+            throw std::invalid_argument(
+                "Minimum threshold must not be greater than maximum");
+        }
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_min_threshold = min;
+        d_max_threshold = max;
+    }
+
+    void
+    threshold_controller_impl::set_hysteresis(double hysteresis)
+    {
+        if (!(hysteresis >= 0.0 && hysteresis < 1.0)) {
+            throw std::invalid_argument("Hysteresis must be in [0, 1)");
+        }
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_hysteresis = hysteresis;
+    }
+
+    void
+    threshold_controller_impl::set_max_step(double max_step)
+    {
+        if (!(max_step > 1.0)) {
+            throw std::invalid_argument("Maximum step must be greater than 1");
+        }
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_max_step = max_step;
+    }
+
+    void
+    threshold_controller_impl::set_max_writes(std::size_t max_writes)
+    {
+        if (max_writes == 0) {
+            throw std::invalid_argument("Maximum writes must not be 0");
+        }
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_max_writes = max_writes;
+    }
+
+    void
+    threshold_controller_impl::set_update_rows(std::uint32_t rows)
+    {
+        if (rows == 0) {
+            throw std::invalid_argument("Update rows must not be 0");
+        }
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_update_rows = rows;
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
@@ -0,0 +1,132 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_THRESHOLD_CONTROLLER_IMPL_H
+#define INCLUDED_SPARSDR_THRESHOLD_CONTROLLER_IMPL_H
+
+#include <bitset>
+#include <mutex>
+#include <sparsdr/threshold_controller.h>
+#include <sparsdr/sample_decoder.h>
+#include "time_expander.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    class threshold_controller_impl : public threshold_controller
+    {
+     private:
+      static const std::size_t BIN_COUNT = compressing_usrp_source::BIN_COUNT;
+
+      /*! \brief The USRP to write thresholds to, or null */
+      compressing_usrp_source::sptr d_usrp;
+      /*! \brief The duration of one hardware time unit, in seconds */
+      double d_window_duration;
+      /*! \brief Interval between rows of averages */
+      std::uint32_t d_average_interval;
+      /*! \brief Maximum spread of times within one row of averages */
+      std::uint32_t d_tolerance;
+
+      /*! \brief Protects the settings and state below */
+      mutable std::mutex d_mutex;
+      double d_target_rate;
+      std::uint32_t d_min_threshold;
+      std::uint32_t d_max_threshold;
+      double d_hysteresis;
+      double d_max_step;
+      std::size_t d_max_writes;
+      std::uint32_t d_update_rows;
+      double d_margin;
+      /*! \brief The last threshold chosen for each bin */
+      std::vector<std::uint32_t> d_thresholds;
+      /*! \brief The bins that have a known threshold */
+      std::bitset<BIN_COUNT> d_thresholds_known;
+      std::uint64_t d_updates;
+      std::uint64_t d_threshold_writes;
+      double d_measured_rate;
+      /*! \brief Set when an overflow is reported, cleared by update() */
+      bool d_overflow_pending;
+
+      /*! \brief Samples decoded from the input */
+      decoded_samples d_samples;
+      /*! \brief Expands the hardware time of each sample */
+      time_expander d_time_expander;
+      /*! \brief The estimated noise floor of each bin */
+      std::vector<std::uint32_t> d_floor;
+      /*! \brief The bins that have a noise floor estimate */
+      std::bitset<BIN_COUNT> d_floor_known;
+      /*! \brief True if a row of averages has been seen */
+      bool d_have_row;
+      /*! \brief The expanded time of the first sample in the last row */
+      std::uint64_t d_row_time;
+      /*! \brief The expanded time of the row that started this period */
+      std::uint64_t d_period_start;
+      /*! \brief Data samples seen since d_period_start */
+      std::uint64_t d_period_samples;
+
+      const pmt::pmt_t d_update_key;
+      const pmt::pmt_t d_margin_key;
+      const pmt::pmt_t d_rate_key;
+      const pmt::pmt_t d_writes_key;
+
+      /*! \brief Handles a message on the overflow port */
+      void handle_overflow(pmt::pmt_t message);
+
+      /*!
+       * \brief Called at the start of each row of averages
+       *
+       * \param time the expanded time of the first sample in the row
+       */
+      void start_row(std::uint64_t time);
+
+      /*!
+       * \brief Adjusts the margin and writes thresholds
+       *
+       * \param elapsed the hardware time since the start of the period
+       */
+      void update(std::uint64_t elapsed);
+
+     public:
+      threshold_controller_impl(compressing_usrp_source::sptr usrp,
+          double target_rate,
+          std::uint32_t average_interval,
+          double initial_margin,
+          double window_duration);
+      ~threshold_controller_impl();
+
+      // Where all the action really happens
+      int work(int noutput_items,
+         gr_vector_const_void_star &input_items,
+         gr_vector_void_star &output_items);
+
+      virtual threshold_controller_stats stats() const;
+      virtual std::vector<std::uint32_t> thresholds() const;
+      virtual void set_target_rate(double rate);
+      virtual void set_threshold_range(std::uint32_t min, std::uint32_t max);
+      virtual void set_hysteresis(double hysteresis);
+      virtual void set_max_step(double max_step);
+      virtual void set_max_writes(std::size_t max_writes);
+      virtual void set_update_rows(std::uint32_t rows);
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_THRESHOLD_CONTROLLER_IMPL_H */
@@ -0,0 +1,88 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_TIME_EXPANDER_H
+#define INCLUDED_SPARSDR_TIME_EXPANDER_H
+
+#include <cstdint>
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Keeps track of the periodically overflowing 20-bit time counter
+     * in compressed samples and expands its values into 64-bit times
+     *
+     * This matches the Overflow type in the Rust sparsdr_reconstruct code.
+     */
+    class time_expander
+    {
+    private:
+      /*! \brief The maximum value of the 20-bit counter */
+      static const std::uint64_t COUNTER_MAX = 0xfffff;
+
+      /*! \brief The offset to add to each value */
+      std::uint64_t d_offset;
+      /*! \brief The last counter value, before expansion */
+      std::uint32_t d_previous;
+
+    public:
+      inline time_expander() : d_offset(0), d_previous(0) {}
+
+      /*!
+       * \brief Creates an expander that continues from an already expanded
+       * time, as if that time had been the last value expanded
+       */
+      inline explicit time_expander(std::uint64_t previous)
+        : d_offset(previous & ~COUNTER_MAX),
+          d_previous(static_cast<std::uint32_t>(previous & COUNTER_MAX))
+      {}
+
+      /*!
+       * \brief Expands a 20-bit counter value into a 64-bit value
+       *
+       * If the value is less than the previous value, this assumes that the
+       * counter has overflowed exactly once.
+       */
+      inline std::uint64_t expand(std::uint32_t value)
+      {
+          if (value < d_previous) {
+              d_offset += COUNTER_MAX + 1;
+          }
+          d_previous = value;
+          return d_offset + value;
+      }
+
+      /*!
+       * \brief Returns the value that expand() would return for a counter
+       * value, without changing the state of this expander
+       */
+      inline std::uint64_t peek(std::uint32_t value) const
+      {
+          return value < d_previous
+              ? d_offset + COUNTER_MAX + 1 + value
+              : d_offset + value;
+      }
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_TIME_EXPANDER_H */
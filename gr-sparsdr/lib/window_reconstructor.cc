@@ -0,0 +1,265 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include "window_reconstructor.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    window_reconstructor::window_reconstructor(const std::vector<band_spec>& bands,
+        bool fill_gaps,
+        bool track_bursts,
+        std::size_t slots)
+      : d_workspace(),
+        d_bands(),
+        d_fill_gaps(fill_gaps),
+        d_track_bursts(track_bursts),
+        d_route_offsets(band_reconstructor::NATIVE_FFT_SIZE + 1, 0),
+        d_route_bands(),
+        d_band_active(std::max(bands.size(), slots), false),
+        d_active_bands(),
+        d_open_bands(),
+        d_time_expander(),
+        d_window_bins(band_reconstructor::NATIVE_FFT_SIZE, gr_complex(0.0, 0.0)),
+        d_window_active(),
+        d_window_active_list(),
+        d_have_window(false),
+        d_has_time(false),
+        d_last_time(0),
+        d_last_sample_time(0)
+    {
+        for (const band_spec& band : bands) {
+            d_bands.emplace_back(new band_reconstructor(band, d_workspace,
+                fill_gaps, track_bursts));
+        }
+        d_bands.resize(d_band_active.size());
+        d_window_active_list.reserve(band_reconstructor::NATIVE_FFT_SIZE);
+        d_active_bands.reserve(d_bands.size());
+        d_open_bands.reserve(d_bands.size());
+        build_routes();
+    }
+
+    void
+    window_reconstructor::build_routes()
+    {
+        // Count the bands that contain each bin, convert the counts into
+        // offsets, then fill in the band indexes
+        std::fill(d_route_offsets.begin(), d_route_offsets.end(), 0);
+        for (const auto& band : d_bands) {
+            if (!band) {
+                continue;
+            }
+            for (std::uint16_t bin = band->bin_start(); bin < band->bin_end(); bin++) {
+                d_route_offsets[bin + 1]++;
+            }
+        }
+        for (std::size_t bin = 0; bin < band_reconstructor::NATIVE_FFT_SIZE; bin++) {
+            d_route_offsets[bin + 1] += d_route_offsets[bin];
+        }
+        d_route_bands.resize(d_route_offsets.back());
+        std::vector<std::uint32_t> fill(d_route_offsets.begin(),
+            d_route_offsets.end() - 1);
+        for (std::uint32_t i = 0; i < d_bands.size(); i++) {
+            if (!d_bands[i]) {
+                continue;
+            }
+            const band_reconstructor& band = *d_bands[i];
+            for (std::uint16_t bin = band.bin_start(); bin < band.bin_end(); bin++) {
+                d_route_bands[fill[bin]++] = i;
+            }
+        }
+    }
+
+    bool
+    window_reconstructor::add_sample(const decoded_samples& samples, std::size_t i)
+    {
+        const std::uint64_t expanded_time = d_time_expander.expand(
+            samples.time[i]);
+        d_last_sample_time = expanded_time;
+        if (samples.is_average(i)) {
+            // Averages keep arriving while no signals are present, so
+            // expanding their times catches rollovers during a silence
+            return false;
+        }
+        const std::uint16_t index = samples.index[i];
+
+        bool window_finished = false;
+        if (d_have_window && expanded_time != d_last_time) {
+            finish_window();
+            window_finished = true;
+        }
+        d_have_window = true;
+        d_has_time = true;
+        d_last_time = expanded_time;
+
+        // Shift from FFT order into logical order
+        const std::uint16_t logical_index = (index
+            + band_reconstructor::NATIVE_FFT_SIZE / 2)
+            % band_reconstructor::NATIVE_FFT_SIZE;
+        d_window_bins[logical_index] = gr_complex(samples.real[i] / 32768.0f,
+            samples.imag[i] / 32768.0f);
+        if (!d_window_active.test(logical_index)) {
+            d_window_active.set(logical_index);
+            d_window_active_list.push_back(logical_index);
+            // Mark the bands that contain this bin
+            const std::uint32_t route_end = d_route_offsets[logical_index + 1];
+            for (std::uint32_t r = d_route_offsets[logical_index]; r < route_end; r++) {
+                const std::uint32_t band = d_route_bands[r];
+                if (!d_band_active[band]) {
+                    d_band_active[band] = true;
+                    d_active_bands.push_back(band);
+                }
+            }
+        }
+        return window_finished;
+    }
+
+    void
+    window_reconstructor::finish()
+    {
+        if (d_have_window) {
+            finish_window();
+        }
+        for (const auto& band : d_bands) {
+            if (band) {
+                band->flush();
+            }
+        }
+    }
+
+    bool
+    window_reconstructor::peek_time(const decoded_samples& samples,
+        std::size_t i,
+        std::uint64_t& time) const
+    {
+        if (samples.is_average(i)) {
+            return false;
+        }
+        time = d_time_expander.peek(samples.time[i]);
+        return true;
+    }
+
+    void
+    window_reconstructor::complete_window()
+    {
+        if (d_have_window) {
+            finish_window();
+        }
+    }
+
+    void
+    window_reconstructor::open_band(std::size_t i, const band_spec& band)
+    {
+        if (d_have_window) {
+            throw std::logic_error("Can't open a band while a window is being assembled");
+        }
+        if (d_bands.at(i)) {
+            throw std::logic_error("Band slot is not empty");
+        }
+        d_bands[i].reset(new band_reconstructor(band, d_workspace, d_fill_gaps,
+            d_track_bursts));
+        build_routes();
+    }
+
+    std::unique_ptr<band_reconstructor>
+    window_reconstructor::close_band(std::size_t i)
+    {
+        if (d_have_window) {
+            throw std::logic_error("Can't close a band while a window is being assembled");
+        }
+        if (!d_bands.at(i)) {
+            throw std::logic_error("Band slot is empty");
+        }
+        std::unique_ptr<band_reconstructor> band = std::move(d_bands[i]);
+        d_open_bands.erase(std::remove(d_open_bands.begin(), d_open_bands.end(), i),
+            d_open_bands.end());
+        band->flush();
+        build_routes();
+        return band;
+    }
+
+    void
+    window_reconstructor::reset()
+    {
+        for (const std::uint16_t bin : d_window_active_list) {
+            d_window_bins[bin] = gr_complex(0.0, 0.0);
+        }
+        d_window_active.reset();
+        d_window_active_list.clear();
+        for (const std::uint32_t band : d_active_bands) {
+            d_band_active[band] = false;
+        }
+        d_active_bands.clear();
+        d_open_bands.clear();
+        d_have_window = false;
+        d_has_time = false;
+        d_last_time = 0;
+        d_last_sample_time = 0;
+        d_time_expander = time_expander();
+        for (const auto& band : d_bands) {
+            if (band) {
+                band->reset();
+            }
+        }
+    }
+
+    void
+    window_reconstructor::finish_window()
+    {
+        // Bands that processed the previous window but have nothing in this
+        // one can write the end of the previous window. Other bands with
+        // nothing in this window have no work to do.
+        for (const std::uint32_t band : d_open_bands) {
+            if (!d_band_active[band]) {
+                d_bands[band]->advance(d_last_time);
+            }
+        }
+        for (const std::uint32_t band : d_active_bands) {
+            d_bands[band]->process_window(d_last_time, d_window_bins.data());
+            d_band_active[band] = false;
+        }
+        d_open_bands.swap(d_active_bands);
+        d_active_bands.clear();
+
+        for (const std::uint16_t bin : d_window_active_list) {
+            d_window_bins[bin] = gr_complex(0.0, 0.0);
+        }
+        d_window_active.reset();
+        d_window_active_list.clear();
+        d_have_window = false;
+    }
+
+    bool
+    window_reconstructor::outputs_full() const
+    {
+        return std::any_of(d_bands.begin(), d_bands.end(),
+            [](const std::unique_ptr<band_reconstructor>& band) {
+                return band && band->pending() != 0;
+            });
+    }
+
+  } /* namespace sparsdr */
+} /* namespace gr */
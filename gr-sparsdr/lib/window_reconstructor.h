@@ -0,0 +1,244 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 The Regents of the University of California.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPARSDR_WINDOW_RECONSTRUCTOR_H
+#define INCLUDED_SPARSDR_WINDOW_RECONSTRUCTOR_H
+
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <sparsdr/band_spec.h>
+#include <sparsdr/sample_decoder.h>
+#include <boost/noncopyable.hpp>
+#include "band_reconstructor.h"
+#include "time_expander.h"
+
+namespace gr {
+  namespace sparsdr {
+
+    /*!
+     * \brief Groups decoded compressed samples into FFT windows and sends
+     * each complete window to a set of band reconstructors
+     *
+     * Average samples are not reconstructed, but their times are expanded
+     * so that a silence longer than one rollover of the time counter does
+     * not shift the times of later windows. A window is complete when a
+     * data sample with a different time arrives, or when finish() is
+     * called.
+     *
+     * All bands share one window. A routing table built from the band
+     * specifications lists the bands that contain each bin, so each sample
+     * is decoded and stored once no matter how many bands there are. When
+     * a window is complete, only the bands that received samples in it
+     * (and the bands that need to write the end of their previous window)
+     * do any work.
+     *
+     * The reconstructor has a fixed number of band slots. Bands can be
+     * opened in empty slots and closed between windows, which rebuilds the
+     * routing table. Other slots are not affected.
+     */
+    class window_reconstructor : public boost::noncopyable
+    {
+    public:
+      typedef std::bitset<band_reconstructor::NATIVE_FFT_SIZE> bin_set;
+
+      /*!
+       * \param bands the bands to reconstruct
+       * \param fill_gaps true to write zeros for the time between
+       * non-adjacent windows in each band (see band_reconstructor)
+       * \param track_bursts true to record the start and end of each burst
+       * in each band
+       * \param slots the number of band slots. The first bands.size() slots
+       * contain the bands and the rest are empty. If this is less than
+       * bands.size(), there is one slot for each band.
+       */
+      explicit window_reconstructor(const std::vector<band_spec>& bands,
+          bool fill_gaps = false,
+          bool track_bursts = false,
+          std::size_t slots = 0);
+
+      /*!
+       * \brief Handles one compressed sample
+       *
+       * \param samples a batch of decoded samples
+       * \param i the position of the sample in samples
+       *
+       * \return true if this sample completed a window
+       */
+      bool add_sample(const decoded_samples& samples, std::size_t i);
+
+      /*!
+       * \brief Completes the current window, if any, and writes the rest of
+       * the last window in each band
+       */
+      void finish();
+
+      /*!
+       * \brief Returns this reconstructor and all bands to their initial
+       * state
+       */
+      void reset();
+
+      /*! \brief Returns the number of band slots */
+      inline std::size_t band_count() const { return d_bands.size(); }
+      /*! \brief Returns true if a band slot contains a band */
+      inline bool has_band(std::size_t i) const { return d_bands[i] != nullptr; }
+      /*!
+       * \brief Returns the reconstructor for a band (only valid if
+       * has_band(i) is true)
+       */
+      inline band_reconstructor& band(std::size_t i) { return *d_bands[i]; }
+
+      /*!
+       * \brief Returns true if a window is being assembled
+       *
+       * Bands can only be opened or closed when this is false.
+       */
+      inline bool has_window() const { return d_have_window; }
+
+      /*!
+       * \brief Finds the expanded time that a sample would have if it was
+       * handled next, without handling it
+       *
+       * \return false if the sample is an average sample
+       */
+      bool peek_time(const decoded_samples& samples, std::size_t i,
+          std::uint64_t& time) const;
+
+      /*!
+       * \brief Sends the current window, if any, to the bands without
+       * waiting for a sample from the next window
+       */
+      void complete_window();
+
+      /*!
+       * \brief Creates a reconstructor for a band in an empty slot
+       *
+       * The band receives windows that are completed after this call.
+       *
+       * \throws std::logic_error if a window is being assembled or the slot
+       * is not empty
+       * \throws std::out_of_range if the band is not valid
+       */
+      void open_band(std::size_t i, const band_spec& band);
+
+      /*!
+       * \brief Removes the band in a slot, writes the rest of its last
+       * window, and returns it
+       *
+       * The returned reconstructor may have pending samples. It uses the
+       * workspace of this reconstructor, so it must be destroyed first.
+       *
+       * \throws std::logic_error if a window is being assembled or the slot
+       * is empty
+       */
+      std::unique_ptr<band_reconstructor> close_band(std::size_t i);
+
+      /*!
+       * \brief Returns true if any band has reconstructed samples that
+       * did not fit in its output buffer
+       */
+      bool outputs_full() const;
+
+      /*!
+       * \brief Returns true if any data samples have been handled since the
+       * last reset
+       */
+      inline bool has_time() const { return d_has_time; }
+      /*!
+       * \brief Returns the expanded time of the last data sample handled
+       */
+      inline std::uint64_t last_time() const { return d_last_time; }
+      /*!
+       * \brief Returns the expanded time of the last sample handled, data
+       * or average
+       */
+      inline std::uint64_t last_sample_time() const
+      {
+          return d_last_sample_time;
+      }
+
+    private:
+      /*! \brief FFT plans and buffers for all bands */
+      reconstruct_workspace d_workspace;
+      /*! \brief One reconstructor for each slot, or null for empty slots */
+      std::vector<std::unique_ptr<band_reconstructor>> d_bands;
+      /*! \brief Options for new bands */
+      bool d_fill_gaps;
+      bool d_track_bursts;
+
+      /*!
+       * \brief Bin to band routing table
+       *
+       * The indexes of the bands that contain logical bin i are
+       * d_route_bands[d_route_offsets[i]] through
+       * d_route_bands[d_route_offsets[i + 1] - 1].
+       */
+      std::vector<std::uint32_t> d_route_offsets;
+      std::vector<std::uint32_t> d_route_bands;
+      /*! \brief For each band, true if it has bins in the current window */
+      std::vector<bool> d_band_active;
+      /*! \brief The indexes of the bands in d_band_active */
+      std::vector<std::uint32_t> d_active_bands;
+      /*!
+       * \brief The indexes of the bands that processed the last window
+       * that was finished, and may still need to write the end of it
+       */
+      std::vector<std::uint32_t> d_open_bands;
+
+      /*! \brief Expands the time values of incoming samples */
+      time_expander d_time_expander;
+
+      /*!
+       * \brief Bin values of the window being assembled, in logical order
+       *
+       * Only bins in d_window_active are non-zero.
+       */
+      std::vector<gr_complex> d_window_bins;
+      /*! \brief The bins that have values in the current window */
+      bin_set d_window_active;
+      /*! \brief The indexes of the bins in d_window_active */
+      std::vector<std::uint16_t> d_window_active_list;
+      /*! \brief True if a window is being assembled */
+      bool d_have_window;
+      /*! \brief True if any data samples have been handled */
+      bool d_has_time;
+      /*!
+       * \brief The expanded time of the last data sample, which is also
+       * the time of the current window
+       */
+      std::uint64_t d_last_time;
+      /*! \brief The expanded time of the last sample, data or average */
+      std::uint64_t d_last_sample_time;
+
+      /*!
+       * \brief Sends the current window to all bands, then clears it
+       */
+      void finish_window();
+
+      /*! \brief Rebuilds the routing table from the bands in all slots */
+      void build_routes();
+    };
+
+  } // namespace sparsdr
+} // namespace gr
+
+#endif /* INCLUDED_SPARSDR_WINDOW_RECONSTRUCTOR_H */
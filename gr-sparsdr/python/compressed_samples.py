@@ -0,0 +1,43 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2020 The Regents of the University of California.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+"""
+Encoders for compressed samples, shared by the tests of blocks that read
+compressed streams
+"""
+
+
+def data_sample(time, index, real, imag):
+    """Returns the two 32-bit items that make up a compressed data sample"""
+    header = ((time & 0xffff) << 16) | (index << 4) | ((time >> 16) & 0xf)
+    payload = ((imag & 0xffff) << 16) | (real & 0xffff)
+    return [to_signed(header), to_signed(payload)]
+
+
+def average_sample(time, index, magnitude):
+    """Returns the two 32-bit items that make up a compressed average sample"""
+    header = ((time & 0xffff) << 16) | (1 << 15) | (index << 4) | ((time >> 16) & 0xf)
+    payload = ((magnitude & 0xffff) << 16) | ((magnitude >> 16) & 0xffff)
+    return [to_signed(header), to_signed(payload)]
+
+
+def to_signed(value):
+    """Converts an unsigned 32-bit value into a signed 32-bit value"""
+    return value - (1 << 32) if value & 0x80000000 else value
@@ -0,0 +1,103 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2020 The Regents of the University of California.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+
+import pmt
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks
+import sparsdr
+from compressed_samples import data_sample, average_sample
+
+# Rows of averages are 16 time steps (10.24 us each) apart
+AVERAGE_INTERVAL = 16
+
+
+def make_items(rows):
+    """Returns rows of averages with data samples in bin 100 in every FFT
+    window and in bin 200 in every third FFT window"""
+    items = []
+    for row in range(rows):
+        time = row * AVERAGE_INTERVAL
+        for index in range(2048):
+            items += average_sample(time, index, 0)
+        for offset in range(1, AVERAGE_INTERVAL):
+            items += data_sample(time + offset, 100, 0, 0)
+            if offset % 3 == 0:
+                items += data_sample(time + offset, 200, 0, 0)
+    return items
+
+
+class qa_auto_masker(gr_unittest.TestCase):
+
+    def run_masker(self, masker, rows):
+        tb = gr.top_block()
+        debug = blocks.message_debug()
+        tb.connect(blocks.vector_source_i(make_items(rows)), masker)
+        tb.msg_connect((masker, 'mask'), (debug, 'store'))
+        tb.run()
+        return [debug.get_message(i) for i in range(debug.num_messages())]
+
+    def test_mask_and_unmask(self):
+        masker = sparsdr.auto_masker(None, AVERAGE_INTERVAL, 0.8, 4, 8)
+        messages = self.run_masker(masker, 16)
+        # Bin 100 is masked after the first full window and unmasked after
+        # the cooldown. Bin 200 is never masked.
+        self.assertEqual(len(messages), 2)
+        masked = messages[0]
+        self.assertEqual(pmt.to_uint64(pmt.dict_ref(masked, pmt.intern('bin'),
+                                                    pmt.PMT_NIL)), 100)
+        self.assertTrue(pmt.to_bool(pmt.dict_ref(masked, pmt.intern('masked'),
+                                                 pmt.PMT_NIL)))
+        self.assertAlmostEqual(pmt.to_double(
+            pmt.dict_ref(masked, pmt.intern('duty_cycle'), pmt.PMT_NIL)), 15 / 16)
+        self.assertEqual(pmt.to_uint64(pmt.dict_ref(masked, pmt.intern('time'),
+                                                    pmt.PMT_NIL)), 4 * AVERAGE_INTERVAL)
+        unmasked = messages[1]
+        self.assertFalse(pmt.to_bool(pmt.dict_ref(unmasked, pmt.intern('masked'),
+                                                  pmt.PMT_NIL)))
+        self.assertEqual(pmt.to_uint64(pmt.dict_ref(unmasked, pmt.intern('time'),
+                                                    pmt.PMT_NIL)), 12 * AVERAGE_INTERVAL)
+        stats = masker.stats()
+        self.assertEqual(stats.masks, 1)
+        self.assertEqual(stats.unmasks, 1)
+        self.assertEqual(stats.masked_bins, 0)
+
+    def test_lower_level(self):
+        masker = sparsdr.auto_masker(None, AVERAGE_INTERVAL, 0.3, 4, 64)
+        messages = self.run_masker(masker, 8)
+        bins = sorted(pmt.to_uint64(pmt.dict_ref(message, pmt.intern('bin'),
+                                                 pmt.PMT_NIL))
+                      for message in messages)
+        self.assertEqual(bins, [100, 200])
+        self.assertEqual(masker.stats().masked_bins, 2)
+
+    def test_invalid_settings(self):
+        with self.assertRaises(ValueError):
+            sparsdr.auto_masker(None, AVERAGE_INTERVAL, 1.5)
+        with self.assertRaises(ValueError):
+            sparsdr.auto_masker(None, 0)
+        masker = sparsdr.auto_masker(None, AVERAGE_INTERVAL)
+        with self.assertRaises(ValueError):
+            masker.set_cooldown_rows(0)
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_auto_masker)
@@ -0,0 +1,103 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2020 The Regents of the University of California.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks
+import pmt
+import sparsdr
+from compressed_samples import data_sample, average_sample
+
+
+class qa_average_detector(gr_unittest.TestCase):
+
+    def setUp(self):
+        self.tb = gr.top_block()
+
+    def tearDown(self):
+        self.tb = None
+
+    def run_detector(self, items, average_interval):
+        source = blocks.vector_source_i(items)
+        detector = sparsdr.average_detector(average_interval)
+        sink = blocks.vector_sink_i()
+        messages = blocks.message_debug()
+        self.tb.connect(source, detector, sink)
+        self.tb.msg_connect((detector, 'overflow'), (messages, 'store'))
+        self.tb.run()
+        self.assertEqual(items, list(sink.data()))
+        tags = [tag for tag in sink.tags() if pmt.to_python(tag.key) == 'overflow']
+        return (detector, tags, messages)
+
+    def test_regular_rows(self):
+        items = []
+        for row in range(4):
+            items += average_sample(row * 16, 0, 1000)
+            items += average_sample(row * 16, 1, 1000)
+            items += data_sample(row * 16 + 3, 100, 10, 10)
+        (detector, tags, messages) = self.run_detector(items, 16)
+        self.assertEqual(0, len(tags))
+        self.assertEqual(0, messages.num_messages())
+        stats = detector.stats()
+        self.assertEqual(8, stats.averages)
+        self.assertEqual(4, stats.data_samples)
+        self.assertEqual(51, stats.last_hardware_time)
+        self.assertEqual(0, stats.overflows)
+
+    def test_missing_row(self):
+        items = []
+        items += average_sample(0, 0, 1000)
+        items += average_sample(16, 0, 1000)
+        # Row at 32 is missing
+        items += average_sample(48, 0, 1000)
+        (detector, tags, messages) = self.run_detector(items, 16)
+        self.assertEqual(1, len(tags))
+        self.assertEqual(4, tags[0].offset)
+        self.assertEqual(1, messages.num_messages())
+        info = messages.get_message(0)
+        self.assertEqual(32, pmt.to_uint64(pmt.dict_ref(info, pmt.intern('expected_time'), pmt.PMT_NIL)))
+        self.assertEqual(48, pmt.to_uint64(pmt.dict_ref(info, pmt.intern('time'), pmt.PMT_NIL)))
+        self.assertEqual(1, pmt.to_uint64(pmt.dict_ref(info, pmt.intern('missing_rows'), pmt.PMT_NIL)))
+        self.assertEqual(1, detector.stats().overflows)
+
+    def test_late_data_reports_once(self):
+        items = []
+        items += average_sample(0, 0, 1000)
+        # This data sample is after the time of the next row
+        items += data_sample(20, 100, 10, 10)
+        items += average_sample(32, 0, 1000)
+        (detector, tags, messages) = self.run_detector(items, 16)
+        self.assertEqual(1, len(tags))
+        self.assertEqual(2, tags[0].offset)
+        self.assertEqual(1, messages.num_messages())
+
+    def test_time_discontinuity(self):
+        items = []
+        items += average_sample(0, 0, 1000)
+        items += average_sample(16, 0, 1000)
+        items += average_sample(23, 0, 1000)
+        (detector, tags, messages) = self.run_detector(items, 16)
+        self.assertEqual(1, len(tags))
+        info = messages.get_message(0)
+        self.assertEqual(0, pmt.to_uint64(pmt.dict_ref(info, pmt.intern('missing_rows'), pmt.PMT_NIL)))
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_average_detector, "qa_average_detector.xml")
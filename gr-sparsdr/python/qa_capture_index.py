@@ -0,0 +1,80 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2020 The Regents of the University of California.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+
+import os
+import shutil
+import tempfile
+
+from gnuradio import gr_unittest
+import sparsdr
+
+
+class qa_capture_index(gr_unittest.TestCase):
+
+    def make_index(self):
+        index = sparsdr.capture_index()
+        index.add(sparsdr.capture_index_entry('low.iqz', 2.4e9, 100e6, 122071))
+        index.add(sparsdr.capture_index_entry('high band.iqz', 2.49e9, 100e6, 122071))
+        return index
+
+    def test_round_trip(self):
+        text = self.make_index().to_string()
+        self.assertEqual(text,
+                         'capture 2400000000 100000000 122071 low.iqz\n'
+                         'capture 2490000000 100000000 122071 high band.iqz\n')
+        index = sparsdr.capture_index.from_string('# comment\n\n' + text)
+        self.assertEqual(index.size(), 2)
+        self.assertEqual(index.entry(1).path, 'high band.iqz')
+        self.assertEqual(index.entry(1).center_frequency, 2.49e9)
+        self.assertEqual(index.entry(1).start_time, 122071)
+        with self.assertRaises(IndexError):
+            index.entry(2)
+
+    def test_file(self):
+        directory = tempfile.mkdtemp()
+        try:
+            path = os.path.join(directory, 'capture.index')
+            self.make_index().write(path)
+            self.assertEqual(sparsdr.capture_index.read(path).to_string(),
+                             self.make_index().to_string())
+        finally:
+            shutil.rmtree(directory)
+
+    def test_find(self):
+        index = self.make_index()
+        self.assertEqual(index.find(2.40e9), 0)
+        # In both bands, closer to the second center frequency
+        self.assertEqual(index.find(2.446e9), 1)
+        self.assertEqual(index.find(2.30e9), -1)
+        self.assertEqual(index.find(2.55e9), -1)
+
+    def test_invalid_text(self):
+        with self.assertRaises(ValueError):
+            sparsdr.capture_index.from_string('capture 2.4e9 100e6 0\n')
+        with self.assertRaises(ValueError):
+            sparsdr.capture_index.from_string('band 2.4e9 100e6 0 a.iqz\n')
+        with self.assertRaises(ValueError):
+            sparsdr.capture_index.from_string('capture 2.4e9 0 0 a.iqz\n')
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_capture_index)
@@ -0,0 +1,100 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2020 The Regents of the University of California.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+import os
+import shutil
+import struct
+import tempfile
+import time
+
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks
+import sparsdr
+
+
+class qa_capture_sink(gr_unittest.TestCase):
+
+    def setUp(self):
+        self.tb = gr.top_block()
+        self.directory = tempfile.mkdtemp()
+        self.path = os.path.join(self.directory, 'capture.iq')
+
+    def tearDown(self):
+        self.tb = None
+        shutil.rmtree(self.directory)
+
+    def run_sink(self, items, buffer_size):
+        source = blocks.vector_source_i(items)
+        sink = sparsdr.capture_sink(self.path, buffer_size, 2, False, 8192)
+        self.tb.connect(source, sink)
+        self.tb.run()
+        return sink.stats()
+
+    def read_items(self):
+        with open(self.path, 'rb') as file:
+            data = file.read()
+        return list(struct.unpack('<{}i'.format(len(data) // 4), data))
+
+    def test_partial_buffer(self):
+        items = list(range(10))
+        stats = self.run_sink(items, 4096)
+        self.assertEqual(items, self.read_items())
+        self.assertEqual(len(items) * 4, stats.bytes_written)
+
+    def test_many_buffers(self):
+        # Several full buffers and one partial buffer. Preallocated space
+        # after the data is removed, so the file has exactly the items.
+        items = list(range(10000))
+        stats = self.run_sink(items, 4096)
+        self.assertEqual(0, stats.write_errors)
+        written = self.read_items()
+        # If the file could not keep up, whole samples may be missing
+        self.assertEqual(len(items), len(written) + stats.items_dropped)
+        if stats.items_dropped == 0:
+            self.assertEqual(items, written)
+
+    def test_pipe_flush(self):
+        # A slow stream into a named pipe reaches the reader before a
+        # buffer fills
+        os.mkfifo(self.path)
+        reader = os.open(self.path, os.O_RDONLY | os.O_NONBLOCK)
+        try:
+            source = blocks.vector_source_i(list(range(16)), True)
+            throttle = blocks.throttle(gr.sizeof_int, 1000)
+            sink = sparsdr.capture_sink(self.path, 4 * 1024 * 1024, 2, False,
+                                        8192, 0.05)
+            self.tb.connect(source, throttle, sink)
+            self.tb.start()
+            time.sleep(0.5)
+            data = os.read(reader, 65536)
+            self.tb.stop()
+            self.tb.wait()
+        finally:
+            os.close(reader)
+        # Only whole samples are written
+        self.assertGreater(len(data), 0)
+        self.assertEqual(0, len(data) % 8)
+        items = list(struct.unpack('<{}i'.format(len(data) // 4), data))
+        self.assertEqual([i % 16 for i in range(len(items))], items)
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_capture_sink, "qa_capture_sink.xml")
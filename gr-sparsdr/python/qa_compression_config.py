@@ -0,0 +1,80 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2020 The Regents of the University of California.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+
+from gnuradio import gr_unittest
+import sparsdr
+
+
+class qa_compression_config(gr_unittest.TestCase):
+
+    def make_config(self):
+        config = sparsdr.compression_config()
+        config.set(sparsdr.compression_config.FFT_SIZE, 1024)
+        config.set(sparsdr.compression_config.FFT_ENABLED, 1)
+        for i in range(sparsdr.compression_config.BIN_COUNT):
+            config.set_threshold(i, 50000)
+            config.set_mask(i, i < 2)
+        return config
+
+    def test_unknown(self):
+        config = sparsdr.compression_config()
+        self.assertFalse(config.has(sparsdr.compression_config.FFT_SIZE))
+        self.assertFalse(config.has_threshold(0))
+        self.assertFalse(config.has_mask(0))
+        with self.assertRaises(IndexError):
+            config.get(sparsdr.compression_config.FFT_SIZE)
+        self.assertEqual(config.to_string(), '')
+
+    def test_threshold_low_bits(self):
+        config = self.make_config()
+        # The register does not store the lowest 11 bits
+        self.assertEqual(config.threshold(7), 49152)
+        other = self.make_config()
+        other.set_threshold(7, 49152)
+        self.assertTrue(config == other)
+
+    def test_round_trip(self):
+        config = self.make_config()
+        text = config.to_string()
+        self.assertIn('threshold 0-2047 49152\n', text)
+        self.assertIn('mask 0-1 1\n', text)
+        self.assertTrue(sparsdr.compression_config.from_string(text) == config)
+
+    def test_invalid_text(self):
+        with self.assertRaises(ValueError):
+            sparsdr.compression_config.from_string('fft_size\n')
+        with self.assertRaises(ValueError):
+            sparsdr.compression_config.from_string('threshold 0-4096 1\n')
+
+    def test_differences(self):
+        config = self.make_config()
+        other = self.make_config()
+        other.set_threshold(10, 4096)
+        other.set_threshold(11, 4096)
+        other.set(sparsdr.compression_config.FFT_ENABLED, 0)
+        self.assertEqual(list(config.differences(other)),
+                         ['fft_enabled: 1 -> 0', 'threshold 10-11: 49152 -> 4096'])
+        self.assertEqual(list(other.differences(other)), [])
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_compression_config)
@@ -0,0 +1,132 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2020 The Regents of the University of California.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+import os
+import shutil
+import tempfile
+
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks
+import pmt
+import sparsdr
+from compressed_samples import data_sample, average_sample
+
+
+class qa_iqz_file(gr_unittest.TestCase):
+
+    def setUp(self):
+        self.directory = tempfile.mkdtemp()
+        self.path = os.path.join(self.directory, 'capture.iqz')
+        # 100 chunks of 10 samples. Times pass the 20-bit counter rollover
+        # several times. Bin 10 is only active in the first half.
+        self.items = []
+        for i in range(1000):
+            time = i * 5000
+            self.items += data_sample(time & 0xfffff, 10 if i < 500 else 900, i, 0)
+        tb = gr.top_block()
+        tb.connect(blocks.vector_source_i(self.items),
+                   sparsdr.iqz_file_sink(self.path, 10))
+        tb.run()
+
+    def tearDown(self):
+        shutil.rmtree(self.directory)
+
+    def read(self, *args):
+        tb = gr.top_block()
+        source = sparsdr.iqz_file_source(self.path, *args)
+        sink = blocks.vector_sink_i()
+        tb.connect(source, sink)
+        tb.run()
+        self.chunk_starts = [(tag.offset, pmt.to_uint64(tag.value))
+                             for tag in sink.tags()
+                             if pmt.symbol_to_string(tag.key) == 'chunk_start']
+        return source, list(sink.data())
+
+    def test_read_all(self):
+        source, items = self.read()
+        self.assertEqual(100, source.total_chunks())
+        self.assertEqual(100, source.selected_chunks())
+        self.assertEqual(self.items, items)
+
+    def test_time_range(self):
+        # Samples 500 through 519, after many rollovers
+        source, items = self.read(500 * 5000, 520 * 5000)
+        self.assertEqual(2, source.selected_chunks())
+        self.assertEqual(self.items[1000:1040], items)
+
+    def test_bin_range(self):
+        source, items = self.read(0, 2**64 - 1, 0, 11)
+        self.assertEqual(50, source.selected_chunks())
+        self.assertEqual(self.items[:1000], items)
+
+    def test_start_time(self):
+        # A capture that starts later on a shared timeline has the same
+        # samples at later expanded times
+        start_time = 7 << 20
+        tb = gr.top_block()
+        tb.connect(blocks.vector_source_i(self.items),
+                   sparsdr.iqz_file_sink(self.path, 10, start_time))
+        tb.run()
+        source, items = self.read(start_time + 500 * 5000,
+                                  start_time + 520 * 5000)
+        self.assertEqual(2, source.selected_chunks())
+        self.assertEqual(self.items[1000:1040], items)
+
+    def test_chunk_start_tags(self):
+        # Chunks alternate between bins 10 and 900, so the chunks for bin 10
+        # are not next to each other in the file
+        items = []
+        for i in range(40):
+            bin = 10 if i // 10 % 2 == 0 else 900
+            items += data_sample((i * 100000) & 0xfffff, bin, i, 0)
+        tb = gr.top_block()
+        tb.connect(blocks.vector_source_i(items),
+                   sparsdr.iqz_file_sink(self.path, 10))
+        tb.run()
+        source, read_items = self.read(0, 2**64 - 1, 0, 11)
+        self.assertEqual(2, source.selected_chunks())
+        self.assertEqual(items[0:20] + items[40:60], read_items)
+        self.assertEqual([(0, 0), (20, 20 * 100000)], self.chunk_starts)
+
+    def test_quiet_period(self):
+        # Only averages arrive for three rollovers of the 20-bit time. The
+        # data samples after that still get their real expanded time.
+        items = []
+        for i in range(10):
+            items += data_sample(i, 10, i, 0)
+        for row in range(1, 13):
+            items += average_sample(row * 0x40000, 0, 1000)
+        later = (3 << 20) + 100
+        for i in range(8):
+            items += data_sample(later, 10, i, 0)
+        tb = gr.top_block()
+        tb.connect(blocks.vector_source_i(items),
+                   sparsdr.iqz_file_sink(self.path, 10))
+        tb.run()
+        source, read_items = self.read(later, later + 1)
+        self.assertEqual(1, source.selected_chunks())
+        self.assertEqual(items[-20:], read_items)
+        # The chunk starts with the last two averages
+        self.assertEqual([(0, 11 * 0x40000)], self.chunk_starts)
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_iqz_file, "qa_iqz_file.xml")
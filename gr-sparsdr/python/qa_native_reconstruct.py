@@ -0,0 +1,237 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2020 The Regents of the University of California.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks
+import pmt
+import sparsdr
+from compressed_samples import data_sample, average_sample
+
+
+class qa_native_reconstruct(gr_unittest.TestCase):
+
+    def setUp(self):
+        self.tb = gr.top_block()
+
+    def tearDown(self):
+        self.tb = None
+
+    def run_reconstruct(self, items, bands, fill_gaps=False, tag_silence=False,
+            tag_bursts=False):
+        source = blocks.vector_source_i(items)
+        reconstruct = sparsdr.native_reconstruct(bands, fill_gaps, tag_silence,
+            tag_bursts)
+        sinks = [blocks.vector_sink_c() for _ in bands]
+        self.tb.connect(source, reconstruct)
+        for i, sink in enumerate(sinks):
+            self.tb.connect((reconstruct, i), sink)
+        self.tb.run()
+        self.sinks = sinks
+        return [sink.data() for sink in sinks]
+
+    def test_no_samples(self):
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2048)])
+        (output,) = self.run_reconstruct([], bands)
+        self.assertEqual(0, len(output))
+
+    def test_averages_ignored(self):
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2048)])
+        items = []
+        for time in range(4):
+            items += average_sample(time, 0, 1000)
+        (output,) = self.run_reconstruct(items, bands)
+        self.assertEqual(0, len(output))
+
+    def test_single_window(self):
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2048)])
+        (output,) = self.run_reconstruct(data_sample(0, 0, 1024, 0), bands)
+        # The only window is completed at the end of the input
+        self.assertEqual(2048, len(output))
+        self.assertNotEqual(0, abs(output[1024]))
+
+    def test_adjacent_windows(self):
+        bands = sparsdr.band_spec_vector([
+            sparsdr.band_spec(0.0, 2048),
+            # This band does not include bin 0, so it produces nothing
+            sparsdr.band_spec(10e6, 64),
+        ])
+        items = []
+        items += data_sample(0, 0, 1024, 0)
+        items += data_sample(1, 0, 1024, 0)
+        items += data_sample(5, 0, 1024, 0)
+        (full, narrow) = self.run_reconstruct(items, bands)
+        # First half of window 0, window 0 overlapped with window 1, the
+        # end of window 1, then all of window 5 at the end of the input
+        self.assertEqual(5120, len(full))
+        self.assertEqual(0, len(narrow))
+        # Overlapped samples have twice the amplitude of the first half
+        self.assertAlmostEqual(2.0, abs(full[1500]) / abs(full[0]), 4)
+
+    def gap_items(self):
+        items = []
+        for time in [0, 1, 5, 6]:
+            items += data_sample(time, 0, 1024, 0)
+        return items
+
+    def test_gaps_skipped(self):
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2048)])
+        (output,) = self.run_reconstruct(self.gap_items(), bands)
+        # Windows 0 and 1, then windows 5 and 6, with no space between them
+        self.assertEqual(6144, len(output))
+        self.assertNotEqual(0, abs(output[3500]))
+
+    def test_gaps_filled(self):
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2048)])
+        (output,) = self.run_reconstruct(self.gap_items(), bands,
+            fill_gaps=True, tag_silence=True)
+        # Windows 0 and 1 end at half-window 3 and window 5 starts at
+        # half-window 5, so two half-windows of zeros go between them
+        self.assertEqual(8192, len(output))
+        self.assertTrue(all(sample == 0 for sample in output[3072:5120]))
+        self.assertNotEqual(0, abs(output[5500]))
+        tags = self.sinks[0].tags()
+        self.assertEqual(1, len(tags))
+        self.assertEqual(3072, tags[0].offset)
+        self.assertEqual('silence', pmt.symbol_to_string(tags[0].key))
+        self.assertEqual(2048, pmt.to_uint64(tags[0].value))
+
+    def test_burst_tags(self):
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2048)])
+        (output,) = self.run_reconstruct(self.gap_items(), bands,
+            tag_bursts=True)
+        self.assertEqual(6144, len(output))
+        tags = sorted(self.sinks[0].tags(), key=lambda tag: tag.offset)
+        # Windows 0 and 1 are one burst, and windows 5 and 6 are another,
+        # which ends at the end of the input
+        self.assertEqual([(0, 'burst_start', 0), (3071, 'burst_end', 1),
+                (3072, 'burst_start', 5), (6143, 'burst_end', 6)],
+            [(tag.offset, pmt.symbol_to_string(tag.key),
+                pmt.to_uint64(pmt.dict_ref(tag.value, pmt.intern('time'),
+                    pmt.PMT_NIL)))
+                for tag in tags])
+        for tag in tags:
+            self.assertEqual(0, pmt.to_uint64(pmt.dict_ref(tag.value,
+                pmt.intern('band'), pmt.PMT_NIL)))
+
+    # A silence longer than one rollover of the 20-bit time counter, with
+    # the averages that the hardware keeps sending while no signals are
+    # present
+    LONG_SILENCE_END = 6 * 0x40000 + 100
+
+    def long_silence_items(self):
+        items = []
+        items += data_sample(0, 0, 1024, 0)
+        items += data_sample(1, 0, 1024, 0)
+        for step in range(1, 7):
+            items += average_sample((step * 0x40000) & 0xfffff, 0, 1000)
+        end = self.LONG_SILENCE_END
+        items += data_sample(end & 0xfffff, 0, 1024, 0)
+        items += data_sample((end + 1) & 0xfffff, 0, 1024, 0)
+        return items
+
+    def test_long_silence_burst_times(self):
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2048)])
+        (output,) = self.run_reconstruct(self.long_silence_items(), bands,
+            tag_bursts=True)
+        self.assertEqual(6144, len(output))
+        tags = sorted(self.sinks[0].tags(), key=lambda tag: tag.offset)
+        end = self.LONG_SILENCE_END
+        self.assertEqual([(0, 'burst_start', 0), (3071, 'burst_end', 1),
+                (3072, 'burst_start', end), (6143, 'burst_end', end + 1)],
+            [(tag.offset, pmt.symbol_to_string(tag.key),
+                pmt.to_uint64(pmt.dict_ref(tag.value, pmt.intern('time'),
+                    pmt.PMT_NIL)))
+                for tag in tags])
+
+    def test_long_silence_filled(self):
+        # Two bins make one output sample per half-window
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2)])
+        (output,) = self.run_reconstruct(self.long_silence_items(), bands,
+            fill_gaps=True, tag_silence=True)
+        end = self.LONG_SILENCE_END
+        # Windows 0 and 1 end at half-window 3 and the last window starts
+        # at half-window end, so end - 3 half-windows of zeros go between
+        self.assertEqual(end + 3, len(output))
+        self.assertTrue(all(sample == 0 for sample in output[3:end]))
+        tags = self.sinks[0].tags()
+        self.assertEqual(1, len(tags))
+        self.assertEqual(3, tags[0].offset)
+        self.assertEqual('silence', pmt.symbol_to_string(tags[0].key))
+        self.assertEqual(end - 3, pmt.to_uint64(tags[0].value))
+
+    def test_open_and_close_band(self):
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2048)])
+        items = []
+        for time in [0, 1, 5, 6, 10]:
+            items += data_sample(time, 0, 1024, 0)
+        source = blocks.vector_source_i(items)
+        reconstruct = sparsdr.native_reconstruct(bands, False, False, False, 2)
+        # The second slot reconstructs windows 5 and 6 only
+        reconstruct.open_band(1, sparsdr.band_spec(0.0, 2048), 5)
+        reconstruct.close_band(1, 7)
+        sinks = [blocks.vector_sink_c() for _ in range(2)]
+        self.tb.connect(source, reconstruct)
+        for i, sink in enumerate(sinks):
+            self.tb.connect((reconstruct, i), sink)
+        self.tb.run()
+        (fixed, opened) = [sink.data() for sink in sinks]
+        # Closing the band wrote the end of window 6
+        self.assertEqual(3072, len(opened))
+        # Windows 5 and 6 start after windows 0 and 1 in the fixed band
+        self.assertComplexTuplesAlmostEqual(fixed[3072:5120], opened[:2048], 4)
+        tags = sinks[1].tags()
+        self.assertEqual(1, len(tags))
+        self.assertEqual(0, tags[0].offset)
+        self.assertEqual('band_open', pmt.symbol_to_string(tags[0].key))
+        self.assertEqual(5, pmt.to_uint64(pmt.dict_ref(tags[0].value,
+            pmt.intern('time'), pmt.PMT_NIL)))
+
+    def test_open_band_after_long_silence(self):
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2048)])
+        source = blocks.vector_source_i(self.long_silence_items())
+        reconstruct = sparsdr.native_reconstruct(bands, False, False, False, 2)
+        # The time has rolled over since the last data sample, so the band
+        # opens only if the averages in the silence were counted
+        end = self.LONG_SILENCE_END
+        reconstruct.open_band(1, sparsdr.band_spec(0.0, 2048), end)
+        sinks = [blocks.vector_sink_c() for _ in range(2)]
+        self.tb.connect(source, reconstruct)
+        for i, sink in enumerate(sinks):
+            self.tb.connect((reconstruct, i), sink)
+        self.tb.run()
+        (fixed, opened) = [sink.data() for sink in sinks]
+        # The last two windows
+        self.assertEqual(3072, len(opened))
+        self.assertComplexTuplesAlmostEqual(fixed[3072:], opened, 4)
+        tags = sinks[1].tags()
+        self.assertEqual(1, len(tags))
+        self.assertEqual(end, pmt.to_uint64(pmt.dict_ref(tags[0].value,
+            pmt.intern('time'), pmt.PMT_NIL)))
+
+    def test_open_band_invalid_slot(self):
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2048)])
+        reconstruct = sparsdr.native_reconstruct(bands, False, False, False, 2)
+        with self.assertRaises(IndexError):
+            reconstruct.open_band(2, sparsdr.band_spec(0.0, 64))
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_native_reconstruct, "qa_native_reconstruct.xml")
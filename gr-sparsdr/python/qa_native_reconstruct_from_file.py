@@ -0,0 +1,95 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2020 The Regents of the University of California.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+import os
+import struct
+import tempfile
+
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks
+import sparsdr
+from compressed_samples import data_sample
+
+
+class qa_native_reconstruct_from_file(gr_unittest.TestCase):
+
+    def setUp(self):
+        self.tb = gr.top_block()
+        (fd, self.path) = tempfile.mkstemp(suffix='.iq')
+        os.close(fd)
+
+    def tearDown(self):
+        self.tb = None
+        os.remove(self.path)
+
+    def write_words(self, words):
+        with open(self.path, 'wb') as file:
+            file.write(struct.pack('<%di' % len(words), *words))
+
+    def run_from_file(self, bands, threads):
+        reconstruct = sparsdr.native_reconstruct_from_file(bands, self.path, threads)
+        sinks = [blocks.vector_sink_c() for _ in bands]
+        for i, sink in enumerate(sinks):
+            self.tb.connect((reconstruct, i), sink)
+        self.tb.run()
+        self.tb = gr.top_block()
+        return [sink.data() for sink in sinks]
+
+    def run_stream(self, words, bands):
+        source = blocks.vector_source_i(words)
+        reconstruct = sparsdr.native_reconstruct(bands)
+        sinks = [blocks.vector_sink_c() for _ in bands]
+        self.tb.connect(source, reconstruct)
+        for i, sink in enumerate(sinks):
+            self.tb.connect((reconstruct, i), sink)
+        self.tb.run()
+        self.tb = gr.top_block()
+        return [sink.data() for sink in sinks]
+
+    def test_empty_file(self):
+        self.write_words([])
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2048)])
+        (output,) = self.run_from_file(bands, 2)
+        self.assertEqual(0, len(output))
+
+    def test_matches_stream(self):
+        words = []
+        for time in [0, 1, 2, 7, 8, 100, 101, 102]:
+            for index in [0, 3, 1950]:
+                words += data_sample(time, index, (index % 100) * 10 + time, -time)
+        self.write_words(words)
+        bands = sparsdr.band_spec_vector([
+            sparsdr.band_spec(0.0, 2048),
+            sparsdr.band_spec(-5e6, 256),
+        ])
+        streamed = self.run_stream(words, bands)
+        for threads in [1, 4]:
+            from_file = self.run_from_file(bands, threads)
+            for (expected, actual) in zip(streamed, from_file):
+                # The file version also finishes the last window, so it
+                # produces more samples at the end
+                self.assertGreater(len(actual), len(expected))
+                self.assertComplexTuplesAlmostEqual(expected,
+                    actual[:len(expected)], 3)
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_native_reconstruct_from_file, "qa_native_reconstruct_from_file.xml")
@@ -0,0 +1,91 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2020 The Regents of the University of California.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+
+import pmt
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks
+import sparsdr
+from compressed_samples import data_sample
+
+PERIOD = 10
+WINDOW_DURATION = 10.24e-6
+# 100 samples per period
+CEILING = 100 * 8 / (PERIOD * WINDOW_DURATION)
+
+
+def make_items(rates):
+    """Returns data samples with evenly spaced times, with the number of
+    samples in each period taken from rates"""
+    items = []
+    for period, count in enumerate(rates):
+        for i in range(count):
+            time = period * PERIOD + i * PERIOD // count
+            items += data_sample(time, 0, 0, 0)
+    return items
+
+
+class qa_rate_governor(gr_unittest.TestCase):
+
+    def run_governor(self, governor, rates):
+        tb = gr.top_block()
+        throttle = blocks.message_debug()
+        raises = blocks.message_debug()
+        tb.connect(blocks.vector_source_i(make_items(rates)), governor)
+        tb.msg_connect((governor, 'throttle'), (throttle, 'store'))
+        tb.msg_connect((governor, 'raise'), (raises, 'store'))
+        tb.run()
+        levels = [pmt.to_uint64(pmt.dict_ref(throttle.get_message(i),
+                                             pmt.intern('level'), pmt.PMT_NIL))
+                  for i in range(throttle.num_messages())]
+        return levels, raises.num_messages()
+
+    def test_throttle_and_relax(self):
+        governor = sparsdr.rate_governor(None, CEILING, PERIOD, WINDOW_DURATION)
+        governor.set_relax_periods(2)
+        # Three periods above 90% of the ceiling, one in between, then
+        # five below 50%
+        levels, raises = self.run_governor(governor, [95] * 3 + [70] + [10] * 6)
+        self.assertEqual(levels, [1, 2, 3, 2, 1])
+        self.assertEqual(raises, 3)
+        stats = governor.stats()
+        self.assertEqual(stats.level, 1)
+        self.assertEqual(stats.raises, 3)
+        self.assertEqual(stats.relaxes, 2)
+
+    def test_below_ceiling(self):
+        governor = sparsdr.rate_governor(None, CEILING, PERIOD, WINDOW_DURATION)
+        levels, raises = self.run_governor(governor, [80] * 10)
+        self.assertEqual(levels, [])
+        self.assertAlmostEqual(governor.stats().measured_rate / CEILING, 0.8)
+
+    def test_invalid_settings(self):
+        with self.assertRaises(ValueError):
+            sparsdr.rate_governor(None, 0.0)
+        governor = sparsdr.rate_governor(None, CEILING)
+        with self.assertRaises(ValueError):
+            governor.set_fractions(0.5, 0.9)
+        with self.assertRaises(ValueError):
+            governor.set_relax_periods(0)
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_rate_governor)
@@ -0,0 +1,97 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2020 The Regents of the University of California.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+import shutil
+import unittest
+
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks
+import sparsdr
+from compressed_samples import data_sample
+
+
+def make_items():
+    """Returns compressed items with one data sample in each of 8 windows"""
+    items = []
+    for time in range(8):
+        items += data_sample(time, 1, 1000 * time, -500)
+    return items
+
+
+class qa_reconstruct(gr_unittest.TestCase):
+
+    def setUp(self):
+        self.tb = gr.top_block()
+
+    def tearDown(self):
+        self.tb = None
+
+    def run_reconstruct(self, items, bands, buffering, in_process=True):
+        source = blocks.vector_source_i(items)
+        reconstruct = sparsdr.reconstruct(bands, in_process=in_process,
+            buffering=buffering)
+        sinks = [blocks.vector_sink_c() for _ in bands]
+        self.tb.connect(source, reconstruct)
+        for i, sink in enumerate(sinks):
+            self.tb.connect((reconstruct, i), sink)
+        self.tb.run()
+        return [sink.data() for sink in sinks]
+
+    def test_buffering_does_not_change_output(self):
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2048),
+            sparsdr.band_spec(0.0, 64)])
+        items = make_items()
+        default = self.run_reconstruct(items, bands,
+            sparsdr.band_buffering_vector())
+        self.tb = gr.top_block()
+        tuned = self.run_reconstruct(items, bands, sparsdr.band_buffering_vector([
+            sparsdr.band_buffering.low_latency(),
+            sparsdr.band_buffering.recording()]))
+        self.assertEqual(default, tuned)
+        self.assertNotEqual(0, len(tuned[0]))
+
+    def test_buffering_count_must_match_bands(self):
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2048)])
+        buffering = sparsdr.band_buffering_vector([sparsdr.band_buffering(),
+            sparsdr.band_buffering()])
+        with self.assertRaises(ValueError):
+            sparsdr.reconstruct(bands, in_process=True, buffering=buffering)
+
+    @unittest.skipIf(shutil.which('sparsdr_reconstruct') is None,
+        'sparsdr_reconstruct is not installed')
+    def test_subprocess_band_buffering(self):
+        # The subprocess gets --band-buffering for each band. A flush
+        # interval must not lose or change any samples.
+        bands = sparsdr.band_spec_vector([sparsdr.band_spec(0.0, 2048),
+            sparsdr.band_spec(0.0, 64)])
+        items = make_items()
+        default = self.run_reconstruct(items, bands,
+            sparsdr.band_buffering_vector(), in_process=False)
+        self.tb = gr.top_block()
+        tuned = self.run_reconstruct(items, bands, sparsdr.band_buffering_vector([
+            sparsdr.band_buffering.low_latency(),
+            sparsdr.band_buffering.recording()]), in_process=False)
+        self.assertEqual(default, tuned)
+        self.assertNotEqual(0, len(tuned[0]))
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_reconstruct, "qa_reconstruct.xml")
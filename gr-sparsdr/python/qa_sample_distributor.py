@@ -21,6 +21,7 @@
 
 from gnuradio import gr, gr_unittest
 from gnuradio import blocks
+import pmt
 # import sparsdr_swig as sparsdr
 import sparsdr
 
@@ -45,6 +46,27 @@ class qa_sample_distributor(gr_unittest.TestCase):
         self.tb.run()
         # Nothing to check
 
+    def test_more_inputs_than_decoders(self):
+        # Each input releases the only decoder when it runs out of samples,
+        # so all samples eventually reach the output
+        inputs = [[float(i) for i in range(10)],
+                  [float(i) for i in range(100, 120)],
+                  [float(i) for i in range(200, 205)]]
+        sample_distributor = sparsdr.sample_distributor(gr.sizeof_float)
+        for i, items in enumerate(inputs):
+            self.tb.connect(blocks.vector_source_f(items), (sample_distributor, i))
+        sink = blocks.vector_sink_f()
+        self.tb.connect(sample_distributor, sink)
+        self.tb.run()
+        self.assertEqual(sorted(sum(inputs, [])), sorted(sink.data()))
+        stats = sample_distributor.stats()
+        self.assertGreaterEqual(stats.assignments, len(inputs))
+        # Source tags are only added when the input using the output changes
+        sources = [pmt.to_long(tag.value) for tag in sink.tags()
+                   if pmt.symbol_to_string(tag.key) == 'source']
+        self.assertEqual(set(range(len(inputs))), set(sources))
+        self.assertLessEqual(len(sources), stats.assignments)
+
 
 if __name__ == '__main__':
     gr_unittest.run(qa_sample_distributor, "qa_sample_distributor.xml")
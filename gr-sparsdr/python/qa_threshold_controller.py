@@ -0,0 +1,97 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2020 The Regents of the University of California.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks
+import sparsdr
+from compressed_samples import data_sample, average_sample
+
+# Rows of averages are 64 time steps (10.24 us each) apart
+AVERAGE_INTERVAL = 64
+WINDOW_DURATION = 10.24e-6
+ROW_DURATION = AVERAGE_INTERVAL * WINDOW_DURATION
+
+
+def make_items(rows, data_per_row, magnitude=10000):
+    """Returns rows of averages with the same magnitude in every bin,
+    each followed by some data samples"""
+    items = []
+    for row in range(rows):
+        time = row * AVERAGE_INTERVAL
+        for index in range(2048):
+            items += average_sample(time, index, magnitude)
+        for i in range(data_per_row):
+            time_offset = 1 + i * (AVERAGE_INTERVAL - 2) // data_per_row
+            items += data_sample(time + time_offset, i % 2048, 0, 0)
+    return items
+
+
+class qa_threshold_controller(gr_unittest.TestCase):
+
+    def run_controller(self, controller, items):
+        tb = gr.top_block()
+        tb.connect(blocks.vector_source_i(items), controller)
+        tb.run()
+
+    def test_rate_above_target(self):
+        # 500 data samples per row, target 100
+        controller = sparsdr.threshold_controller(None, 100 / ROW_DURATION,
+                                                  AVERAGE_INTERVAL, 8.0,
+                                                  WINDOW_DURATION)
+        controller.set_update_rows(2)
+        controller.set_max_writes(2048)
+        self.run_controller(controller, make_items(9, 500))
+        stats = controller.stats()
+        # Four updates, each limited to a factor of 2
+        self.assertEqual(stats.updates, 4)
+        self.assertAlmostEqual(stats.margin, 8.0 * 16)
+        self.assertAlmostEqual(stats.measured_rate, 500 / ROW_DURATION, places=0)
+        thresholds = controller.thresholds()
+        self.assertEqual(len(thresholds), 2048)
+        self.assertEqual(thresholds[5], 8 * 16 * 10000)
+
+    def test_rate_within_hysteresis(self):
+        controller = sparsdr.threshold_controller(None, 450 / ROW_DURATION,
+                                                  AVERAGE_INTERVAL, 8.0,
+                                                  WINDOW_DURATION)
+        controller.set_update_rows(2)
+        self.run_controller(controller, make_items(9, 500))
+        stats = controller.stats()
+        self.assertEqual(stats.updates, 4)
+        self.assertAlmostEqual(stats.margin, 8.0)
+        # Only the first update writes thresholds
+        self.assertEqual(stats.threshold_writes, 2048)
+
+    def test_invalid_settings(self):
+        controller = sparsdr.threshold_controller(None, 1000.0, AVERAGE_INTERVAL)
+        with self.assertRaises(ValueError):
+            controller.set_hysteresis(1.0)
+        with self.assertRaises(ValueError):
+            controller.set_max_step(1.0)
+        with self.assertRaises(ValueError):
+            controller.set_threshold_range(10, 5)
+        with self.assertRaises(ValueError):
+            sparsdr.threshold_controller(None, 0.0, AVERAGE_INTERVAL)
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_threshold_controller)
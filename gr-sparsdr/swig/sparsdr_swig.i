@@ -8,12 +8,24 @@
 %include "std_vector.i"
 %{
 #include "sparsdr/band_spec.h"
+#include "sparsdr/band_buffering.h"
+#include "sparsdr/mask_range.h"
 %}
 %include "sparsdr/band_spec.h"
+%include "sparsdr/band_buffering.h"
+%include "sparsdr/mask_range.h"
 
-// Required to support the bands argument in the reconstruct block make function
+// Required to support the bands and buffering arguments in the reconstruct
+// block make function, the mask argument of
+// compressing_usrp_source::set_mask, the masks argument of
+// real_time_receiver::make, and compression_config::differences
+%include "std_string.i"
 namespace std {
     %template(band_spec_vector) vector<::gr::sparsdr::band_spec>;
+    %template(band_buffering_vector) vector<::gr::sparsdr::band_buffering>;
+    %template(bool_vector) vector<bool>;
+    %template(mask_range_vector) vector<::gr::sparsdr::mask_range>;
+    %template(string_vector) vector<string>;
 }
 
 %include "gnuradio.i"			// the common stuff
@@ -22,13 +34,24 @@ namespace std {
 %include "sparsdr_swig_doc.i"
 
 %{
+#include "sparsdr/auto_masker.h"
 #include "sparsdr/average_detector.h"
+#include "sparsdr/capture_sink.h"
+#include "sparsdr/iqz_file_sink.h"
+#include "sparsdr/iqz_file_source.h"
 #include "sparsdr/real_time_receiver.h"
+#include "sparsdr/capture_index.h"
+#include "sparsdr/multi_device_receiver.h"
 #include "sparsdr/multi_sniffer.h"
 #include "sparsdr/reconstruct.h"
 #include "sparsdr/reconstruct_from_file.h"
+#include "sparsdr/native_reconstruct.h"
+#include "sparsdr/native_reconstruct_from_file.h"
 #include "sparsdr/mask_range.h"
+#include "sparsdr/compression_config.h"
 #include "sparsdr/compressing_usrp_source.h"
+#include "sparsdr/threshold_controller.h"
+#include "sparsdr/rate_governor.h"
 #include "sparsdr/average_waterfall.h"
 #include "sparsdr/sample_distributor.h"
 #include "sparsdr/tagged_wavfile_sink.h"
@@ -37,16 +60,40 @@ using namespace gr::sparsdr;
 
 %include "sparsdr/average_detector.h"
 GR_SWIG_BLOCK_MAGIC2(sparsdr, average_detector);
+%include "sparsdr/capture_sink.h"
+GR_SWIG_BLOCK_MAGIC2(sparsdr, capture_sink);
+%include "sparsdr/iqz_file_sink.h"
+GR_SWIG_BLOCK_MAGIC2(sparsdr, iqz_file_sink);
+%include "sparsdr/iqz_file_source.h"
+GR_SWIG_BLOCK_MAGIC2(sparsdr, iqz_file_source);
 %include "sparsdr/real_time_receiver.h"
 GR_SWIG_BLOCK_MAGIC2(sparsdr, real_time_receiver);
 %include "sparsdr/multi_sniffer.h"
 GR_SWIG_BLOCK_MAGIC2(sparsdr, multi_sniffer);
 %include "sparsdr/reconstruct.h"
 GR_SWIG_BLOCK_MAGIC2(sparsdr, reconstruct);
+// Required to support the return value of reconstruct::band_stats
+%template(reconstruct_pipe_stats_vector) std::vector<::gr::sparsdr::reconstruct_pipe_stats>;
 %include "sparsdr/reconstruct_from_file.h"
 GR_SWIG_BLOCK_MAGIC2(sparsdr, reconstruct_from_file);
+%include "sparsdr/native_reconstruct.h"
+GR_SWIG_BLOCK_MAGIC2(sparsdr, native_reconstruct);
+%include "sparsdr/native_reconstruct_from_file.h"
+GR_SWIG_BLOCK_MAGIC2(sparsdr, native_reconstruct_from_file);
+%include "sparsdr/compression_config.h"
 %include "sparsdr/compressing_usrp_source.h"
 GR_SWIG_BLOCK_MAGIC2(sparsdr, compressing_usrp_source);
+%include "sparsdr/threshold_controller.h"
+GR_SWIG_BLOCK_MAGIC2(sparsdr, threshold_controller);
+%include "sparsdr/auto_masker.h"
+GR_SWIG_BLOCK_MAGIC2(sparsdr, auto_masker);
+%include "sparsdr/rate_governor.h"
+GR_SWIG_BLOCK_MAGIC2(sparsdr, rate_governor);
+%include "sparsdr/capture_index.h"
+// Required to support the usrps argument of multi_device_receiver::make
+%template(compressing_usrp_source_sptr_vector) std::vector<gr::sparsdr::compressing_usrp_source::sptr>;
+%include "sparsdr/multi_device_receiver.h"
+GR_SWIG_BLOCK_MAGIC2(sparsdr, multi_device_receiver);
 %include "sparsdr/average_waterfall.h"
 GR_SWIG_BLOCK_MAGIC2(sparsdr, average_waterfall);
 
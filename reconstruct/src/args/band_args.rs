@@ -19,6 +19,7 @@ use std::error::Error;
 use std::fmt;
 use std::path::PathBuf;
 use std::str::FromStr;
+use std::time::Duration;
 
 /// Arguments used to set up a band to be decompressed
 #[derive(Debug)]
@@ -31,6 +32,8 @@ pub struct BandArgs {
     pub path: Option<PathBuf>,
     /// Window time log path
     pub time_log_path: Option<PathBuf>,
+    /// Output buffering, or None to use the default
+    pub buffering: Option<BufferArgs>,
 }
 
 impl FromStr for BandArgs {
@@ -56,6 +59,47 @@ impl FromStr for BandArgs {
             center_frequency: frequency,
             path,
             time_log_path,
+            buffering: None,
+        })
+    }
+}
+
+/// Arguments that control the buffering of a band output
+#[derive(Debug, Clone)]
+pub struct BufferArgs {
+    /// Number of bytes to buffer before writing, or 0 to write immediately
+    pub capacity: usize,
+    /// Longest time to keep samples in the buffer, or None to keep them until the buffer is full
+    pub flush_interval: Option<Duration>,
+}
+
+impl FromStr for BufferArgs {
+    type Err = ParseError;
+
+    /// Parses BufferArgs from `bytes:flush_interval_ms`
+    fn from_str(s: &str) -> Result<Self, Self::Err> {
+        let mut parts = s.split(':');
+        let capacity: &str = parts.next().ok_or(ParseError::Format)?;
+        let flush_interval: &str = parts.next().ok_or(ParseError::Format)?;
+        if parts.next().is_some() {
+            return Err(ParseError::Format);
+        }
+
+        let capacity = capacity
+            .parse::<usize>()
+            .map_err(|_| ParseError::BufferSize)?;
+        let flush_interval = flush_interval
+            .parse::<u64>()
+            .map_err(|_| ParseError::FlushInterval)?;
+        let flush_interval = if flush_interval == 0 {
+            None
+        } else {
+            Some(Duration::from_millis(flush_interval))
+        };
+
+        Ok(BufferArgs {
+            capacity,
+            flush_interval,
         })
     }
 }
@@ -69,6 +113,10 @@ pub enum ParseError {
     BinNumber,
     /// Center frequency parse failure
     CenterFrequency,
+    /// Buffer size parse failure
+    BufferSize,
+    /// Flush interval parse failure
+    FlushInterval,
 }
 
 impl fmt::Display for ParseError {
@@ -77,8 +125,62 @@ impl fmt::Display for ParseError {
             ParseError::Format => write!(f, "Invalid format, expected bins:frequency:path"),
             ParseError::BinNumber => write!(f, "Invalid bin number value"),
             ParseError::CenterFrequency => write!(f, "Invalid center frequency value"),
+            ParseError::BufferSize => write!(f, "Invalid buffer size value"),
+            ParseError::FlushInterval => write!(f, "Invalid flush interval value"),
         }
     }
 }
 
 impl Error for ParseError {}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    #[test]
+    fn test_buffer_args_with_interval() {
+        let args = BufferArgs::from_str("65536:20").unwrap();
+        assert_eq!(args.capacity, 65536);
+        assert_eq!(args.flush_interval, Some(Duration::from_millis(20)));
+    }
+    #[test]
+    fn test_buffer_args_zero_interval() {
+        let args = BufferArgs::from_str("4096:0").unwrap();
+        assert_eq!(args.capacity, 4096);
+        assert_eq!(args.flush_interval, None);
+    }
+    #[test]
+    fn test_buffer_args_unbuffered() {
+        let args = BufferArgs::from_str("0:0").unwrap();
+        assert_eq!(args.capacity, 0);
+        assert_eq!(args.flush_interval, None);
+    }
+    #[test]
+    fn test_buffer_args_missing_interval() {
+        match BufferArgs::from_str("4096") {
+            Err(ParseError::Format) => {}
+            other => panic!("Unexpected result {:?}", other),
+        }
+    }
+    #[test]
+    fn test_buffer_args_extra_part() {
+        match BufferArgs::from_str("4096:10:5") {
+            Err(ParseError::Format) => {}
+            other => panic!("Unexpected result {:?}", other),
+        }
+    }
+    #[test]
+    fn test_buffer_args_bad_size() {
+        match BufferArgs::from_str("-1:10") {
+            Err(ParseError::BufferSize) => {}
+            other => panic!("Unexpected result {:?}", other),
+        }
+    }
+    #[test]
+    fn test_buffer_args_bad_interval() {
+        match BufferArgs::from_str("4096:1.5") {
+            Err(ParseError::FlushInterval) => {}
+            other => panic!("Unexpected result {:?}", other),
+        }
+    }
+}
@@ -25,7 +25,7 @@ use std::str::FromStr;
 use clap::{App, Arg};
 use simplelog::LevelFilter;
 
-pub use self::band_args::BandArgs;
+pub use self::band_args::{BandArgs, BufferArgs};
 
 #[derive(Debug)]
 pub struct Args {
@@ -33,6 +33,8 @@ pub struct Args {
     pub source_path: Option<PathBuf>,
     /// Enable buffering for source and destination
     pub buffer: bool,
+    /// Source and band paths are shared-memory rings instead of files
+    pub shared_memory: bool,
     /// Bandwidth of the signal before compression
     pub compressed_bandwidth: f32,
     /// Bands to decompress
@@ -111,6 +113,15 @@ impl Args {
                 Arg::with_name("unbuffered")
                     .long("unbuffered")
                     .help("Disables buffering on the source and destination"),
+            ).arg(
+                Arg::with_name("shared_memory")
+                    .long("shared-memory")
+                    .requires("source")
+                    .help(
+                        "Treats the source and band output paths as shared-memory ring buffers \
+                         (usually /dev/fd/[descriptor] for a descriptor inherited from the parent \
+                         process) instead of files",
+                    ),
             ).arg(
                 Arg::with_name("log_level")
                     .long("log-level")
@@ -131,6 +142,21 @@ impl Args {
                 .conflicts_with_all(&["destination", "bins", "center_frequency"])
                 .validator(validate::<BandArgs>)
             )
+            .arg(Arg::with_name("band_buffering")
+                .long("band-buffering")
+                .takes_value(true)
+                .multiple(true)
+                .number_of_values(1)
+                .value_name("bytes:flush_interval_ms")
+                .help("The number of bytes to buffer before writing a band's output (0 to write \
+                    each sample immediately), and the longest time in milliseconds to keep \
+                    samples in the buffer (0 to keep them until the buffer is full). If this \
+                    argument is used, it must be repeated once for each --decompress-band \
+                    argument, in the same order. Otherwise, --unbuffered controls the buffering \
+                    of all bands.")
+                .requires("decompress_band")
+                .validator(validate::<BufferArgs>)
+            )
             .arg(Arg::with_name("no_progress")
                 .long("no-progress-bar")
                 .help("Disables the command-line progress bar")
@@ -158,7 +184,7 @@ impl Args {
 
         let buffer = !matches.is_present("unbuffered");
 
-        let bands = if let Some(band_strings) = matches.values_of("decompress_band") {
+        let mut bands: Vec<BandArgs> = if let Some(band_strings) = matches.values_of("decompress_band") {
             // New multi-band version
             band_strings
                 .map(|s| BandArgs::from_str(s).unwrap())
@@ -174,13 +200,31 @@ impl Args {
                     .unwrap(),
                 path: matches.value_of("destination").map(PathBuf::from),
                 time_log_path: None,
+                buffering: None,
             };
             vec![band]
         };
 
+        if let Some(buffering_strings) = matches.values_of("band_buffering") {
+            let buffering: Vec<BufferArgs> = buffering_strings
+                .map(|s| BufferArgs::from_str(s).unwrap())
+                .collect();
+            if buffering.len() != bands.len() {
+                clap::Error::with_description(
+                    "--band-buffering must be used once for each --decompress-band",
+                    clap::ErrorKind::WrongNumberOfValues,
+                )
+                .exit();
+            }
+            for (band, buffering) in bands.iter_mut().zip(buffering) {
+                band.buffering = Some(buffering);
+            }
+        }
+
         Args {
             source_path: matches.value_of_os("source").map(PathBuf::from),
             buffer,
+            shared_memory: matches.is_present("shared_memory"),
             compressed_bandwidth: matches
                 .value_of("compressed_bandwidth")
                 .unwrap()
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2019 The Regents of the University of California
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+//! A writer that flushes its destination at a minimum interval
+
+use std::io::{Result, Write};
+use std::sync::mpsc::{self, RecvTimeoutError, Sender};
+use std::sync::{Arc, Mutex};
+use std::thread::{self, JoinHandle};
+use std::time::{Duration, Instant};
+
+use log::warn;
+
+/// Wraps a buffered writer and flushes it no later than the flush interval after data was
+/// written to it
+///
+/// This limits how long samples can wait in a buffer, even if no more samples arrive. A write
+/// flushes if at least the interval has passed since the last flush, and a background thread
+/// flushes buffered data that would otherwise wait longer.
+pub struct FlushInterval<W> {
+    /// The destination and flush state, shared with the flush thread
+    inner: Arc<Mutex<Inner<W>>>,
+    /// The minimum time between flushes
+    interval: Duration,
+    /// Dropped to stop the flush thread
+    stop: Option<Sender<()>>,
+    /// The flush thread
+    thread: Option<JoinHandle<()>>,
+}
+
+/// The part of a FlushInterval that the flush thread uses
+struct Inner<W> {
+    /// The destination
+    writer: W,
+    /// The time of the last flush
+    last_flush: Instant,
+    /// True if data has been written since the last flush
+    dirty: bool,
+}
+
+impl<W> Inner<W>
+where
+    W: Write,
+{
+    fn flush(&mut self) -> Result<()> {
+        self.last_flush = Instant::now();
+        self.dirty = false;
+        self.writer.flush()
+    }
+}
+
+impl<W> FlushInterval<W>
+where
+    W: Write + Send + 'static,
+{
+    /// Creates a writer that flushes inner after at least interval
+    pub fn new(inner: W, interval: Duration) -> Self {
+        let inner = Arc::new(Mutex::new(Inner {
+            writer: inner,
+            last_flush: Instant::now(),
+            dirty: false,
+        }));
+        let (stop, stopped) = mpsc::channel();
+        let thread_inner = Arc::clone(&inner);
+        let thread = thread::spawn(move || loop {
+            let wait = {
+                let mut inner = thread_inner.lock().unwrap();
+                let elapsed = inner.last_flush.elapsed();
+                if !inner.dirty {
+                    interval
+                } else if elapsed >= interval {
+                    if let Err(e) = inner.flush() {
+                        warn!("Failed to flush output: {}", e);
+                    }
+                    interval
+                } else {
+                    interval - elapsed
+                }
+            };
+            match stopped.recv_timeout(wait) {
+                Err(RecvTimeoutError::Timeout) => {}
+                _ => break,
+            }
+        });
+        FlushInterval {
+            inner,
+            interval,
+            stop: Some(stop),
+            thread: Some(thread),
+        }
+    }
+}
+
+impl<W> Write for FlushInterval<W>
+where
+    W: Write,
+{
+    fn write(&mut self, buf: &[u8]) -> Result<usize> {
+        let mut inner = self.inner.lock().unwrap();
+        let written = inner.writer.write(buf)?;
+        inner.dirty = true;
+        if inner.last_flush.elapsed() >= self.interval {
+            inner.flush()?;
+        }
+        Ok(written)
+    }
+
+    fn flush(&mut self) -> Result<()> {
+        self.inner.lock().unwrap().flush()
+    }
+}
+
+impl<W> Drop for FlushInterval<W> {
+    fn drop(&mut self) {
+        // Dropping the sender wakes up the flush thread and makes it exit
+        self.stop.take();
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    /// A writer that counts flushes
+    struct CountFlushes {
+        flushes: usize,
+    }
+
+    impl Write for CountFlushes {
+        fn write(&mut self, buf: &[u8]) -> Result<usize> {
+            Ok(buf.len())
+        }
+        fn flush(&mut self) -> Result<()> {
+            self.flushes += 1;
+            Ok(())
+        }
+    }
+
+    fn flushes(writer: &FlushInterval<CountFlushes>) -> usize {
+        writer.inner.lock().unwrap().writer.flushes
+    }
+
+    #[test]
+    fn test_no_flush_before_interval() {
+        let mut writer = FlushInterval::new(CountFlushes { flushes: 0 }, Duration::from_secs(60));
+        for _ in 0..10 {
+            writer.write_all(&[1, 2, 3]).unwrap();
+        }
+        assert_eq!(flushes(&writer), 0);
+    }
+    #[test]
+    fn test_flush_after_interval_without_writes() {
+        let mut writer = FlushInterval::new(CountFlushes { flushes: 0 }, Duration::from_millis(10));
+        writer.write_all(&[1]).unwrap();
+        assert_eq!(flushes(&writer), 0);
+        // The flush thread flushes the data without waiting for another write
+        thread::sleep(Duration::from_millis(100));
+        assert_eq!(flushes(&writer), 1);
+    }
+    #[test]
+    fn test_no_flush_without_data() {
+        let writer = FlushInterval::new(CountFlushes { flushes: 0 }, Duration::from_millis(10));
+        thread::sleep(Duration::from_millis(50));
+        assert_eq!(flushes(&writer), 0);
+    }
+    #[test]
+    fn test_explicit_flush_passes_through() {
+        let mut writer = FlushInterval::new(CountFlushes { flushes: 0 }, Duration::from_secs(60));
+        writer.flush().unwrap();
+        assert_eq!(flushes(&writer), 1);
+    }
+}
@@ -67,6 +67,7 @@ use sparsdr_reconstruct::input::iqzip::CompressedSamples;
 use sparsdr_reconstruct::{decompress, BandSetupBuilder, DecompressSetup};
 
 mod args;
+mod flush_interval;
 mod setup;
 
 use std::io::{self, Read};
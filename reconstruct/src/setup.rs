@@ -20,9 +20,15 @@ use std::io::{self, BufReader, BufWriter, Read, Result, Write};
 
 use simplelog::LevelFilter;
 use log::debug;
+use sparsdr_reconstruct::steps::shared_ring::{SharedRingReader, SharedRingWriter};
 
 use super::args::Args;
-use super::args::BandArgs;
+use super::args::{BandArgs, BufferArgs};
+use super::flush_interval::FlushInterval;
+
+/// Number of bytes to buffer for each band output, if buffering is enabled and not configured
+/// for the band
+const DEFAULT_BUFFER_CAPACITY: usize = 8192;
 
 /// The setup for a decompression operation
 ///
@@ -65,10 +71,19 @@ pub struct BandSetup {
 impl Setup {
     pub fn from_args(args: Args) -> Result<Self> {
         let buffer = args.buffer;
+        let shared_memory = args.shared_memory;
         // Open source and get length
         // The order of opening (source, then output files) is important to prevent deadlock
         // when using named pipes.
         let source: Box<dyn Read + Send> = match args.source_path {
+            Some(ref path) if args.shared_memory => {
+                debug!("Opening ring {} to read compressed samples", path.display());
+                if args.buffer {
+                    Box::new(BufReader::new(SharedRingReader::open(path)?))
+                } else {
+                    Box::new(SharedRingReader::open(path)?)
+                }
+            }
             Some(ref path) => {
                 debug!("Opening file {} to read compressed samples", path.display());
                 if args.buffer {
@@ -87,8 +102,10 @@ impl Setup {
                 }
             }
         };
+        // The size of a ring is not the length of its contents
         let source_length = args
             .source_path
+            .filter(|_| !shared_memory)
             .and_then(|path| fs::metadata(path).ok())
             .map(|data| data.len())
             .filter(|&length| length != 0);
@@ -97,7 +114,7 @@ impl Setup {
         let bands = args
             .bands
             .into_iter()
-            .map(|band_args| BandSetup::from_args(band_args, buffer))
+            .map(|band_args| BandSetup::from_args(band_args, buffer, shared_memory))
             .collect::<Result<Vec<BandSetup>>>()?;
 
         let input_time_log: Option<Box<dyn Write>> = match args.input_time_log_path {
@@ -123,27 +140,41 @@ impl Setup {
 }
 
 impl BandSetup {
-    fn from_args(args: BandArgs, buffer: bool) -> Result<Self> {
+    fn from_args(args: BandArgs, buffer: bool, shared_memory: bool) -> Result<Self> {
         // Open destination
         let destination: Box<dyn Write + Send> = match args.path {
+            Some(ref path) if shared_memory => {
+                debug!("Opening ring {} for output", path.display());
+                Box::new(SharedRingWriter::open(path)?)
+            }
             Some(ref path) => {
                 debug!("Opening file {} for output", path.display());
-                if buffer {
-                    Box::new(BufWriter::new(File::create(path)?))
-                } else {
-                    Box::new(File::create(path)?)
-                }
+                Box::new(File::create(path)?)
             }
             None => {
                 // Standard output
                 debug!("Writing output to standard output");
-                if buffer {
-                    Box::new(BufWriter::new(io::stdout()))
-                } else {
-                    Box::new(io::stdout())
-                }
+                Box::new(io::stdout())
             }
         };
+        let buffering = args.buffering.unwrap_or(BufferArgs {
+            capacity: if buffer { DEFAULT_BUFFER_CAPACITY } else { 0 },
+            flush_interval: None,
+        });
+        let destination: Box<dyn Write + Send> = match buffering {
+            BufferArgs { capacity: 0, .. } => destination,
+            BufferArgs {
+                capacity,
+                flush_interval: None,
+            } => Box::new(BufWriter::with_capacity(capacity, destination)),
+            BufferArgs {
+                capacity,
+                flush_interval: Some(interval),
+            } => Box::new(FlushInterval::new(
+                BufWriter::with_capacity(capacity, destination),
+                interval,
+            )),
+        };
 
         let time_log: Option<Box<dyn Write + Send>> = match args.time_log_path {
             Some(path) => Some(Box::new(BufWriter::new(File::create(path)?))),
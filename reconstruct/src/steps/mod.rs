@@ -26,5 +26,6 @@ pub mod frequency_correct;
 pub mod group;
 pub mod overlap;
 pub mod phase_correct;
+pub mod shared_ring;
 pub mod shift;
 pub mod writer;
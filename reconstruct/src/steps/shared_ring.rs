@@ -0,0 +1,377 @@
+/*
+ * Copyright 2019 The Regents of the University of California
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+//!
+//! Shared-memory ring buffers for exchanging samples with another process
+//!
+//! A ring is a shared memory file, usually a memfd created by the other process and inherited
+//! by this one. It has a 4096-byte header followed by a data area whose size is a power of two.
+//! All header integers use the native byte order.
+//!
+//! | Offset | Type | Written by | Contents |
+//! |--------|------|------------|----------|
+//! | 0 | u32 | creator | Magic number "SRNG" (0x474e5253) |
+//! | 4 | u32 | creator | Version (1) |
+//! | 8 | u64 | creator | Capacity of the data area in bytes |
+//! | 64 | u64 | writer | Write position (total bytes written) |
+//! | 72 | u32 | writer | Data futex, incremented to wake the reader |
+//! | 76 | u32 | reader | 1 if the reader is waiting for data |
+//! | 80 | u32 | writer | 1 if the writer has closed the ring |
+//! | 128 | u64 | reader | Read position (total bytes read) |
+//! | 136 | u32 | reader | Space futex, incremented to wake the writer |
+//! | 140 | u32 | writer | 1 if the writer is waiting for space |
+//! | 144 | u32 | reader | 1 if the reader has closed the ring |
+//!
+//! Byte n of the stream is at offset 4096 + n % capacity.
+//!
+//! After changing a position or a closed flag, each side checks if the other side is waiting.
+//! If it is, it increments the other side's futex and wakes it. A side that has nothing to do
+//! sets its waiting flag, checks again, and then waits on its futex with a timeout.
+//!
+//! The same layout is implemented in C++ in gr-sparsdr.
+//!
+
+use std::cmp;
+use std::fs::OpenOptions;
+use std::io::{self, ErrorKind, Read, Write};
+use std::os::unix::io::AsRawFd;
+use std::path::Path;
+use std::ptr;
+use std::sync::atomic::{self, AtomicU32, AtomicU64, Ordering};
+
+use libc;
+
+/// Magic number at the start of the header
+const MAGIC: u32 = 0x474e_5253;
+/// Supported version
+const VERSION: u32 = 1;
+/// Size of the header before the data area
+const HEADER_SIZE: usize = 4096;
+
+// Header field offsets
+const MAGIC_OFFSET: usize = 0;
+const VERSION_OFFSET: usize = 4;
+const CAPACITY_OFFSET: usize = 8;
+const WRITE_POSITION_OFFSET: usize = 64;
+const DATA_FUTEX_OFFSET: usize = 72;
+const READER_WAITING_OFFSET: usize = 76;
+const WRITER_CLOSED_OFFSET: usize = 80;
+const READ_POSITION_OFFSET: usize = 128;
+const SPACE_FUTEX_OFFSET: usize = 136;
+const WRITER_WAITING_OFFSET: usize = 140;
+const READER_CLOSED_OFFSET: usize = 144;
+
+/// The longest time to wait on a futex before checking the ring again
+const WAIT_TIMEOUT_NS: libc::c_long = 100_000_000;
+/// Futex operations (from linux/futex.h)
+const FUTEX_WAIT: libc::c_int = 0;
+const FUTEX_WAKE: libc::c_int = 1;
+
+/// A mapped ring
+struct Ring {
+    /// The start of the header
+    base: *mut u8,
+    /// The length of the mapping
+    length: usize,
+    /// The capacity of the data area
+    capacity: usize,
+    /// The process that was the parent of this process when the ring was opened
+    ///
+    /// If the parent changes, the other side of the ring has exited.
+    parent: libc::pid_t,
+}
+
+// The ring is only accessed through atomic header fields and the parts of the data area that
+// the other side is not using
+unsafe impl Send for Ring {}
+
+impl Ring {
+    fn open<P>(path: P) -> io::Result<Self>
+    where
+        P: AsRef<Path>,
+    {
+        let file = OpenOptions::new().read(true).write(true).open(path)?;
+        let length = file.metadata()?.len() as usize;
+        if length < HEADER_SIZE {
+            return Err(invalid_ring());
+        }
+        let base = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                length,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        if base == libc::MAP_FAILED {
+            return Err(io::Error::last_os_error());
+        }
+        // The mapping stays valid after the file is closed
+        let mut ring = Ring {
+            base: base as *mut u8,
+            length,
+            capacity: 0,
+            parent: unsafe { libc::getppid() },
+        };
+        let capacity = ring.field64(CAPACITY_OFFSET).load(Ordering::Relaxed) as usize;
+        if ring.field32(MAGIC_OFFSET).load(Ordering::Acquire) != MAGIC
+            || ring.field32(VERSION_OFFSET).load(Ordering::Relaxed) != VERSION
+            || !capacity.is_power_of_two()
+            || HEADER_SIZE + capacity > length
+        {
+            return Err(invalid_ring());
+        }
+        ring.capacity = capacity;
+        Ok(ring)
+    }
+
+    fn field64(&self, offset: usize) -> &AtomicU64 {
+        unsafe { &*(self.base.add(offset) as *const AtomicU64) }
+    }
+
+    fn field32(&self, offset: usize) -> &AtomicU32 {
+        unsafe { &*(self.base.add(offset) as *const AtomicU32) }
+    }
+
+    /// Returns true if the other side has exited
+    fn other_side_exited(&self) -> bool {
+        unsafe { libc::getppid() != self.parent }
+    }
+
+    /// Waits on a futex until ready returns true, the futex changes, or the timeout passes
+    fn wait<F>(&self, waiting_offset: usize, futex_offset: usize, ready: F)
+    where
+        F: Fn() -> bool,
+    {
+        let futex = self.field32(futex_offset);
+        let sequence = futex.load(Ordering::Acquire);
+        self.field32(waiting_offset).store(1, Ordering::SeqCst);
+        // Check again after setting the flag, so that a wake from the other side can't be missed
+        atomic::fence(Ordering::SeqCst);
+        if !ready() {
+            let timeout = libc::timespec {
+                tv_sec: 0,
+                tv_nsec: WAIT_TIMEOUT_NS,
+            };
+            let futex_ptr: *const AtomicU32 = futex;
+            let timeout_ptr: *const libc::timespec = &timeout;
+            unsafe {
+                libc::syscall(
+                    libc::SYS_futex,
+                    futex_ptr,
+                    FUTEX_WAIT,
+                    sequence,
+                    timeout_ptr,
+                    ptr::null::<u32>(),
+                    0,
+                );
+            }
+        }
+        self.field32(waiting_offset).store(0, Ordering::Relaxed);
+    }
+
+    /// Wakes the other side if its waiting flag is set
+    fn wake(&self, waiting_offset: usize, futex_offset: usize) {
+        atomic::fence(Ordering::SeqCst);
+        if self.field32(waiting_offset).load(Ordering::Relaxed) != 0 {
+            let futex = self.field32(futex_offset);
+            futex.fetch_add(1, Ordering::Release);
+            let futex_ptr: *const AtomicU32 = futex;
+            unsafe {
+                libc::syscall(
+                    libc::SYS_futex,
+                    futex_ptr,
+                    FUTEX_WAKE,
+                    libc::c_int::max_value(),
+                    ptr::null::<libc::timespec>(),
+                    ptr::null::<u32>(),
+                    0,
+                );
+            }
+        }
+    }
+
+    /// Returns a pointer to the byte at a stream position in the data area
+    fn data_at(&self, position: u64) -> *mut u8 {
+        let offset = (position as usize) & (self.capacity - 1);
+        unsafe { self.base.add(HEADER_SIZE + offset) }
+    }
+}
+
+impl Drop for Ring {
+    fn drop(&mut self) {
+        unsafe {
+            libc::munmap(self.base as *mut libc::c_void, self.length);
+        }
+    }
+}
+
+fn invalid_ring() -> io::Error {
+    io::Error::new(ErrorKind::InvalidData, "Not a shared-memory ring")
+}
+
+/// Reads from a shared-memory ring
+///
+/// Reads wait until data is available. A read returns 0 (end of file) when the writer has
+/// closed the ring and all data has been read, or when the parent process has exited.
+pub struct SharedRingReader {
+    ring: Ring,
+}
+
+impl SharedRingReader {
+    /// Opens and maps a ring for reading
+    pub fn open<P>(path: P) -> io::Result<Self>
+    where
+        P: AsRef<Path>,
+    {
+        Ok(SharedRingReader {
+            ring: Ring::open(path)?,
+        })
+    }
+}
+
+impl Read for SharedRingReader {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        if buf.is_empty() {
+            return Ok(0);
+        }
+        let ring = &self.ring;
+        let write_field = ring.field64(WRITE_POSITION_OFFSET);
+        let read_field = ring.field64(READ_POSITION_OFFSET);
+        let closed_field = ring.field32(WRITER_CLOSED_OFFSET);
+        let read_position = read_field.load(Ordering::Relaxed);
+        loop {
+            // Check the closed flag first, so that data written before the writer closed the
+            // ring is seen
+            let closed = closed_field.load(Ordering::Acquire) != 0;
+            let available = write_field.load(Ordering::Acquire).wrapping_sub(read_position) as usize;
+            if available != 0 {
+                let count = cmp::min(available, buf.len());
+                let offset = (read_position as usize) & (ring.capacity - 1);
+                let first = cmp::min(count, ring.capacity - offset);
+                unsafe {
+                    ptr::copy_nonoverlapping(ring.data_at(read_position), buf.as_mut_ptr(), first);
+                    ptr::copy_nonoverlapping(
+                        ring.data_at(0),
+                        buf.as_mut_ptr().add(first),
+                        count - first,
+                    );
+                }
+                read_field.store(read_position.wrapping_add(count as u64), Ordering::Release);
+                ring.wake(WRITER_WAITING_OFFSET, SPACE_FUTEX_OFFSET);
+                return Ok(count);
+            }
+            if closed || ring.other_side_exited() {
+                return Ok(0);
+            }
+            ring.wait(READER_WAITING_OFFSET, DATA_FUTEX_OFFSET, || {
+                write_field.load(Ordering::Acquire) != read_position
+                    || closed_field.load(Ordering::Acquire) != 0
+            });
+        }
+    }
+}
+
+impl Drop for SharedRingReader {
+    fn drop(&mut self) {
+        self.ring
+            .field32(READER_CLOSED_OFFSET)
+            .store(1, Ordering::Release);
+        self.ring.wake(WRITER_WAITING_OFFSET, SPACE_FUTEX_OFFSET);
+    }
+}
+
+/// Writes to a shared-memory ring
+///
+/// Writes wait until space is available. A write fails with a broken pipe error if the reader
+/// has closed the ring or the parent process has exited. Dropping the writer closes the ring.
+pub struct SharedRingWriter {
+    ring: Ring,
+}
+
+impl SharedRingWriter {
+    /// Opens and maps a ring for writing
+    pub fn open<P>(path: P) -> io::Result<Self>
+    where
+        P: AsRef<Path>,
+    {
+        Ok(SharedRingWriter {
+            ring: Ring::open(path)?,
+        })
+    }
+}
+
+impl Write for SharedRingWriter {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        if buf.is_empty() {
+            return Ok(0);
+        }
+        let ring = &self.ring;
+        let write_field = ring.field64(WRITE_POSITION_OFFSET);
+        let read_field = ring.field64(READ_POSITION_OFFSET);
+        let closed_field = ring.field32(READER_CLOSED_OFFSET);
+        let write_position = write_field.load(Ordering::Relaxed);
+        let capacity = ring.capacity;
+        let free_space = || {
+            capacity - write_position.wrapping_sub(read_field.load(Ordering::Acquire)) as usize
+        };
+        loop {
+            if closed_field.load(Ordering::Acquire) != 0 || ring.other_side_exited() {
+                return Err(io::Error::new(
+                    ErrorKind::BrokenPipe,
+                    "Shared-memory ring reader closed",
+                ));
+            }
+            let space = free_space();
+            if space != 0 {
+                let count = cmp::min(space, buf.len());
+                let offset = (write_position as usize) & (capacity - 1);
+                let first = cmp::min(count, capacity - offset);
+                unsafe {
+                    ptr::copy_nonoverlapping(buf.as_ptr(), ring.data_at(write_position), first);
+                    ptr::copy_nonoverlapping(
+                        buf.as_ptr().add(first),
+                        ring.data_at(0),
+                        count - first,
+                    );
+                }
+                write_field.store(write_position.wrapping_add(count as u64), Ordering::Release);
+                ring.wake(READER_WAITING_OFFSET, DATA_FUTEX_OFFSET);
+                return Ok(count);
+            }
+            ring.wait(WRITER_WAITING_OFFSET, SPACE_FUTEX_OFFSET, || {
+                free_space() != 0 || closed_field.load(Ordering::Acquire) != 0
+            });
+        }
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        // Writes are visible to the reader immediately
+        Ok(())
+    }
+}
+
+impl Drop for SharedRingWriter {
+    fn drop(&mut self) {
+        self.ring
+            .field32(WRITER_CLOSED_OFFSET)
+            .store(1, Ordering::Release);
+        self.ring.wake(READER_WAITING_OFFSET, DATA_FUTEX_OFFSET);
+    }
+}